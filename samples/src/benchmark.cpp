@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file benchmark.cpp
+ * @brief easy-performance-analyzer demo that benchmarks two ways of computing a remainder with EZP_BENCH
+ * @date 2026-10-18
+ */
+
+#include<ezp.hpp>
+
+volatile unsigned int divisor = 101;
+volatile unsigned int mask = 127;
+unsigned int y = 0;
+
+void modulo(){
+    for(int j=0;j<1000;j++)
+        y = (y + 28138481u) % divisor;
+}
+
+void bitmask(){
+    for(int j=0;j<1000;j++)
+        y = (y + 28138481u) & mask;
+}
+
+int main(){
+    EZP_ENABLE
+
+    EZP_BENCH("MOD", modulo)
+    EZP_BENCH("MASK", bitmask)
+
+    //A looser precision stops earlier
+    EZP_SET_BENCH_LIMITS(5, 200)
+    EZP_BENCH("MOD5", modulo)
+
+    //Benchmarks are offline analysis blocks too
+    EZP_PRINT_OFFLINE
+    return 0;
+}
@@ -27,7 +27,7 @@
 int main(int argc, char** argv){
     int* y = new int;
 
-    printf("%s: Instrumented code running, run `ezp_control --enable` to remotely enable instrumentation, `ezp_control --disable` to remotely disable instrumentation, `ezp_control --print` to print offline analysis information and `ezp_control --clear` to clear offline analysis history on demand.\n",argv[0]);
+    printf("%s: Instrumented code running, run `ezp_control --enable` to remotely enable instrumentation, `ezp_control --disable` to remotely disable instrumentation, `ezp_control --print` to print offline analysis information, `ezp_control --smooth` to print smoothed analysis information and `ezp_control --clear` to clear offline analysis history on demand.\n",argv[0]);
 
     while(true){
 
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file function-hooks.cpp
+ * @brief easy-performance-analyzer demo that analyzes functions without instrumenting them by hand
+ * @date 2026-10-18
+ *
+ * Compiled with -finstrument-functions, linked with libezp_hooks and with -rdynamic so that functions have names
+ */
+
+#include<ezp.hpp>
+
+int* y;
+
+void spin(int iterations){
+    for(int j=0;j<iterations;j++){
+        *y += 28138481u;
+        *y = 623415232 % *y;
+    }
+}
+
+int fibonacci(int n){
+    spin(1000);
+    return n < 2 ? n : fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+static void shortLoop(){
+    spin(100000);
+}
+
+void longLoop(){
+    spin(1000000);
+}
+
+int main(int argc, char** argv){
+    y = new int;
+
+    printf("%s: Instrumented code running...\n", argv[0]);
+
+    EZP_ENABLE
+    EZP_SET_FUNCTION_HOOKS(true)
+
+    //spin() is called too often to be worth analyzing on its own
+    EZP_DISABLE_FUNCTIONS(&spin, (char*)&spin + 1)
+
+    for(int i=0;i<100;i++){
+        shortLoop();
+        longLoop();
+    }
+    printf("%s: fibonacci(15) = %d\n", argv[0], fibonacci(15));
+
+    EZP_PRINT_OFFLINE
+
+    return 0;
+}
@@ -36,6 +36,10 @@
 #elif defined(EZP_SAMPLE_SMOOTHED)
     #define EZP_SAMPLE_START EZP_START_SMOOTH
     #define EZP_SAMPLE_END EZP_END_SMOOTH
+#elif defined(EZP_SAMPLE_FLAT)
+    typedef ezp::BasicAnalyzer<ezp::TscClock, ezp::FlatStorage<ezp::TscClock, 1024>, ezp::NullSink> FlatAnalyzer;
+    #define EZP_SAMPLE_START(BLOCK_NAME) FlatAnalyzer::start(BLOCK_NAME);
+    #define EZP_SAMPLE_END(BLOCK_NAME) FlatAnalyzer::end(BLOCK_NAME);
 #else
     #define EZP_SAMPLE_START EZP_START_OFFLINE
     #define EZP_SAMPLE_END EZP_END_OFFLINE
@@ -61,7 +65,6 @@ unsigned long long int maxstarttime[nblocks];
 unsigned long long int maxendtime[nblocks];
 unsigned long long int t,mt;
 unsigned long long int overhead = UINT_MAX;
-
 inline void measureAndDiscard(const char* argv_0){
     for(int s=0;s<dsamples;s++){
         for(int i=0;i<nsamples;i++)
@@ -138,6 +141,27 @@ __attribute__((optimize("unroll-loops"))) inline unsigned long long int getMeasu
     return mt/4/(nsamples*nblocks);
 }
 
+inline double getPairTime(){
+
+    //Times the instrumentation calls themselves on one block that is already
+    //known, i.e. the steady state of every start/end pair in the application,
+    //thread ID lookup included
+
+    EZP_SAMPLE_START("pair")
+    EZP_SAMPLE_END("pair")
+
+    EZP_META_MEASURE_BEGIN
+
+    for(int i=0;i<nsamples*nblocks;i++){
+        EZP_SAMPLE_START("pair")
+        EZP_SAMPLE_END("pair")
+    }
+
+    EZP_META_MEASURE_END
+
+    return (double)mt/(nsamples*nblocks);
+}
+
 int main(int argc, char** argv){
     for(int b=0;b<nblocks;b++){
         avgstarttimes[b] = 0;
@@ -166,6 +190,12 @@ int main(int argc, char** argv){
 
     printf("%s: Measurement overhead is measured as %lld ns\n", argv[0], overhead);
 
+    //
+    //Measure a known block's start/end pair without per-call measurement
+    //
+
+    printf("%s: Start/end pair on a known block, no per-call measurement: %.1f ns\n", argv[0], getPairTime());
+
     //
     //Measure instrumentation performance
     //
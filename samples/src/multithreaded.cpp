@@ -18,6 +18,10 @@
 /**
  * @file multithreaded.cpp
  * @brief easy-performance-analyzer demo that shows multithreading support
+ *
+ * With EZP_SAMPLE_STRESS, it rather enables and disables instrumentation remotely at high frequency while threads are
+ * instrumented, then checks that no run is lost or counted twice and that statistics are consistent; to be run with WITH_TSAN
+ * and registered with ctest
  * @author Ayberk Özgür
  * @date 2014-10-19
  */
@@ -27,6 +31,148 @@
 
 #include<ezp.hpp>
 
+#if defined(EZP_SAMPLE_STRESS)
+
+#include<cmath>
+#include<cstdlib>
+#include<string>
+#include<vector>
+
+const int N = 4;
+const int ntoggles = 1000;
+const int nfinal = 10000;
+volatile bool toggling = true;
+unsigned long long iterations[N];
+int numFailures = 0;
+
+void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+//Instrumentation calls as tight as possible while the analysis session is toggled from outside, then a known number of them
+void* run(void* arg){
+    unsigned long long* count = (unsigned long long*)arg;
+
+    printf("Thread launched\n");
+
+    while(__atomic_load_n(&toggling, __ATOMIC_RELAXED)){
+        EZP_START_OFFLINE("TGT")
+        (*count)++;
+        EZP_END_OFFLINE("TGT")
+    }
+
+    //Instrumentation is enabled for good by now, none of these may be lost
+    for(int i=0;i<nfinal;i++){
+        EZP_START_OFFLINE("FIN")
+        EZP_END_OFFLINE("FIN")
+    }
+
+    printf("Thread exited after %llu iterations\n", *count);
+
+    pthread_exit(NULL);
+}
+
+//Goes through the command listener like ezp_control would
+void* toggle(void* arg){
+    for(int i=0;i<ntoggles;i++){
+        EZP_ENABLE_REMOTE
+        EZP_DISABLE_REMOTE
+    }
+    EZP_ENABLE_REMOTE
+
+    //The listener handles commands in order, so all toggles are applied once it answers this one
+    EZP_PRINT_OPEN_REMOTE
+
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief Gets the columns of the summed row of a block in an offline report in CSV, empty if there is none
+ */
+std::vector<std::string> getSummedRow(const std::string& csv, const char* block){
+    std::vector<std::string> columns;
+    std::string prefix = std::string("summed,,,\"") + block + "\",";
+    size_t begin = csv.find("\n" + prefix);
+    if(begin == std::string::npos)
+        return columns;
+    begin++;
+    size_t end = csv.find('\n', begin);
+    std::string row = csv.substr(begin, end - begin);
+    size_t from = 0, to;
+    while((to = row.find(',', from)) != std::string::npos){
+        columns.push_back(row.substr(from, to - from));
+        from = to + 1;
+    }
+    columns.push_back(row.substr(from));
+    return columns;
+}
+
+//Columns of the CSV report
+enum{ CALLS = 4, TOTAL = 5, AVERAGE = 6, P50 = 7, P90 = 8, P99 = 9 };
+
+int main(int argc, char** argv){
+    pthread_t threads[N];
+    pthread_t toggler;
+
+    //Launch the command listener before anything is sent to it, under a name of its own to run along other tests
+    EZP_SET_CONTROL_NAME("ezp_test_stress")
+    EZP_START_OFFLINE("MAIN")
+
+    for(int i=0;i<N;i++){
+        iterations[i] = 0;
+        pthread_create(&threads[i],NULL,run,(void*)&iterations[i]);
+    }
+    pthread_create(&toggler,NULL,toggle,NULL);
+
+    pthread_join(toggler,NULL);
+    __atomic_store_n(&toggling, false, __ATOMIC_RELAXED);
+    for(int i=0;i<N;i++)
+        pthread_join(threads[i],NULL);
+
+    EZP_END_OFFLINE("MAIN")
+    EZP_PRINT_OFFLINE
+
+    //Exited threads are summed in their retired bucket, the summed rows hold every run
+    std::string csv;
+    EZP_FORMAT_OFFLINE(csv, CSV)
+    unsigned long long totalIterations = 0;
+    for(int i=0;i<N;i++)
+        totalIterations += iterations[i];
+
+    std::vector<std::string> fin = getSummedRow(csv, "FIN");
+    std::vector<std::string> tgt = getSummedRow(csv, "TGT");
+    check(fin.size() > P99 && tgt.size() > P99, "FIN and TGT have summed rows");
+    if(fin.size() > P99 && tgt.size() > P99){
+        check(strtoull(fin[CALLS].c_str(), NULL, 10) == (unsigned long long)N*nfinal, "no run is lost while enabled");
+        check(strtoull(tgt[CALLS].c_str(), NULL, 10) <= totalIterations, "no run is counted twice while toggled");
+
+        //A torn begin time or counter shows as an average that does not match or an absurd time
+        const std::vector<std::string>* rows[] = {&fin, &tgt};
+        for(int r=0;r<2;r++){
+            const std::vector<std::string>& row = *rows[r];
+            unsigned long long calls = strtoull(row[CALLS].c_str(), NULL, 10);
+            unsigned long long total = strtoull(row[TOTAL].c_str(), NULL, 10);
+            double average = strtod(row[AVERAGE].c_str(), NULL);
+            check(calls > 0 && fabs((double)total/calls - average) < 1.0, "average is total over calls");
+            check(total <= calls*1000000000ULL, "no run takes a second");
+            check(strtod(row[P50].c_str(), NULL) <= strtod(row[P90].c_str(), NULL) &&
+                    strtod(row[P90].c_str(), NULL) <= strtod(row[P99].c_str(), NULL), "percentiles are ordered");
+        }
+    }
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n", argv[0], numFailures);
+        return 1;
+    }
+    printf("%s: All checks passed\n", argv[0]);
+    return 0;
+}
+
+#else
+
 void* run(void* arg){
     int* y = new int;
     const char* cmd = (const char*)arg;
@@ -75,3 +221,4 @@ int main(int argc, char** argv){
     return 0;
 }
 
+#endif
@@ -22,59 +22,141 @@
  * @date 2014-10-15
  */
 
-#include"ezp.hpp"
+#include"ezp_internal.hpp"
 
 namespace ezp{
 
-///////////////////////////////////////////////////////////////////////////////
-//Platform-dependent defs
-///////////////////////////////////////////////////////////////////////////////
-
-#define EZP_CLOCK CLOCK_THREAD_CPUTIME_ID
-#ifdef ANDROID
-#define EZP_GET_TID gettid()
-#else
-#define EZP_GET_TID syscall(SYS_gettid)
-#endif
-
-#ifdef ANDROID
-#define EZP_PRINT(...) __android_log_print(ANDROID_LOG_INFO, ezp::EasyPerformanceAnalyzer::androidTag, __VA_ARGS__)
-#define EZP_PERR(...) (ezp::EasyPerformanceAnalyzer::forceStderr ? fprintf(stderr,__VA_ARGS__) :__android_log_print(ANDROID_LOG_ERROR, ezp::EasyPerformanceAnalyzer::androidTag, __VA_ARGS__))
-#else
-#define EZP_PRINT(...) printf(__VA_ARGS__)
-#define EZP_PERR(...) fprintf(stderr,__VA_ARGS__)
-#endif
-
 ///////////////////////////////////////////////////////////////////////////////
 //Static members
 ///////////////////////////////////////////////////////////////////////////////
 
 const char* EasyPerformanceAnalyzer::androidTag = "EZP";
-const char* EasyPerformanceAnalyzer::cmdSocketName = "\0ezp_control";
+EnabledFlag EasyPerformanceAnalyzer::enabled;
+const char* EasyPerformanceAnalyzer::cmdSocketName = "ezp_control";
+pid_t EasyPerformanceAnalyzer::cmdSocketPid = 0;
+pid_t EasyPerformanceAnalyzer::parentSocketPid = -1;
+pid_t EasyPerformanceAnalyzer::remotePid = 0;
+int EasyPerformanceAnalyzer::cmdAcceptor = -1;
 
 pthread_t EasyPerformanceAnalyzer::cmdListener;
 
-bool EasyPerformanceAnalyzer::listenerRunning = false;
-bool EasyPerformanceAnalyzer::enabled = false;
+unsigned int EasyPerformanceAnalyzer::state = 0;
 bool EasyPerformanceAnalyzer::forceStderr = false;
 
+float EasyPerformanceAnalyzer::smoothPrintInterval = 0.0f;
+float EasyPerformanceAnalyzer::benchPrecision = 0.01f;
+float EasyPerformanceAnalyzer::benchBudget = 1000.0f;
+bool EasyPerformanceAnalyzer::exportPerThread = false;
+EasyPerformanceAnalyzer::ThreadAggregation EasyPerformanceAnalyzer::threadAggregation = EasyPerformanceAnalyzer::AGGREGATE_TID;
+
+bool EasyPerformanceAnalyzer::exporterRunning = false;
+pthread_t EasyPerformanceAnalyzer::metricsExporter;
+int EasyPerformanceAnalyzer::exporterAcceptor = -1;
+
 Blk2Clk EasyPerformanceAnalyzer::blocks(BlockKey::compare);
 Blk2SMarker EasyPerformanceAnalyzer::smoothBlocks(BlockKey::compare);
 Blk2AMarker EasyPerformanceAnalyzer::offlineBlocks(BlockKey::compare);
+unsigned int EasyPerformanceAnalyzer::offlineGeneration = 0;
+AggregateMarker* EasyPerformanceAnalyzer::offlineRecords[EZP_MAX_DUMPED_BLOCKS];
+unsigned int EasyPerformanceAnalyzer::numOfflineRecords = 0;
+
+unsigned short EasyPerformanceAnalyzer::blockIdSlots[EZP_BLOCK_ID_TABLE_SIZE];
+unsigned int EasyPerformanceAnalyzer::blockIdNames[EZP_MAX_BLOCK_IDS];
+unsigned int EasyPerformanceAnalyzer::numBlockIds = 0;
+unsigned int EasyPerformanceAnalyzer::disabledBlocks[EZP_MAX_BLOCK_IDS/32];
+FilterRules EasyPerformanceAnalyzer::blockFilters;
+FilterRules EasyPerformanceAnalyzer::threadFilters;
+
+unsigned long long EasyPerformanceAnalyzer::traceThresholds[EZP_MAX_BLOCK_IDS];
+unsigned int EasyPerformanceAnalyzer::numTraceThresholds = 0;
+unsigned int EasyPerformanceAnalyzer::numTraces = 0;
+unsigned int EasyPerformanceAnalyzer::nextTraceIndex = 0;
+pthread_mutex_t EasyPerformanceAnalyzer::traceLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t EasyPerformanceAnalyzer::traceCond = PTHREAD_COND_INITIALIZER;
+TraceSnapshot* EasyPerformanceAnalyzer::traceQueue = NULL;
+TraceSnapshot* EasyPerformanceAnalyzer::traceQueueTail = NULL;
+unsigned int EasyPerformanceAnalyzer::numQueuedTraces = 0;
+bool EasyPerformanceAnalyzer::traceWriterRunning = false;
+bool EasyPerformanceAnalyzer::flushTracesRegistered = false;
+char EasyPerformanceAnalyzer::tracePath[PATH_MAX] = "ezp_trace";
+
+unsigned char EasyPerformanceAnalyzer::cpuNodes[EZP_MAX_CPUS];
+pthread_once_t EasyPerformanceAnalyzer::cpuNodesOnce = PTHREAD_ONCE_INIT;
+
+AllocCounters* (*EasyPerformanceAnalyzer::allocCountersGetter)() = NULL;
+pthread_once_t EasyPerformanceAnalyzer::allocCountersGetterOnce = PTHREAD_ONCE_INIT;
+
+unsigned short EasyPerformanceAnalyzer::functionSlots[EZP_FUNCTION_TABLE_SIZE];
+void* EasyPerformanceAnalyzer::functionAddresses[EZP_MAX_FUNCTIONS];
+unsigned int EasyPerformanceAnalyzer::numFunctions = 0;
+unsigned int EasyPerformanceAnalyzer::disabledFunctions[EZP_MAX_FUNCTIONS/32];
+AddressRules EasyPerformanceAnalyzer::functionFilters;
+bool EasyPerformanceAnalyzer::stopFunctionHooksRegistered = false;
+__thread unsigned int EasyPerformanceAnalyzer::openFunctions[EZP_MAX_FUNCTION_DEPTH];
+__thread unsigned int EasyPerformanceAnalyzer::numOpenFunctions = 0;
+
+unsigned long long EasyPerformanceAnalyzer::samplingPeriod = 0;
+bool EasyPerformanceAnalyzer::samplingBacktraces = false;
+unsigned int EasyPerformanceAnalyzer::samplingGeneration = 0;
+pthread_once_t EasyPerformanceAnalyzer::samplingHandlerOnce = PTHREAD_ONCE_INIT;
+
+pthread_mutex_t EasyPerformanceAnalyzer::recordLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t EasyPerformanceAnalyzer::recordCond = PTHREAD_COND_INITIALIZER;
+FILE* EasyPerformanceAnalyzer::recordFile = NULL;
+bool EasyPerformanceAnalyzer::recordStopping = false;
+RecordHeader EasyPerformanceAnalyzer::recordHeader;
+RecordBuffer* EasyPerformanceAnalyzer::recordQueue = NULL;
+RecordBuffer* EasyPerformanceAnalyzer::recordQueueTail = NULL;
+RecordBuffer* EasyPerformanceAnalyzer::freeRecordBuffers = NULL;
+unsigned int EasyPerformanceAnalyzer::numRecordBuffers = 0;
+pthread_t EasyPerformanceAnalyzer::recordEncoder;
+bool EasyPerformanceAnalyzer::stopRecordingRegistered = false;
+
+__thread TID EasyPerformanceAnalyzer::cachedTid = 0;
+pthread_once_t EasyPerformanceAnalyzer::forkHandlersOnce = PTHREAD_ONCE_INIT;
+__thread ThreadInfo* EasyPerformanceAnalyzer::currentThread = NULL;
+pthread_key_t EasyPerformanceAnalyzer::threadKey;
+pthread_once_t EasyPerformanceAnalyzer::threadKeyOnce = PTHREAD_ONCE_INIT;
+Tid2Thread EasyPerformanceAnalyzer::threads;
+Name2Thread EasyPerformanceAnalyzer::retiredPools;
+std::vector<AggregateMarker*> EasyPerformanceAnalyzer::freeOfflineMarkers;
+size_t EasyPerformanceAnalyzer::numOfflineMarkers = 0;
+size_t EasyPerformanceAnalyzer::numPreallocatedMarkers = 0;
+
+unsigned int EasyPerformanceAnalyzer::maxRecords = 0;
+unsigned int EasyPerformanceAnalyzer::maxPools = 0;
+unsigned int EasyPerformanceAnalyzer::traceRingSize = EZP_TRACE_RING_SIZE;
+unsigned long long EasyPerformanceAnalyzer::numOverflows = 0;
+size_t PoolAllocatorBase::freeBytes = 0;
+
+SharedHeader* EasyPerformanceAnalyzer::sharedStats = NULL;
+SharedRecord* EasyPerformanceAnalyzer::sharedRecords = NULL;
+bool EasyPerformanceAnalyzer::sharedStatsPending = false;
+
+char EasyPerformanceAnalyzer::exitDumpPath[PATH_MAX];
+char EasyPerformanceAnalyzer::signalDumpPath[PATH_MAX];
+int EasyPerformanceAnalyzer::dumpLock = 0;
+
+bool EasyPerformanceAnalyzer::childMerging = false;
+bool EasyPerformanceAnalyzer::mergeAtExitRegistered = false;
 
 pthread_mutex_t EasyPerformanceAnalyzer::listenerLauncherLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t EasyPerformanceAnalyzer::exporterLauncherLock = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t EasyPerformanceAnalyzer::lock = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t EasyPerformanceAnalyzer::smoothLock = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t EasyPerformanceAnalyzer::offlineLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t EasyPerformanceAnalyzer::threadLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t EasyPerformanceAnalyzer::filterLock = PTHREAD_MUTEX_INITIALIZER;
 
 ///////////////////////////////////////////////////////////////////////////////
 //Functions
 ///////////////////////////////////////////////////////////////////////////////
 
 //This function is not time critical
-void EasyPerformanceAnalyzer::controlRemote(Command cmd)
+void EasyPerformanceAnalyzer::controlRemote(Command cmd, const char* arg)
 {
     struct sockaddr_un addr;
+    socklen_t addrLen;
     int fd;
 
     if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1){
@@ -82,50 +164,100 @@ void EasyPerformanceAnalyzer::controlRemote(Command cmd)
         return;
     }
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, cmdSocketName, sizeof(addr.sun_path) - 1);
+    getCmdSocketAddress(remotePid, addr, addrLen);
 
-    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1){
+    if(connect(fd, (struct sockaddr*)&addr, addrLen) == -1){
         EZP_PERR("EZP: connect() error: %s\n",strerror(errno));
         EZP_PERR("EZP: Make sure that there is an EZP instrumented code running on this machine.\n");
         EZP_PERR("EZP: Control listener does not start until the first EZP_START* or EZP_BEGIN_CONTROL is encountered!\n");
+        close(fd);
         return;
     }
 
-    int ret;
+    //Commands are one character followed by an optional argument and a null character
+    std::string msg;
     switch(cmd){
         case CMD_ENABLE:
-            ret = write(fd,"e",2);
+            msg = "e";
             break;
         case CMD_DISABLE:
-            ret = write(fd,"d",2);
+            msg = "d";
             break;
         case CMD_PRINT:
-            ret = write(fd,"p",2);
+            msg = "p";
             break;
         case CMD_CLEAR:
-            ret = write(fd,"c",2);
+            msg = "c";
+            break;
+        case CMD_PRINT_SMOOTH:
+            msg = "s";
+            break;
+        case CMD_PRINT_JSON:
+            msg = "j";
+            break;
+        case CMD_PRINT_CSV:
+            msg = "v";
+            break;
+        case CMD_ENABLE_BLOCKS:
+            msg = "B";
+            break;
+        case CMD_DISABLE_BLOCKS:
+            msg = "b";
+            break;
+        case CMD_ENABLE_THREADS:
+            msg = "T";
+            break;
+        case CMD_DISABLE_THREADS:
+            msg = "t";
+            break;
+        case CMD_RESET_FILTERS:
+            msg = "r";
+            break;
+        case CMD_SET_TRACE_THRESHOLD:
+            msg = "x";
+            break;
+        case CMD_PRINT_OPEN:
+            msg = "o";
+            break;
+        case CMD_PRINT_MEMORY:
+            msg = "M";
+            break;
+        case CMD_RECORD:
+            msg = "R";
             break;
     }
+    msg += std::string(arg).substr(0, EZP_MAX_CMD_LENGTH - 2);
+    msg += '\0';
+
+    int ret = write(fd, msg.data(), msg.size());
     if(ret < 0)
         EZP_PERR("EZP: write() error: %s\n",strerror(errno));
-    else if(ret < 2)
+    else if(ret < (int)msg.size())
         EZP_PERR("EZP: write() error: Could not write command completely\n");
 
+    //Some commands are answered over the socket, forward the answer to our stdout
+    else if(cmd == CMD_PRINT_JSON || cmd == CMD_PRINT_CSV || cmd == CMD_PRINT_OPEN || cmd == CMD_PRINT_MEMORY){
+        char buf[4096];
+        while((ret = read(fd, buf, sizeof(buf))) > 0)
+            fwrite(buf, 1, ret, stdout);
+        if(ret < 0)
+            EZP_PERR("EZP: read() error: %s\n",strerror(errno));
+        fflush(stdout);
+    }
+
     close(fd);
 }
 
 //This function is not time critical
-void EasyPerformanceAnalyzer::control(Command cmd)
+void EasyPerformanceAnalyzer::control(Command cmd, const char* arg)
 {
     switch(cmd){
         case CMD_ENABLE:
-            enabled = true;
+            setState(STATE_ENABLED, true);
             EZP_PRINT("EZP: Enabled local instrumentation.\n");
             break;
         case CMD_DISABLE:
-            enabled = false;
+            setState(STATE_ENABLED, false);
             EZP_PRINT("EZP: Disabled local instrumentation.\n");
             break;
         case CMD_PRINT:
@@ -134,101 +266,253 @@ void EasyPerformanceAnalyzer::control(Command cmd)
         case CMD_CLEAR:
             clearOfflineProfiles();
             break;
+        case CMD_PRINT_SMOOTH:
+            printSmoothProfiles();
+            break;
+        case CMD_PRINT_JSON:
+            writeOfflineProfiles(stdout, FORMAT_JSON);
+            break;
+        case CMD_PRINT_CSV:
+            writeOfflineProfiles(stdout, FORMAT_CSV);
+            break;
+        case CMD_ENABLE_BLOCKS:
+            setBlockFilter(arg, true);
+            break;
+        case CMD_DISABLE_BLOCKS:
+            setBlockFilter(arg, false);
+            break;
+        case CMD_ENABLE_THREADS:
+            setThreadFilter(arg, true);
+            break;
+        case CMD_DISABLE_THREADS:
+            setThreadFilter(arg, false);
+            break;
+        case CMD_RESET_FILTERS:
+            resetFilters();
+            break;
+        case CMD_SET_TRACE_THRESHOLD:
+            parseTraceThreshold(arg);
+            break;
+        case CMD_PRINT_OPEN:
+            {
+                std::string output;
+                formatOpenBlocks(output);
+                fwrite(output.data(), 1, output.size(), stdout);
+                fflush(stdout);
+            }
+            break;
+        case CMD_PRINT_MEMORY:
+            {
+                std::string output;
+                formatMemoryUsage(output);
+                fwrite(output.data(), 1, output.size(), stdout);
+                fflush(stdout);
+            }
+            break;
+        case CMD_RECORD:
+            if(arg[0] != '\0')
+                startRecording(arg);
+            else
+                stopRecording();
+            break;
     }
 }
 
+//This function is not time critical
+bool EasyPerformanceAnalyzer::isEnabled()
+{
+    return __atomic_load_n(&state, __ATOMIC_ACQUIRE) & STATE_ENABLED;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setEnabled(bool on)
+{
+    setState(STATE_ENABLED, on);
+}
+
+//This function is not time critical
+EnabledFlag_t::operator bool() const
+{
+    return EasyPerformanceAnalyzer::isEnabled();
+}
+
+//This function is not time critical
+EnabledFlag_t& EnabledFlag_t::operator=(bool on)
+{
+    EasyPerformanceAnalyzer::setEnabled(on);
+    return *this;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setSchedStats(bool on)
+{
+    setState(STATE_SCHED_STATS, on);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setOpenTimes(bool on)
+{
+    setState(STATE_OPEN_TIMES, on);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setState(unsigned int flags, bool set)
+{
+    if(set)
+        __atomic_or_fetch(&state, flags, __ATOMIC_RELEASE);
+    else
+        __atomic_and_fetch(&state, ~flags, __ATOMIC_RELEASE);
+}
+
 //This function is time critical!
 void EasyPerformanceAnalyzer::startProfiling(const char* blockName)
 {
+    OnlineAnalyzer::start(blockName);
+}
+
+//This function is time critical!
+void EasyPerformanceAnalyzer::endProfiling(const char* blockName)
+{
+    OnlineAnalyzer::end(blockName);
+}
+
+//This function is time critical!
+Timespec* EasyPerformanceAnalyzer::openOnlineBlock(unsigned int blockName)
+{
+    if(blockName == hashStr(EZP_OTHER_NAME)){
+        warnReservedBlockName();
+        return NULL;
+    }
+
     //Record begin time even if not enabled to ensure mid-block enabling works
 
-    if(!listenerRunning)
+    if(!(__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_LISTENER_RUNNING))
         launchCmdListener();
+    if(currentThread == NULL)
+        registerThread();
 
+    BlockKey key(getTid(), blockName);
     Timespec* begin = new Timespec();
-    BlkClkPair pair(BlockKey(EZP_GET_TID, hashStr(blockName)), begin);
 
     pthread_mutex_lock(&lock);
-    std::pair<Blk2Clk::iterator, bool> result = blocks.insert(pair);
-
-    //We did not find the marker from before, so we inserted the new one
-    if(result.second){
-        pthread_mutex_unlock(&lock);
 
-        //Get time in the very end to disturb the measurements the least possible
-        clock_gettime(EZP_CLOCK,begin);
-    }
+    //Past the limit, blocks without a record share the one of EZP_OTHER_NAME
+    unsigned int limit = __atomic_load_n(&maxRecords, __ATOMIC_RELAXED);
+    if(limit > 0 && blocks.size() >= limit && blocks.find(key) == blocks.end())
+        key.blockName = hashStr(EZP_OTHER_NAME);
+    std::pair<Blk2Clk::iterator, bool> result = blocks.insert(BlkClkPair(key, begin));
 
     //We found a marker from before, so we didn't insert the new one
-    else{
+    if(!result.second){
         delete begin;
-        Timespec* target = result.first->second;
-        pthread_mutex_unlock(&lock);
-
-        //Get time in the very end to disturb the measurements the least possible
-        clock_gettime(EZP_CLOCK,target);
+        begin = result.first->second;
     }
+    pthread_mutex_unlock(&lock);
+
+    //The first start gives the block its ID so that filtering its ends never locks
+    if(result.second)
+        registerBlock(key.blockName);
+
+    //Blocks sharing the record may be nested, so each keeps its own begin time
+    if(key.blockName != blockName)
+        begin = pushOtherBlock(currentThread, blockName, ANALYSIS_REALTIME, begin);
+    return begin;
 }
 
 //This function is time critical!
-void EasyPerformanceAnalyzer::endProfiling(const char* blockName)
+bool EasyPerformanceAnalyzer::closeOnlineBlock(unsigned int blockName, const Timespec* end, const Timespec** begin)
 {
-    Timespec end;
-    clock_gettime(EZP_CLOCK, &end);
+    *begin = NULL;
+    if(blockName == hashStr(EZP_OTHER_NAME))
+        return true;
 
-    if(!enabled)
-        return;
+    //Blocks in the EZP_OTHER_NAME record are popped even if instrumentation is disabled, they were pushed regardless
+    ThreadInfo* info = currentThread;
+    Timespec otherBegin;
+    bool otherBeginValid = info != NULL && info->numOtherBlocks > 0 && popOtherBlock(info, blockName, ANALYSIS_REALTIME, &otherBegin);
+
+    unsigned int flags = __atomic_load_n(&state, __ATOMIC_RELAXED);
+    if(!(flags & STATE_ENABLED))
+        return true;
 
-    TID tid = EZP_GET_TID;
-    BlockKey key(tid, hashStr(blockName));
+    BlockKey key(getTid(), blockName);
+    if((flags & STATE_FILTERING) && isFilteredOut(key.blockName))
+        return true;
 
     pthread_mutex_lock(&lock);
+    if(otherBeginValid)
+        key.blockName = hashStr(EZP_OTHER_NAME);
     Blk2Clk::iterator pairIt = blocks.find(key);
+    if(pairIt == blocks.end() && __atomic_load_n(&maxRecords, __ATOMIC_RELAXED) > 0){
+        key.blockName = hashStr(EZP_OTHER_NAME);
+        pairIt = blocks.find(key);
+    }
     if(pairIt == blocks.end()){
         pthread_mutex_unlock(&lock);
-
-        EZP_PERR("EZP: Can't find %s, did you call EZP_START(\"%s\")?\n", blockName, blockName);
+        return false;
     }
-    else{
-        Timespec* begin = pairIt->second;
-        pthread_mutex_unlock(&lock);
 
-        EZP_PRINT("EZP: [%d]\t%s\t%6.2f ms\n", tid, blockName, getTimeDiff(begin,&end));
-    }
+    //Only this thread writes to its record, which holds the begin time of the block for the caller until its next block
+    if(otherBeginValid)
+        *(pairIt->second) = otherBegin;
+    *begin = pairIt->second;
+    pthread_mutex_unlock(&lock);
+
+    if(flags & STATE_TRACING)
+        traceBlock(key.blockName, *begin, end);
+    return true;
 }
 
 //This function is time critical!
 void EasyPerformanceAnalyzer::startProfilingSmooth(const char* blockName)
 {
+    unsigned int name = hashStr(blockName);
+    if(name == hashStr(EZP_OTHER_NAME)){
+        warnReservedBlockName();
+        return;
+    }
+
     //Record begin time even if not enabled to ensure mid-block enabling works
 
-    if(!listenerRunning)
+    if(!(__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_LISTENER_RUNNING))
         launchCmdListener();
+    if(currentThread == NULL)
+        registerThread();
 
     SmoothMarker* begin = new SmoothMarker();
 
-    Blk2SMarkerPair pair(BlockKey(EZP_GET_TID, hashStr(blockName)), begin);
+    BlockKey key(getTid(), name);
+    SmoothMarker* target;
 
     pthread_mutex_lock(&smoothLock);
-    std::pair<Blk2SMarker::iterator, bool> result = smoothBlocks.insert(pair);
+
+    //Past the limit, blocks without a record share the one of EZP_OTHER_NAME
+    unsigned int limit = __atomic_load_n(&maxRecords, __ATOMIC_RELAXED);
+    if(limit > 0 && smoothBlocks.size() >= limit && smoothBlocks.find(key) == smoothBlocks.end())
+        key.blockName = hashStr(EZP_OTHER_NAME);
+    std::pair<Blk2SMarker::iterator, bool> result = smoothBlocks.insert(Blk2SMarkerPair(key, begin));
 
     //We did not find the marker from before, so we inserted the new one
     if(result.second){
+        target = begin;
         pthread_mutex_unlock(&smoothLock);
-
-        //Get time in the very end to disturb the measurements the least possible
-        clock_gettime(EZP_CLOCK,&(begin->beginTime));
+        registerBlock(key.blockName);
     }
 
     //We found a marker from before, so we didn't insert the new one
     else{
         delete begin;
-        SmoothMarker* target = result.first->second;
+        target = result.first->second;
         pthread_mutex_unlock(&smoothLock);
-
-        //Get time in the very end to disturb the measurements the least possible
-        clock_gettime(EZP_CLOCK,&(target->beginTime));
     }
+
+    //Blocks sharing the record may be nested, so each keeps its own begin time
+    Timespec* beginTime = &(target->beginTime);
+    if(key.blockName != name)
+        beginTime = pushOtherBlock(currentThread, name, ANALYSIS_SMOOTHED, beginTime);
+
+    //Get time in the very end to disturb the measurements the least possible
+    clock_gettime(EZP_CLOCK,beginTime);
 }
 
 //This function is time critical!
@@ -237,227 +521,420 @@ void EasyPerformanceAnalyzer::endProfilingSmooth(const char* blockName, float sf
     Timespec end;
     clock_gettime(EZP_CLOCK,&end);
 
-    if(!enabled)
+    unsigned int name = hashStr(blockName);
+    if(name == hashStr(EZP_OTHER_NAME))
         return;
 
-    TID tid = EZP_GET_TID;
-    BlockKey key(tid, hashStr(blockName));
+    //Blocks in the EZP_OTHER_NAME record are popped even if instrumentation is disabled, they were pushed regardless
+    ThreadInfo* info = currentThread;
+    Timespec otherBegin;
+    bool otherBeginValid = info != NULL && info->numOtherBlocks > 0 && popOtherBlock(info, name, ANALYSIS_SMOOTHED, &otherBegin);
+
+    unsigned int flags = __atomic_load_n(&state, __ATOMIC_RELAXED);
+    if(!(flags & STATE_ENABLED))
+        return;
+
+    TID tid = getTid();
+    BlockKey key(tid, name);
+    if((flags & STATE_FILTERING) && isFilteredOut(key.blockName))
+        return;
 
     pthread_mutex_lock(&smoothLock);
-    Blk2SMarker::iterator pairIt = smoothBlocks.find(key);
+    Blk2SMarker::iterator pairIt = otherBeginValid ? smoothBlocks.end() : smoothBlocks.find(key);
+    if(pairIt == smoothBlocks.end() && (otherBeginValid || __atomic_load_n(&maxRecords, __ATOMIC_RELAXED) > 0)){
+        Blk2SMarker::iterator otherIt = smoothBlocks.find(BlockKey(tid, hashStr(EZP_OTHER_NAME)));
+        if(otherIt != smoothBlocks.end()){
+            pairIt = otherIt;
+            key.blockName = otherIt->first.blockName;
+            blockName = EZP_OTHER_NAME;
+        }
+    }
     if(pairIt == smoothBlocks.end()){
         pthread_mutex_unlock(&smoothLock);
 
         EZP_PERR("EZP: Can't find %s, did you call EZP_START_SMOOTH(\"%s\")?\n", blockName, blockName);
     }
     else{
-        float slice = sf*pairIt->second->lastSlice + (1.0f - sf)*getTimeDiff(&(pairIt->second->beginTime),&end);
-        pairIt->second->lastSlice = slice;
+        SmoothMarker* marker = pairIt->second;
+        if(otherBeginValid)
+            marker->beginTime = otherBegin;
+        Timespec begin = marker->beginTime;
+
+        //Exponential moving average of the time and of its variance
+        float diff = getTimeDiff(&(marker->beginTime),&end) - marker->lastSlice;
+        float slice = marker->lastSlice + (1.0f - sf)*diff;
+        float variance = sf*(marker->variance + (1.0f - sf)*diff*diff);
+        marker->lastSlice = slice;
+        marker->variance = variance;
+
+        //Decide whether to print while still holding the marker, but print outside the lock
+        bool print = smoothPrintInterval == 0.0f;
+        if(smoothPrintInterval > 0.0f){
+            Timespec now;
+            clock_gettime(EZP_WALL_CLOCK,&now);
+            if(getTimeDiff(&(marker->lastPrintTime),&now) >= smoothPrintInterval){
+                marker->lastPrintTime = now;
+                print = true;
+            }
+        }
         pthread_mutex_unlock(&smoothLock);
 
-        EZP_PRINT("EZP: [%d]\t%s\t~%6.2f ms\n", tid, blockName, slice);
+        if(print)
+            EZP_PRINT("EZP: [%d]\t%s\t~%6.2f ms\tvar %6.2f ms^2\n", tid, blockName, slice, variance);
+        if(flags & STATE_TRACING)
+            traceBlock(key.blockName, &begin, &end);
     }
 }
 
 //This function is time critical!
 void EasyPerformanceAnalyzer::startProfilingOffline(const char* blockName)
 {
+    OfflineAnalyzer::start(blockName);
+}
+
+//This function is time critical!
+void EasyPerformanceAnalyzer::endProfilingOffline(const char* blockName)
+{
+    OfflineAnalyzer::end(blockName);
+}
+
+//This function is time critical!
+Timespec* EasyPerformanceAnalyzer::openOfflineBlock(unsigned int blockName)
+{
+    if(blockName == hashStr(EZP_OTHER_NAME)){
+        warnReservedBlockName();
+        return NULL;
+    }
+
     //Record begin time even if not enabled to ensure mid-block enabling works
 
-    if(!listenerRunning)
+    unsigned int flags = __atomic_load_n(&state, __ATOMIC_RELAXED);
+    if(!(flags & STATE_LISTENER_RUNNING))
         launchCmdListener();
+    if(currentThread == NULL)
+        registerThread();
 
-    AggregateMarker* begin = new AggregateMarker();
+    //Filtered blocks are neither looked up nor timed, which costs a single load while no filter is set
+    if((flags & STATE_FILTERING) && isFilteredOut(blockName))
+        return NULL;
 
-    Blk2AMarkerPair pair(BlockKey(EZP_GET_TID, hashStr(blockName)), begin);
+    BlockKey key(getTid(), blockName);
+    AggregateMarker* target;
 
     pthread_mutex_lock(&offlineLock);
-    std::pair<Blk2AMarker::iterator, bool> result = offlineBlocks.insert(pair);
+    Blk2AMarker::iterator pairIt = offlineBlocks.find(key);
 
-    //We did not find the marker from before, so we inserted a new one
-    if(result.second){
-        pthread_mutex_unlock(&offlineLock);
+    bool created = pairIt == offlineBlocks.end();
 
-        //Get time in the very end to disturb the measurements the least possible
-        clock_gettime(EZP_CLOCK,&(begin->beginTime));
-    }
+    //We found a marker from before, reuse it
+    if(!created)
+        target = pairIt->second;
 
-    //We found a marker from before, so we didn't insert the new one
-    else{
-        delete begin;
-        AggregateMarker* target = result.first->second;
-        pthread_mutex_unlock(&offlineLock);
+    //We did not find the marker from before, so we insert a new one
+    else
+        target = createOfflineMarker(key);
+    pthread_mutex_unlock(&offlineLock);
+
+    //The first start gives the block its ID so that filtering its ends never locks
+    if(created)
+        registerBlock(blockName);
 
-        //Get time in the very end to disturb the measurements the least possible
-        clock_gettime(EZP_CLOCK,&(target->beginTime));
+    if((flags & STATE_SAMPLING) && currentThread->samplingGeneration != __atomic_load_n(&samplingGeneration, __ATOMIC_RELAXED))
+        armSampling(currentThread);
+
+    //The caller gets time in the very end to disturb the measurements the least possible
+    AllocCounters* counters = (flags & STATE_ALLOC_STATS) ? getAllocCounters() : NULL;
+    target->beginAllocsValid = counters != NULL;
+    if(counters != NULL)
+        target->beginAllocs = *counters;
+
+    //One wall clock read serves scheduler statistics, open block listings and the recording, and none is made if nothing needs it
+    Timespec wallBegin = {0, 0};
+    if(flags & STATE_SCHED_STATS){
+        takeSchedSample(&(target->beginSched), true);
+        wallBegin = target->beginSched.wallTime;
+    }
+    else{
+        target->beginSched.valid = false;
+        if(flags & (STATE_OPEN_TIMES | STATE_RECORDING))
+            clock_gettime(EZP_WALL_CLOCK, &wallBegin);
     }
+    pushOpenBlock(currentThread, target, blockName, &wallBegin);
+
+    //Blocks sharing the record may be nested, so each keeps its own begin time
+    if(target->blockName != blockName)
+        return pushOtherBlock(currentThread, blockName, ANALYSIS_OFFLINE, &(target->beginTime));
+    return &(target->beginTime);
 }
 
 //This function is time critical!
-void EasyPerformanceAnalyzer::endProfilingOffline(const char* blockName)
+bool EasyPerformanceAnalyzer::endOfflineBlock(unsigned int blockName, const Timespec* end, const Timespec** begin)
 {
-    Timespec end;
-    clock_gettime(EZP_CLOCK,&end);
-
-    if(!enabled)
-        return;
-
-    BlockKey key(EZP_GET_TID, hashStr(blockName));
+    if(begin != NULL)
+        *begin = NULL;
+    if(blockName == hashStr(EZP_OTHER_NAME))
+        return true;
+
+    //Blocks are popped even if instrumentation is disabled, they were pushed regardless
+    ThreadInfo* info = currentThread;
+    Timespec wallBegin = {0, 0};
+    bool wallBeginValid = info != NULL && info->numOpenBlocks > 0 && popOpenBlock(info, blockName, &wallBegin);
+    Timespec otherBegin;
+    bool otherBeginValid = info != NULL && info->numOtherBlocks > 0 && popOtherBlock(info, blockName, ANALYSIS_OFFLINE, &otherBegin);
+
+    unsigned int flags = __atomic_load_n(&state, __ATOMIC_RELAXED);
+    if(!(flags & STATE_ENABLED))
+        return true;
+
+    BlockKey key(getTid(), blockName);
+    if((flags & STATE_FILTERING) && isFilteredOut(key.blockName))
+        return true;
+
+    //Only filtered starts skip the stack when it has room, their record holds the begin time of an earlier run
+    if(!wallBeginValid && info != NULL && info->numOpenBlocks < EZP_MAX_OPEN_BLOCKS)
+        return true;
+
+    SchedSample endSched;
+    endSched.valid = false;
+    if(flags & STATE_SCHED_STATS)
+        takeSchedSample(&endSched, false);
+    AllocCounters endAllocs = AllocCounters();
+    AllocCounters* counters = (flags & STATE_ALLOC_STATS) ? getAllocCounters() : NULL;
+    if(counters != NULL)
+        endAllocs = *counters;
+
+    int node = (flags & STATE_NODE_STATS) ? getNode() : -1;
 
     pthread_mutex_lock(&offlineLock);
+    if(otherBeginValid)
+        key.blockName = hashStr(EZP_OTHER_NAME);
     Blk2AMarker::iterator pairIt = offlineBlocks.find(key);
+    if(pairIt == offlineBlocks.end() && __atomic_load_n(&maxRecords, __ATOMIC_RELAXED) > 0){
+        key.blockName = hashStr(EZP_OTHER_NAME);
+        pairIt = offlineBlocks.find(key);
+    }
     if(pairIt == offlineBlocks.end()){
         pthread_mutex_unlock(&offlineLock);
+        return false;
+    }
 
-        EZP_PERR("EZP: Can't find %s, did you call EZP_START_OFFLINE(\"%s\")?\n", blockName, blockName);
+    AggregateMarker* marker = pairIt->second;
+    if(otherBeginValid)
+        marker->beginTime = otherBegin;
+    Timespec beginTime = marker->beginTime;
+    unsigned long long time = getTimeDiffNs(&beginTime, end);
+    int bucket = getHistogramBucket(time);
+
+    //Only this thread writes to the marker, relaxed stores are enough for the exporter to read them without locking
+    __atomic_store_n(&(marker->numSamples), marker->numSamples + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&(marker->totalTime), marker->totalTime + time, __ATOMIC_RELAXED);
+    __atomic_store_n(&(marker->histogram[bucket]), marker->histogram[bucket] + 1, __ATOMIC_RELAXED);
+    if(marker->shared != NULL)
+        updateSharedRecord(marker, bucket);
+
+    //Only runs sampled at both ends count, scheduler statistics may have been turned on or off in between
+    if(endSched.valid && marker->beginSched.valid){
+        marker->sched.numSamples++;
+        marker->sched.cpuTime += time;
+        marker->sched.wallTime += getTimeDiffNs(&(marker->beginSched.wallTime), &(endSched.wallTime));
+        marker->sched.voluntarySwitches += endSched.voluntarySwitches - marker->beginSched.voluntarySwitches;
+        marker->sched.involuntarySwitches += endSched.involuntarySwitches - marker->beginSched.involuntarySwitches;
     }
-    else{
-        pairIt->second->numSamples++;
-        pairIt->second->totalTime += getTimeDiff(&(pairIt->second->beginTime), &end);
-        pthread_mutex_unlock(&offlineLock);
+    if(node >= 0){
+        marker->nodes.numSamples[node]++;
+        marker->nodes.totalTime[node] += time;
     }
+    if(counters != NULL && marker->beginAllocsValid){
+        marker->allocs.numSamples++;
+        marker->allocs.count += endAllocs.count - marker->beginAllocs.count;
+        marker->allocs.bytes += endAllocs.bytes - marker->beginAllocs.bytes;
+    }
+
+    //The record holds the samples taken when this block started, an enclosing block in it must not take them as its own
+    if(otherBeginValid)
+        for(unsigned int i = 0; i < info->numOtherBlocks; i++)
+            if(info->otherBlocks[i].analysis == ANALYSIS_OFFLINE){
+                marker->beginSched.valid = false;
+                marker->beginAllocsValid = false;
+                break;
+            }
+    pthread_mutex_unlock(&offlineLock);
+
+    if((flags & STATE_RECORDING) && wallBeginValid && (wallBegin.tv_sec != 0 || wallBegin.tv_nsec != 0))
+        recordBlock(info, key.blockName, &wallBegin, time);
+    if(flags & STATE_TRACING)
+        traceBlock(key.blockName, &beginTime, end);
+    if(begin != NULL)
+        *begin = &(marker->beginTime);
+    return true;
 }
 
 //This function is not time critical
 void EasyPerformanceAnalyzer::printOfflineProfiles()
 {
-    pthread_mutex_lock(&offlineLock);
-    if(offlineBlocks.size() == 0){
+    OfflineReport report;
+    if(!buildOfflineReport(report)){
         EZP_PERR("EZP: No offline block found; instrument some code first by wrapping it with EZP_START_OFFLINE() ... EZP_END_OFFLINE()\n");
-        pthread_mutex_unlock(&offlineLock);
         return;
     }
 
-    //Transfer offline profiles into sortable data structure and find max block name length
-    std::vector<AggregateProfile> sortedProfiles(offlineBlocks.size());
-    Blk2AMarker::iterator its = offlineBlocks.begin();
-    std::vector<AggregateProfile>::iterator itt = sortedProfiles.begin();
-    for(; its != offlineBlocks.end(); its++, itt++){
-        itt->tid = its->first.tid;
-        itt->blockName = its->first.blockName;
-        itt->numSamples = its->second->numSamples;
-        itt->averageTime = its->second->totalTime/itt->numSamples;
-        if(isnanf(itt->averageTime))
-            itt->averageTime = -1;
-    }
-    pthread_mutex_unlock(&offlineLock);
+    std::string output;
+    formatOfflineReport(report, FORMAT_TEXT, output);
 
-    //Sort for printing according to average time taken
-    std::sort(sortedProfiles.begin(),sortedProfiles.end(),AggregateProfile::compareAvgTime);
+    //Print line by line since Logcat truncates long messages
+    size_t begin = 0, end;
+    while((end = output.find('\n', begin)) != std::string::npos){
+        EZP_PRINT("%.*s\n", (int)(end - begin), output.c_str() + begin);
+        begin = end + 1;
+    }
+}
 
-    //Do the thread-wise printing
-    EZP_PRINT("EZP: ===============================================================================\n");
-    EZP_PRINT("EZP: Thread-wise analysis results\n");
-    EZP_PRINT("EZP: -------------------------------------------------------------------------------\n");
-    EZP_PRINT("EZP: Thread ID    Name    Average(ms)         Total(ms)           Calls\n");
-    EZP_PRINT("EZP: -------------------------------------------------------------------------------\n");
-    char cbuf[5];
-    for(std::vector<AggregateProfile>::iterator it = sortedProfiles.begin(); it != sortedProfiles.end(); it++){
-        unhashStr(it->blockName,cbuf);
-        if(it->numSamples == 0)
-            EZP_PRINT("EZP: %9d    %4s    EZP_END_OFFLINE(\"%s\") was not present or was not enabled\n",
-                    it->tid, cbuf, cbuf);
-        else
-            EZP_PRINT("EZP: %9d    %4s    %-16.2f    %-16.2f    %-10d\n",
-                    it->tid, cbuf, it->averageTime, it->averageTime*it->numSamples, it->numSamples);
-    }
-
-    //Sort according to block name for summing
-    std::sort(sortedProfiles.begin(),sortedProfiles.end(),AggregateProfile::compareBlockName);
-
-    //Sum profiles coming from different threads
-    std::vector<SummedProfile> totalProfiles;
-    std::vector<AggregateProfile>::iterator itS = sortedProfiles.begin();
-    totalProfiles.push_back(SummedProfile(itS->blockName, itS->averageTime*itS->numSamples, itS->numSamples));
-    itS++;
-    for(;itS!=sortedProfiles.end();itS++)
-        if(itS->blockName == totalProfiles.back().blockName){
-            totalProfiles.back().totalTime += itS->averageTime*itS->numSamples;
-            totalProfiles.back().numSamples += itS->numSamples;
-        }
-        else
-            totalProfiles.push_back(SummedProfile(itS->blockName, itS->averageTime*itS->numSamples, itS->numSamples));
+//This function is not time critical
+void EasyPerformanceAnalyzer::printSmoothProfiles()
+{
+    pthread_mutex_lock(&smoothLock);
+    if(smoothBlocks.size() == 0){
+        EZP_PERR("EZP: No smoothed block found; instrument some code first by wrapping it with EZP_START_SMOOTH() ... EZP_END_SMOOTH()\n");
+        pthread_mutex_unlock(&smoothLock);
+        return;
+    }
 
-    //Sort summed profiles according to average time
-    std::sort(totalProfiles.begin(),totalProfiles.end(),SummedProfile::compare);
+    //Copy the markers so that printing does not block the instrumented threads
+    std::vector<std::pair<BlockKey, SmoothMarker> > markers;
+    markers.reserve(smoothBlocks.size());
+    for(Blk2SMarker::iterator it = smoothBlocks.begin(); it != smoothBlocks.end(); it++)
+        markers.push_back(std::make_pair(it->first, *(it->second)));
+    pthread_mutex_unlock(&smoothLock);
 
-    //Print summed profiles
     EZP_PRINT("EZP: ===============================================================================\n");
-    EZP_PRINT("EZP: Anaylsis results summed across threads\n");
+    EZP_PRINT("EZP: Smoothed analysis results\n");
     EZP_PRINT("EZP: -------------------------------------------------------------------------------\n");
-    EZP_PRINT("EZP: Name    Average(ms)         Total(ms)           Calls\n");
+    EZP_PRINT("EZP: Thread ID    Name    Smoothed(ms)        Variance(ms^2)      Std dev(ms)\n");
     EZP_PRINT("EZP: -------------------------------------------------------------------------------\n");
-    for(std::vector<SummedProfile>::iterator it = totalProfiles.begin(); it != totalProfiles.end(); it++){
-        unhashStr(it->blockName,cbuf);
-        if(it->numSamples == 0)
-            EZP_PRINT("EZP: %4s    EZP_END_OFFLINE(\"%s\") was not present or was not enabled\n",
-                    cbuf, cbuf);
-        else
-            EZP_PRINT("EZP: %4s    %-16.2f    %-16.2f    %-10d\n",
-                    cbuf, it->totalTime/it->numSamples, it->totalTime, it->numSamples);
+    char cbuf[5];
+    for(std::vector<std::pair<BlockKey, SmoothMarker> >::iterator it = markers.begin(); it != markers.end(); it++){
+        unhashStr(it->first.blockName,cbuf);
+        EZP_PRINT("EZP: %9d    %4s    %-16.2f    %-16.2f    %-16.2f\n",
+                it->first.tid, cbuf, it->second.lastSlice, it->second.variance, sqrtf(it->second.variance));
     }
     EZP_PRINT("EZP: ===============================================================================\n");
 }
 
-//This function is not time critical
-void EasyPerformanceAnalyzer::clearOfflineProfiles()
+//This function is (mostly) not time critical
+AggregateMarker* EasyPerformanceAnalyzer::createOfflineMarker(const BlockKey& key)
 {
-    //We will tolerate the memory leak caused by not freeing the one AggregateMarker per instrumentation block
-    //In order to free them, pthread lock must be held until after the clock measurement to check for null pointer in endProfilingOffline()
-    //The disturbance in the measurements is not worth fixing the memory leak
+    //Past the limit, blocks without a record share the one of EZP_OTHER_NAME, which is created regardless
+    unsigned int otherBlockName = hashStr(EZP_OTHER_NAME);
+    unsigned int limit = __atomic_load_n(&maxRecords, __ATOMIC_RELAXED);
+    if(limit > 0 && offlineBlocks.size() >= limit && key.blockName != otherBlockName){
+        if(numOverflows++ == 0)
+            EZP_PERR("EZP: More than %u offline analysis records, new blocks go to the %s record of their thread\n", limit, EZP_OTHER_NAME);
+        return getOfflineMarker(BlockKey(key.tid, otherBlockName));
+    }
 
-    pthread_mutex_lock(&offlineLock);
-    offlineBlocks.clear();
-    pthread_mutex_unlock(&offlineLock);
+    AggregateMarker* marker;
+
+    //Reuse the marker of an exited thread, it is already published to signal handlers and shared memory readers
+    if(!freeOfflineMarkers.empty()){
+        marker = freeOfflineMarkers.back();
+        freeOfflineMarkers.pop_back();
+        __atomic_store_n(&(marker->tid), key.tid, __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->blockName), key.blockName, __ATOMIC_RELAXED);
+        if(marker->shared != NULL)
+            updateSharedRecord(marker, -1);
+    }
+    else{
+        marker = new AggregateMarker(key.tid, key.blockName);
+        numOfflineMarkers++;
+        publishOfflineMarker(marker);
+    }
+
+    offlineBlocks.insert(Blk2AMarkerPair(key, marker));
+    __atomic_add_fetch(&offlineGeneration, 1, __ATOMIC_RELEASE);
+    return marker;
 }
 
-//This function is time critical!
-inline float EasyPerformanceAnalyzer::getTimeDiff(const Timespec* begin, const Timespec* end)
+//This function is not time critical
+void EasyPerformanceAnalyzer::publishOfflineMarker(AggregateMarker* marker)
 {
-    return (float)(end->tv_sec - begin->tv_sec)*1000.0f + (float)(end->tv_nsec - begin->tv_nsec)/1000000.0f;
+    //Publish the marker to signal handlers and shared memory readers after it is fully built
+    if(numOfflineRecords < EZP_MAX_DUMPED_BLOCKS){
+        offlineRecords[numOfflineRecords] = marker;
+        if(sharedStats != NULL){
+            marker->shared = sharedRecords + numOfflineRecords;
+            updateSharedRecord(marker, -1);
+            __atomic_store_n(&(sharedStats->numRecords), numOfflineRecords + 1, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&numOfflineRecords, numOfflineRecords + 1, __ATOMIC_RELEASE);
+    }
+    else if(numOfflineRecords == EZP_MAX_DUMPED_BLOCKS){
+        EZP_PERR("EZP: More than %d offline blocks, the rest will not be dumped\n", EZP_MAX_DUMPED_BLOCKS);
+        numOfflineRecords++; //Warn only once, readers never read past EZP_MAX_DUMPED_BLOCKS
+    }
 }
 
-//This function is time critical!
-inline unsigned int EasyPerformanceAnalyzer::hashStr(const char* str)
+//This function is not time critical
+void EasyPerformanceAnalyzer::init(unsigned int expectedThreads, unsigned int expectedBlocks)
 {
-    unsigned int result = 0;
-
-    result += str[0];
-    if(str[1] == '\0')
-        return result << 24;
-    result = result << 8;
-
-    result += str[1];
-    if(str[2] == '\0')
-        return result << 16;
-    result = result << 8;
-
-    result += str[2];
-    if(str[3] == '\0')
-        return result << 8;
-    result = result << 8;
-
-    result += str[3];
-    if(str[4] != '\0')
-        EZP_PERR("EZP: Block name %s is too long, truncating to 4 characters\n", str);
-    return result;
+    launchCmdListener();
+    initThread();
+
+    size_t numMarkers = (size_t)expectedThreads*expectedBlocks;
+    pthread_mutex_lock(&offlineLock);
+    numPreallocatedMarkers = std::max(numPreallocatedMarkers, numMarkers);
+    preallocateOfflineMarkers(false);
+
+    //Nodes of erased keys go to the free list of the allocator of offlineBlocks; tid 0 is never the key of a live record
+    for(size_t i=0;i<numMarkers;i++)
+        offlineBlocks.insert(Blk2AMarkerPair(BlockKey(0, (unsigned int)i), NULL));
+    for(size_t i=0;i<numMarkers;i++)
+        offlineBlocks.erase(BlockKey(0, (unsigned int)i));
+    pthread_mutex_unlock(&offlineLock);
+
+    //The constructors and the insertions above wrote nearly all the memory they got, so its pages are already faulted in
 }
 
-//This function is time critical!
-inline void EasyPerformanceAnalyzer::unhashStr(unsigned int hash, char* output)
+//This function is not time critical
+void EasyPerformanceAnalyzer::clearOfflineProfiles()
 {
-    output[4] = '\0';
+    //We will tolerate the memory leak caused by not freeing the one AggregateMarker per instrumentation block
+    //In order to free them, pthread lock must be held until after the clock measurement to check for null pointer in endProfilingOffline()
+    //The disturbance in the measurements is not worth fixing the memory leak
 
-    output[3] = hash;
-    hash = hash >> 8;
+    pthread_mutex_lock(&offlineLock);
+    offlineBlocks.clear();
+    __atomic_add_fetch(&offlineGeneration, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&numOfflineRecords, 0, __ATOMIC_RELEASE);
+    if(sharedStats != NULL){
+        __atomic_add_fetch(&(sharedStats->clearGeneration), 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&(sharedStats->numRecords), 0, __ATOMIC_RELEASE);
+    }
 
-    output[2] = hash;
-    hash = hash >> 8;
+    //Spare markers are used by no thread, unlike the cleared ones; they and the freed map nodes keep first starts from allocating
+    preallocateOfflineMarkers(true);
+    pthread_mutex_unlock(&offlineLock);
+}
 
-    output[1] = hash;
-    hash = hash >> 8;
+//This function is not time critical
+void EasyPerformanceAnalyzer::preallocateOfflineMarkers(bool republish)
+{
+    //Their shared copies were given to cleared markers or belong to the segment of a parent
+    if(republish)
+        for(size_t i=0;i<freeOfflineMarkers.size();i++){
+            freeOfflineMarkers[i]->shared = NULL;
+            publishOfflineMarker(freeOfflineMarkers[i]);
+        }
 
-    output[0] = hash;
+    //Recycled markers of exited threads count towards the preallocated ones, they are used the same way
+    if(freeOfflineMarkers.size() < numPreallocatedMarkers){
+        freeOfflineMarkers.reserve(numPreallocatedMarkers);
+        while(freeOfflineMarkers.size() < numPreallocatedMarkers){
+            AggregateMarker* marker = new AggregateMarker(0, 0);
+            numOfflineMarkers++;
+            publishOfflineMarker(marker);
+            freeOfflineMarkers.push_back(marker);
+        }
+    }
 }
 
 //This function is (mostly) not time critical
@@ -465,25 +942,38 @@ void EasyPerformanceAnalyzer::launchCmdListener()
 {
     pthread_mutex_lock(&listenerLauncherLock);
 
-    if(listenerRunning){ //Extra guard agains other threads entering this function at the same time
+    if(__atomic_load_n(&state, __ATOMIC_ACQUIRE) & STATE_LISTENER_RUNNING){ //Extra guard agains other threads entering this function at the same time
         pthread_mutex_unlock(&listenerLauncherLock);
         return;
     }
 
+    //Forked children need their own listener, register the handlers that tell them
+    pthread_once(&forkHandlersOnce, registerForkHandlers);
+
+    //Left to us by the fork handler of a child
+    if(sharedStatsPending){
+        sharedStatsPending = false;
+        publishSharedStats();
+    }
+    if(childMerging && parentSocketPid >= 0 && !mergeAtExitRegistered){
+        mergeAtExitRegistered = true; //Inherited by our own children along with the registration
+        if(atexit(&EasyPerformanceAnalyzer::mergeAtExit) != 0)
+            EZP_PERR("EZP: atexit() error: Could not register the merge handler\n");
+    }
+
     struct sockaddr_un acceptorAddr;
+    socklen_t addrLen;
     int acceptorFD;
 
     if((acceptorFD = socket(AF_UNIX, SOCK_STREAM, 0)) == -1){
         EZP_PERR("EZP: socket() error: %s\n",strerror(errno));
+        pthread_mutex_unlock(&listenerLauncherLock);
         return;
     }
 
-    memset(&acceptorAddr, 0, sizeof(acceptorAddr));
-    acceptorAddr.sun_family = AF_UNIX;
-    strncpy(acceptorAddr.sun_path, cmdSocketName, sizeof(acceptorAddr.sun_path) - 1);
+    getCmdSocketAddress(cmdSocketPid, acceptorAddr, addrLen);
 
-    unlink(cmdSocketName);
-    if(bind(acceptorFD, (struct sockaddr*)&acceptorAddr, sizeof(acceptorAddr)) == -1){
+    if(bind(acceptorFD, (struct sockaddr*)&acceptorAddr, addrLen) == -1){
         EZP_PERR("EZP: bind() error: %s\n",strerror(errno));
         EZP_PERR("EZP: Make sure that this is the only instrumented process running on this machine.\n");
         EZP_PERR("EZP: There is no multiple EZP session functionality yet...\n");
@@ -500,8 +990,10 @@ void EasyPerformanceAnalyzer::launchCmdListener()
     pthread_attr_setguardsize(listenerAttr, 0);
     pthread_attr_setstacksize(listenerAttr, PTHREAD_STACK_MIN); //This should be plenty
     int ret = pthread_create(&cmdListener, listenerAttr, &EasyPerformanceAnalyzer::listenCmd, (void*)(new int(acceptorFD)));
-    if(!ret)
-        listenerRunning = true;
+    if(!ret){
+        cmdAcceptor = acceptorFD;
+        setState(STATE_LISTENER_RUNNING, true);
+    }
     else
         EZP_PERR("EZP: pthread_create() error: %s\n", strerror(ret));
 
@@ -511,8 +1003,8 @@ void EasyPerformanceAnalyzer::launchCmdListener()
 //This function is not time critical
 void* EasyPerformanceAnalyzer::listenCmd(void* arg)
 {
-    char buf[2];
-    int ret;
+    char buf[EZP_MAX_CMD_LENGTH];
+    int ret = 0;
     int clientFD;
     int acceptorFD = *((int*)arg);
     EZP_PRINT("EZP: [%d]\tCommand listener running...\n",(unsigned int)EZP_GET_TID);
@@ -523,15 +1015,19 @@ void* EasyPerformanceAnalyzer::listenCmd(void* arg)
             continue;
         }
 
-        ret = read(clientFD, buf, sizeof(buf));
-        if(ret == 2){
+        //Read up to the null character only, anything after it belongs to the command
+        int length = 0;
+        while(length < EZP_MAX_CMD_LENGTH && (ret = read(clientFD, buf + length, 1)) == 1 && buf[length] != '\0')
+            length++;
+        if(length < EZP_MAX_CMD_LENGTH && ret == 1){
+            const char* cmdArg = buf + 1;
             switch(buf[0]){
                 case 'e':
-                    enabled = true;
+                    setState(STATE_ENABLED, true);
                     EZP_PRINT("EZP: Enabled instrumentation upon remote request.\n");
                     break;
                 case 'd':
-                    enabled = false;
+                    setState(STATE_ENABLED, false);
                     EZP_PRINT("EZP: Disabled instrumentation upon remote request.\n");
                     break;
                 case 'p':
@@ -542,6 +1038,67 @@ void* EasyPerformanceAnalyzer::listenCmd(void* arg)
                     clearOfflineProfiles();
                     EZP_PRINT("EZP: Cleared offline analysis history upon remote request.\n");
                     break;
+                case 's':
+                    printSmoothProfiles();
+                    EZP_PRINT("EZP: Printed smoothed analyses upon remote request.\n");
+                    break;
+                case 'j':
+                    writeOfflineProfiles(clientFD, FORMAT_JSON);
+                    break;
+                case 'v':
+                    writeOfflineProfiles(clientFD, FORMAT_CSV);
+                    break;
+                case 'm':
+                    receiveMerge(clientFD);
+                    break;
+                case 'o':
+                    {
+                        std::string output;
+                        formatOpenBlocks(output);
+                        if(!writeAll(clientFD, output))
+                            EZP_PERR("EZP: write() error: %s\n", strerror(errno));
+                    }
+                    break;
+                case 'M':
+                    {
+                        std::string output;
+                        formatMemoryUsage(output);
+                        if(!writeAll(clientFD, output))
+                            EZP_PERR("EZP: write() error: %s\n", strerror(errno));
+                    }
+                    break;
+                case 'B':
+                    setBlockFilter(cmdArg, true);
+                    EZP_PRINT("EZP: Enabled blocks beginning with \"%s\" upon remote request.\n", cmdArg);
+                    break;
+                case 'b':
+                    setBlockFilter(cmdArg, false);
+                    EZP_PRINT("EZP: Disabled blocks beginning with \"%s\" upon remote request.\n", cmdArg);
+                    break;
+                case 'T':
+                    setThreadFilter(cmdArg, true);
+                    EZP_PRINT("EZP: Enabled threads \"%s\" upon remote request.\n", cmdArg);
+                    break;
+                case 't':
+                    setThreadFilter(cmdArg, false);
+                    EZP_PRINT("EZP: Disabled threads \"%s\" upon remote request.\n", cmdArg);
+                    break;
+                case 'r':
+                    resetFilters();
+                    EZP_PRINT("EZP: Reset block and thread filters upon remote request.\n");
+                    break;
+                case 'x':
+                    if(parseTraceThreshold(cmdArg))
+                        EZP_PRINT("EZP: Set trace threshold \"%s\" upon remote request.\n", cmdArg);
+                    break;
+                case 'R':
+                    if(cmdArg[0] == '\0'){
+                        stopRecording();
+                        EZP_PRINT("EZP: Stopped recording upon remote request.\n");
+                    }
+                    else if(startRecording(cmdArg))
+                        EZP_PRINT("EZP: Recording to %s upon remote request.\n", cmdArg);
+                    break;
                 default:
                     EZP_PERR("EZP: Unknown command received: %c\n", buf[0]);
                     break;
@@ -550,7 +1107,7 @@ void* EasyPerformanceAnalyzer::listenCmd(void* arg)
         else if(ret == -1)
             EZP_PERR("EZP: read() error: %s\n", strerror(errno));
         else
-            EZP_PERR("EZP: Received %d bytes in read(), must receive 2 bytes\n", ret);
+            EZP_PERR("EZP: Received an incomplete or too long command, must be at most %d bytes ending with a null character\n", EZP_MAX_CMD_LENGTH);
 
         close(clientFD);
     }
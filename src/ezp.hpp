@@ -39,6 +39,56 @@
  */
 #define EZP_BEGIN_CONTROL ezp::EasyPerformanceAnalyzer::launchCmdListener();
 
+/**
+ * @brief Initializes EZP up front so that the first blocks do not pay for it, to be called once before the threads start
+ *
+ * Launches the control listener, registers the calling thread and preallocates the offline analysis records of
+ * EXPECTED_THREADS threads running EXPECTED_BLOCKS distinct blocks each, so that offline analysis blocks (EZP_SAMPLE_START)
+ * starting for the first time in a registered thread neither allocate memory nor make system calls other than reading
+ * the clocks. Real-time and smoothed blocks are not covered, their first run in a thread still allocates its record.
+ */
+#define EZP_INIT(EXPECTED_THREADS,EXPECTED_BLOCKS) ezp::EasyPerformanceAnalyzer::init(EXPECTED_THREADS,EXPECTED_BLOCKS);
+
+/**
+ * @brief Registers the calling thread up front so that its first block does not pay for it, to be called at the beginning of threads
+ */
+#define EZP_INIT_THREAD ezp::EasyPerformanceAnalyzer::initThread();
+
+/**
+ * @brief Launches the OpenMetrics exporter thread that serves offline analysis results to scrapers
+ *
+ * ADDRESS is either "tcp:PORT" to listen on the loopback interface or "unix:NAME" to listen on an abstract UNIX socket
+ * (or on a filesystem UNIX socket if NAME begins with '/')
+ */
+#define EZP_BEGIN_EXPORTER(ADDRESS) ezp::EasyPerformanceAnalyzer::launchMetricsExporter(ADDRESS);
+
+/**
+ * @brief Sets whether the OpenMetrics exporter also serves thread-wise results in addition to results summed across threads
+ */
+#define EZP_SET_EXPORTER_PER_THREAD(PER_THREAD) ezp::EasyPerformanceAnalyzer::exportPerThread = PER_THREAD;
+
+/**
+ * @brief Publishes the offline analysis records of this process in a shared memory segment that ezp_control -m can read
+ */
+#define EZP_BEGIN_SHARED_STATS ezp::EasyPerformanceAnalyzer::publishSharedStats();
+
+/**
+ * @brief Sums what changed since the last pull in the shared memory segments of all other processes on this host into the offline analyses of this process
+ */
+#define EZP_PULL_SHARED_STATS ezp::EasyPerformanceAnalyzer::pullSharedStats();
+
+/**
+ * @brief Names the calling thread in offline analysis reports, max 15 characters; the pthread name of the thread is used by default
+ */
+#define EZP_SET_THREAD_NAME(NAME) ezp::EasyPerformanceAnalyzer::setThreadName(NAME);
+
+/**
+ * @brief Sets how thread-wise offline analysis results are grouped: by TID (default), by thread NAME or by thread POOL
+ *
+ * A pool is a thread name without its trailing number, e.g "worker-1" and "worker-2" are both in the pool "worker"
+ */
+#define EZP_SET_THREAD_AGGREGATION(MODE) ezp::EasyPerformanceAnalyzer::threadAggregation = ezp::EasyPerformanceAnalyzer::AGGREGATE_##MODE;
+
 /**
  * @brief Turns on instrumentation for the analysis session that is in this process
  */
@@ -49,6 +99,120 @@
  */
 #define EZP_DISABLE ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_DISABLE);
 
+/**
+ * @brief Enables the blocks whose names begin with PREFIX in this process, overriding earlier filters that match them
+ *
+ * Filters only apply to blocks ending while instrumentation is enabled with EZP_ENABLE and are checked when blocks end; ""
+ * matches all blocks
+ */
+#define EZP_ENABLE_BLOCKS(PREFIX) ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_ENABLE_BLOCKS,PREFIX);
+
+/**
+ * @brief Disables the blocks whose names begin with PREFIX in this process, overriding earlier filters that match them
+ */
+#define EZP_DISABLE_BLOCKS(PREFIX) ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_DISABLE_BLOCKS,PREFIX);
+
+/**
+ * @brief Enables the threads whose ID is THREAD or whose names begin with THREAD in this process, overriding earlier filters that match them
+ */
+#define EZP_ENABLE_THREADS(THREAD) ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_ENABLE_THREADS,THREAD);
+
+/**
+ * @brief Disables the threads whose ID is THREAD or whose names begin with THREAD in this process, overriding earlier filters that match them
+ */
+#define EZP_DISABLE_THREADS(THREAD) ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_DISABLE_THREADS,THREAD);
+
+/**
+ * @brief Removes all block, thread and function filters in this process, enabling all blocks, threads and functions
+ */
+#define EZP_RESET_FILTERS ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_RESET_FILTERS);
+
+/**
+ * @brief Turns on or off wall clock times and context switch counts of offline analysis blocks besides their CPU times
+ *
+ * Reports then tell how long blocks spent off the CPU, e.g waiting for locks or I/O, at the cost of a system call at
+ * every EZP_START_OFFLINE and EZP_END_OFFLINE
+ */
+#define EZP_SET_SCHED_STATS(ON) ezp::EasyPerformanceAnalyzer::setSchedStats(ON);
+
+/**
+ * @brief Turns on or off wall clock start times of offline analysis blocks, for EZP_PRINT_OPEN to tell how long open blocks have run
+ *
+ * Costs a clock read at every EZP_START_OFFLINE unless scheduler statistics or a recording already take one. The first
+ * listing of open blocks turns them on, blocks started before are listed without their elapsed time.
+ */
+#define EZP_SET_OPEN_TIMES(ON) ezp::EasyPerformanceAnalyzer::setOpenTimes(ON);
+
+/**
+ * @brief Turns on or off the breakdown of offline analysis blocks per NUMA node, according to the CPU they end on
+ */
+#define EZP_SET_NODE_STATS(ON) ezp::EasyPerformanceAnalyzer::setNodeStats(ON);
+
+/**
+ * @brief Turns on or off counting the memory allocated during offline analysis blocks, needs libezp_malloc.so in LD_PRELOAD
+ */
+#define EZP_SET_ALLOC_STATS(ON) ezp::EasyPerformanceAnalyzer::setAllocStats(ON);
+
+/**
+ * @brief Samples the offline analysis blocks open in each thread every PERIOD_MS of the CPU time of the thread, 0 to stop
+ *
+ * Each sample counts for every block open in the thread and for the innermost one as its own; with BACKTRACES, short frame
+ * pointer backtraces are also kept, which reports group per innermost block. Threads are sampled from the first
+ * EZP_START_OFFLINE they call afterwards. Samples are taken by a SIGPROF handler, which must not be used by anything else.
+ */
+#define EZP_SET_SAMPLING(PERIOD_MS,BACKTRACES) ezp::EasyPerformanceAnalyzer::setSampling(PERIOD_MS,BACKTRACES);
+
+/**
+ * @brief Turns on or off the offline analysis of functions compiled with -finstrument-functions, needs libezp_hooks linked in
+ *
+ * Every instrumented function becomes an offline analysis block; reports name it after its symbol, found with dladdr()
+ * when the report is made, so link with -rdynamic for the functions of the executable to have names
+ */
+#define EZP_SET_FUNCTION_HOOKS(ON) ezp::EasyPerformanceAnalyzer::setFunctionHooks(ON);
+
+/**
+ * @brief Enables the instrumented functions whose addresses are in [BEGIN, END), overriding earlier function filters that match them
+ *
+ * [&function, (char*)&function + 1) matches a single function; [0, UINTPTR_MAX) matches all functions
+ */
+#define EZP_ENABLE_FUNCTIONS(BEGIN,END) ezp::EasyPerformanceAnalyzer::setFunctionFilter((const void*)(BEGIN),(const void*)(END),true);
+
+/**
+ * @brief Disables the instrumented functions whose addresses are in [BEGIN, END), overriding earlier function filters that match them
+ */
+#define EZP_DISABLE_FUNCTIONS(BEGIN,END) ezp::EasyPerformanceAnalyzer::setFunctionFilter((const void*)(BEGIN),(const void*)(END),false);
+
+/**
+ * @brief Keeps the recent blocks of each thread and writes them to a trace file whenever BLOCK_NAME lasts longer than THRESHOLD_MS
+ *
+ * A THRESHOLD_MS of 0 stops tracing BLOCK_NAME. Traces are Chrome trace event files that chrome://tracing or Perfetto open.
+ */
+#define EZP_SET_TRACE_THRESHOLD(BLOCK_NAME,THRESHOLD_MS) ezp::EasyPerformanceAnalyzer::setTraceThreshold(BLOCK_NAME,THRESHOLD_MS);
+
+/**
+ * @brief Sets where traces are written, the N-th trace goes to PATH.N.json (default PATH is "ezp_trace")
+ */
+#define EZP_SET_TRACE_PATH(PATH) ezp::EasyPerformanceAnalyzer::setTracePath(PATH);
+
+/**
+ * @brief Records every offline analysis block that ends from now on to the file PATH, see ezp_decode
+ *
+ * Threads buffer their blocks and a background thread compresses each full buffer into one chunk of the file
+ */
+#define EZP_BEGIN_RECORDING(PATH) ezp::EasyPerformanceAnalyzer::startRecording(PATH);
+
+/**
+ * @brief Stops recording, writes the remaining buffered blocks and the index of the recording and closes it
+ */
+#define EZP_END_RECORDING ezp::EasyPerformanceAnalyzer::stopRecording();
+
+/**
+ * @brief Tags the offline analysis blocks that the calling thread ends from now on with request ID, 0 for none
+ *
+ * Recordings keep the tag so that ezp_critical follows a request across all the threads that worked on it
+ */
+#define EZP_SET_REQUEST_ID(ID) ezp::EasyPerformanceAnalyzer::setRequestId(ID);
+
 /**
  * @brief Forces error messages to stderr instead of Logcat on Android
  */
@@ -59,6 +223,32 @@
  */
 #define EZP_FORCE_STDERR_OFF ezp::EasyPerformanceAnalyzer::forceStdErr = false;
 
+/**
+ * @brief Makes processes forked from this one send their offline analysis records to this process when they exit
+ *
+ * The records of all children are summed in the retired bucket "children"
+ */
+#define EZP_MERGE_CHILDREN ezp::EasyPerformanceAnalyzer::enableChildMerging();
+
+/**
+ * @brief Sends the offline analysis records of this forked process to its parent process and clears them
+ */
+#define EZP_MERGE_INTO_PARENT ezp::EasyPerformanceAnalyzer::mergeIntoParent();
+
+/**
+ * @brief Sets the process whose analysis session is controlled by *_REMOTE calls, 0 for the first instrumented process (default)
+ *
+ * Processes forked from an instrumented process have their own session that can only be reached this way
+ */
+#define EZP_SET_REMOTE_PID(PID) ezp::EasyPerformanceAnalyzer::remotePid = PID;
+
+/**
+ * @brief Sets the name of the command socket that EZP_BEGIN_CONTROL listens on and *_REMOTE calls reach, "ezp_control" by default
+ *
+ * Sessions with different names are independent, e.g ezp_aggregator listens on "ezp_aggregator"
+ */
+#define EZP_SET_CONTROL_NAME(NAME) ezp::EasyPerformanceAnalyzer::cmdSocketName = NAME;
+
 /**
  * @brief Turns on instrumentation for the analysis session that is in a potentially different process
  */
@@ -69,15 +259,55 @@
  */
 #define EZP_DISABLE_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_DISABLE);
 
+/**
+ * @brief Enables the blocks whose names begin with PREFIX in a potentially different process
+ */
+#define EZP_ENABLE_BLOCKS_REMOTE(PREFIX) ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_ENABLE_BLOCKS,PREFIX);
+
+/**
+ * @brief Disables the blocks whose names begin with PREFIX in a potentially different process
+ */
+#define EZP_DISABLE_BLOCKS_REMOTE(PREFIX) ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_DISABLE_BLOCKS,PREFIX);
+
+/**
+ * @brief Enables the threads whose ID is THREAD or whose names begin with THREAD in a potentially different process
+ */
+#define EZP_ENABLE_THREADS_REMOTE(THREAD) ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_ENABLE_THREADS,THREAD);
+
+/**
+ * @brief Disables the threads whose ID is THREAD or whose names begin with THREAD in a potentially different process
+ */
+#define EZP_DISABLE_THREADS_REMOTE(THREAD) ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_DISABLE_THREADS,THREAD);
+
+/**
+ * @brief Removes all block and thread filters in a potentially different process
+ */
+#define EZP_RESET_FILTERS_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_RESET_FILTERS);
+
+/**
+ * @brief Sets the trace threshold of a block in a potentially different process, THRESHOLD is "BLOCK_NAME:THRESHOLD_MS"
+ */
+#define EZP_SET_TRACE_THRESHOLD_REMOTE(THRESHOLD) ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_SET_TRACE_THRESHOLD,THRESHOLD);
+
+/**
+ * @brief Starts recording to PATH in a potentially different process, PATH is relative to the working directory of that process
+ */
+#define EZP_BEGIN_RECORDING_REMOTE(PATH) ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_RECORD,PATH);
+
+/**
+ * @brief Stops recording in a potentially different process
+ */
+#define EZP_END_RECORDING_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_RECORD);
+
 /**
  * @brief Begins a real-time analysis block
  */
-#define EZP_START(BLOCK_NAME) ezp::EasyPerformanceAnalyzer::startProfiling(BLOCK_NAME);
+#define EZP_START(BLOCK_NAME) ezp::OnlineAnalyzer::start(BLOCK_NAME);
 
 /**
  * @brief Ends a real-time analysis block and prints execution time
  */
-#define EZP_END(BLOCK_NAME) ezp::EasyPerformanceAnalyzer::endProfiling(BLOCK_NAME);
+#define EZP_END(BLOCK_NAME) ezp::OnlineAnalyzer::end(BLOCK_NAME);
 
 /**
  * @brief Starts a smoothed real-time analysis block
@@ -94,21 +324,98 @@
  */
 #define EZP_END_SMOOTH_FACTOR(BLOCK_NAME,SMOOTHING_FACTOR) ezp::EasyPerformanceAnalyzer::endProfilingSmooth(BLOCK_NAME,SMOOTHING_FACTOR);
 
+/**
+ * @brief Sets the minimum wall clock interval between two prints of the same smoothed block
+ *
+ * 0 prints on every EZP_END_SMOOTH* (default), a positive value in milliseconds prints at most once per interval and
+ * a negative value never prints automatically, leaving EZP_PRINT_SMOOTH as the only way to see the smoothed times
+ */
+#define EZP_SET_SMOOTH_PRINT_INTERVAL(INTERVAL_MS) ezp::EasyPerformanceAnalyzer::smoothPrintInterval = INTERVAL_MS;
+
 /**
  * @brief Starts an offline analysis block
  */
-#define EZP_START_OFFLINE(BLOCK_NAME) ezp::EasyPerformanceAnalyzer::startProfilingOffline(BLOCK_NAME);
+#define EZP_START_OFFLINE(BLOCK_NAME) ezp::OfflineAnalyzer::start(BLOCK_NAME);
 
 /**
  * @brief Ends an offline analysis block
  */
-#define EZP_END_OFFLINE(BLOCK_NAME) ezp::EasyPerformanceAnalyzer::endProfilingOffline(BLOCK_NAME);
+#define EZP_END_OFFLINE(BLOCK_NAME) ezp::OfflineAnalyzer::end(BLOCK_NAME);
 
 /**
  * @brief Prints average and total times and numbers of execution of all offline analysis blocks in this process
  */
 #define EZP_PRINT_OFFLINE ezp::EasyPerformanceAnalyzer::printOfflineProfiles();
 
+/**
+ * @brief Prints the current smoothed times and their variances of all smoothed analysis blocks in this process
+ */
+#define EZP_PRINT_SMOOTH ezp::EasyPerformanceAnalyzer::printSmoothProfiles();
+
+/**
+ * @brief Prints the offline analysis blocks that are started but not ended in each thread of this process, with their wall clock time so far
+ */
+#define EZP_PRINT_OPEN ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_PRINT_OPEN);
+
+/**
+ * @brief Prints the memory that EZP itself uses in this process, broken down by structure
+ */
+#define EZP_PRINT_MEMORY ezp::EasyPerformanceAnalyzer::control(ezp::EasyPerformanceAnalyzer::CMD_PRINT_MEMORY);
+
+/**
+ * @brief Bounds the memory of EZP, 0 for no limit on the first two
+ *
+ * Past MAX_RECORDS offline, real-time or smoothed analysis records, blocks without a record of their own in a thread share
+ * the EZP_OTHER_NAME record of that thread, which is created even past the limit: each analysis holds at most MAX_RECORDS
+ * records plus one per live thread. Past MAX_POOLS - 1 retired buckets, exited threads of further pools are folded into the
+ * EZP_OTHER_NAME bucket, so there are at most MAX_POOLS buckets. Live threads are not capped, they are bounded by the threads
+ * that the program runs at once. Threads allocate trace rings of TRACE_RING_SIZE blocks from then on.
+ */
+#define EZP_SET_MEMORY_LIMITS(MAX_RECORDS,MAX_POOLS,TRACE_RING_SIZE) ezp::EasyPerformanceAnalyzer::setMemoryLimits(MAX_RECORDS,MAX_POOLS,TRACE_RING_SIZE);
+
+/**
+ * @brief Writes all information on offline analysis blocks in this process to a FILE* or a file descriptor in TEXT, JSON or CSV format
+ */
+#define EZP_WRITE_OFFLINE(OUTPUT,FORMAT) ezp::EasyPerformanceAnalyzer::writeOfflineProfiles(OUTPUT,ezp::EasyPerformanceAnalyzer::FORMAT_##FORMAT);
+
+/**
+ * @brief Benchmarks FUNCTION, a function or functor called without arguments, and prints its mean, median, standard deviation and confidence interval per call
+ *
+ * FUNCTION is timed on the thread CPU clock in batches of calls long enough for the clock, whose overhead is subtracted.
+ * Warm-up batches are discarded until the median of EZP_BENCH_WINDOW batches settles, then batches are timed until the
+ * 95% confidence interval of the mean is within the precision or the time budget runs out, see EZP_SET_BENCH_LIMITS.
+ * Each call of a measured batch also counts as one run of BLOCK_NAME, lasting the batch's time per call, in the offline analysis
+ * records of the calling thread.
+ */
+#define EZP_BENCH(BLOCK_NAME,FUNCTION) ezp::Benchmark<ezp::ThreadCpuClock>::run(BLOCK_NAME,FUNCTION);
+
+/**
+ * @brief Sets the half width of the confidence interval that EZP_BENCH aims for in % of the mean (default 1) and its wall clock time budget in ms (default 1000)
+ */
+#define EZP_SET_BENCH_LIMITS(PRECISION_PERCENT,BUDGET_MS) ezp::EasyPerformanceAnalyzer::benchPrecision = (PRECISION_PERCENT)/100.0f; ezp::EasyPerformanceAnalyzer::benchBudget = BUDGET_MS;
+
+/**
+ * @brief Appends all information on offline analysis blocks in this process to an std::string in TEXT, JSON or CSV format
+ */
+#define EZP_FORMAT_OFFLINE(OUTPUT,FORMAT) ezp::EasyPerformanceAnalyzer::formatOfflineProfiles(ezp::EasyPerformanceAnalyzer::FORMAT_##FORMAT,OUTPUT);
+
+/**
+ * @brief Writes all offline analysis records in this process to a binary dump file
+ */
+#define EZP_DUMP_OFFLINE(PATH) ezp::EasyPerformanceAnalyzer::dumpOfflineProfiles(PATH);
+
+/**
+ * @brief Writes all offline analysis records in this process to a binary dump file when the process exits normally
+ */
+#define EZP_DUMP_ON_EXIT(PATH) ezp::EasyPerformanceAnalyzer::dumpOnExit(PATH);
+
+/**
+ * @brief Writes all offline analysis records in this process to a binary dump file whenever the given signal is received
+ *
+ * The process continues after SIGUSR1 and SIGUSR2; for other signals, the signal is raised again with its default action after the dump
+ */
+#define EZP_DUMP_ON_SIGNAL(SIGNUM,PATH) ezp::EasyPerformanceAnalyzer::dumpOnSignal(SIGNUM,PATH);
+
 /**
  * @brief Erases the offline analysis history in this process
  */
@@ -119,342 +426,2353 @@
  */
 #define EZP_PRINT_OFFLINE_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_PRINT);
 
+/**
+ * @brief Prints the current smoothed times and their variances of all smoothed analysis blocks in a potentially different process
+ */
+#define EZP_PRINT_SMOOTH_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_PRINT_SMOOTH);
+
+/**
+ * @brief Prints all information on offline analysis blocks in a potentially different process as JSON to the stdout of this process
+ */
+#define EZP_PRINT_OFFLINE_JSON_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_PRINT_JSON);
+
+/**
+ * @brief Prints all information on offline analysis blocks in a potentially different process as CSV to the stdout of this process
+ */
+#define EZP_PRINT_OFFLINE_CSV_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_PRINT_CSV);
+
 /**
  * @brief Erases the offline analysis history in a potentially different process
  */
 #define EZP_CLEAR_OFFLINE_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_CLEAR);
 
+/**
+ * @brief Prints the offline analysis blocks open in each thread of a potentially different process to the stdout of the caller, e.g to find where it hangs
+ */
+#define EZP_PRINT_OPEN_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_PRINT_OPEN);
+
+/**
+ * @brief Prints the memory that EZP itself uses in a potentially different process, broken down by structure, to the stdout of the caller
+ */
+#define EZP_PRINT_MEMORY_REMOTE ezp::EasyPerformanceAnalyzer::controlRemote(ezp::EasyPerformanceAnalyzer::CMD_PRINT_MEMORY);
+
 ///////////////////////////////////////////////////////////////////////////////
 //Private API
 ///////////////////////////////////////////////////////////////////////////////
 
 #include<algorithm>
 #include<cerrno>
+#include<climits>
 #include<cmath>
+#include<cstddef>
+#include<csignal>
+#include<cstring>
 #include<ctime>
 #include<map>
+#include<new>
 #include<pthread.h>
 #include<unistd.h>
 #include<string>
 #include<vector>
 
-#include<sys/socket.h>
-#include<sys/syscall.h>
-#include<sys/un.h>
+#include<netinet/in.h>
+#include<sys/socket.h>
+#include<sys/syscall.h>
+#include<sys/un.h>
+
+#include<cstdio>
+
+#ifdef ANDROID
+#include<android/log.h>
+#else
+#include<bits/local_lim.h>
+#endif
+
+/**
+ * @brief Number of buckets in the duration histogram of offline analysis blocks
+ *
+ * Bucket 0 holds durations of 0 ns and bucket i > 0 holds durations in [2^(i-1), 2^i) ns; the last bucket also holds
+ * all longer durations
+ */
+#define EZP_HISTOGRAM_BUCKETS 40
+
+/**
+ * @brief Number of timed batches in a warm-up window of EZP_BENCH, warm-up ends once the median of a window is within 5% of the previous one
+ */
+#define EZP_BENCH_WINDOW 10
+
+/**
+ * @brief Minimum number of measured batches before EZP_BENCH checks its confidence interval
+ */
+#define EZP_BENCH_MIN_SAMPLES 30
+
+/**
+ * @brief Maximum number of measured batches of EZP_BENCH, all are kept for the median
+ */
+#define EZP_BENCH_MAX_SAMPLES 100000
+
+/**
+ * @brief Minimum length of a timed batch of EZP_BENCH in clock overheads, shorter functions are called several times per batch
+ */
+#define EZP_BENCH_MIN_BATCH 100
+
+/**
+ * @brief Maximum number of offline analysis records, i.e (thread, block) pairs, that binary dumps can contain
+ */
+#define EZP_MAX_DUMPED_BLOCKS 4096
+
+/**
+ * @brief Size of thread name buffers, including the terminating null character
+ */
+#define EZP_THREAD_NAME_LENGTH 16
+
+/**
+ * @brief Maximum length of a command sent to the command listener, including the command character and the terminating null character
+ */
+#define EZP_MAX_CMD_LENGTH 64
+
+/**
+ * @brief Maximum number of distinct block names that block filters can tell apart; further blocks are always enabled
+ */
+#define EZP_MAX_BLOCK_IDS 1024
+
+/**
+ * @brief Size of the hash table that maps block names to block IDs, must be a power of two larger than EZP_MAX_BLOCK_IDS
+ */
+#define EZP_BLOCK_ID_TABLE_SIZE 2048
+
+/**
+ * @brief Default number of most recently ended blocks that each thread keeps for traces, see EZP_SET_MEMORY_LIMITS
+ */
+#define EZP_TRACE_RING_SIZE 256
+
+/**
+ * @brief Name of the record that blocks of a thread share once there are too many records, and of the pool whose retired
+ * bucket exited threads go to once there are too many pools, see EZP_SET_MEMORY_LIMITS; blocks cannot be named so
+ */
+#define EZP_OTHER_NAME "othr"
+
+/**
+ * @brief Number of blocks that can be open at once in the EZP_OTHER_NAME records of a thread with their own begin times, deeper ones share those of the records
+ */
+#define EZP_MAX_OTHER_BLOCKS 16
+
+/**
+ * @brief Bytes that a map node takes in addition to its value in common standard libraries, i.e its color and three links
+ */
+#define EZP_MAP_NODE_OVERHEAD (4*sizeof(void*))
+
+/**
+ * @brief Maximum number of traces written after a trace threshold is set, so that a too low threshold does not flood the disk
+ */
+#define EZP_MAX_TRACES 64
+
+/**
+ * @brief Number of NUMA nodes that offline analysis records tell apart, blocks ending on further nodes count for the last one
+ */
+#define EZP_MAX_NUMA_NODES 8
+
+/**
+ * @brief Number of CPUs whose NUMA node is known, blocks ending on further CPUs count for node 0
+ */
+#define EZP_MAX_CPUS 1024
+
+/**
+ * @brief Maximum number of distinct functions analyzed through function hooks, further functions are not analyzed
+ */
+#define EZP_MAX_FUNCTIONS 16384
+
+/**
+ * @brief Size of the hash table that maps function addresses to function indices, must be a power of two larger than EZP_MAX_FUNCTIONS
+ */
+#define EZP_FUNCTION_TABLE_SIZE 32768
+
+/**
+ * @brief Call depth down to which function hooks analyze functions, deeper calls are not analyzed
+ */
+#define EZP_MAX_FUNCTION_DEPTH 256
+
+/**
+ * @brief Block names of functions are their index ORed with this, no 4 character block name begins with '\x01'
+ */
+#define EZP_FUNCTION_BLOCK_NAME 0x01000000u
+
+/**
+ * @brief Size of the buffers that block names are written to in reports, i.e 4 characters or a function symbol, including the terminating null character
+ */
+#define EZP_BLOCK_LABEL_LENGTH 256
+
+/**
+ * @brief Number of offline analysis blocks that can be open at once in a thread, deeper blocks are not listed and get no samples
+ */
+#define EZP_MAX_OPEN_BLOCKS 64
+
+/**
+ * @brief Number of ended offline analysis blocks that each thread buffers before they become one chunk of a recording
+ */
+#define EZP_RECORD_BUFFER_EVENTS 4096
+
+/**
+ * @brief Number of frames in the backtraces of samples, including the interrupted instruction
+ */
+#define EZP_SAMPLE_FRAMES 8
+
+/**
+ * @brief Number of most recent sample backtraces that each thread keeps
+ */
+#define EZP_SAMPLE_RING_SIZE 1024
+
+/**
+ * @brief Number of most sampled backtraces shown for each block in text reports
+ */
+#define EZP_MAX_REPORTED_STACKS 5
+
+namespace ezp{
+
+typedef pid_t TID;
+typedef struct timespec Timespec;
+
+/**
+ * @brief Key to reaching analysis records
+ */
+struct BlockKey_t{
+    TID tid;                ///< Thread ID of the block's caller
+    unsigned int blockName; ///< Hash of name of the block
+
+    /**
+     * @brief Creates a new analysis record key
+     *
+     * @param tid_ Thread ID of the block's caller
+     * @param blockName_ Hash of the name of the block
+     */
+    BlockKey_t(TID tid_, unsigned int blockName_)
+    {
+        tid = tid_;
+        blockName = blockName_;
+    }
+
+    /**
+     * @brief Compares two BlockKeys for sorting purposes, thread ID has priority
+     *
+     * @param one First compared key
+     * @param two Second compared key
+     *
+     * @return Whether first key is ahead of second key
+     */
+    static bool compare(const struct BlockKey_t& one, const struct BlockKey_t& two)
+    {
+        if(one.tid == two.tid)
+            return one.blockName > two.blockName;
+        else
+            return one.tid > two.tid;
+    }
+};
+
+/**
+ * @brief Allocations of a thread so far, counted by libezp_malloc.so
+ */
+struct AllocCounters_t{
+    unsigned long long count;   ///< Number of allocations
+    unsigned long long bytes;   ///< Number of bytes requested
+};
+
+/**
+ * @brief Sample taken in a thread, as kept for backtraces
+ */
+struct SampleEvent_t{
+    unsigned int blockName;             ///< Innermost offline analysis block open when the sample was taken
+    unsigned int weight;                ///< Number of periods the sample stands for, more than 1 when the timer overran
+    unsigned int numFrames;             ///< Number of valid entries in frames
+    void* frames[EZP_SAMPLE_FRAMES];    ///< Interrupted instruction, then return addresses of its callers
+};
+
+/**
+ * @brief Block that ended in a thread, as kept for traces
+ */
+struct TraceEvent_t{
+    unsigned int blockName;         ///< Hash of the name of the block
+    unsigned long long beginTime;   ///< When the block began in ns, on EZP_CLOCK
+    unsigned long long duration;    ///< How long the block lasted in ns
+};
+
+/**
+ * @brief Trace ring of a thread as copied when one of its blocks went over its threshold, queued for the trace writer thread
+ */
+struct TraceSnapshot_t{
+    TID tid;                                ///< ID of the thread
+    char threadName[EZP_THREAD_NAME_LENGTH];///< Name of the thread
+    unsigned int index;                     ///< N of the trace file
+    unsigned long long threshold;           ///< Threshold of the last block in ns
+    unsigned int numEvents;                 ///< Number of entries of events
+    struct TraceEvent_t* events;            ///< Blocks of the ring, oldest first; the last one is over its threshold
+    struct TraceSnapshot_t* next;           ///< Next snapshot in the queue
+};
+
+/**
+ * @brief Offline analysis block that ended in a thread, as buffered for recordings
+ */
+struct RecordEvent_t{
+    unsigned int blockName;     ///< Hash of the name of the block
+    unsigned long long begin;   ///< When the block began in ns, on EZP_WALL_CLOCK
+    unsigned long long end;     ///< When the block ended in ns, on EZP_WALL_CLOCK
+    unsigned long long cpuTime; ///< How long the block lasted in ns, on EZP_CLOCK
+    unsigned long long request; ///< Request ID of the thread when the block ended, 0 for none
+};
+
+/**
+ * @brief Blocks of one thread that become one chunk of a recording once full, or once the recording stops
+ */
+struct RecordBuffer_t{
+    int tid;                                            ///< Thread ID
+    char threadName[EZP_THREAD_NAME_LENGTH];            ///< Thread name when the buffer was queued
+    unsigned int numEvents;                             ///< Number of valid entries in events
+    struct RecordBuffer_t* next;                        ///< Next buffer in the encoder queue or in the free list
+    struct RecordEvent_t events[EZP_RECORD_BUFFER_EVENTS]; ///< Ended blocks, in the order they ended
+    unsigned int numOpenEvents;                         ///< Number of valid entries in openEvents
+    struct RecordEvent_t openEvents[EZP_MAX_OPEN_BLOCKS]; ///< Blocks still open when the thread filled the buffer, outermost first, end and cpuTime unused
+};
+
+/**
+ * @brief Offline analysis block open in a thread
+ */
+struct OpenBlock_t{
+    struct AggregateMarker_t* marker;   ///< Record of the block
+    unsigned int blockName;             ///< Hash of the name of the block, that of the record unless it is the EZP_OTHER_NAME record
+    Timespec wallBegin;                 ///< When the block was started, on EZP_WALL_CLOCK
+};
+
+/**
+ * @brief Kinds of analysis records
+ */
+enum BlockAnalysis{
+    ANALYSIS_REALTIME = 0,  ///< EZP_START/EZP_END records
+    ANALYSIS_SMOOTHED = 1,  ///< EZP_START_SMOOTH/EZP_END_SMOOTH records
+    ANALYSIS_OFFLINE = 2    ///< EZP_START_OFFLINE/EZP_END_OFFLINE records
+};
+
+/**
+ * @brief Block open in the EZP_OTHER_NAME record of a thread
+ *
+ * Blocks sharing that record may be nested, so each keeps its own begin time until it ends.
+ */
+struct OtherBlock_t{
+    unsigned int blockName;             ///< Hash of the name of the block
+    unsigned int analysis;              ///< BlockAnalysis of the record
+    Timespec beginTime;                 ///< When the block was started, on the clock of its analysis
+};
+
+/**
+ * @brief Name and trace ring of a live thread, or name of the retired bucket that holds the records of exited threads of a pool
+ */
+struct ThreadInfo_t{
+    TID tid;                            ///< Thread ID, negative for a retired bucket
+    char name[EZP_THREAD_NAME_LENGTH];  ///< Thread name, or pool name for a retired bucket
+    bool named;                         ///< Whether name was set with EZP_SET_THREAD_NAME, otherwise it follows the pthread name
+    bool retired;                       ///< Whether this is a retired bucket
+    bool disabled;                      ///< Whether thread filters disable this thread
+    struct TraceEvent_t* traceRing;     ///< Most recently ended blocks of this thread, NULL until a trace threshold is set
+    unsigned int traceRingSize;         ///< Number of entries of traceRing
+    unsigned int numTraceEvents;        ///< Number of blocks ever put in traceRing, the next one goes to numTraceEvents % traceRingSize
+    struct AllocCounters_t* allocCounters; ///< Allocation counters of this thread in libezp_malloc.so, NULL until first needed
+    struct OpenBlock_t openBlocks[EZP_MAX_OPEN_BLOCKS]; ///< Offline blocks open in this thread, innermost last
+    unsigned int numOpenBlocks;         ///< Number of valid entries in openBlocks
+    unsigned int openSequence;          ///< Odd while openBlocks changes, for other threads to read it without locks
+    struct OtherBlock_t otherBlocks[EZP_MAX_OTHER_BLOCKS]; ///< Blocks open in the EZP_OTHER_NAME records of this thread, innermost last, only used by this thread
+    unsigned int numOtherBlocks;        ///< Number of valid entries in otherBlocks
+    bool samplingTimerCreated;          ///< Whether samplingTimer exists
+    timer_t samplingTimer;              ///< Timer on the CPU time of this thread that sends it SIGPROF
+    unsigned int samplingGeneration;    ///< samplingGeneration when samplingTimer was last armed, 0 if never
+    struct SampleEvent_t* sampleRing;   ///< Most recent sample backtraces of this thread, NULL unless backtraces were asked for
+    unsigned int numSampleEvents;       ///< Number of samples ever put in sampleRing, the next one goes to numSampleEvents % EZP_SAMPLE_RING_SIZE
+    unsigned long stackLow;             ///< Lowest address of the stack of this thread, frame pointers are only followed inside the stack
+    unsigned long stackHigh;            ///< Address after the highest address of the stack of this thread
+    struct RecordBuffer_t* recordBuffer;///< Blocks buffered for the recording, NULL if none, EZP_RECORD_BUSY while this thread appends to it
+    unsigned long long requestId;       ///< Request that this thread works on, 0 for none
+};
+
+/**
+ * @brief Holds a smooth analysis record
+ */
+struct SmoothMarker_t{
+    Timespec beginTime;     ///< When the most recent block was started
+    Timespec lastPrintTime; ///< Wall clock time when this block was last printed
+    float lastSlice;        ///< Most recent smoothed time that this analysis took, i.e history
+    float variance;         ///< Most recent smoothed variance of the time that this analysis took
+
+    /**
+     * @brief Creates a new smooth analysis record with zero history
+     */
+    SmoothMarker_t()
+    {
+        lastPrintTime.tv_sec = 0;
+        lastPrintTime.tv_nsec = 0;
+        lastSlice = 0.0f;
+        variance = 0.0f;
+    }
+};
+
+/**
+ * @brief Header of the shared memory segment that publishes offline analysis records, followed by capacity SharedRecords
+ */
+struct SharedHeader_t{
+    char magic[4];                  ///< Always "EZPS"
+    unsigned int version;           ///< Version of the segment layout, currently 2
+    unsigned int pid;               ///< Process ID of the publishing process
+    unsigned int histogramBuckets;  ///< Number of histogram buckets per record, EZP_HISTOGRAM_BUCKETS of the publishing process
+    unsigned int recordSize;        ///< Size of one record in bytes
+    unsigned int capacity;          ///< Number of records that follow
+    unsigned int numRecords;        ///< Number of records in use, written with release semantics
+    unsigned int retireSeq;         ///< Sequence lock, odd while the records of an exiting thread move to a retired bucket
+    unsigned int clearGeneration;   ///< Bumped with release semantics before the records are cleared, a reader forgets what it saw when it changes
+};
+
+/**
+ * @brief Offline analysis record of one block of one thread in the shared memory segment, protected by a sequence lock
+ *
+ * The owning thread makes seq odd, updates the record and makes seq even again; a reader retries until it reads the same even seq
+ * before and after copying the record
+ */
+struct SharedRecord_t{
+    unsigned int seq;                                   ///< Sequence lock, odd while the record is being written
+    int tid;                                            ///< Thread ID
+    unsigned int blockName;                             ///< Hash of the name of the block
+    unsigned int reserved;                              ///< Padding, always 0
+    unsigned long long numSamples;                      ///< How many times this block was ran
+    unsigned long long totalTime;                       ///< Total time in nanoseconds that this block took
+    unsigned long long histogram[EZP_HISTOGRAM_BUCKETS];///< Number of runs in each duration bucket
+};
+
+/**
+ * @brief Header at the beginning of a recording file
+ *
+ * Chunks follow the header, then the block names, then the chunk index, then a RecordTrailer. A chunk holds the blocks
+ * of one thread as 5 varints each: the index of its name in the block names, its beginning minus the beginning of the
+ * previous block of the chunk (the first one is relative to RecordChunk::firstBegin) zigzag encoded, its wall clock
+ * duration, its CPU time and its request ID. A varint count of the blocks that were still open in the thread when the
+ * chunk was cut follows, 0 for the last chunk of a thread, each as its name index, zigzag encoded beginning delta and
+ * request ID. Varints are 7 bits per byte, least significant first, high bit set on all but the last byte. Version 1
+ * files lack request IDs and open blocks.
+ */
+struct RecordHeader_t{
+    char magic[4];                  ///< Always "EZPR"
+    unsigned int version;           ///< Version of the file layout, currently 2
+    unsigned int pid;               ///< Process ID of the recording process
+    unsigned int reserved;          ///< Padding, always 0
+    unsigned long long beginTime;   ///< When the recording began in ns, on EZP_WALL_CLOCK
+};
+
+/**
+ * @brief Entry of the chunk index of a recording
+ */
+struct RecordChunk_t{
+    unsigned long long offset;              ///< Offset of the chunk in the file
+    unsigned int size;                      ///< Size of the chunk in bytes
+    unsigned int numEvents;                 ///< Number of blocks in the chunk
+    int tid;                                ///< Thread ID of the blocks
+    unsigned int codec;                     ///< How the varints are further compressed, 0 for not at all
+    char threadName[EZP_THREAD_NAME_LENGTH];///< Thread name
+    unsigned long long firstBegin;          ///< Earliest beginning of the blocks, open ones included, in ns, on EZP_WALL_CLOCK
+    unsigned long long lastEnd;             ///< Latest end of the blocks in ns, on EZP_WALL_CLOCK
+};
+
+/**
+ * @brief Trailer at the end of a recording file, a file without it was not closed
+ *
+ * Each of the numNames block names is the hash of the name (4 bytes), the length of its label (4 bytes) and the label
+ */
+struct RecordTrailer_t{
+    unsigned long long namesOffset; ///< Offset of the block names in the file
+    unsigned long long indexOffset; ///< Offset of the chunk index in the file
+    unsigned long long endTime;     ///< When the recording ended in ns, on EZP_WALL_CLOCK
+    unsigned int numNames;          ///< Number of block names
+    unsigned int numChunks;         ///< Number of chunks
+    char magic[4];                  ///< Always "EZPI"
+    unsigned int version;           ///< Version of the file layout, currently 2
+};
+
+/**
+ * @brief Offline analysis block decoded from a recording
+ */
+struct RecordedBlock_t{
+    int tid;                    ///< Thread ID
+    unsigned int blockName;     ///< Hash of the name of the block
+    unsigned long long begin;   ///< When the block began in ns since the beginning of the recording
+    unsigned long long end;     ///< When the block ended in ns since the beginning of the recording
+    unsigned long long cpuTime; ///< How long the block lasted in ns of thread CPU time
+    unsigned long long request; ///< Request ID of the thread when the block ended, 0 for none
+
+    /**
+     * @brief Compares two RecordedBlocks on their beginnings for sorting purposes, longer blocks first so that parents come before their children
+     *
+     * @param one First compared block
+     * @param two Second compared block
+     *
+     * @return Whether the first block began before the second
+     */
+    static bool compareBegin(const struct RecordedBlock_t& one, const struct RecordedBlock_t& two)
+    {
+        return one.begin != two.begin ? one.begin < two.begin : one.end > two.end;
+    }
+};
+
+/**
+ * @brief Recording read from a file
+ */
+struct Recording_t{
+    unsigned int pid;                               ///< Process ID of the recording process
+    unsigned long long beginTime;                   ///< When the recording began in ns, on EZP_WALL_CLOCK of the recording process
+    unsigned long long duration;                    ///< How long the recording lasted in ns
+    std::vector<struct RecordChunk_t> chunks;       ///< Chunk index
+    std::map<unsigned int, std::string> labels;     ///< Label of each block name
+    std::vector<struct RecordedBlock_t> blocks;     ///< Decoded blocks, sorted on beginning
+};
+
+/**
+ * @brief Outcome of an EZP_BENCH benchmark, times are per call in ns
+ */
+struct BenchResult_t{
+    unsigned int blockName;             ///< Hash of the name of the benchmark
+    unsigned long long batch;           ///< Number of calls per timed batch
+    unsigned long long warmupSamples;   ///< Number of batches discarded as warm-up, batch size search included
+    unsigned long long numSamples;      ///< Number of measured batches
+    double overhead;                    ///< Clock overhead subtracted from each batch in ns
+    double mean;                        ///< Mean time per call
+    double median;                      ///< Median time per call
+    double stddev;                      ///< Standard deviation of the time per call over measured batches
+    double ciHalfWidth;                 ///< Half width of the 95% confidence interval of the mean
+    bool converged;                     ///< Whether the confidence interval got within the precision before the time budget ran out
+};
+
+/**
+ * @brief Progress of a running EZP_BENCH benchmark
+ */
+struct BenchState_t{
+    struct BenchResult_t result;        ///< Outcome so far
+    int phase;                          ///< 0 while searching the batch size, 1 while warming up, 2 while measuring
+    Timespec beginTime;                 ///< When the benchmark began, on EZP_WALL_CLOCK
+    std::vector<double> window;         ///< Times per call of the batches of the current warm-up window
+    double previousMedian;              ///< Median of the previous warm-up window, negative if none
+    std::vector<double> samples;        ///< Times per call of the measured batches, reserved up front
+    double m2;                          ///< Sum of the squared differences of the measured batches from their mean
+};
+
+/**
+ * @brief Wall clock time and context switch counts of the calling thread, taken next to its CPU time
+ */
+struct SchedSample_t{
+    bool valid;                     ///< Whether the sample was taken, i.e whether scheduler statistics were on
+    Timespec wallTime;              ///< Wall clock time
+    long voluntarySwitches;         ///< Context switches so far where the thread gave up the CPU, e.g to wait for a lock or I/O
+    long involuntarySwitches;       ///< Context switches so far where the thread was preempted
+};
+
+/**
+ * @brief Scheduler statistics of the runs of a block that were sampled with SchedSamples at both ends
+ */
+struct SchedStats_t{
+    int numSamples;                         ///< Number of sampled runs
+    unsigned long long cpuTime;             ///< Total CPU time in nanoseconds of the sampled runs
+    unsigned long long wallTime;            ///< Total wall clock time in nanoseconds of the sampled runs
+    unsigned long long voluntarySwitches;   ///< Total voluntary context switches during the sampled runs
+    unsigned long long involuntarySwitches; ///< Total involuntary context switches during the sampled runs
+
+    /**
+     * @brief Initializes statistics with no sampled runs
+     */
+    SchedStats_t()
+    {
+        numSamples = 0;
+        cpuTime = 0;
+        wallTime = 0;
+        voluntarySwitches = 0;
+        involuntarySwitches = 0;
+    }
+
+    /**
+     * @brief Adds the sampled runs of other statistics of the same block
+     *
+     * @param stats Statistics to add
+     */
+    void add(const struct SchedStats_t& stats)
+    {
+        numSamples += stats.numSamples;
+        cpuTime += stats.cpuTime;
+        wallTime += stats.wallTime;
+        voluntarySwitches += stats.voluntarySwitches;
+        involuntarySwitches += stats.involuntarySwitches;
+    }
+
+    /**
+     * @brief Gets the time the sampled runs spent off the CPU, i.e waiting or preempted
+     *
+     * @return Wall clock time minus CPU time in nanoseconds, 0 if negative because of clock granularity
+     */
+    unsigned long long getOffCpuTime() const
+    {
+        return wallTime > cpuTime ? wallTime - cpuTime : 0;
+    }
+};
+
+/**
+ * @brief Memory allocated during the runs of a block that started and ended with allocation counting on
+ */
+struct AllocStats_t{
+    int numSamples;             ///< Number of counted runs
+    unsigned long long count;   ///< Total number of allocations during the counted runs
+    unsigned long long bytes;   ///< Total number of bytes requested during the counted runs
+
+    /**
+     * @brief Initializes statistics with no counted runs
+     */
+    AllocStats_t()
+    {
+        numSamples = 0;
+        count = 0;
+        bytes = 0;
+    }
+
+    /**
+     * @brief Adds the counted runs of other statistics of the same block
+     *
+     * @param stats Statistics to add
+     */
+    void add(const struct AllocStats_t& stats)
+    {
+        numSamples += stats.numSamples;
+        count += stats.count;
+        bytes += stats.bytes;
+    }
+};
+
+/**
+ * @brief Runs of a block broken down by the NUMA node of the CPU they ended on
+ */
+struct NodeStats_t{
+    int numSamples[EZP_MAX_NUMA_NODES];                 ///< Number of runs that ended on each node
+    unsigned long long totalTime[EZP_MAX_NUMA_NODES];   ///< Total time in nanoseconds of the runs that ended on each node
+
+    /**
+     * @brief Initializes statistics with no runs
+     */
+    NodeStats_t()
+    {
+        memset(numSamples, 0, sizeof(numSamples));
+        memset(totalTime, 0, sizeof(totalTime));
+    }
+
+    /**
+     * @brief Adds the runs of other statistics of the same block
+     *
+     * @param stats Statistics to add
+     */
+    void add(const struct NodeStats_t& stats)
+    {
+        for(int i=0;i<EZP_MAX_NUMA_NODES;i++){
+            numSamples[i] += stats.numSamples[i];
+            totalTime[i] += stats.totalTime[i];
+        }
+    }
+
+    /**
+     * @brief Tells whether any run was recorded per node
+     *
+     * @return Whether there is a run on any node
+     */
+    bool any() const
+    {
+        for(int i=0;i<EZP_MAX_NUMA_NODES;i++)
+            if(numSamples[i] > 0)
+                return true;
+        return false;
+    }
+};
+
+/**
+ * @brief Holds the total amount of time a block took in the past
+ *
+ * Only the thread that owns the block writes to the record; other threads may read it without locking. When the owning
+ * thread exits, the record is folded into the retired bucket of its pool and recycled with a tid of 0.
+ */
+struct AggregateMarker_t{
+    TID tid;                                            ///< Thread ID of the block's caller
+    unsigned int blockName;                             ///< Hash of the name of the block
+    Timespec beginTime;                                 ///< When the most recent block was started
+    unsigned long long totalTime;                       ///< Total time in nanoseconds that this block took in the past
+    int numSamples;                                     ///< How many times this block was ran in the past
+    unsigned int histogram[EZP_HISTOGRAM_BUCKETS];      ///< Number of past runs in each duration bucket
+    struct SharedRecord_t* shared;                      ///< Copy of this record in the shared memory segment, NULL if not published
+    struct SchedSample_t beginSched;                    ///< Scheduler sample taken when the most recent block was started
+    struct SchedStats_t sched;                          ///< Scheduler statistics of past runs, read under offlineLock only
+    struct NodeStats_t nodes;                           ///< Past runs per NUMA node, read under offlineLock only
+    bool beginAllocsValid;                              ///< Whether beginAllocs was taken, i.e whether allocation counting was on
+    struct AllocCounters_t beginAllocs;                 ///< Allocation counters of the thread when the most recent block was started
+    struct AllocStats_t allocs;                         ///< Memory allocated during past runs, read under offlineLock only
+    unsigned long long samples;                         ///< Number of SIGPROF samples taken while this block was open
+    unsigned long long selfSamples;                     ///< Number of SIGPROF samples taken while this block was the innermost open block
+
+    /**
+     * @brief Creates a new aggregate analysis with zero history
+     *
+     * @param tid_ Thread ID of the block's caller
+     * @param blockName_ Hash of the name of the block
+     */
+    AggregateMarker_t(TID tid_ = 0, unsigned int blockName_ = 0)
+    {
+        tid = tid_;
+        blockName = blockName_;
+        shared = NULL;
+        totalTime = 0;
+        numSamples = 0;
+        memset(histogram, 0, sizeof(histogram));
+        beginSched.valid = false;
+        beginAllocsValid = false;
+        samples = 0;
+        selfSamples = 0;
+    }
+};
+
+/**
+ * @brief Header of a binary offline analysis dump, followed by numRecords DumpRecords
+ */
+struct DumpHeader_t{
+    char magic[4];                  ///< Always "EZPD"
+    unsigned int version;           ///< Version of the dump format, currently 1
+    unsigned int pid;               ///< Process ID of the dumped process
+    unsigned int histogramBuckets;  ///< Number of histogram buckets per record, EZP_HISTOGRAM_BUCKETS of the dumped process
+    unsigned int numRecords;        ///< Number of records that follow
+};
+
+/**
+ * @brief Offline analysis record of one block of one thread in a binary offline analysis dump
+ */
+struct DumpRecord_t{
+    int tid;                                            ///< Thread ID
+    unsigned int blockName;                             ///< Hash of the name of the block
+    unsigned long long numSamples;                      ///< How many times this block was ran
+    unsigned long long totalTime;                       ///< Total time in nanoseconds that this block took
+    unsigned long long histogram[EZP_HISTOGRAM_BUCKETS];///< Number of runs in each duration bucket
+};
+
+/**
+ * @brief Brings AggregateMarker and BlockKey together in a sortable object
+ */
+struct AggregateProfile_t{
+    TID tid;                                            ///< Thread ID, negative for a retired bucket, 0 if grouped by name or pool
+    char threadName[EZP_THREAD_NAME_LENGTH];            ///< Thread name, or name of the group if grouped by name or pool
+    bool retired;                                       ///< Whether this holds the records of exited threads only
+    unsigned int blockName;                             ///< Hash of the name of the block
+    float averageTime;                                  ///< Average time in milliseconds the block took in the past, -1 if it never ran
+    int numSamples;                                     ///< How many times this block was ran in the past
+    unsigned long long totalTime;                       ///< Total time in nanoseconds the block took in the past
+    unsigned long long histogram[EZP_HISTOGRAM_BUCKETS];///< Number of past runs in each duration bucket
+    struct SchedStats_t sched;                          ///< Scheduler statistics of past runs
+    struct NodeStats_t nodes;                           ///< Past runs per NUMA node
+    struct AllocStats_t allocs;                         ///< Memory allocated during past runs
+    unsigned long long samples;                         ///< Number of samples taken while the block was open
+    unsigned long long selfSamples;                     ///< Number of samples taken while the block was the innermost open block
+
+    /**
+     * @brief Adds the runs of a profile of the same block coming from another thread of the same group
+     *
+     * @param profile Profile to add
+     */
+    void add(const struct AggregateProfile_t& profile)
+    {
+        totalTime += profile.totalTime;
+        numSamples += profile.numSamples;
+        retired = retired && profile.retired;
+        for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+            histogram[i] += profile.histogram[i];
+        sched.add(profile.sched);
+        nodes.add(profile.nodes);
+        allocs.add(profile.allocs);
+        samples += profile.samples;
+        selfSamples += profile.selfSamples;
+    }
+
+    /**
+     * @brief Compares two AggregateProfiles on their average times for sorting purposes
+     *
+     * @param one First compared profile
+     * @param two Second compared profile
+     *
+     * @return Whether first took more average time than the second
+     */
+    static bool compareAvgTime(const struct AggregateProfile_t& one, const struct AggregateProfile_t& two)
+    {
+        return one.averageTime > two.averageTime;
+    }
+
+    /**
+     * @brief Compares two AggregateProfiles on their block names for sorting purposes
+     *
+     * @param one First compared profile
+     * @param two Second compared profile
+     *
+     * @return Whether first block name comes before the second
+     */
+    static bool compareBlockName(const struct AggregateProfile_t& one, const struct AggregateProfile_t& two)
+    {
+        return one.blockName < two.blockName;
+    }
+};
+
+/**
+ * @brief Sum of profiles coming from different threads
+ */
+struct SummedProfile_t{
+    unsigned int blockName;                             ///< Hash of the name of the profile
+    unsigned long long totalTime;                       ///< Total time in nanoseconds this profile took
+    int numSamples;                                     ///< Total number of times this profile was done
+    unsigned long long histogram[EZP_HISTOGRAM_BUCKETS];///< Total number of runs in each duration bucket
+    struct SchedStats_t sched;                          ///< Total scheduler statistics
+    struct NodeStats_t nodes;                           ///< Total runs per NUMA node
+    struct AllocStats_t allocs;                         ///< Total memory allocated
+    unsigned long long samples;                         ///< Total number of samples taken while the block was open
+    unsigned long long selfSamples;                     ///< Total number of samples taken while the block was the innermost open block
+
+    /**
+     * @brief Initializes a new summed profile with no runs
+     *
+     * @param blockName_ Hash of the name of the block
+     */
+    SummedProfile_t(unsigned int blockName_ = 0)
+    {
+        blockName = blockName_;
+        totalTime = 0;
+        numSamples = 0;
+        memset(histogram, 0, sizeof(histogram));
+        samples = 0;
+        selfSamples = 0;
+    }
+
+    /**
+     * @brief Adds the runs of a profile coming from a thread
+     *
+     * @param profile Profile of the same block coming from a thread
+     */
+    void add(const struct AggregateProfile_t& profile)
+    {
+        totalTime += profile.totalTime;
+        numSamples += profile.numSamples;
+        for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+            histogram[i] += profile.histogram[i];
+        sched.add(profile.sched);
+        nodes.add(profile.nodes);
+        allocs.add(profile.allocs);
+        samples += profile.samples;
+        selfSamples += profile.selfSamples;
+    }
+
+    /**
+     * @brief Compares two SummedProfiles on their average times for sorting purposes
+     *
+     * @param one First compared profile
+     * @param two Second compared profile
+     *
+     * @return Whether first took more average time than the second
+     */
+    static bool compare(const struct SummedProfile_t& one, const struct SummedProfile_t& two)
+    {
+        return (one.numSamples == 0 ? -1.0 : (double)one.totalTime/one.numSamples) > (two.numSamples == 0 ? -1.0 : (double)two.totalTime/two.numSamples);
+    }
+};
+
+/**
+ * @brief Sample backtrace of a block and how many samples of the live threads had it
+ */
+struct SampledStack_t{
+    unsigned int blockName;             ///< Innermost offline analysis block open when the samples were taken
+    unsigned long long count;           ///< Number of samples with this backtrace
+    unsigned int numFrames;             ///< Number of valid entries in frames
+    void* frames[EZP_SAMPLE_FRAMES];    ///< Interrupted instruction, then return addresses of its callers
+
+    /**
+     * @brief Compares two SampledStacks on their blocks, then on their counts for sorting purposes
+     *
+     * @param one First compared stack
+     * @param two Second compared stack
+     *
+     * @return Whether first comes before the second, i.e has a smaller block name or was sampled more
+     */
+    static bool compare(const struct SampledStack_t& one, const struct SampledStack_t& two)
+    {
+        if(one.blockName == two.blockName)
+            return one.count > two.count;
+        return one.blockName < two.blockName;
+    }
+};
+
+/**
+ * @brief Thread-wise and summed offline analysis results taken at one point in time
+ */
+struct OfflineReport_t{
+    std::vector<struct AggregateProfile_t> threadProfiles;  ///< Thread-wise results, sorted on average time
+    std::vector<struct SummedProfile_t> summedProfiles;     ///< Results summed across threads, sorted on average time
+    unsigned long long samplingPeriod;                      ///< Sampling period in ns of thread CPU time, 0 if not sampling
+    std::vector<struct SampledStack_t> sampledStacks;       ///< Sample backtraces of the live threads, sorted on block then on count
+
+    /**
+     * @brief Creates an empty report
+     */
+    OfflineReport_t()
+    {
+        samplingPeriod = 0;
+    }
+};
+
+/**
+ * @brief Bookkeeping shared by all PoolAllocators
+ */
+class PoolAllocatorBase{
+public:
+
+    static size_t freeBytes;    ///< Bytes in the free lists of all pool allocators, guarded by offlineLock
+};
+
+/**
+ * @brief Allocator that keeps freed single elements in a free list to hand them out again, see EZP_INIT
+ *
+ * Map nodes are allocated one at a time, so a map using it stops calling malloc() once it has been as large as it gets.
+ * The free list is static, i.e shared by all maps of the same node type, and is not thread safe. Its only user is
+ * offlineBlocks, so it is only touched under offlineLock; another map using it must be guarded by offlineLock too.
+ */
+template<class T>
+class PoolAllocator : public PoolAllocatorBase{
+public:
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind{
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator(){}
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&){}
+
+    pointer address(reference value) const { return &value; }
+    const_pointer address(const_reference value) const { return &value; }
+    size_type max_size() const { return ((size_t)-1)/sizeof(T); }
+    void construct(pointer p, const T& value){ new((void*)p) T(value); }
+    void destroy(pointer p){ p->~T(); }
+
+    pointer allocate(size_type n, const void* = NULL)
+    {
+        if(n == 1 && freeList != NULL){
+            FreeNode* node = freeList;
+            freeList = node->next;
+            freeBytes -= sizeof(T);
+            return (pointer)node;
+        }
+        return (pointer)::operator new(n*sizeof(T));
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        if(n == 1 && sizeof(T) >= sizeof(FreeNode)){
+            FreeNode* node = (FreeNode*)(void*)p;
+            node->next = freeList;
+            freeList = node;
+            freeBytes += sizeof(T);
+        }
+        else
+            ::operator delete(p);
+    }
+
+    bool operator==(const PoolAllocator&) const { return true; }
+    bool operator!=(const PoolAllocator&) const { return false; }
+
+private:
+
+    struct FreeNode{
+        FreeNode* next;
+    };
+
+    static FreeNode* freeList;  ///< Freed elements, linked through their first bytes, guarded by offlineLock
+};
+
+template<class T>
+typename PoolAllocator<T>::FreeNode* PoolAllocator<T>::freeList = NULL;
+
+typedef struct BlockKey_t BlockKey;
+typedef bool (*BlockKeyComp)(const BlockKey&, const BlockKey&);
+typedef struct ThreadInfo_t ThreadInfo;
+typedef struct AllocCounters_t AllocCounters;
+typedef struct TraceEvent_t TraceEvent;
+typedef struct TraceSnapshot_t TraceSnapshot;
+typedef struct RecordEvent_t RecordEvent;
+typedef struct RecordBuffer_t RecordBuffer;
+typedef struct RecordHeader_t RecordHeader;
+typedef struct RecordChunk_t RecordChunk;
+typedef struct RecordTrailer_t RecordTrailer;
+typedef struct RecordedBlock_t RecordedBlock;
+typedef struct Recording_t Recording;
+typedef void (*RecordingVisitor)(const RecordedBlock&, bool, void*);
+typedef struct BenchResult_t BenchResult;
+typedef struct BenchState_t BenchState;
+typedef struct SmoothMarker_t SmoothMarker;
+typedef struct SchedSample_t SchedSample;
+typedef struct SchedStats_t SchedStats;
+typedef struct NodeStats_t NodeStats;
+typedef struct AllocStats_t AllocStats;
+typedef struct OpenBlock_t OpenBlock;
+typedef struct OtherBlock_t OtherBlock;
+typedef struct SampleEvent_t SampleEvent;
+typedef struct SampledStack_t SampledStack;
+typedef struct AggregateMarker_t AggregateMarker;
+typedef struct SharedHeader_t SharedHeader;
+typedef struct SharedRecord_t SharedRecord;
+typedef struct DumpHeader_t DumpHeader;
+typedef struct DumpRecord_t DumpRecord;
+typedef struct AggregateProfile_t AggregateProfile;
+typedef struct SummedProfile_t SummedProfile;
+typedef struct OfflineReport_t OfflineReport;
+typedef std::map<BlockKey, Timespec*, BlockKeyComp> Blk2Clk;
+typedef std::pair<BlockKey, Timespec*> BlkClkPair;
+typedef std::map<BlockKey, SmoothMarker*, BlockKeyComp> Blk2SMarker;
+typedef std::pair<BlockKey, SmoothMarker*> Blk2SMarkerPair;
+typedef std::map<BlockKey, AggregateMarker*, BlockKeyComp, PoolAllocator<std::pair<const BlockKey, AggregateMarker*> > > Blk2AMarker;
+typedef std::pair<BlockKey, AggregateMarker*> Blk2AMarkerPair;
+typedef std::map<TID, ThreadInfo*> Tid2Thread;
+typedef std::map<std::string, ThreadInfo*> Name2Thread;
+typedef std::vector<std::pair<std::string, bool> > FilterRules;
+typedef std::vector<std::pair<std::pair<const void*, const void*>, bool> > AddressRules;
+
+/**
+ * @brief Type of EasyPerformanceAnalyzer::enabled, which was a plain bool; reading or assigning it reads or sets whether instrumentation is enabled
+ */
+struct EnabledFlag_t{
+    operator bool() const;
+    struct EnabledFlag_t& operator=(bool on);
+};
+typedef struct EnabledFlag_t EnabledFlag;
+
+/**
+ * @brief Simple instrumented performance analyzer that relies on CPU clocks
+ */
+class EasyPerformanceAnalyzer{
+public:
+
+    /**
+     * @brief List of possible remote/local commands
+     */
+    enum Command{
+        CMD_ENABLE,         ///< Enable instrumentation
+        CMD_DISABLE,        ///< Disable instrumentation
+        CMD_PRINT,          ///< Print information on offline analyses
+        CMD_CLEAR,          ///< Clear offline analysis history
+        CMD_PRINT_SMOOTH,   ///< Print information on smoothed analyses
+        CMD_PRINT_JSON,     ///< Print information on offline analyses as JSON to the stdout of the caller
+        CMD_PRINT_CSV,      ///< Print information on offline analyses as CSV to the stdout of the caller
+        CMD_ENABLE_BLOCKS,  ///< Enable blocks whose names begin with the argument
+        CMD_DISABLE_BLOCKS, ///< Disable blocks whose names begin with the argument
+        CMD_ENABLE_THREADS, ///< Enable threads whose ID is the argument or whose names begin with the argument
+        CMD_DISABLE_THREADS,///< Disable threads whose ID is the argument or whose names begin with the argument
+        CMD_RESET_FILTERS,  ///< Remove all block and thread filters
+        CMD_SET_TRACE_THRESHOLD,///< Set the trace threshold of a block, the argument is BLOCK_NAME:THRESHOLD_MS
+        CMD_PRINT_OPEN,     ///< Print the offline analysis blocks open in each thread to the stdout of the caller
+        CMD_PRINT_MEMORY,   ///< Print the memory that EZP uses, broken down by structure, to the stdout of the caller
+        CMD_RECORD          ///< Start recording to the file given as argument, or stop recording if the argument is empty
+    };
+
+    /**
+     * @brief List of possible offline analysis report formats
+     */
+    enum ReportFormat{
+        FORMAT_TEXT,        ///< Fixed-width tables as printed by printOfflineProfiles()
+        FORMAT_JSON,        ///< JSON object with thread-wise and summed results, times in nanoseconds
+        FORMAT_CSV          ///< CSV table with thread-wise and summed results, times in nanoseconds
+    };
+
+    /**
+     * @brief List of possible groupings of thread-wise offline analysis results
+     */
+    enum ThreadAggregation{
+        AGGREGATE_TID,      ///< One group per thread, exited threads are grouped in the retired bucket of their pool
+        AGGREGATE_NAME,     ///< One group per thread name
+        AGGREGATE_POOL      ///< One group per thread name without its trailing number
+    };
+
+    /**
+     * @brief Sends a command to an analysis session in a different process
+     *
+     * @param cmd Command to send
+     * @param arg Argument of the command, truncated to EZP_MAX_CMD_LENGTH - 2 characters
+     */
+    static void controlRemote(Command cmd, const char* arg = "");
+
+    /**
+     * @brief Controls the analysis session in this process
+     *
+     * @param cmd Command to execute
+     * @param arg Argument of the command
+     */
+    static void control(Command cmd, const char* arg = "");
+
+    /**
+     * @brief Gets whether instrumentation is enabled in this process
+     *
+     * @return Whether instrumentation is enabled
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Enables or disables instrumentation in this process without printing anything, unlike EZP_ENABLE and EZP_DISABLE
+     *
+     * @param on Whether to enable instrumentation
+     */
+    static void setEnabled(bool on);
+
+    /**
+     * @brief Adds a block filter that applies to existing and future blocks; the last filter that matches a block decides
+     *
+     * @param prefix Blocks whose names begin with prefix are matched, "" matches all blocks
+     * @param enable Whether matched blocks are enabled or disabled
+     */
+    static void setBlockFilter(const char* prefix, bool enable);
+
+    /**
+     * @brief Adds a thread filter that applies to existing and future threads; the last filter that matches a thread decides
+     *
+     * @param thread Thread ID, or prefix of the names of matched threads
+     * @param enable Whether matched threads are enabled or disabled
+     */
+    static void setThreadFilter(const char* thread, bool enable);
+
+    /**
+     * @brief Adds a function filter that applies to existing and future functions; the last filter that matches a function decides
+     *
+     * @param begin Lowest address of matched functions
+     * @param end Address after the highest address of matched functions
+     * @param enable Whether matched functions are enabled or disabled
+     */
+    static void setFunctionFilter(const void* begin, const void* end, bool enable);
+
+    /**
+     * @brief Removes all block, thread and function filters
+     */
+    static void resetFilters();
+
+    /**
+     * @brief Sets the duration over which a block makes the thread that ran it write its most recently ended blocks to a trace
+     *
+     * @param blockName Name of the block
+     * @param thresholdMs Threshold in ms, 0 to stop tracing the block
+     */
+    static void setTraceThreshold(const char* blockName, float thresholdMs);
+
+    /**
+     * @brief Sets where traces are written
+     *
+     * @param path The N-th trace is written to path.N.json
+     */
+    static void setTracePath(const char* path);
+
+    /**
+     * @brief Bounds the number of analysis records and retired buckets and sets the size of the trace rings allocated from now on
+     *
+     * @param maxRecords Number of offline, real-time or smoothed analysis records past which blocks without a record of their own share
+     * the EZP_OTHER_NAME record of their thread, 0 for no limit
+     * @param maxPools Number of retired buckets past which exited threads of further pools go to the EZP_OTHER_NAME bucket, 0 for no limit
+     * @param traceRingSize Number of most recently ended blocks that threads keep for traces, at least 1
+     */
+    static void setMemoryLimits(unsigned int maxRecords, unsigned int maxPools, unsigned int traceRingSize);
+
+    /**
+     * @brief Turns on or off scheduler statistics of offline analysis blocks, i.e their wall clock times and context switches
+     *
+     * @param on Whether to take scheduler samples at both ends of offline analysis blocks
+     */
+    static void setSchedStats(bool on);
+
+    /**
+     * @brief Turns on or off wall clock start times of offline analysis blocks, for listings of open blocks
+     *
+     * @param on Whether to read the wall clock when offline analysis blocks start
+     */
+    static void setOpenTimes(bool on);
+
+    /**
+     * @brief Turns on or off the breakdown of offline analysis blocks per NUMA node
+     *
+     * @param on Whether to record the NUMA node of the CPU that offline analysis blocks end on
+     */
+    static void setNodeStats(bool on);
+
+    /**
+     * @brief Turns on or off counting the memory allocated during offline analysis blocks
+     *
+     * @param on Whether to count allocations, only possible if libezp_malloc.so is loaded with LD_PRELOAD
+     *
+     * @return Whether allocation counting is in the requested state
+     */
+    static bool setAllocStats(bool on);
+
+    /**
+     * @brief Turns on or off the offline analysis of the functions that call the function hooks
+     *
+     * @param on Whether startProfilingFunction() and endProfilingFunction() analyze functions
+     */
+    static void setFunctionHooks(bool on);
+
+    /**
+     * @brief Starts, changes or stops sampling the offline analysis blocks open in each thread
+     *
+     * @param periodMs Period in ms of the CPU time of each thread, 0 to stop sampling
+     * @param backtraces Whether to also keep frame pointer backtraces of samples
+     */
+    static void setSampling(float periodMs, bool backtraces);
+
+    /**
+     * @brief Starts a named analysis
+     *
+     * @param blockName Name of the analyzed block, max 4 characters
+     */
+    static void startProfiling(const char* blockName = "NDEF");
+
+    /**
+     * @brief Ends the named analysis, printing the running time of the block; it must have been started before
+     *
+     * @param blockName Name of the analyzed block, max 4 characters
+     */
+    static void endProfiling(const char* blockName = "NDEF");
+
+    /**
+     * @brief Starts a named analysis that is smoothed over time
+     *
+     * @param blockName Name of the analyzed block, max 4 characters
+     */
+    static void startProfilingSmooth(const char* blockName = "NDEF");
+
+    /**
+     * @brief  Ends a named smoothed analysis, updating the smoothed time and variance of the block and printing them
+     * if smoothPrintInterval allows it; it must have been started before
+     *
+     * @param blockName Name of the analyzed block, max 4 characters
+     * @param smoothingFactor Coefficient of the history, between 0 and 1
+     */
+    static void endProfilingSmooth(const char* blockName = "NDEF", float smoothingFactor = 0.95f);
+
+    /**
+     * @brief Starts a named offline analysis that keeps the total running time and number of calls
+     *
+     * @param blockName Name of the analyzed block, max 4 characters
+     */
+    static void startProfilingOffline(const char* blockName = "NDEF");
+
+    /**
+     * @brief Ends a named offline analysis, it must have been smoothed before
+     *
+     * @param blockName Name of the analyzed profile, max 4 characters
+     */
+    static void endProfilingOffline(const char* blockName = "NDEF");
+
+    /**
+     * @brief Starts the offline analysis of a function, called by __cyg_profile_func_enter() in libezp_hooks
+     *
+     * Only the outermost call of a recursive function is analyzed
+     *
+     * @param function Address of the function
+     */
+    static void startProfilingFunction(void* function);
+
+    /**
+     * @brief Ends the offline analysis of the function that was started last in the calling thread, called by __cyg_profile_func_exit() in libezp_hooks
+     *
+     * @param function Address of the function
+     */
+    static void endProfilingFunction(void* function);
+
+    /**
+     * @brief Names the calling thread in offline analysis reports
+     *
+     * @param name Name of the thread, truncated to EZP_THREAD_NAME_LENGTH - 1 characters
+     */
+    static void setThreadName(const char* name);
+
+    /**
+     * @brief Tags the offline analysis blocks that the calling thread ends from now on with a request ID
+     *
+     * @param id Request ID, 0 for none
+     */
+    static void setRequestId(unsigned long long id);
+
+    /**
+     * @brief Prints all data of all offline analyses up to now
+     */
+    static void printOfflineProfiles();
+
+    /**
+     * @brief Formats all data of all offline analyses up to now
+     *
+     * @param format Format of the report
+     * @param output String to append the report to
+     */
+    static void formatOfflineProfiles(ReportFormat format, std::string& output);
+
+    /**
+     * @brief Writes all data of all offline analyses up to now to a file
+     *
+     * @param file File to write to
+     * @param format Format of the report
+     */
+    static void writeOfflineProfiles(FILE* file, ReportFormat format);
+
+    /**
+     * @brief Writes all data of all offline analyses up to now to a file descriptor
+     *
+     * @param fd File descriptor to write to
+     * @param format Format of the report
+     */
+    static void writeOfflineProfiles(int fd, ReportFormat format);
+
+    /**
+     * @brief Publishes offline analysis records in the shared memory segment /ezp.PID if not already published
+     *
+     * @return Whether the records are published
+     */
+    static bool publishSharedStats();
+
+    /**
+     * @brief Reads the offline analysis records published by another process without communicating with it
+     *
+     * @param pid Process ID of the publishing process
+     * @param report Report to fill
+     *
+     * @return Whether the shared memory segment could be read
+     */
+    static bool readSharedStats(pid_t pid, OfflineReport& report);
+
+    /**
+     * @brief Starts recording every offline analysis block that ends to a file if not already recording
+     *
+     * @param path File to write the recording to
+     *
+     * @return Whether recording
+     */
+    static bool startRecording(const char* path);
+
+    /**
+     * @brief Stops recording and waits until the recording is completely written, registered with atexit() by startRecording()
+     */
+    static void stopRecording();
+
+    /**
+     * @brief Reads the blocks of a recording in a time range, decoding its chunks in parallel
+     *
+     * @param path Recording file
+     * @param from Beginning of the time range in ns since the beginning of the recording, blocks that end before it are skipped
+     * @param to End of the time range in ns since the beginning of the recording, blocks that begin after it are skipped
+     * @param numThreads Number of threads that decode chunks, at least 1 and at most the number of chunks
+     * @param recording Recording to fill
+     *
+     * @return Whether the recording could be read
+     */
+    static bool readRecording(const char* path, unsigned long long from, unsigned long long to, int numThreads, Recording& recording);
+
+    /**
+     * @brief Visits the beginning and the end of every block of a recording in time order, holding about one chunk per thread in memory
+     *
+     * Chunks are read in the order that their threads fall behind, and a block is visited once no block left unread can
+     * come before it. Blocks that were still open when a chunk was cut are visited as soon as they begin with an end and a
+     * CPU time of 0; blocks still open when the recording stopped end with it. Ends come before beginnings at equal times.
+     *
+     * @param path Recording file
+     * @param visitor Called with each block, whether it is its beginning, and arg
+     * @param arg Passed to the visitor
+     * @param recording Recording to fill, all but its blocks before the first visit
+     *
+     * @return Whether the recording could be read
+     */
+    static bool streamRecording(const char* path, RecordingVisitor visitor, void* arg, Recording& recording);
+
+    /**
+     * @brief Sums what changed since the last pull in the shared memory segments of all other processes on this host into the offline analysis records of this process
+     *
+     * Segments stay mapped between pulls and only records whose sequence changed are read. The records of each process
+     * are summed in a retired bucket named "COMM.PID", so grouping by pool sums processes of the same executable.
+     * Segments of exited processes are pulled one last time and unmapped.
+     *
+     * @return Number of segments pulled, -1 if shared memory statistics are not supported
+     */
+    static int pullSharedStats();
+
+    /**
+     * @brief Writes a report in the given format to a file
+     *
+     * @param report Report to write
+     * @param file File to write to
+     * @param format Format of the report
+     */
+    static void writeOfflineReport(const OfflineReport& report, FILE* file, ReportFormat format);
+
+    /**
+     * @brief Writes all offline analysis records to a binary dump file; this function is async-signal-safe
+     *
+     * @param path Path of the dump file, truncated if it exists
+     *
+     * @return Whether the dump was written completely
+     */
+    static bool dumpOfflineProfiles(const char* path);
+
+    /**
+     * @brief Registers a handler that dumps all offline analysis records to a file when the process exits normally
+     *
+     * @param path Path of the dump file
+     */
+    static void dumpOnExit(const char* path);
+
+    /**
+     * @brief Installs a handler that dumps all offline analysis records to a file whenever a signal is received
+     *
+     * @param signum Signal to handle, e.g SIGUSR2
+     * @param path Path of the dump file
+     */
+    static void dumpOnSignal(int signum, const char* path);
+
+    /**
+     * @brief Prints the current smoothed times and variances of all smoothed analyses
+     */
+    static void printSmoothProfiles();
+
+    /**
+     * @brief Clears the offline analysis record
+     */
+    static void clearOfflineProfiles();
+
+    /**
+     * @brief Launches the command listener thread if not already running
+     */
+    static void launchCmdListener();
+
+    /**
+     * @brief Launches the command listener, registers the calling thread and preallocates offline analysis records
+     *
+     * The records and the nodes of offlineBlocks that hold them are kept aside and used by offline analysis blocks starting
+     * for the first time in a thread, also after the records are cleared or the process forks; real-time and smoothed blocks still allocate theirs
+     *
+     * @param expectedThreads Number of threads expected to run offline analysis blocks at once
+     * @param expectedBlocks Number of distinct offline analysis blocks expected to run in each thread
+     */
+    static void init(unsigned int expectedThreads, unsigned int expectedBlocks);
+
+    /**
+     * @brief Registers the calling thread if not already registered and arms its sampling timer if sampling
+     */
+    static void initThread();
+
+    /**
+     * @brief Makes processes forked from this one send their offline analysis records to this process when they exit,
+     * launching the command listener to receive them
+     */
+    static void enableChildMerging();
+
+    /**
+     * @brief Sends the offline analysis records of this forked process to the command listener of its parent process, where
+     * they are summed in the retired bucket "children", and clears them
+     *
+     * @return Whether the records were received by the parent
+     */
+    static bool mergeIntoParent();
+
+    /**
+     * @brief Launches the OpenMetrics exporter thread if not already running
+     *
+     * @param address "tcp:PORT" for a loopback TCP socket, "unix:NAME" for an abstract UNIX socket or "unix:/PATH" for a filesystem UNIX socket
+     */
+    static void launchMetricsExporter(const char* address = "unix:ezp_metrics");
+
+    static const char* androidTag;      ///< Logcat tag on Android
+    static EnabledFlag enabled;         ///< Whether analysis is enabled, kept for existing code, see isEnabled() and setEnabled()
+    static bool forceStderr;            ///< Whether to force error messages to stderr instead of Logcat on Android
+    static float smoothPrintInterval;   ///< Minimum wall clock ms between two prints of a smoothed block, 0 for always, negative for never
+    static bool exportPerThread;        ///< Whether the OpenMetrics exporter serves thread-wise results as well
+    static ThreadAggregation threadAggregation; ///< How thread-wise offline analysis results are grouped in reports
+    static pid_t remotePid;             ///< Process whose session controlRemote() reaches, 0 for the first instrumented process
+    static const char* cmdSocketName;  ///< Name of the abstract UNIX socket of the command listener, followed by .PID in forked processes
+    static float benchPrecision;        ///< Half width of the confidence interval that EZP_BENCH aims for, relative to the mean
+    static float benchBudget;           ///< Wall clock time budget of EZP_BENCH in ms
+
+private:
+
+    //Policies of the analyzer core reach the records through the private API
+    template<class Clock, class Storage, class Sink> friend class BasicAnalyzer;
+    template<class Clock, unsigned int N> friend class FlatStorage;
+    friend class OnlineStorage;
+    friend class OfflineStorage;
+    friend class PrintSink;
+    template<class Clock> friend class Benchmark;
+
+    /**
+     * @brief Begins an EZP_BENCH benchmark with one call per batch
+     *
+     * @param bench Benchmark to begin
+     * @param blockName Name of the benchmark, max 4 characters
+     * @param overhead Clock overhead of timing a batch in ns
+     */
+    static void beginBenchmark(BenchState& bench, const char* blockName, double overhead);
+
+    /**
+     * @brief Takes the time of the batch that just ran, called outside of the timed loop
+     *
+     * @param bench Running benchmark
+     * @param ns Time that the batch took in ns, clock overhead included
+     *
+     * @return Whether to time another batch, of bench.result.batch calls
+     */
+    static bool addBenchmarkSample(BenchState& bench, double ns);
+
+    /**
+     * @brief Ends an EZP_BENCH benchmark: computes its statistics, counts its batches as runs in the offline analysis records of the calling thread and prints it
+     *
+     * @param bench Benchmark to end
+     */
+    static void endBenchmark(BenchState& bench);
+
+    /**
+     * @brief Flags of the state word, read on every instrumentation call
+     *
+     * The flags only decide whether a call records anything, no data is published through them. Hot path reads are
+     * therefore relaxed: a call that sees a stale flag records or skips one more sample, and the next call sees the new
+     * flag since relaxed loads are never merged or hoisted out of loops. Writers use release so that whatever they did
+     * before setting a flag, e.g launching the listener or filling the filter bitmap, is visible to acquire readers.
+     * Data that is actually published across threads is guarded by the locks or by its own acquire/release pairs.
+     */
+    enum StateFlag{
+        STATE_ENABLED = 1,              ///< Instrumentation is enabled
+        STATE_LISTENER_RUNNING = 2,     ///< The command listener thread is launched
+        STATE_FILTERING = 4,            ///< At least one block or thread filter is set
+        STATE_TRACING = 8,              ///< At least one trace threshold is set
+        STATE_SCHED_STATS = 16,         ///< Offline analysis blocks take scheduler samples
+        STATE_NODE_STATS = 32,          ///< Offline analysis blocks record their NUMA node
+        STATE_ALLOC_STATS = 64,         ///< Offline analysis blocks count allocations
+        STATE_FUNCTION_HOOKS = 128,     ///< Function hooks analyze functions
+        STATE_SAMPLING = 256,           ///< Threads sample their open offline analysis blocks
+        STATE_RECORDING = 512,          ///< Offline analysis blocks are recorded
+        STATE_OPEN_TIMES = 1024         ///< Offline analysis blocks read the wall clock when they start, for open block listings
+    };
+
+    /**
+     * @brief Sets or clears flags of the state word
+     *
+     * @param flags Flags to change
+     * @param set Whether to set or clear them
+     */
+    static void setState(unsigned int flags, bool set);
+
+    /**
+     * @brief Gets the ID of the calling thread without a system call, except for the first call in each thread
+     *
+     * @return ID of the calling thread
+     */
+    static TID getTid();
+
+    /**
+     * @brief Gets the ID of the calling thread from the kernel and caches it
+     */
+    static void cacheTid();
+
+    /**
+     * @brief Registers the fork handlers with pthread_atfork(), called once
+     */
+    static void registerForkHandlers();
+
+    /**
+     * @brief Takes all locks before fork() so that the child does not inherit a lock held by a thread that it does not have
+     */
+    static void prepareFork();
+
+    /**
+     * @brief Releases all locks in the parent after fork()
+     */
+    static void resumeParentAfterFork();
+
+    /**
+     * @brief Releases all locks in the child after fork() and resets its per-process state: its thread ID, records inherited
+     * from the parent, listener, exporter, shared memory segment and dump paths
+     *
+     * Publishing the segment of the child and registering its merge at exit are not async-signal-safe, they are left to the
+     * next launchCmdListener(), i.e the next EZP_START* of the child.
+     */
+    static void resetChildAfterFork();
+
+    /**
+     * @brief Gets the address of the command socket of a process
+     *
+     * @param pid Process ID in the socket name, 0 for the first instrumented process
+     * @param addr Address to fill
+     * @param addrLen Filled with the length of the address
+     */
+    static void getCmdSocketAddress(pid_t pid, struct sockaddr_un& addr, socklen_t& addrLen);
+
+    /**
+     * @brief Sends all offline analysis records to the command listener of the parent process
+     *
+     * @return Whether the records were received by the parent
+     */
+    static bool sendToParent();
+
+    /**
+     * @brief Sends all offline analysis records to the parent process, registered with atexit() in children if merging is enabled
+     */
+    static void mergeAtExit();
+
+    /**
+     * @brief Receives the offline analysis records of a child process and sums them in the retired bucket "children"
+     *
+     * Records are only accepted from a child of this process, checked with the credentials of the connected peer; any local
+     * process can connect to the abstract command socket.
+     *
+     * @param fd Connection to the child, positioned after the command
+     */
+    static void receiveMerge(int fd);
+
+    /**
+     * @brief Gets the time difference between two times
+     *
+     * @param begin Beginning time
+     * @param end Ending time
+     *
+     * @return Difference in milliseconds
+     */
+    static float getTimeDiff(const Timespec* begin, const Timespec* end);
+
+    /**
+     * @brief Gets the time difference between two times
+     *
+     * @param begin Beginning time
+     * @param end Ending time
+     *
+     * @return Difference in nanoseconds, 0 if end is before begin
+     */
+    static unsigned long long getTimeDiffNs(const Timespec* begin, const Timespec* end);
+
+    /**
+     * @brief Gets the duration histogram bucket of a duration
+     *
+     * @param ns Duration in nanoseconds
+     *
+     * @return Index of the bucket, between 0 and EZP_HISTOGRAM_BUCKETS - 1
+     */
+    static int getHistogramBucket(unsigned long long ns);
+
+    /**
+     * @brief Hashes a string of maximum length 4 into an int uniquely
+     *
+     * @param str String of maximum length 4
+     *
+     * @return Unique hash of given string
+     */
+    static unsigned int hashStr(const char* str);
+
+    /**
+     * @brief Unhashes a string of length 4 from its unique hash
+     *
+     * @param hash Unique hash of length 4 string
+     * @param output Preallocated buffer to write string to, must be at least 5 characters long
+     */
+    static void unhashStr(unsigned int hash, char* output);
+
+    /**
+     * @brief Writes the name of a block as shown in reports, i.e its unhashed name or the symbol of its function
+     *
+     * @param blockName Hash of the name of the block, or block name of a function
+     * @param output Preallocated buffer of at least EZP_BLOCK_LABEL_LENGTH characters to write the name to
+     */
+    static void getBlockLabel(unsigned int blockName, char* output);
+
+    /**
+     * @brief Registers the calling thread with its pthread name so that its records are retired when it exits
+     */
+    static void registerThread();
+
+    /**
+     * @brief Reads the pthread names of live threads again, except those named with EZP_SET_THREAD_NAME
+     *
+     * Threads often name themselves after their first block, the name read at registration would otherwise stay.
+     */
+    static void refreshThreadNames();
+
+    /**
+     * @brief Creates threadKey, called once
+     */
+    static void createThreadKey();
+
+    /**
+     * @brief Folds the offline analysis records of an exiting thread into the retired bucket of its pool and frees its other records
+     *
+     * @param arg ThreadInfo of the exiting thread, destructor of threadKey
+     */
+    static void retireThread(void* arg);
+
+    /**
+     * @brief Gets the dense ID of a block without locking
+     *
+     * @param blockName Hash of the name of the block
+     *
+     * @return ID of the block, -1 if it has none yet
+     */
+    static int getBlockId(unsigned int blockName);
+
+    /**
+     * @brief Tells whether block and thread filters disable a block starting or ending in the calling thread, without locking
+     *
+     * Offline analysis blocks are checked at both ends: a filtered start takes no lock and is not timed, and a run is only
+     * recorded if neither end was filtered. Real-time and smoothed blocks are only checked when they end.
+     *
+     * @param blockName Hash of the name of the block
+     *
+     * @return Whether the block must not be recorded
+     */
+    static bool isFilteredOut(unsigned int blockName);
+
+    /**
+     * @brief Gives a block an ID and its bit in the filter bitmap if it has none yet, called when the block first starts
+     *
+     * @param blockName Hash of the name of the block
+     */
+    static void registerBlock(unsigned int blockName);
+
+    /**
+     * @brief Tells whether a block name is that of a function analyzed through function hooks
+     *
+     * @param blockName Block name
+     *
+     * @return Whether the block is a function
+     */
+    static bool isFunctionBlock(unsigned int blockName);
+
+    /**
+     * @brief Gets the block name of a function without locking, registering the function if it is new
+     *
+     * @param function Address of the function
+     *
+     * @return Block name of the function, 0 if function filters disable it or if there are too many functions
+     */
+    static unsigned int getFunctionBlockName(void* function);
+
+    /**
+     * @brief Gives a function an index and decides whether function filters enable it
+     *
+     * @param function Address of the function
+     *
+     * @return Block name of the function, 0 if function filters disable it or if there are too many functions
+     */
+    static unsigned int registerFunction(void* function);
+
+    /**
+     * @brief Tells whether function filters enable a function, must be called with filterLock held
+     *
+     * @param function Address of the function
+     *
+     * @return Whether the function is enabled
+     */
+    static bool matchFunctionFilters(const void* function);
+
+    /**
+     * @brief Turns function hooks off before static objects are destroyed, registered with atexit()
+     */
+    static void stopFunctionHooks();
+
+    /**
+     * @brief Puts the record of a started offline analysis block on the open block stack of the calling thread
+     *
+     * @param info Calling thread
+     * @param marker Record of the block
+     * @param blockName Hash of the name of the block
+     * @param wallBegin When the block began on EZP_WALL_CLOCK, 0 if no feature asked for it
+     */
+    static void pushOpenBlock(ThreadInfo* info, AggregateMarker* marker, unsigned int blockName, const Timespec* wallBegin);
+
+    /**
+     * @brief Lists the offline analysis blocks open in each live thread with their wall clock time so far
+     *
+     * @param output String to append the fixed-width table to
+     */
+    static void formatOpenBlocks(std::string& output);
+
+    /**
+     * @brief Lists the memory that EZP uses in this process by structure, along with the memory limits
+     *
+     * @param output String to append the fixed-width table to
+     */
+    static void formatMemoryUsage(std::string& output);
+
+    /**
+     * @brief Removes the innermost record of an offline analysis block from the open block stack of the calling thread
+     *
+     * @param info Calling thread
+     * @param blockName Hash of the name of the block, or block name of a function
+     * @param wallBegin Where to write when the block began on EZP_WALL_CLOCK, untouched if the block is not on the stack
+     *
+     * @return Whether the block was on the stack
+     */
+    static bool popOpenBlock(ThreadInfo* info, unsigned int blockName, Timespec* wallBegin);
+
+    /**
+     * @brief Puts a block started in the EZP_OTHER_NAME record of the calling thread on its stack of such blocks
+     *
+     * @param info Calling thread
+     * @param blockName Hash of the name of the block
+     * @param analysis Kind of the record
+     * @param recordBegin Begin time of the record, used if the stack is full
+     *
+     * @return Where the caller writes when the block began
+     */
+    static Timespec* pushOtherBlock(ThreadInfo* info, unsigned int blockName, BlockAnalysis analysis, Timespec* recordBegin);
+
+    /**
+     * @brief Removes the innermost entry of a block from the stack of blocks open in the EZP_OTHER_NAME records of the calling thread
+     *
+     * @param info Calling thread
+     * @param blockName Hash of the name of the block
+     * @param analysis Kind of the record
+     * @param beginTime Where to write when the block began, untouched if the block is not on the stack
+     *
+     * @return Whether the block was on the stack
+     */
+    static bool popOtherBlock(ThreadInfo* info, unsigned int blockName, BlockAnalysis analysis, Timespec* beginTime);
+
+    /**
+     * @brief Puts a block that ended in the calling thread in its record buffer, queueing the buffer for the encoder thread once full
+     *
+     * @param info Calling thread
+     * @param blockName Hash of the name of the block, or block name of a function
+     * @param wallBegin When the block began on EZP_WALL_CLOCK
+     * @param cpuTime How long the block lasted in ns on EZP_CLOCK
+     */
+    static void recordBlock(ThreadInfo* info, unsigned int blockName, const Timespec* wallBegin, unsigned long long cpuTime);
+
+    /**
+     * @brief Takes an empty record buffer for a thread
+     *
+     * @return Empty buffer, NULL if not recording or if the recording is stopping
+     */
+    static RecordBuffer* takeRecordBuffer();
+
+    /**
+     * @brief Queues a record buffer for the encoder thread
+     *
+     * @param info Thread that filled the buffer
+     * @param buffer Buffer to queue
+     */
+    static void queueRecordBuffer(ThreadInfo* info, RecordBuffer* buffer);
+
+    /**
+     * @brief Compresses queued record buffers into chunks until the recording stops, then writes the block names and the chunk index and closes the file
+     *
+     * @param arg Unused
+     *
+     * @return NULL
+     */
+    static void* encodeRecording(void* arg);
+
+    /**
+     * @brief Installs sampleThread() as the SIGPROF handler, called once
+     */
+    static void installSamplingHandler();
+
+    /**
+     * @brief Creates or rearms the sampling timer of the calling thread with the current sampling period
+     *
+     * @param info Calling thread
+     */
+    static void armSampling(ThreadInfo* info);
+
+    /**
+     * @brief SIGPROF handler, counts a sample for the open blocks of the calling thread and keeps its backtrace
+     *
+     * @param signal SIGPROF
+     * @param signalInfo Unused
+     * @param context Interrupted user context
+     */
+    static void sampleThread(int signal, siginfo_t* signalInfo, void* context);
 
-#ifdef ANDROID
-#include<android/log.h>
-#else
-#include<bits/local_lim.h>
-#include<cstdio>
-#endif
+    /**
+     * @brief Counts the sample backtraces kept by the live threads
+     *
+     * @param stacks Where to put the distinct backtraces, sorted on block then on count
+     */
+    static void collectSampledStacks(std::vector<SampledStack>& stacks);
 
-namespace ezp{
+    /**
+     * @brief Writes a code address as shown in reports, i.e relative to its symbol or to its module
+     *
+     * @param address Code address
+     * @param output Preallocated buffer of at least EZP_BLOCK_LABEL_LENGTH characters to write to
+     */
+    static void getAddressLabel(const void* address, char* output);
 
-typedef pid_t TID;
-typedef struct timespec Timespec;
+    /**
+     * @brief Starts an offline analysis, creating its record if needed; the caller reads the clock into the begin time
+     *
+     * @param blockName Hash of the name of the block, or block name of a function
+     *
+     * @return Begin time of the record of the block
+     */
+    static Timespec* openOfflineBlock(unsigned int blockName);
 
-/**
- * @brief Key to reaching analysis records
- */
-struct BlockKey_t{
-    TID tid;                ///< Thread ID of the block's caller
-    unsigned int blockName; ///< Hash of name of the block
+    /**
+     * @brief Ends an offline analysis
+     *
+     * @param blockName Hash of the name of the block, or block name of a function
+     * @param end Time at which the block ended
+     * @param begin If not NULL, set to the begin time of the run if it was recorded, to NULL otherwise
+     *
+     * @return Whether the record of the block was found, i.e whether the block was started before
+     */
+    static bool endOfflineBlock(unsigned int blockName, const Timespec* end, const Timespec** begin = NULL);
 
     /**
-     * @brief Creates a new analysis record key
+     * @brief Starts a real-time analysis, creating its record if needed; the caller reads the clock into the begin time
      *
-     * @param tid_ Thread ID of the block's caller
-     * @param blockName_ Hash of the name of the block
+     * @param blockName Hash of the name of the block
+     *
+     * @return Begin time of the record of the block
      */
-    BlockKey_t(TID tid_, unsigned int blockName_)
-    {
-        tid = tid_;
-        blockName = blockName_;
-    }
+    static Timespec* openOnlineBlock(unsigned int blockName);
 
     /**
-     * @brief Compares two BlockKeys for sorting purposes, thread ID has priority
+     * @brief Ends a real-time analysis
      *
-     * @param one First compared key
-     * @param two Second compared key
+     * @param blockName Hash of the name of the block
+     * @param end Time at which the block ended
+     * @param begin Set to the begin time of the run if it is to be printed, to NULL otherwise
      *
-     * @return Whether first key is ahead of second key
+     * @return Whether the record of the block was found, i.e whether the block was started before
      */
-    static bool compare(const struct BlockKey_t& one, const struct BlockKey_t& two)
-    {
-        if(one.tid == two.tid)
-            return one.blockName > two.blockName;
-        else
-            return one.tid > two.tid;
-    }
-};
+    static bool closeOnlineBlock(unsigned int blockName, const Timespec* end, const Timespec** begin);
 
-/**
- * @brief Holds a smooth analysis record
- */
-struct SmoothMarker_t{
-    Timespec beginTime; ///< When the most recent block was started
-    float lastSlice;    ///< Most recent smoothed time that this analysis took, i.e history
+    /**
+     * @brief Prints the time of a run of a block in the calling thread
+     *
+     * @param blockName Hash of the name of the block
+     * @param time Time of the run in milliseconds
+     */
+    static void printBlockTime(unsigned int blockName, float time);
 
     /**
-     * @brief Creates a new smooth analysis record with zero history
+     * @brief Reports that a block was ended without being started
+     *
+     * @param blockName Name of the block
+     * @param start Name of the call that starts the block
      */
-    SmoothMarker_t()
-    {
-        lastSlice = 0.0f;
-    }
-};
+    static void reportMissingBlock(const char* blockName, const char* start);
 
-/**
- * @brief Holds the total amount of time a block took in the past
- */
-struct AggregateMarker_t{
-    Timespec beginTime; ///< When the most recent block was started
-    float totalTime;    ///< Total time that this block took in the past
-    int numSamples;     ///< How many times this block was ran in the past
+    /**
+     * @brief Reports that a block name is truncated
+     *
+     * @param blockName Name of the block
+     */
+    static void warnLongBlockName(const char* blockName);
 
     /**
-     * @brief Creates a new aggregate analysis with zero history
+     * @brief Reports that a block is named EZP_OTHER_NAME and is not analyzed, once per process
      */
-    AggregateMarker_t()
-    {
-        totalTime = 0.0f;
-        numSamples = 0;
-    }
-};
+    static void warnReservedBlockName();
 
-/**
- * @brief Brings AggregateMarker and BlockKey together in a sortable object
- */
-struct AggregateProfile_t{
-    TID tid;                ///< Thread ID
-    unsigned int blockName; ///< Hash of the name of the block
-    float averageTime;      ///< Average time the block took in the past
-    int numSamples;         ///< How many times this block was ran in the past
+    /**
+     * @brief Registers the calling thread for its name to appear in reports of storages other than the offline records
+     *
+     * @return ID of the calling thread
+     */
+    static TID registerExternalThread();
 
     /**
-     * @brief Compares two AggregateProfiles on their average times for sorting purposes
+     * @brief Names, groups and sums the thread-wise results of a storage other than the offline records, then writes them
      *
-     * @param one First compared profile
-     * @param two Second compared profile
+     * @param report Report whose thread-wise results have their thread IDs, block names, times and numbers of runs
+     * @param file File to write to
+     * @param format Format of the report
+     */
+    static void writeExternalReport(OfflineReport& report, FILE* file, ReportFormat format);
+
+    /**
+     * @brief Tells whether block filters enable a block, must be called with filterLock held
      *
-     * @return Whether first took more average time than the second
+     * @param blockName Hash of the name of the block
+     *
+     * @return Whether the last matching filter enables the block, true if there is none
      */
-    static bool compareAvgTime(const struct AggregateProfile_t& one, const struct AggregateProfile_t& two)
-    {
-        return one.averageTime > two.averageTime;
-    }
+    static bool matchBlockFilters(unsigned int blockName);
 
     /**
-     * @brief Compares two AggregateProfiles on their block names for sorting purposes
+     * @brief Tells whether thread filters enable a thread, must be called with threadLock held
      *
-     * @param one First compared profile
-     * @param two Second compared profile
+     * @param info Thread to match
      *
-     * @return Whether first block name comes before the second
+     * @return Whether the last matching filter enables the thread, true if there is none
      */
-    static bool compareBlockName(const struct AggregateProfile_t& one, const struct AggregateProfile_t& two)
-    {
-        return one.blockName < two.blockName;
-    }
-};
+    static bool matchThreadFilters(const ThreadInfo* info);
 
-/**
- * @brief Sum of profiles coming from different threads
- */
-struct SummedProfile_t{
-    unsigned int blockName; ///< Hash of the name of the profile
-    float totalTime;        ///< Total time this profile took
-    int numSamples;         ///< Total number of times this profile was done
+    /**
+     * @brief Sets a trace threshold given as BLOCK_NAME:THRESHOLD_MS
+     *
+     * @param threshold Block name and threshold in ms separated by a colon
+     *
+     * @return Whether threshold was well formed
+     */
+    static bool parseTraceThreshold(const char* threshold);
 
     /**
-     * @brief Initializes a new summed profile
+     * @brief Puts a block that ended in the calling thread in its trace ring, queues the ring for a trace if the block is over its threshold
      *
-     * @param blockName_ Hash of the name of the block
-     * @param totalTime_ Initial total time coming from a thread
-     * @param numSamples_ Initial number of times this profile was done, coming from a thread
+     * @param blockName Hash of the name of the block
+     * @param begin When the block began
+     * @param end When the block ended
      */
-    SummedProfile_t(unsigned int blockName_, float totalTime_, int numSamples_)
-    {
-        blockName = blockName_;
-        totalTime = totalTime_;
-        numSamples = numSamples_;
-    }
+    static void traceBlock(unsigned int blockName, const Timespec* begin, const Timespec* end);
 
     /**
-     * @brief Compares two SummedProfiles on their average times for sorting purposes
+     * @brief Takes a scheduler sample of the calling thread, right after reading the CPU clock at the end of a block or right before at its beginning
      *
-     * @param one First compared profile
-     * @param two Second compared profile
+     * @param sample Sample to fill
+     * @param begin Whether the block is beginning, so that the system call is not counted as off-CPU time
+     */
+    static void takeSchedSample(SchedSample* sample, bool begin);
+
+    /**
+     * @brief Gets the NUMA node of the CPU that the calling thread runs on
      *
-     * @return Whether first took more average time than the second
+     * @return Index of the node, at most EZP_MAX_NUMA_NODES - 1
      */
-    static bool compare(const struct SummedProfile_t& one, const struct SummedProfile_t& two)
-    {
-        return (one.numSamples == 0 ? -1 : one.totalTime/one.numSamples) > (two.numSamples == 0 ? -1 : two.totalTime/two.numSamples);
-    }
-};
+    static int getNode();
 
-typedef struct BlockKey_t BlockKey;
-typedef bool (*BlockKeyComp)(const BlockKey&, const BlockKey&);
-typedef struct SmoothMarker_t SmoothMarker;
-typedef struct AggregateMarker_t AggregateMarker;
-typedef struct AggregateProfile_t AggregateProfile;
-typedef struct SummedProfile_t SummedProfile;
-typedef std::map<BlockKey, Timespec*, BlockKeyComp> Blk2Clk;
-typedef std::pair<BlockKey, Timespec*> BlkClkPair;
-typedef std::map<BlockKey, SmoothMarker*, BlockKeyComp> Blk2SMarker;
-typedef std::pair<BlockKey, SmoothMarker*> Blk2SMarkerPair;
-typedef std::map<BlockKey, AggregateMarker*, BlockKeyComp> Blk2AMarker;
-typedef std::pair<BlockKey, AggregateMarker*> Blk2AMarkerPair;
+    /**
+     * @brief Reads the NUMA node of each CPU from sysfs into cpuNodes
+     */
+    static void loadCpuNodes();
 
-/**
- * @brief Simple instrumented performance analyzer that relies on CPU clocks
- */
-class EasyPerformanceAnalyzer{
-public:
+    /**
+     * @brief Gets the allocation counters of the calling thread in libezp_malloc.so
+     *
+     * @return Allocation counters of the calling thread, NULL if the thread is not registered
+     */
+    static AllocCounters* getAllocCounters();
 
     /**
-     * @brief List of possible remote/local commands
+     * @brief Looks up the accessor of allocation counters in libezp_malloc.so
      */
-    enum Command{
-        CMD_ENABLE,     ///< Enable instrumentation
-        CMD_DISABLE,    ///< Disable instrumentation
-        CMD_PRINT,      ///< Print information on offline analyses
-        CMD_CLEAR       ///< Clear offline analysis history
-    };
+    static void findAllocCountersGetter();
 
     /**
-     * @brief Sends a command to an analysis session in a different process
+     * @brief Copies the trace ring of the calling thread and queues it to be written to the next trace file by the trace writer thread
      *
-     * @param cmd Command to send
+     * Only the ring of the calling thread is copied; the rings of other threads are written by their threads without locking.
+     *
+     * @param info Calling thread
+     * @param threshold Threshold in ns of the most recent block in the ring, which is over it
      */
-    static void controlRemote(Command cmd);
+    static void queueTrace(ThreadInfo* info, unsigned long long threshold);
 
     /**
-     * @brief Controls the analysis session in this process
+     * @brief Writes queued trace rings to their trace files, launched with the first trace
      *
-     * @param cmd Command to execute
+     * @param arg Unused
+     *
+     * @return Never returns
      */
-    static void control(Command cmd);
+    static void* writeTraces(void* arg);
 
     /**
-     * @brief Starts a named analysis
+     * @brief Writes a trace ring to its trace file
      *
-     * @param blockName Name of the analyzed block, max 4 characters
+     * @param snapshot Trace ring to write
      */
-    static void startProfiling(const char* blockName = "NDEF");
+    static void writeTrace(const TraceSnapshot* snapshot);
 
     /**
-     * @brief Ends the named analysis, printing the running time of the block; it must have been started before
+     * @brief Waits until the trace writer thread has written every queued trace ring, registered with atexit()
+     */
+    static void flushTraces();
+
+    /**
+     * @brief Gets the pool of a thread name, i.e the name without its trailing number and separators
      *
-     * @param blockName Name of the analyzed block, max 4 characters
+     * @param name Thread name
+     * @param pool Preallocated buffer of EZP_THREAD_NAME_LENGTH characters to write the pool name to
      */
-    static void endProfiling(const char* blockName = "NDEF");
+    static void getPoolName(const char* name, char* pool);
 
     /**
-     * @brief Starts a named analysis that is smoothed over time
+     * @brief Gets the ID of the retired bucket of a pool, creating it if necessary
      *
-     * @param blockName Name of the analyzed block, max 4 characters
+     * @param pool Name of the pool
+     *
+     * @return Negative ID of the retired bucket
      */
-    static void startProfilingSmooth(const char* blockName = "NDEF");
+    static TID getRetiredTid(const char* pool);
 
     /**
-     * @brief  Ends a named smoothed analysis, printing the running time of the block; it must have been started before
+     * @brief Finds an offline analysis record, creating it if necessary; must be called with offlineLock held
      *
-     * @param blockName Name of the analyzed block, max 4 characters
-     * @param smoothingFactor Coefficient of the history, between 0 and 1
+     * @param key Key of the record
+     *
+     * @return The record
      */
-    static void endProfilingSmooth(const char* blockName = "NDEF", float smoothingFactor = 0.95f);
+    static AggregateMarker* getOfflineMarker(const BlockKey& key);
 
     /**
-     * @brief Starts a named offline analysis that keeps the total running time and number of calls
+     * @brief Adds the runs of a record to another record that no thread owns; must be called with offlineLock held
      *
-     * @param blockName Name of the analyzed block, max 4 characters
+     * @param target Record to add to
+     * @param source Record to add
      */
-    static void startProfilingOffline(const char* blockName = "NDEF");
+    static void foldOfflineMarker(AggregateMarker* target, const AggregateMarker* source);
 
     /**
-     * @brief Ends a named offline analysis, it must have been smoothed before
+     * @brief Creates a new offline analysis record, reusing a recycled one if possible; must be called with offlineLock held
      *
-     * @param blockName Name of the analyzed profile, max 4 characters
+     * @param key Key of the new record
+     *
+     * @return The new record, already in offlineBlocks
      */
-    static void endProfilingOffline(const char* blockName = "NDEF");
+    static AggregateMarker* createOfflineMarker(const BlockKey& key);
 
     /**
-     * @brief Prints all data of all offline analyses up to now
+     * @brief Publishes a new offline analysis record to signal handlers and shared memory readers if there is room; must be called with offlineLock held
+     *
+     * @param marker Fully built record
      */
-    static void printOfflineProfiles();
+    static void publishOfflineMarker(AggregateMarker* marker);
 
     /**
-     * @brief Clears the offline analysis record
+     * @brief Tops the spare offline analysis records up to what EZP_INIT asked for; must be called with offlineLock held
+     *
+     * @param republish Whether the records were just cleared, spare records are then published again from the first slot
      */
-    static void clearOfflineProfiles();
+    static void preallocateOfflineMarkers(bool republish);
 
     /**
-     * @brief Launches the command listener thread if not already running
+     * @brief Accepts external connections to the UNIX socket and listens to commands forever
+     *
+     * @param arg Points to an int that is the file descriptor of the acceptor thread
+     *
+     * @return Nothing
      */
-    static void launchCmdListener();
+    static void* listenCmd(void* arg);
 
-    static const char* androidTag;      ///< Logcat tag on Android
-    static bool enabled;                ///< Whether analysis is enabled
-    static bool forceStderr;            ///< Whether to force error messages to stderr instead of Logcat on Android
+    /**
+     * @brief Copies the list of offline analysis records, taking the lock only if the list changed since the last call
+     *
+     * @param markers Previous copy of the list, updated in place
+     * @param generation Generation of the previous copy, updated in place
+     */
+    static void snapshotOfflineMarkers(std::vector<Blk2AMarkerPair>& markers, unsigned int& generation);
 
-private:
+    /**
+     * @brief Formats the current offline analysis records in the OpenMetrics text exposition format
+     *
+     * @param markers Offline analysis records to format
+     * @param output String to append the exposition to
+     */
+    static void formatMetrics(const std::vector<Blk2AMarkerPair>& markers, std::string& output);
 
     /**
-     * @brief Gets the time difference between two times
+     * @brief Takes a snapshot of the offline analysis records in a single pass, summing them across threads
      *
-     * @param begin Beginning time
-     * @param end Ending time
+     * @param report Report to fill, results are sorted on average time
      *
-     * @return Difference in milliseconds
+     * @return Whether there was any offline analysis record
      */
-    static float getTimeDiff(const Timespec* begin, const Timespec* end);
+    static bool buildOfflineReport(OfflineReport& report);
 
     /**
-     * @brief Hashes a string of maximum length 4 into an int uniquely
+     * @brief Computes averages, sums thread-wise profiles across threads and sorts them in a report whose thread-wise profiles are filled
      *
-     * @param str String of maximum length 4
+     * @param report Report to complete
+     */
+    static void completeOfflineReport(OfflineReport& report);
+
+    /**
+     * @brief Copies the contents of a marker to its shared memory record under the sequence lock, must be called with offlineLock held
      *
-     * @return Unique hash of given string
+     * @param marker Marker with a shared record
+     * @param bucket Only histogram bucket that changed since the last update, -1 to copy all buckets
      */
-    static unsigned int hashStr(const char* str);
+    static void updateSharedRecord(AggregateMarker* marker, int bucket);
 
     /**
-     * @brief Unhashes a string of length 4 from its unique hash
+     * @brief Removes the shared memory segment, registered with atexit()
+     */
+    static void unlinkSharedStats();
+
+    /**
+     * @brief Formats an offline analysis snapshot
      *
-     * @param hash Unique hash of length 4 string
-     * @param output Preallocated buffer to write string to, must be at least 5 characters long
+     * @param report Snapshot to format
+     * @param format Format of the report
+     * @param output String to append the report to
      */
-    static void unhashStr(unsigned int hash, char* output);
+    static void formatOfflineReport(const OfflineReport& report, ReportFormat format, std::string& output);
 
     /**
-     * @brief Accepts external connections to the UNIX socket and listens to commands forever
+     * @brief Writes a string to a file descriptor completely
      *
-     * @param arg Points to an int that is the file descriptor of the acceptor thread
+     * @param fd File descriptor to write to
+     * @param data String to write
+     *
+     * @return Whether the string was written completely
+     */
+    static bool writeAll(int fd, const std::string& data);
+
+    /**
+     * @brief Accepts scraper connections to the exporter socket and serves metrics forever
+     *
+     * @param arg Points to an int that is the file descriptor of the acceptor socket
      *
      * @return Nothing
      */
-    static void* listenCmd(void* arg);
+    static void* exportMetrics(void* arg);
+
+    /**
+     * @brief Writes all offline analysis records in the binary dump format; this function is async-signal-safe
+     *
+     * @param fd File descriptor to write to
+     *
+     * @return Whether the dump was written completely
+     */
+    static bool writeDump(int fd);
+
+    /**
+     * @brief Gets the path that this process writes a dump or trace to, i.e the base path with a .PID suffix in a forked child; this function is async-signal-safe
+     *
+     * @param base Path as given by the user
+     * @param path Preallocated buffer to write the path to
+     * @param size Size of path in bytes, PATH_MAX + 16 is enough
+     */
+    static void getProcessPath(const char* base, char* path, size_t size);
+
+    /**
+     * @brief Dumps to exitDumpPath, registered with atexit()
+     */
+    static void dumpAtExit();
+
+    /**
+     * @brief Dumps to signalDumpPath, then raises the signal again with its default action unless it is SIGUSR1 or SIGUSR2
+     *
+     * @param signum Received signal
+     */
+    static void dumpAtSignal(int signum);
 
-    static bool listenerRunning;                    ///< Whether the command listener thread is already launched
-    static const char* cmdSocketName;               ///< Name of the abstract UNIX socket
+    static unsigned int state;                      ///< StateFlag bits, see StateFlag for the memory ordering
+    static pid_t cmdSocketPid;                      ///< Process ID in the name of our socket, 0 for the first instrumented process
+    static pid_t parentSocketPid;                   ///< cmdSocketPid of the parent process, -1 if this process was not forked
+    static int cmdAcceptor;                         ///< Listening socket of the command listener, -1 if not running
     static pthread_t cmdListener;                   ///< Listens to external commands over a UNIX sockets
     static pthread_mutex_t listenerLauncherLock;    ///< To not launch multiple listener threads
 
+    static bool exporterRunning;                    ///< Whether the OpenMetrics exporter thread is already launched
+    static pthread_t metricsExporter;               ///< Serves OpenMetrics text to scrapers
+    static int exporterAcceptor;                    ///< Listening socket of the exporter, -1 if not running
+    static pthread_mutex_t exporterLauncherLock;    ///< To not launch multiple exporter threads
+
     static Blk2Clk blocks;              ///< Names and beginning times of analysis blocks
     static Blk2SMarker smoothBlocks;    ///< Names, beginning times and latest time slices of smoothed analysis blocks
     static Blk2AMarker offlineBlocks;   ///< Names, beginning times, total times and number of samples of offline analysis blocks
+    static unsigned int offlineGeneration; ///< Incremented whenever records are added to or removed from offlineBlocks
+    static AggregateMarker* offlineRecords[EZP_MAX_DUMPED_BLOCKS]; ///< Every marker in offlineBlocks, readable from signal handlers
+    static unsigned int numOfflineRecords;  ///< Number of valid entries in offlineRecords
+
+    static SharedHeader* sharedStats;       ///< Shared memory segment where offline records are published, NULL if not published
+    static SharedRecord* sharedRecords;     ///< Records of the shared memory segment, indexed like offlineRecords
+    static bool sharedStatsPending;         ///< Whether a forked child publishes its own segment when it launches its listener
+
+    static char exitDumpPath[PATH_MAX];     ///< Where to dump at exit, before getProcessPath()
+    static char signalDumpPath[PATH_MAX];   ///< Where to dump upon signal, before getProcessPath()
+    static int dumpLock;                    ///< Nonzero while a dump is being written
+
+    static bool childMerging;               ///< Whether forked processes send their records to their parent when they exit
+    static bool mergeAtExitRegistered;      ///< Whether mergeAtExit() is registered with atexit() in this process
+
+    static __thread TID cachedTid;              ///< ID of the calling thread, 0 if not cached yet
+    static pthread_once_t forkHandlersOnce;     ///< To register fork handlers only once
+    static __thread ThreadInfo* currentThread;  ///< Info of the calling thread, NULL if not registered yet
+    static pthread_key_t threadKey;             ///< Calls retireThread() when a registered thread exits
+    static pthread_once_t threadKeyOnce;        ///< To create threadKey only once
+    static Tid2Thread threads;                  ///< Live threads and retired buckets
+    static Name2Thread retiredPools;            ///< Retired buckets by pool name
+    static std::vector<AggregateMarker*> freeOfflineMarkers; ///< Recycled markers of exited threads, still in offlineRecords
+    static size_t numOfflineMarkers;        ///< Number of markers ever allocated, they are never freed
+    static size_t numPreallocatedMarkers;   ///< Number of spare markers that EZP_INIT asked for, kept across clears and forks
+
+    static unsigned int maxRecords;         ///< Number of records per kind of analysis past which new blocks share the EZP_OTHER_NAME record of their thread, 0 for no limit, accessed atomically
+    static unsigned int maxPools;           ///< Number of retired buckets past which exited threads go to the EZP_OTHER_NAME bucket, 0 for no limit, accessed atomically
+    static unsigned int traceRingSize;      ///< Number of entries of the trace rings allocated from now on
+    static unsigned long long numOverflows; ///< Number of blocks that started in an EZP_OTHER_NAME record for lack of a record of their own
+
+    static unsigned short blockIdSlots[EZP_BLOCK_ID_TABLE_SIZE];    ///< Open addressing table of block IDs plus one, 0 if empty
+    static unsigned int blockIdNames[EZP_MAX_BLOCK_IDS];            ///< Hash of the name of each block ID
+    static unsigned int numBlockIds;                                ///< Number of block IDs given so far
+    static unsigned int disabledBlocks[EZP_MAX_BLOCK_IDS/32];       ///< Bitmap of blocks that are disabled by block filters, indexed by block ID
+    static FilterRules blockFilters;                                ///< Block name prefixes and whether they enable or disable, in order
+    static FilterRules threadFilters;                               ///< Thread IDs or name prefixes and whether they enable or disable, in order
+
+    static unsigned long long traceThresholds[EZP_MAX_BLOCK_IDS];   ///< Trace threshold of each block ID in ns, 0 if not traced
+    static unsigned int numTraceThresholds;                         ///< Number of nonzero entries in traceThresholds
+    static unsigned int numTraces;                                  ///< Number of traces written since a threshold was last set
+    static unsigned int nextTraceIndex;                             ///< N of the next trace file
+    static char tracePath[PATH_MAX];                                ///< Traces are written to tracePath.N.json, tracePath.PID.N.json in a forked child
+    static pthread_mutex_t traceLock;                               ///< Locks the trace queue
+    static pthread_cond_t traceCond;                                ///< Signals the trace writer that a ring is queued, and flushTraces() that all are written
+    static TraceSnapshot* traceQueue;                               ///< First ring queued for the trace writer thread
+    static TraceSnapshot* traceQueueTail;                           ///< Last ring queued for the trace writer thread
+    static unsigned int numQueuedTraces;                            ///< Number of rings queued or being written
+    static bool traceWriterRunning;                                 ///< Whether the trace writer thread is launched
+    static bool flushTracesRegistered;                              ///< Whether flushTraces() is registered with atexit()
+
+    static unsigned char cpuNodes[EZP_MAX_CPUS];    ///< NUMA node of each CPU
+    static pthread_once_t cpuNodesOnce;             ///< To read cpuNodes only once
+
+    static AllocCounters* (*allocCountersGetter)(); ///< ezp_get_alloc_counters() of libezp_malloc.so, NULL if not loaded
+    static pthread_once_t allocCountersGetterOnce;  ///< To look up allocCountersGetter only once
+
+    static unsigned short functionSlots[EZP_FUNCTION_TABLE_SIZE];   ///< Open addressing table of function indices plus one, 0 if empty
+    static void* functionAddresses[EZP_MAX_FUNCTIONS];              ///< Address of each function index
+    static unsigned int numFunctions;                               ///< Number of function indices given so far
+    static unsigned int disabledFunctions[EZP_MAX_FUNCTIONS/32];    ///< Bitmap of functions that are disabled by function filters, indexed by function index
+    static AddressRules functionFilters;                            ///< Function address ranges and whether they enable or disable, in order
+    static bool stopFunctionHooksRegistered;                        ///< Whether stopFunctionHooks() is registered with atexit()
+    static __thread unsigned int openFunctions[EZP_MAX_FUNCTION_DEPTH]; ///< Block names of the functions the calling thread is in, 0 for those not analyzed
+    static __thread unsigned int numOpenFunctions;                  ///< Call depth of the calling thread in functions calling the hooks
+
+    static unsigned long long samplingPeriod;   ///< Sampling period in ns of thread CPU time
+    static bool samplingBacktraces;             ///< Whether samples keep backtraces
+    static unsigned int samplingGeneration;     ///< Incremented whenever the sampling period or backtraces change, threads rearm their timers when it does
+    static pthread_once_t samplingHandlerOnce;  ///< To install the SIGPROF handler only once
+
+    static pthread_mutex_t recordLock;          ///< Locks the recording file, the encoder queue and the free record buffers
+    static pthread_cond_t recordCond;           ///< Signals the encoder thread that a buffer is queued or that the recording stops
+    static FILE* recordFile;                    ///< File of the recording, NULL if not recording
+    static bool recordStopping;                 ///< Whether the recording is stopping, threads do not get new buffers then
+    static RecordHeader recordHeader;           ///< Header of the recording
+    static RecordBuffer* recordQueue;           ///< First buffer queued for the encoder thread
+    static RecordBuffer* recordQueueTail;       ///< Last buffer queued for the encoder thread
+    static RecordBuffer* freeRecordBuffers;     ///< Encoded buffers, kept for the next threads that need one
+    static unsigned int numRecordBuffers;       ///< Number of buffers taken by threads or queued and not encoded yet
+    static pthread_t recordEncoder;             ///< Compresses queued buffers into chunks
+    static bool stopRecordingRegistered;        ///< Whether stopRecording() is registered with atexit()
 
     static pthread_mutex_t lock;        ///< Locks normal analysis record access
     static pthread_mutex_t smoothLock;  ///< Locks smooth analysis record access
     static pthread_mutex_t offlineLock; ///< Locks offline analysis record access
+    static pthread_mutex_t threadLock;  ///< Locks thread info and thread filter access
+    static pthread_mutex_t filterLock;  ///< Locks block ID, function index and block and function filter access
 
 };
 
 } /* namespace ezp */
 
+#include"ezp_core.hpp"
+
 #endif /* EZP_HPP */
 
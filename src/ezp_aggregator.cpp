@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_aggregator.cpp
+ * @brief Daemon that sums the shared memory statistics of all EZP sessions on the host and serves them
+ * @date 2026-10-18
+ */
+
+#include<csignal>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<string>
+#include<getopt.h>
+
+#include"ezp.hpp"
+
+using namespace std;
+
+static volatile sig_atomic_t running = 1;
+
+void stop(int){
+    running = 0;
+}
+
+void printHelp(bool desc){
+    cout << "Usage: ezp_aggregator [OPTION]" << endl;
+    if(desc){
+        cout << "Sums the offline analyses of all processes on this host that called" << endl;
+        cout << "EZP_BEGIN_SHARED_STATS, pulling only what changed since the last pull." << endl;
+        cout << "ezp_control -a reaches the summed analyses, e.g ezp_control -a -p." << endl;
+    }
+    cout << endl;
+    cout << "  -i, --interval=MS    Pulls every MS ms, 1000 by default" << endl;
+    cout << "  -n, --count=N        Exits after N pulls instead of at SIGINT or SIGTERM" << endl;
+    cout << "  -o, --output=PATH    Rewrites PATH with the summed analyses after each pull" << endl;
+    cout << "  -f, --format=FORMAT  Format of PATH: text, json (default) or csv" << endl;
+    cout << "  -g, --group          Groups processes of the same executable together" << endl;
+    cout << "  -x, --exporter=ADDRESS" << endl;
+    cout << "                       Serves the summed analyses to OpenMetrics scrapers at ADDRESS," << endl;
+    cout << "                       tcp:PORT or unix:NAME" << endl;
+    cout << "  -h, --help           Displays this message" << endl;
+}
+
+/**
+ * @brief Writes the summed analyses to a temporary file and renames it over the output so that readers never see half a report
+ */
+bool writeOutput(const char* path, ezp::EasyPerformanceAnalyzer::ReportFormat format){
+    string temporary = string(path) + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "w");
+    if(file == NULL){
+        cerr << "EZP: Could not open " << temporary << ": " << strerror(errno) << endl;
+        return false;
+    }
+    ezp::EasyPerformanceAnalyzer::writeOfflineProfiles(file, format);
+    if(fclose(file) != 0 || rename(temporary.c_str(), path) != 0){
+        cerr << "EZP: Could not write " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv){
+    struct option options[] = {
+        {"interval",    required_argument,  NULL,   'i'},
+        {"count",       required_argument,  NULL,   'n'},
+        {"output",      required_argument,  NULL,   'o'},
+        {"format",      required_argument,  NULL,   'f'},
+        {"group",       no_argument,        NULL,   'g'},
+        {"exporter",    required_argument,  NULL,   'x'},
+        {"help",        no_argument,        NULL,   'h'},
+        {NULL,          0,                  NULL,   0}
+    };
+
+    long interval = 1000;
+    long count = -1;
+    const char* output = NULL;
+    ezp::EasyPerformanceAnalyzer::ReportFormat format = ezp::EasyPerformanceAnalyzer::FORMAT_JSON;
+    const char* exporter = NULL;
+
+    int i = 0;
+    int c;
+    while((c = getopt_long(argc, argv, "i:n:o:f:gx:h", options, &i)) != -1)
+        switch(c){
+            case 'i':
+                interval = atol(optarg);
+                if(interval <= 0){
+                    cerr << "EZP: Interval must be positive" << endl;
+                    return -1;
+                }
+                break;
+            case 'n':
+                count = atol(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'f':
+                if(strcmp(optarg, "text") == 0)
+                    format = ezp::EasyPerformanceAnalyzer::FORMAT_TEXT;
+                else if(strcmp(optarg, "json") == 0)
+                    format = ezp::EasyPerformanceAnalyzer::FORMAT_JSON;
+                else if(strcmp(optarg, "csv") == 0)
+                    format = ezp::EasyPerformanceAnalyzer::FORMAT_CSV;
+                else{
+                    cerr << "EZP: Unknown format " << optarg << endl;
+                    return -1;
+                }
+                break;
+            case 'g':
+                EZP_SET_THREAD_AGGREGATION(POOL)
+                break;
+            case 'x':
+                exporter = optarg;
+                break;
+            case 'h':
+                printHelp(true);
+                return 0;
+            default:
+                printHelp(false);
+                return -1;
+        }
+
+    signal(SIGINT, &stop);
+    signal(SIGTERM, &stop);
+
+    //Our own session is where the summed analyses live, reachable under its own control socket name
+    EZP_FORCE_STDERR_ON
+    EZP_SET_CONTROL_NAME("ezp_aggregator")
+    EZP_BEGIN_CONTROL
+    if(exporter != NULL)
+        EZP_BEGIN_EXPORTER(exporter)
+
+    struct timespec period;
+    period.tv_sec = interval/1000;
+    period.tv_nsec = (interval%1000)*1000000;
+    while(running && count != 0){
+        if(ezp::EasyPerformanceAnalyzer::pullSharedStats() < 0)
+            return -1;
+        if(output != NULL)
+            writeOutput(output, format);
+        if(count > 0)
+            count--;
+        if(count != 0)
+            nanosleep(&period, NULL); //Cut short by SIGINT and SIGTERM
+    }
+    return 0;
+}
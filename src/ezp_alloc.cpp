@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_alloc.cpp
+ * @brief Attribution of the allocations counted by libezp_malloc.so to offline analysis blocks
+ * @date 2026-10-18
+ */
+
+#include<dlfcn.h>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::setAllocStats(bool on)
+{
+    pthread_once(&allocCountersGetterOnce, findAllocCountersGetter);
+    if(on && allocCountersGetter == NULL){
+        EZP_PERR("EZP: Cannot count allocations, run with LD_PRELOAD=libezp_malloc.so\n");
+        return false;
+    }
+    setState(STATE_ALLOC_STATS, on);
+    return true;
+}
+
+//This function is not time critical, called once
+void EasyPerformanceAnalyzer::findAllocCountersGetter()
+{
+    AllocCounters* (*getter)() = (AllocCounters* (*)())dlsym(RTLD_DEFAULT, "ezp_get_alloc_counters");
+    __atomic_store_n(&allocCountersGetter, getter, __ATOMIC_RELEASE);
+}
+
+} /* namespace ezp */
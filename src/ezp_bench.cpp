@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_bench.cpp
+ * @brief Warm-up detection, stopping rule and statistics of EZP_BENCH benchmarks
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Phases of a benchmark, see BenchState::phase
+ */
+enum BenchPhase{
+    BENCH_BATCHING = 0,     ///< Doubling the batch until it lasts EZP_BENCH_MIN_BATCH clock overheads
+    BENCH_WARMING_UP = 1,   ///< Discarding batches until the median of a window settles
+    BENCH_MEASURING = 2     ///< Keeping batches until the confidence interval is tight enough
+};
+
+/**
+ * @brief Gets the median of some values
+ *
+ * @param values Values, reordered
+ *
+ * @return Median of the values, 0 if there are none
+ */
+static double getMedian(std::vector<double>& values)
+{
+    if(values.empty())
+        return 0.0;
+    size_t middle = values.size()/2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double median = values[middle];
+    if(values.size()%2 == 0)
+        median = (median + *std::max_element(values.begin(), values.begin() + middle))/2.0;
+    return median;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::beginBenchmark(BenchState& bench, const char* blockName, double overhead)
+{
+    memset(&(bench.result), 0, sizeof(bench.result));
+    bench.result.blockName = hashStr(blockName);
+    bench.result.batch = 1;
+    bench.result.overhead = overhead;
+    bench.phase = BENCH_BATCHING;
+    bench.window.clear();
+    bench.window.reserve(EZP_BENCH_WINDOW);
+    bench.previousMedian = -1.0;
+
+    //Measured batches never allocate
+    bench.samples.clear();
+    bench.samples.reserve(EZP_BENCH_MAX_SAMPLES);
+    bench.m2 = 0.0;
+    clock_gettime(EZP_WALL_CLOCK, &(bench.beginTime));
+}
+
+//This function is not time critical, called between batches
+bool EasyPerformanceAnalyzer::addBenchmarkSample(BenchState& bench, double ns)
+{
+    BenchResult& result = bench.result;
+    Timespec now;
+    clock_gettime(EZP_WALL_CLOCK, &now);
+    double elapsed = getTimeDiffNs(&(bench.beginTime), &now)/1000000.0;
+    double perCall = std::max(ns - result.overhead, 0.0)/result.batch;
+
+    switch(bench.phase){
+        case BENCH_BATCHING:
+
+            //The clock overhead must be a small part of a batch, and a batch long enough for the clock to tell it from 0
+            if(ns < std::max(EZP_BENCH_MIN_BATCH*result.overhead, 1000.0) && result.batch < (1ULL << 40) && elapsed < benchBudget/4){
+                result.batch *= 2;
+                result.warmupSamples++;
+                return true;
+            }
+            bench.phase = BENCH_WARMING_UP;
+            //Fall through, this batch is the first of the warm-up
+
+        case BENCH_WARMING_UP:
+
+            //Caches, branch predictors and frequency scaling settle; warm-up takes at most a quarter of the budget
+            result.warmupSamples++;
+            bench.window.push_back(perCall);
+            if(bench.window.size() < EZP_BENCH_WINDOW)
+                return true;
+            {
+                double median = getMedian(bench.window);
+                bool settled = bench.previousMedian >= 0.0 && fabs(median - bench.previousMedian) <= 0.05*bench.previousMedian;
+                bench.previousMedian = median;
+                bench.window.clear();
+                if(!settled && elapsed < benchBudget/4)
+                    return true;
+            }
+            bench.phase = BENCH_MEASURING;
+            return true;
+
+        default:
+
+            //Welford's running mean and variance
+            bench.samples.push_back(perCall);
+            {
+                size_t n = bench.samples.size();
+                double delta = perCall - result.mean;
+                result.mean += delta/n;
+                bench.m2 += delta*(perCall - result.mean);
+                if(n >= EZP_BENCH_MAX_SAMPLES || elapsed >= benchBudget)
+                    return false;
+                if(n >= EZP_BENCH_MIN_SAMPLES){
+                    result.ciHalfWidth = 1.96*sqrt(bench.m2/(n - 1)/n);
+                    if(result.ciHalfWidth <= benchPrecision*result.mean){
+                        result.converged = true;
+                        return false;
+                    }
+                }
+            }
+            return true;
+    }
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::endBenchmark(BenchState& bench)
+{
+    BenchResult& result = bench.result;
+    size_t n = bench.samples.size();
+    result.numSamples = n;
+    result.stddev = n > 1 ? sqrt(bench.m2/(n - 1)) : 0.0;
+    result.ciHalfWidth = n > 0 ? 1.96*result.stddev/sqrt((double)n) : 0.0;
+
+    //Each batch counts as many runs as it made calls, all lasting its time per call, until the run counter is full
+    if(currentThread == NULL)
+        registerThread();
+    pthread_mutex_lock(&offlineLock);
+    AggregateMarker* marker = getOfflineMarker(BlockKey(getTid(), result.blockName));
+    for(std::vector<double>::const_iterator it = bench.samples.begin(); it != bench.samples.end(); it++){
+        unsigned long long calls = std::min(result.batch, (unsigned long long)(INT_MAX - marker->numSamples));
+        if(calls == 0)
+            break;
+        int bucket = getHistogramBucket((unsigned long long)(*it + 0.5));
+        __atomic_store_n(&(marker->numSamples), marker->numSamples + (int)calls, __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->totalTime), marker->totalTime + (unsigned long long)(*it*calls + 0.5), __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->histogram[bucket]), marker->histogram[bucket] + (unsigned int)calls, __ATOMIC_RELAXED);
+    }
+    if(marker->shared != NULL)
+        updateSharedRecord(marker, -1);
+    pthread_mutex_unlock(&offlineLock);
+
+    result.median = getMedian(bench.samples);
+
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    getBlockLabel(result.blockName, cbuf);
+    EZP_PRINT("EZP: Benchmark %s: %.3f ns per call +- %.3f ns (95%% CI, %.2f%%), median %.3f ns, std dev %.3f ns\n", cbuf, result.mean,
+            result.ciHalfWidth, result.mean > 0.0 ? 100.0*result.ciHalfWidth/result.mean : 0.0, result.median, result.stddev);
+    EZP_PRINT("EZP:     %llu batches of %llu calls after %llu warm-up batches, %.1f ns of clock overhead subtracted per batch%s\n",
+            result.numSamples, result.batch, result.warmupSamples, result.overhead,
+            result.converged ? "" : ", time budget ran out before the precision was reached");
+}
+
+} /* namespace ezp */
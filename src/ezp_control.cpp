@@ -23,6 +23,7 @@
  * @date 2014-10-30
  */
 
+#include<cstdlib>
 #include<iostream>
 #include<getopt.h>
 
@@ -38,7 +39,36 @@ void printHelp(bool desc){
     cout << "  -e, --enable     Enables instrumentation" << endl;
     cout << "  -d, --disable    Disables instrumentation" << endl;
     cout << "  -p, --print      Prints all information on offline analyses" << endl;
+    cout << "  -j, --json       Prints all information on offline analyses as JSON to stdout" << endl;
+    cout << "  -v, --csv        Prints all information on offline analyses as CSV to stdout" << endl;
+    cout << "  -s, --smooth     Prints all information on smoothed analyses" << endl;
     cout << "  -c, --clear      Clears all offline analysis history" << endl;
+    cout << "  -o, --open       Prints the offline analysis blocks open in each thread with" << endl;
+    cout << "                   their elapsed time so far, e.g to find where it hangs" << endl;
+    cout << "  -M, --memory     Prints the memory that EZP uses in the process, broken down by" << endl;
+    cout << "                   structure" << endl;
+    cout << "  -E, --enable-blocks=PREFIX" << endl;
+    cout << "                   Enables blocks whose names begin with PREFIX" << endl;
+    cout << "  -D, --disable-blocks=PREFIX" << endl;
+    cout << "                   Disables blocks whose names begin with PREFIX, \"\" for all" << endl;
+    cout << "  -t, --enable-threads=THREAD" << endl;
+    cout << "                   Enables threads whose ID is THREAD or whose names begin with THREAD" << endl;
+    cout << "  -T, --disable-threads=THREAD" << endl;
+    cout << "                   Disables threads whose ID is THREAD or whose names begin with THREAD" << endl;
+    cout << "  -r, --reset-filters" << endl;
+    cout << "                   Removes all block and thread filters" << endl;
+    cout << "  -x, --trace=BLOCK:MS" << endl;
+    cout << "                   Writes the last blocks of a thread to a trace file whenever" << endl;
+    cout << "                   BLOCK lasts longer than MS ms in it, 0 to stop" << endl;
+    cout << "  -R, --record=PATH" << endl;
+    cout << "                   Records every offline analysis block that ends to PATH, \"\" to" << endl;
+    cout << "                   stop; see ezp_decode" << endl;
+    cout << "  -m, --shm=PID    Prints all information on offline analyses of process PID" << endl;
+    cout << "                   from shared memory, without communicating with it" << endl;
+    cout << "  -P, --pid=PID    Sends the following command to process PID, which was forked" << endl;
+    cout << "                   from an instrumented process, instead of the first one" << endl;
+    cout << "  -a, --aggregator Sends the following command to ezp_aggregator, which sums the" << endl;
+    cout << "                   shared memory statistics of all processes on this host" << endl;
     cout << "  -h, --help       Displays this message" << endl;
 }
 
@@ -47,13 +77,28 @@ int main(int argc, char** argv){
         {"enable",  no_argument,    NULL,   'e'},
         {"disable", no_argument,    NULL,   'd'},
         {"print",   no_argument,    NULL,   'p'},
+        {"json",    no_argument,    NULL,   'j'},
+        {"csv",     no_argument,    NULL,   'v'},
+        {"smooth",  no_argument,    NULL,   's'},
         {"clear",   no_argument,    NULL,   'c'},
+        {"open",    no_argument,    NULL,   'o'},
+        {"memory",  no_argument,    NULL,   'M'},
+        {"enable-blocks",   required_argument,  NULL,   'E'},
+        {"disable-blocks",  required_argument,  NULL,   'D'},
+        {"enable-threads",  required_argument,  NULL,   't'},
+        {"disable-threads", required_argument,  NULL,   'T'},
+        {"reset-filters",   no_argument,        NULL,   'r'},
+        {"trace",   required_argument,  NULL,   'x'},
+        {"record",  required_argument,  NULL,   'R'},
+        {"shm",     required_argument,  NULL,   'm'},
+        {"pid",     required_argument,  NULL,   'P'},
+        {"aggregator",  no_argument,    NULL,   'a'},
         {"help",    no_argument,    NULL,   'h'}
     };
 
     int i = 0;
     while (true)
-        switch(getopt_long(argc, argv, "edpch", options, &i)){
+        switch(getopt_long(argc, argv, "edpjvscoME:D:t:T:rx:R:m:P:ah", options, &i)){
             case 'e':
                 EZP_FORCE_STDERR_ON
                 EZP_ENABLE_REMOTE
@@ -66,10 +111,76 @@ int main(int argc, char** argv){
                 EZP_FORCE_STDERR_ON
                 EZP_PRINT_OFFLINE_REMOTE
                 return 0;
+            case 'j':
+                EZP_FORCE_STDERR_ON
+                EZP_PRINT_OFFLINE_JSON_REMOTE
+                return 0;
+            case 'v':
+                EZP_FORCE_STDERR_ON
+                EZP_PRINT_OFFLINE_CSV_REMOTE
+                return 0;
+            case 's':
+                EZP_FORCE_STDERR_ON
+                EZP_PRINT_SMOOTH_REMOTE
+                return 0;
             case 'c':
                 EZP_FORCE_STDERR_ON
                 EZP_CLEAR_OFFLINE_REMOTE
                 return 0;
+            case 'o':
+                EZP_FORCE_STDERR_ON
+                EZP_PRINT_OPEN_REMOTE
+                return 0;
+            case 'M':
+                EZP_FORCE_STDERR_ON
+                EZP_PRINT_MEMORY_REMOTE
+                return 0;
+            case 'E':
+                EZP_FORCE_STDERR_ON
+                EZP_ENABLE_BLOCKS_REMOTE(optarg)
+                return 0;
+            case 'D':
+                EZP_FORCE_STDERR_ON
+                EZP_DISABLE_BLOCKS_REMOTE(optarg)
+                return 0;
+            case 't':
+                EZP_FORCE_STDERR_ON
+                EZP_ENABLE_THREADS_REMOTE(optarg)
+                return 0;
+            case 'T':
+                EZP_FORCE_STDERR_ON
+                EZP_DISABLE_THREADS_REMOTE(optarg)
+                return 0;
+            case 'r':
+                EZP_FORCE_STDERR_ON
+                EZP_RESET_FILTERS_REMOTE
+                return 0;
+            case 'x':
+                EZP_FORCE_STDERR_ON
+                EZP_SET_TRACE_THRESHOLD_REMOTE(optarg)
+                return 0;
+            case 'R':
+                EZP_FORCE_STDERR_ON
+                if(optarg[0] == '\0')
+                    EZP_END_RECORDING_REMOTE
+                else
+                    EZP_BEGIN_RECORDING_REMOTE(optarg)
+                return 0;
+            case 'm':
+                {
+                    EZP_FORCE_STDERR_ON
+                    ezp::OfflineReport report;
+                    if(!ezp::EasyPerformanceAnalyzer::readSharedStats(atoi(optarg), report))
+                        return -1;
+                    ezp::EasyPerformanceAnalyzer::writeOfflineReport(report, stdout, ezp::EasyPerformanceAnalyzer::FORMAT_TEXT);
+                }
+                return 0;
+            case 'P':
+                EZP_SET_REMOTE_PID(atoi(optarg))
+                break;
+            case 'a':
+                EZP_SET_CONTROL_NAME("ezp_aggregator")
+                break;
             case 'h':
                 printHelp(true);
                 return 0;
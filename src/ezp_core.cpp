@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_core.cpp
+ * @brief Out-of-line parts of the clock, storage and sink policies of the analyzer core
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Wall clock time over which the timestamp counter is calibrated, in nanoseconds
+ */
+#define EZP_TSC_CALIBRATION_TIME 20000000
+
+static double nsPerTick = 1.0;
+static pthread_once_t nsPerTickOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Measures the length of a counter tick, called once
+ */
+static void calibrateTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    Timespec begin, end;
+    TscClock::Stamp beginTicks, endTicks;
+    clock_gettime(EZP_WALL_CLOCK, &begin);
+    TscClock::now(beginTicks);
+    do
+        clock_gettime(EZP_WALL_CLOCK, &end);
+    while((end.tv_sec - begin.tv_sec)*1000000000LL + end.tv_nsec - begin.tv_nsec < EZP_TSC_CALIBRATION_TIME);
+    TscClock::now(endTicks);
+    nsPerTick = (double)((end.tv_sec - begin.tv_sec)*1000000000LL + end.tv_nsec - begin.tv_nsec)/(endTicks - beginTicks);
+#elif defined(__aarch64__)
+    unsigned long long frequency;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+    nsPerTick = 1000000000.0/frequency;
+#endif
+}
+
+//This function is not time critical
+double TscClock::getNsPerTick()
+{
+    pthread_once(&nsPerTickOnce, calibrateTsc);
+    return nsPerTick;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::printBlockTime(unsigned int blockName, float time)
+{
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    getBlockLabel(blockName, cbuf);
+    EZP_PRINT("EZP: [%d]\t%s\t%6.2f ms\n", getTid(), cbuf, time);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::reportMissingBlock(const char* blockName, const char* start)
+{
+    EZP_PERR("EZP: Can't find %s, did you call %s(\"%s\")?\n", blockName, start, blockName);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::warnLongBlockName(const char* blockName)
+{
+    EZP_PERR("EZP: Block name %s is too long, truncating to 4 characters\n", blockName);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::warnReservedBlockName()
+{
+    static bool warned = false;
+    if(!__atomic_exchange_n(&warned, true, __ATOMIC_RELAXED))
+        EZP_PERR("EZP: Block name %s is reserved for blocks without a record of their own, blocks named so are not analyzed\n", EZP_OTHER_NAME);
+}
+
+//This function is not time critical, called once per thread
+TID EasyPerformanceAnalyzer::registerExternalThread()
+{
+    if(currentThread == NULL)
+        registerThread();
+    return getTid();
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::writeExternalReport(OfflineReport& report, FILE* file, ReportFormat format)
+{
+    if(report.threadProfiles.empty()){
+        EZP_PERR("EZP: No block found; instrument some code first by wrapping it with start() ... end()\n");
+        return;
+    }
+
+    refreshThreadNames();
+    pthread_mutex_lock(&threadLock);
+    for(std::vector<AggregateProfile>::iterator it = report.threadProfiles.begin(); it != report.threadProfiles.end(); it++){
+        Tid2Thread::iterator threadIt = threads.find(it->tid);
+        if(threadIt != threads.end())
+            memcpy(it->threadName, threadIt->second->name, sizeof(it->threadName));
+        else
+            snprintf(it->threadName, sizeof(it->threadName), "%d", it->tid);
+    }
+    pthread_mutex_unlock(&threadLock);
+
+    completeOfflineReport(report);
+    writeOfflineReport(report, file, format);
+}
+
+} /* namespace ezp */
@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_core.hpp
+ * @brief Analyzer core templated on its clock, storage and sink policies, included by ezp.hpp
+ * @date 2026-10-18
+ *
+ * A clock policy provides:
+ *   - typedef Stamp, the type of a time stamp
+ *   - static void now(Stamp& stamp), reads the clock
+ *   - static unsigned long long elapsed(const Stamp& begin, const Stamp& end), time between two stamps in clock units
+ *   - static double toNs(unsigned long long units), converts clock units to nanoseconds
+ *
+ * A storage policy provides:
+ *   - static Stamp* open(unsigned int blockName), finds or creates the record of a block in the calling thread and
+ *     returns where to write its begin time, NULL to skip it
+ *   - static bool close(unsigned int blockName, const Stamp& end, const Stamp*& begin), records the end of a block,
+ *     returns whether its record was found and sets begin to its begin time, or to NULL if the run was not recorded
+ *   - static void missing(const char* blockName), reports a block that was never started
+ *   - static void write(FILE* file, EasyPerformanceAnalyzer::ReportFormat format), writes its records
+ *
+ * A sink policy provides:
+ *   - static void write(unsigned int blockName, float time), receives the time in milliseconds of each recorded run
+ *
+ * Policies are resolved at compile time, so a null sink costs nothing. Only FlatStorage is inlined and lock-free, though:
+ * OnlineStorage and OfflineStorage, behind the EZP_START and EZP_START_OFFLINE macros, forward to the same out-of-line
+ * functions as before, which take a lock at both ends of a block. The default path costs what it did before the policies.
+ */
+
+#ifndef EZP_CORE_HPP
+#define EZP_CORE_HPP
+
+namespace ezp{
+
+///////////////////////////////////////////////////////////////////////////////
+//Clock policies
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief CPU time of the calling thread, the clock of all EZP_* blocks
+ */
+class ThreadCpuClock{
+public:
+
+    typedef Timespec Stamp;
+
+    //This function is time critical!
+    static inline void now(Stamp& stamp)
+    {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stamp);
+    }
+
+    //This function is time critical!
+    static inline unsigned long long elapsed(const Stamp& begin, const Stamp& end)
+    {
+        return (end.tv_sec - begin.tv_sec)*1000000000LL + end.tv_nsec - begin.tv_nsec;
+    }
+
+    //This function is not time critical
+    static inline double toNs(unsigned long long units)
+    {
+        return (double)units;
+    }
+};
+
+/**
+ * @brief Monotonic wall clock time, includes the time the thread spends off CPU
+ */
+class MonotonicClock{
+public:
+
+    typedef Timespec Stamp;
+
+    //This function is time critical!
+    static inline void now(Stamp& stamp)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &stamp);
+    }
+
+    //This function is time critical!
+    static inline unsigned long long elapsed(const Stamp& begin, const Stamp& end)
+    {
+        return (end.tv_sec - begin.tv_sec)*1000000000LL + end.tv_nsec - begin.tv_nsec;
+    }
+
+    //This function is not time critical
+    static inline double toNs(unsigned long long units)
+    {
+        return (double)units;
+    }
+};
+
+/**
+ * @brief CPU timestamp counter on x86 and virtual counter on AArch64, read without a system call
+ *
+ * Counts wall clock time like MonotonicClock; threads migrating between CPUs need an invariant, synchronized counter,
+ * which all recent x86 and AArch64 CPUs have. Falls back to MonotonicClock elsewhere.
+ */
+class TscClock{
+public:
+
+    typedef unsigned long long Stamp;
+
+    //This function is time critical!
+    static inline void now(Stamp& stamp)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        stamp = __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(stamp));
+#else
+        Timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        stamp = time.tv_sec*1000000000ULL + time.tv_nsec;
+#endif
+    }
+
+    //This function is time critical!
+    static inline unsigned long long elapsed(const Stamp& begin, const Stamp& end)
+    {
+        return end - begin;
+    }
+
+    //This function is not time critical
+    static inline double toNs(unsigned long long units)
+    {
+        return units*getNsPerTick();
+    }
+
+private:
+
+    /**
+     * @brief Gets the length of a counter tick, calibrated against CLOCK_MONOTONIC on x86 at the first call
+     *
+     * @return Length of a counter tick in nanoseconds
+     */
+    static double getNsPerTick();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//Sink policies
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Discards the time of each run, records are only seen in reports
+ */
+class NullSink{
+public:
+
+    //This function is time critical!
+    static inline void write(unsigned int blockName, float time)
+    {
+        (void)blockName;
+        (void)time;
+    }
+};
+
+/**
+ * @brief Prints the time of each run with the thread ID, as EZP_END does
+ */
+class PrintSink{
+public:
+
+    //This function is time critical!
+    static inline void write(unsigned int blockName, float time)
+    {
+        EasyPerformanceAnalyzer::printBlockTime(blockName, time);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//Storage policies
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Begin times of EZP_START blocks, kept in a map under a lock; needs a clock with Timespec stamps
+ *
+ * Forwards to the out-of-line openOnlineBlock() and closeOnlineBlock(), which lock at both ends of a block.
+ */
+class OnlineStorage{
+public:
+
+    //This function is time critical!
+    static inline Timespec* open(unsigned int blockName)
+    {
+        return EasyPerformanceAnalyzer::openOnlineBlock(blockName);
+    }
+
+    //This function is time critical!
+    static inline bool close(unsigned int blockName, const Timespec& end, const Timespec*& begin)
+    {
+        return EasyPerformanceAnalyzer::closeOnlineBlock(blockName, &end, &begin);
+    }
+
+    //This function is not time critical
+    static inline void missing(const char* blockName)
+    {
+        EasyPerformanceAnalyzer::reportMissingBlock(blockName, "EZP_START");
+    }
+
+    //This function is not time critical
+    static inline void write(FILE* file, EasyPerformanceAnalyzer::ReportFormat format)
+    {
+        (void)file;
+        (void)format;
+    }
+};
+
+/**
+ * @brief Offline analysis records of EZP_START_OFFLINE blocks with all their statistics, filters and reports; needs a
+ * clock with Timespec stamps, and all statistics other than times assume ThreadCpuClock
+ *
+ * Forwards to the out-of-line openOfflineBlock() and endOfflineBlock(), which lock offlineLock at both ends of a block.
+ */
+class OfflineStorage{
+public:
+
+    //This function is time critical!
+    static inline Timespec* open(unsigned int blockName)
+    {
+        return EasyPerformanceAnalyzer::openOfflineBlock(blockName);
+    }
+
+    //This function is time critical!
+    static inline bool close(unsigned int blockName, const Timespec& end, const Timespec*& begin)
+    {
+        return EasyPerformanceAnalyzer::endOfflineBlock(blockName, &end, &begin);
+    }
+
+    //This function is not time critical
+    static inline void missing(const char* blockName)
+    {
+        EasyPerformanceAnalyzer::reportMissingBlock(blockName, "EZP_START_OFFLINE");
+    }
+
+    //This function is not time critical
+    static inline void write(FILE* file, EasyPerformanceAnalyzer::ReportFormat format)
+    {
+        EasyPerformanceAnalyzer::writeOfflineProfiles(file, format);
+    }
+};
+
+/**
+ * @brief Times and numbers of runs in a flat, open-addressed table per thread, without locks
+ *
+ * Each thread writes only to its own table, which is never freed so that reports include threads that exited. There are
+ * no filters and no enabling: blocks are always recorded. Reports have times and numbers of runs only.
+ *
+ * @tparam Clock Clock policy whose units are accumulated
+ * @tparam N Number of blocks per thread, must be a power of 2; blocks that do not fit are not recorded
+ */
+template<class Clock, unsigned int N = 64>
+class FlatStorage{
+public:
+
+    typedef typename Clock::Stamp Stamp;
+
+    //This function is time critical!
+    static inline Stamp* open(unsigned int blockName)
+    {
+        Table* target = table;
+        if(target == NULL)
+            target = createTable();
+        Slot* slot = findSlot(target, blockName, true);
+        return slot != NULL ? &(slot->beginTime) : NULL;
+    }
+
+    //This function is time critical!
+    static inline bool close(unsigned int blockName, const Stamp& end, const Stamp*& begin)
+    {
+        Table* target = table;
+        Slot* slot = target != NULL ? findSlot(target, blockName, false) : NULL;
+        if(slot == NULL)
+            return false;
+
+        //Only this thread writes to the slot, relaxed stores are enough for reports to read it
+        __atomic_store_n(&(slot->numSamples), slot->numSamples + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&(slot->totalTime), slot->totalTime + Clock::elapsed(slot->beginTime, end), __ATOMIC_RELAXED);
+        begin = &(slot->beginTime);
+        return true;
+    }
+
+    //This function is not time critical
+    static inline void missing(const char* blockName)
+    {
+        EasyPerformanceAnalyzer::reportMissingBlock(blockName, "start");
+    }
+
+    //This function is not time critical
+    static void write(FILE* file, EasyPerformanceAnalyzer::ReportFormat format)
+    {
+        OfflineReport report;
+        for(Table* it = __atomic_load_n(&tables, __ATOMIC_ACQUIRE); it != NULL; it = it->next)
+            for(unsigned int i=0;i<N;i++){
+                if(!__atomic_load_n(&(it->slots[i].used), __ATOMIC_ACQUIRE))
+                    continue;
+                report.threadProfiles.push_back(AggregateProfile());
+                AggregateProfile& profile = report.threadProfiles.back();
+                profile.tid = it->tid;
+                profile.blockName = it->slots[i].blockName;
+                profile.numSamples = __atomic_load_n(&(it->slots[i].numSamples), __ATOMIC_RELAXED);
+                profile.totalTime = (unsigned long long)Clock::toNs(__atomic_load_n(&(it->slots[i].totalTime), __ATOMIC_RELAXED));
+            }
+        EasyPerformanceAnalyzer::writeExternalReport(report, file, format);
+    }
+
+private:
+
+    /**
+     * @brief Record of a block in a thread
+     */
+    struct Slot{
+        unsigned int blockName;         ///< Hash of the name of the block
+        bool used;                      ///< Whether this slot holds a block, published with release
+        Stamp beginTime;                ///< When the most recent run was started
+        int numSamples;                 ///< How many times this block was ran
+        unsigned long long totalTime;   ///< Total time in clock units this block took
+    };
+
+    /**
+     * @brief Records of a thread
+     */
+    struct Table{
+        TID tid;            ///< Thread ID of the owner
+        Table* next;        ///< Next table in the list of all tables
+        Slot slots[N];      ///< Records, indexed by hashed block name with linear probing
+    };
+
+    static __thread Table* table;   ///< Table of the calling thread, NULL until its first block
+    static Table* tables;           ///< List of all tables, tables are pushed to its head and never removed
+
+    /**
+     * @brief Creates the table of the calling thread and adds it to the list of all tables
+     *
+     * @return New table
+     */
+    //This function is not time critical, called once per thread
+    static Table* createTable()
+    {
+        Table* created = new Table();
+        created->tid = EasyPerformanceAnalyzer::registerExternalThread();
+        created->next = __atomic_load_n(&tables, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&tables, &(created->next), created, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        table = created;
+        return created;
+    }
+
+    /**
+     * @brief Finds the slot of a block in a table
+     *
+     * @param target Table of the calling thread
+     * @param blockName Hash of the name of the block
+     * @param insert Whether to take a free slot for the block if it has none
+     *
+     * @return Slot of the block, NULL if it has none and none could be taken
+     */
+    //This function is time critical!
+    static inline Slot* findSlot(Table* target, unsigned int blockName, bool insert)
+    {
+        unsigned int index = (blockName*2654435761u) & (N - 1);
+        for(unsigned int probe=0;probe<N;probe++){
+            Slot* slot = target->slots + ((index + probe) & (N - 1));
+            if(!slot->used){
+                if(!insert)
+                    return NULL;
+                slot->blockName = blockName;
+                __atomic_store_n(&(slot->used), true, __ATOMIC_RELEASE);
+                return slot;
+            }
+            if(slot->blockName == blockName)
+                return slot;
+        }
+        return NULL;
+    }
+};
+
+template<class Clock, unsigned int N>
+__thread typename FlatStorage<Clock, N>::Table* FlatStorage<Clock, N>::table = NULL;
+
+template<class Clock, unsigned int N>
+typename FlatStorage<Clock, N>::Table* FlatStorage<Clock, N>::tables = NULL;
+
+///////////////////////////////////////////////////////////////////////////////
+//Analyzer core
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Analysis blocks measured with Clock, kept in Storage and whose runs go to Sink
+ *
+ * All calls are inlined into the instrumented code, e.g
+ * BasicAnalyzer<TscClock, FlatStorage<TscClock>, NullSink> reads the counter and updates a thread-local slot only.
+ */
+template<class Clock, class Storage, class Sink>
+class BasicAnalyzer{
+public:
+
+    typedef typename Clock::Stamp Stamp;
+
+    /**
+     * @brief Starts a block
+     *
+     * @param blockName Name of the block, max 4 characters
+     */
+    //This function is time critical!
+    static inline void start(const char* blockName = "NDEF")
+    {
+        Stamp* begin = Storage::open(EasyPerformanceAnalyzer::hashStr(blockName));
+
+        //Get time in the very end to disturb the measurements the least possible
+        if(begin != NULL)
+            Clock::now(*begin);
+    }
+
+    /**
+     * @brief Ends a block, it must have been started before in the same thread
+     *
+     * @param blockName Name of the block, max 4 characters
+     */
+    //This function is time critical!
+    static inline void end(const char* blockName = "NDEF")
+    {
+        Stamp end;
+        Clock::now(end);
+
+        unsigned int name = EasyPerformanceAnalyzer::hashStr(blockName);
+        const Stamp* begin = NULL;
+        if(!Storage::close(name, end, begin))
+            Storage::missing(blockName);
+        else if(begin != NULL)
+            Sink::write(name, (float)(Clock::toNs(Clock::elapsed(*begin, end))/1000000.0));
+    }
+
+    /**
+     * @brief Writes the records of all blocks
+     *
+     * @param file File to write to
+     * @param format Format of the report
+     */
+    //This function is not time critical
+    static void write(FILE* file, EasyPerformanceAnalyzer::ReportFormat format)
+    {
+        Storage::write(file, format);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//Benchmark runner
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Right operand of the comma after a benchmarked call, see Benchmark
+ */
+typedef struct ResultSink_t{} ResultSink;
+
+/**
+ * @brief Forces the result of a benchmarked call into memory so that the compiler cannot drop the call
+ *
+ * Calls returning void use the built-in comma instead.
+ *
+ * @param value Result of the call
+ */
+template<class T>
+inline ResultSink operator,(const T& value, ResultSink sink)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+    return sink;
+}
+
+/**
+ * @brief Runs EZP_BENCH benchmarks timed with Clock
+ *
+ * Only reading the clock and the calls themselves are in the timed loop, everything else happens between batches.
+ * The result of each call and the memory it wrote are treated as used, so calls without side effects are not optimized away.
+ */
+template<class Clock>
+class Benchmark{
+public:
+
+    typedef typename Clock::Stamp Stamp;
+
+    /**
+     * @brief Benchmarks a function, see EZP_BENCH
+     *
+     * @param blockName Name of the benchmark, max 4 characters
+     * @param function Function or functor called without arguments
+     *
+     * @return Outcome of the benchmark
+     */
+    //This function is not time critical, its timed loop is
+    template<class Function>
+    static BenchResult run(const char* blockName, Function function)
+    {
+        //The overhead of timing a batch is that of an empty one, the least of many so that preemption does not inflate it
+        Stamp begin, end;
+        unsigned long long overhead = ULLONG_MAX;
+        for(int i=0;i<1000;i++){
+            Clock::now(begin);
+            Clock::now(end);
+            overhead = std::min(overhead, Clock::elapsed(begin, end));
+        }
+
+        BenchState bench;
+        ResultSink sink;
+        EasyPerformanceAnalyzer::beginBenchmark(bench, blockName, Clock::toNs(overhead));
+        do{
+            unsigned long long batch = bench.result.batch;
+            Clock::now(begin);
+            for(unsigned long long i=0;i<batch;i++){
+                (void)(function(), sink);
+                asm volatile("" : : : "memory");
+            }
+            Clock::now(end);
+        }while(EasyPerformanceAnalyzer::addBenchmarkSample(bench, Clock::toNs(Clock::elapsed(begin, end))));
+        EasyPerformanceAnalyzer::endBenchmark(bench);
+        return bench.result;
+    }
+};
+
+/**
+ * @brief Analyzer of EZP_START/EZP_END blocks
+ */
+typedef BasicAnalyzer<ThreadCpuClock, OnlineStorage, PrintSink> OnlineAnalyzer;
+
+/**
+ * @brief Analyzer of EZP_START_OFFLINE/EZP_END_OFFLINE blocks
+ */
+typedef BasicAnalyzer<ThreadCpuClock, OfflineStorage, NullSink> OfflineAnalyzer;
+
+//This function is time critical!
+inline unsigned int EasyPerformanceAnalyzer::hashStr(const char* str)
+{
+    unsigned int result = 0;
+
+    result += str[0];
+    if(str[1] == '\0')
+        return result << 24;
+    result = result << 8;
+
+    result += str[1];
+    if(str[2] == '\0')
+        return result << 16;
+    result = result << 8;
+
+    result += str[2];
+    if(str[3] == '\0')
+        return result << 8;
+    result = result << 8;
+
+    result += str[3];
+    if(str[4] != '\0')
+        warnLongBlockName(str);
+    return result;
+}
+
+} /* namespace ezp */
+
+#endif /* EZP_CORE_HPP */
@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_critical.cpp
+ * @brief Computes block concurrency, thread utilisation and the critical paths of requests over EZP recordings in one pass
+ * @date 2026-10-18
+ */
+
+#include<algorithm>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<map>
+#include<set>
+#include<string>
+#include<vector>
+#include<getopt.h>
+
+#include"ezp.hpp"
+
+using namespace std;
+
+void printHelp(bool desc){
+    cout << "Usage: ezp_critical [OPTION] RECORDING" << endl;
+    if(desc){
+        cout << "Reads a recording written by EZP_BEGIN_RECORDING or ezp_control -R once, in time order," << endl;
+        cout << "and reports how many threads were inside each block at once, how busy the threads were" << endl;
+        cout << "over time and the critical path of each request tagged with EZP_SET_REQUEST_ID." << endl;
+    }
+    cout << endl;
+    cout << "  -n, --bins=N         Splits the recording into N time bins for utilisation, 20 by default" << endl;
+    cout << "  -g, --gap=MS         Considers a request complete once none of its blocks ended for MS ms," << endl;
+    cout << "                       1000 by default" << endl;
+    cout << "  -k, --slowest=K      Prints the critical paths of the K slowest requests, 5 by default" << endl;
+    cout << "  -o, --output=PATH    Writes utilisation, concurrency and the slowest critical paths to PATH" << endl;
+    cout << "                       as a Chrome trace event file" << endl;
+    cout << "  -h, --help           Displays this message" << endl;
+}
+
+/**
+ * @brief Writes a string as a JSON string
+ */
+void writeJSONString(FILE* file, const string& str){
+    fputc('"', file);
+    for(string::const_iterator it = str.begin(); it != str.end(); it++)
+        if(*it == '"' || *it == '\\')
+            fprintf(file, "\\%c", *it);
+        else if((unsigned char)*it < 0x20)
+            fprintf(file, "\\u%04x", *it);
+        else
+            fputc(*it, file);
+    fputc('"', file);
+}
+
+/**
+ * @brief Concurrency of one block over the recording
+ */
+struct BlockConcurrency{
+    unsigned long long calls;       ///< Number of times the block ended
+    set<int> threads;               ///< Threads that ran the block
+    unsigned int inside;            ///< Number of threads inside the block right now
+    unsigned int maxInside;         ///< Most threads ever inside the block at once
+    unsigned long long lastChange;  ///< When inside last changed in ns
+    unsigned long long activeTime;  ///< Time in ns during which at least one thread was inside the block
+    unsigned long long busyTime;    ///< Sum over threads of the time in ns they were inside the block
+    unsigned long long pathTime;    ///< Time in ns that the block spent on critical paths
+    unsigned long long pathCalls;   ///< Number of times the block was on a critical path
+    vector<double> bins;            ///< Thread time in ns inside the block in each time bin
+
+    BlockConcurrency() : calls(0), inside(0), maxInside(0), lastChange(0), activeTime(0), busyTime(0), pathTime(0), pathCalls(0){}
+};
+
+/**
+ * @brief Blocks of a request that may still get more blocks
+ */
+struct Request{
+    vector<ezp::RecordedBlock> blocks;  ///< Ended blocks of the request
+    unsigned long long lastEnd;         ///< Latest end of its blocks in ns
+};
+
+/**
+ * @brief Critical path of a complete request
+ */
+struct CriticalPath{
+    unsigned long long request;         ///< Request ID
+    unsigned long long begin;           ///< Earliest beginning of the blocks of the request in ns
+    unsigned long long end;             ///< Latest end of the blocks of the request in ns
+    unsigned long long wait;            ///< Time in ns on the path between one block and the next
+    vector<ezp::RecordedBlock> path;    ///< Blocks on the critical path in time order
+};
+
+/**
+ * @brief State of the analysis while the recording streams by
+ */
+struct Analysis{
+    const ezp::Recording* recording;                    ///< Recording, without blocks
+    double binWidth;                                    ///< Width of a time bin in ns
+    unsigned long long gap;                             ///< Idle time in ns after which a request is complete
+    size_t numSlowest;                                  ///< Number of slowest critical paths to keep
+
+    map<unsigned int, BlockConcurrency> blocks;         ///< Concurrency of each block
+    map<pair<unsigned int, int>, unsigned int> depths;  ///< Nesting depth of each block in each thread, while nonzero
+    map<int, unsigned int> threadDepths;                ///< Number of blocks open in each thread, while nonzero
+    unsigned int busyThreads;                           ///< Number of threads inside any block right now
+    unsigned long long lastBusyChange;                  ///< When busyThreads last changed in ns
+    vector<double> busyBins;                            ///< Thread time in ns inside any block in each time bin
+
+    map<unsigned long long, Request> requests;          ///< Requests that may still get more blocks
+    unsigned long long nextSweep;                       ///< When to look for complete requests next in ns
+    unsigned long long numRequests;                     ///< Number of complete requests
+    unsigned long long totalLatency;                    ///< Sum of the latencies of complete requests in ns
+    unsigned long long totalPath;                       ///< Sum of the critical path block times of complete requests in ns
+    multimap<unsigned long long, CriticalPath> slowest; ///< Slowest critical paths on their latencies
+
+    unsigned long long numBlocks;                       ///< Number of ended blocks
+};
+
+/**
+ * @brief Spreads a constant number of threads over the time bins of an interval
+ *
+ * @param bins Time bins
+ * @param width Width of a bin in ns
+ * @param from Beginning of the interval in ns
+ * @param to End of the interval in ns
+ * @param threads Number of threads during the interval
+ */
+void addToBins(vector<double>& bins, double width, unsigned long long from, unsigned long long to, unsigned int threads){
+    if(threads == 0 || to <= from)
+        return;
+    size_t last = bins.size() - 1;
+    for(size_t bin = min((size_t)(from/width), last); bin <= last; bin++){
+        double binBegin = max(bin*width, (double)from);
+        double binEnd = bin == last ? (double)to : min((bin + 1)*width, (double)to);
+        if(binEnd > binBegin)
+            bins[bin] += (binEnd - binBegin)*threads;
+        if(binEnd >= to)
+            break;
+    }
+}
+
+/**
+ * @brief Computes the critical path of a complete request and folds it into the analysis
+ *
+ * Only the outermost blocks of the request in each thread count. The path begins with the block that ended last and
+ * walks back, each time to the block that ended last before the current one began, i.e the one it waited for.
+ */
+void completeRequest(Analysis& analysis, unsigned long long id, Request& request){
+    vector<ezp::RecordedBlock>& blocks = request.blocks;
+    sort(blocks.begin(), blocks.end(), ezp::RecordedBlock::compareBegin);
+    map<int, unsigned long long> outerEnds;
+    vector<ezp::RecordedBlock> outer;
+    CriticalPath path;
+    path.request = id;
+    path.begin = blocks[0].begin;
+    path.end = 0;
+    path.wait = 0;
+    for(vector<ezp::RecordedBlock>::const_iterator it = blocks.begin(); it != blocks.end(); it++){
+        path.end = max(path.end, it->end);
+        map<int, unsigned long long>::iterator outerEnd = outerEnds.find(it->tid);
+        if(outerEnd != outerEnds.end() && it->end <= outerEnd->second)
+            continue;
+        outerEnds[it->tid] = it->end;
+        outer.push_back(*it);
+    }
+
+    //Sorted on end, the block that ended last before time t is the last one before the upper bound of t
+    vector<pair<unsigned long long, size_t> > ends;
+    for(size_t i=0;i<outer.size();i++)
+        ends.push_back(make_pair(outer[i].end, i));
+    sort(ends.begin(), ends.end());
+    size_t current = ends.size() - 1;
+    while(true){
+        const ezp::RecordedBlock& block = outer[ends[current].second];
+        path.path.push_back(block);
+        size_t previous = upper_bound(ends.begin(), ends.begin() + current, make_pair(block.begin, outer.size())) - ends.begin();
+        if(previous == 0)
+            break;
+        current = previous - 1;
+        path.wait += block.begin - ends[current].first;
+    }
+    reverse(path.path.begin(), path.path.end());
+
+    analysis.numRequests++;
+    analysis.totalLatency += path.end - path.begin;
+    for(vector<ezp::RecordedBlock>::const_iterator it = path.path.begin(); it != path.path.end(); it++){
+        BlockConcurrency& concurrency = analysis.blocks[it->blockName];
+        concurrency.pathTime += it->end - it->begin;
+        concurrency.pathCalls++;
+        analysis.totalPath += it->end - it->begin;
+    }
+    if(analysis.numSlowest > 0 && (analysis.slowest.size() < analysis.numSlowest || path.end - path.begin > analysis.slowest.begin()->first)){
+        analysis.slowest.insert(make_pair(path.end - path.begin, path));
+        if(analysis.slowest.size() > analysis.numSlowest)
+            analysis.slowest.erase(analysis.slowest.begin());
+    }
+}
+
+/**
+ * @brief Completes the requests that got no block for the gap, or all requests
+ */
+void completeRequests(Analysis& analysis, unsigned long long now, bool all){
+    for(map<unsigned long long, Request>::iterator it = analysis.requests.begin(); it != analysis.requests.end();)
+        if(all || it->second.lastEnd + analysis.gap < now){
+            completeRequest(analysis, it->first, it->second);
+            analysis.requests.erase(it++);
+        }
+        else
+            it++;
+    analysis.nextSweep = now + analysis.gap/2 + 1;
+}
+
+/**
+ * @brief Folds the beginning or the end of a block into the analysis, called by streamRecording() in time order
+ */
+void visitBlock(const ezp::RecordedBlock& block, bool begin, void* arg){
+    Analysis& analysis = *(Analysis*)arg;
+    unsigned long long now = begin ? block.begin : block.end;
+    if(analysis.binWidth == 0.0)
+        analysis.binWidth = max((double)analysis.recording->duration/analysis.busyBins.size(), 1.0);
+
+    //Concurrency counts threads, a block nested in itself counts once
+    BlockConcurrency& concurrency = analysis.blocks[block.blockName];
+    if(concurrency.bins.empty())
+        concurrency.bins.resize(analysis.busyBins.size(), 0.0);
+    unsigned int& depth = analysis.depths[make_pair(block.blockName, block.tid)];
+    if(begin ? depth++ == 0 : depth > 0 && --depth == 0){
+        concurrency.busyTime += concurrency.inside*(now - concurrency.lastChange);
+        if(concurrency.inside > 0)
+            concurrency.activeTime += now - concurrency.lastChange;
+        addToBins(concurrency.bins, analysis.binWidth, concurrency.lastChange, now, concurrency.inside);
+        concurrency.inside += begin ? 1 : -1;
+        concurrency.maxInside = max(concurrency.maxInside, concurrency.inside);
+        concurrency.lastChange = now;
+    }
+    if(depth == 0)
+        analysis.depths.erase(make_pair(block.blockName, block.tid));
+
+    unsigned int& threadDepth = analysis.threadDepths[block.tid];
+    if(begin ? threadDepth++ == 0 : threadDepth > 0 && --threadDepth == 0){
+        addToBins(analysis.busyBins, analysis.binWidth, analysis.lastBusyChange, now, analysis.busyThreads);
+        analysis.busyThreads += begin ? 1 : -1;
+        analysis.lastBusyChange = now;
+    }
+    if(threadDepth == 0)
+        analysis.threadDepths.erase(block.tid);
+
+    if(begin)
+        return;
+    analysis.numBlocks++;
+    concurrency.calls++;
+    concurrency.threads.insert(block.tid);
+    if(block.request != 0){
+        Request& request = analysis.requests[block.request];
+        request.blocks.push_back(block);
+        request.lastEnd = block.end;
+    }
+    if(now >= analysis.nextSweep)
+        completeRequests(analysis, now, false);
+}
+
+/**
+ * @brief Writes utilisation, concurrency and the slowest critical paths as a Chrome trace event file
+ */
+void writeTrace(FILE* file, const Analysis& analysis, const map<int, string>& threadNames){
+    const ezp::Recording& recording = *analysis.recording;
+    fprintf(file, "{\"otherData\":{\"clock\":\"wall clock\",\"durationNs\":%llu},\n\"traceEvents\":[", recording.duration);
+    fprintf(file, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"ezp_critical\"}}", recording.pid);
+
+    //Counters hold their value until the next sample, the trailing one brings them back to 0
+    for(size_t bin=0;bin<=analysis.busyBins.size();bin++){
+        double ts = bin*analysis.binWidth/1000.0;
+        double busy = bin < analysis.busyBins.size() ? analysis.busyBins[bin]/analysis.binWidth : 0.0;
+        fprintf(file, ",\n{\"name\":\"busy threads\",\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"args\":{\"threads\":%.3f}}", recording.pid, ts, busy);
+        for(map<unsigned int, BlockConcurrency>::const_iterator it = analysis.blocks.begin(); it != analysis.blocks.end(); it++){
+            fprintf(file, ",\n{\"name\":");
+            writeJSONString(file, recording.labels.find(it->first)->second + " threads");
+            fprintf(file, ",\"ph\":\"C\",\"pid\":%u,\"ts\":%.3f,\"args\":{\"threads\":%.3f}}", recording.pid, ts,
+                    bin < it->second.bins.size() ? it->second.bins[bin]/analysis.binWidth : 0.0);
+        }
+    }
+
+    //Each slowest request gets a track of its critical path, with the waits between blocks
+    int track = 0;
+    for(multimap<unsigned long long, CriticalPath>::const_reverse_iterator it = analysis.slowest.rbegin(); it != analysis.slowest.rend(); it++){
+        track++;
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%d,\"args\":{\"name\":\"request %llu\"}}",
+                recording.pid, -track, it->second.request);
+        unsigned long long previousEnd = it->second.path[0].begin;
+        for(vector<ezp::RecordedBlock>::const_iterator block = it->second.path.begin(); block != it->second.path.end(); block++){
+            if(block->begin > previousEnd)
+                fprintf(file, ",\n{\"name\":\"waiting\",\"ph\":\"X\",\"pid\":%u,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        recording.pid, -track, previousEnd/1000.0, (block->begin - previousEnd)/1000.0);
+            fprintf(file, ",\n{\"name\":");
+            writeJSONString(file, recording.labels.find(block->blockName)->second);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":%u,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"tid\":%d,\"thread\":",
+                    recording.pid, -track, block->begin/1000.0, (block->end - block->begin)/1000.0, block->tid);
+            map<int, string>::const_iterator name = threadNames.find(block->tid);
+            writeJSONString(file, name != threadNames.end() ? name->second : "");
+            fprintf(file, ",\"cpuNs\":%llu}}", block->cpuTime);
+            previousEnd = block->end;
+        }
+    }
+    fprintf(file, "\n]}\n");
+}
+
+/**
+ * @brief Compares blocks on their busy time, busiest first
+ */
+bool compareBusy(const pair<unsigned int, const BlockConcurrency*>& one, const pair<unsigned int, const BlockConcurrency*>& two){
+    return one.second->busyTime > two.second->busyTime;
+}
+
+/**
+ * @brief Compares blocks on their time on critical paths, longest first
+ */
+bool comparePath(const pair<unsigned int, const BlockConcurrency*>& one, const pair<unsigned int, const BlockConcurrency*>& two){
+    return one.second->pathTime > two.second->pathTime;
+}
+
+int main(int argc, char** argv){
+    struct option options[] = {
+        {"bins",    required_argument,  NULL,   'n'},
+        {"gap",     required_argument,  NULL,   'g'},
+        {"slowest", required_argument,  NULL,   'k'},
+        {"output",  required_argument,  NULL,   'o'},
+        {"help",    no_argument,        NULL,   'h'},
+        {NULL,      0,                  NULL,   0}
+    };
+
+    int numBins = 20;
+    double gap = 1000.0;
+    int numSlowest = 5;
+    const char* output = NULL;
+
+    int i = 0;
+    int c;
+    while((c = getopt_long(argc, argv, "n:g:k:o:h", options, &i)) != -1)
+        switch(c){
+            case 'n':
+                numBins = atoi(optarg);
+                if(numBins <= 0){
+                    cerr << "EZP: Number of bins must be positive" << endl;
+                    return -1;
+                }
+                break;
+            case 'g':
+                gap = atof(optarg);
+                break;
+            case 'k':
+                numSlowest = max(atoi(optarg), 0);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+                printHelp(true);
+                return 0;
+            default:
+                printHelp(false);
+                return -1;
+        }
+    if(optind != argc - 1){
+        printHelp(false);
+        return -1;
+    }
+
+    //streamRecording() fills the recording before the first visit, the bins are sized there
+    ezp::Recording recording;
+    Analysis analysis;
+    analysis.recording = &recording;
+    analysis.binWidth = 0.0;
+    analysis.gap = (unsigned long long)(max(gap, 0.0)*1000000.0);
+    analysis.numSlowest = numSlowest;
+    analysis.busyThreads = 0;
+    analysis.lastBusyChange = 0;
+    analysis.busyBins.resize(numBins, 0.0);
+    analysis.nextSweep = 0;
+    analysis.numRequests = 0;
+    analysis.totalLatency = 0;
+    analysis.totalPath = 0;
+    analysis.numBlocks = 0;
+    if(!ezp::EasyPerformanceAnalyzer::streamRecording(argv[optind], visitBlock, &analysis, recording))
+        return -1;
+    analysis.binWidth = max((double)recording.duration/numBins, 1.0);
+    completeRequests(analysis, recording.duration, true);
+
+    map<int, string> threadNames;
+    for(vector<ezp::RecordChunk>::const_iterator it = recording.chunks.begin(); it != recording.chunks.end(); it++)
+        threadNames[it->tid] = string(it->threadName, strnlen(it->threadName, sizeof(it->threadName)));
+
+    printf("Process %u, %.3f ms, %u threads, %llu blocks\n", recording.pid, recording.duration/1000000.0,
+            (unsigned int)threadNames.size(), analysis.numBlocks);
+
+    //Concurrency, busiest blocks first
+    vector<pair<unsigned int, const BlockConcurrency*> > blocks;
+    for(map<unsigned int, BlockConcurrency>::const_iterator it = analysis.blocks.begin(); it != analysis.blocks.end(); it++)
+        blocks.push_back(make_pair(it->first, &it->second));
+    sort(blocks.begin(), blocks.end(), compareBusy);
+    printf("\nConcurrency: threads inside each block at once while any is\n");
+    printf("%-24s%-12s%-10s%-14s%-14s%-10s%-10s\n", "Name", "Calls", "Threads", "Active(ms)", "Busy(ms)", "Mean", "Max");
+    for(vector<pair<unsigned int, const BlockConcurrency*> >::const_iterator it = blocks.begin(); it != blocks.end(); it++)
+        printf("%-24s%-12llu%-10u%-14.3f%-14.3f%-10.2f%-10u\n", recording.labels[it->first].c_str(), it->second->calls,
+                (unsigned int)it->second->threads.size(), it->second->activeTime/1000000.0, it->second->busyTime/1000000.0,
+                it->second->activeTime > 0 ? (double)it->second->busyTime/it->second->activeTime : 0.0, it->second->maxInside);
+
+    //Utilisation, the share of the threads of the recording that were inside any block
+    printf("\nUtilisation over %d bins of %.3f ms\n", numBins, analysis.binWidth/1000000.0);
+    printf("%-14s%-14s%-14s%-14s\n", "From(ms)", "To(ms)", "Busy threads", "Utilisation");
+    for(int bin=0;bin<numBins;bin++){
+        double busy = analysis.busyBins[bin]/analysis.binWidth;
+        double utilisation = threadNames.empty() ? 0.0 : busy/threadNames.size();
+        printf("%-14.3f%-14.3f%-14.2f%5.1f%% %s\n", bin*analysis.binWidth/1000000.0, (bin + 1)*analysis.binWidth/1000000.0, busy,
+                utilisation*100.0, string((size_t)(utilisation*20.0 + 0.5), '#').c_str());
+    }
+
+    //Critical paths
+    if(analysis.numRequests > 0){
+        sort(blocks.begin(), blocks.end(), comparePath);
+        printf("\nCritical paths of %llu requests, %.3f ms mean latency, %.3f ms mean on blocks\n", analysis.numRequests,
+                analysis.totalLatency/1000000.0/analysis.numRequests, analysis.totalPath/1000000.0/analysis.numRequests);
+        printf("%-24s%-14s%-10s%-14s\n", "Name", "On path(ms)", "Share", "Times on path");
+        for(vector<pair<unsigned int, const BlockConcurrency*> >::const_iterator it = blocks.begin(); it != blocks.end(); it++)
+            if(it->second->pathCalls > 0)
+                printf("%-24s%-14.3f%5.1f%%    %-14llu\n", recording.labels[it->first].c_str(), it->second->pathTime/1000000.0,
+                        100.0*it->second->pathTime/analysis.totalLatency, it->second->pathCalls);
+
+        for(multimap<unsigned long long, CriticalPath>::const_reverse_iterator it = analysis.slowest.rbegin(); it != analysis.slowest.rend(); it++){
+            printf("\nRequest %llu: %.3f ms, %u blocks on the critical path, %.3f ms waiting between them\n", it->second.request,
+                    it->first/1000000.0, (unsigned int)it->second.path.size(), it->second.wait/1000000.0);
+            printf("  %-14s%-14s%-16s%-10s%-24s\n", "Begin(ms)", "Length(ms)", "Thread", "TID", "Name");
+            for(vector<ezp::RecordedBlock>::const_iterator block = it->second.path.begin(); block != it->second.path.end(); block++)
+                printf("  %-14.3f%-14.3f%-16s%-10d%-24s\n", block->begin/1000000.0, (block->end - block->begin)/1000000.0,
+                        threadNames[block->tid].c_str(), block->tid, recording.labels[block->blockName].c_str());
+        }
+    }
+    else
+        printf("\nNo request IDs in the recording, tag blocks with EZP_SET_REQUEST_ID for critical paths\n");
+
+    if(output != NULL){
+        FILE* file = fopen(output, "w");
+        if(file == NULL){
+            cerr << "EZP: Could not open " << output << ": " << strerror(errno) << endl;
+            return -1;
+        }
+        writeTrace(file, analysis, threadNames);
+        fclose(file);
+    }
+    return 0;
+}
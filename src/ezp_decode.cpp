@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_decode.cpp
+ * @brief Decodes EZP recordings into Chrome trace event files or CSV
+ * @date 2026-10-18
+ */
+
+#include<climits>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<map>
+#include<string>
+#include<getopt.h>
+#include<unistd.h>
+
+#include"ezp.hpp"
+
+using namespace std;
+
+void printHelp(bool desc){
+    cout << "Usage: ezp_decode [OPTION] RECORDING" << endl;
+    if(desc)
+        cout << "Decodes a recording written by EZP_BEGIN_RECORDING or ezp_control -R." << endl;
+    cout << endl;
+    cout << "  -l, --list           Lists the chunks of the recording instead of its blocks" << endl;
+    cout << "  -b, --begin=MS       Skips blocks that end before MS ms into the recording" << endl;
+    cout << "  -e, --end=MS         Skips blocks that begin after MS ms into the recording" << endl;
+    cout << "  -j, --jobs=N         Decodes N chunks at once, N >= 1, the number of CPUs by default" << endl;
+    cout << "  -f, --format=FORMAT  chrome for a Chrome trace event file (default) or csv" << endl;
+    cout << "  -o, --output=PATH    Writes to PATH instead of stdout" << endl;
+    cout << "  -h, --help           Displays this message" << endl;
+}
+
+/**
+ * @brief Writes a string as a JSON string
+ */
+void writeJSONString(FILE* file, const string& str){
+    fputc('"', file);
+    for(string::const_iterator it = str.begin(); it != str.end(); it++)
+        if(*it == '"' || *it == '\\')
+            fprintf(file, "\\%c", *it);
+        else if((unsigned char)*it < 0x20)
+            fprintf(file, "\\u%04x", *it);
+        else
+            fputc(*it, file);
+    fputc('"', file);
+}
+
+int main(int argc, char** argv){
+    struct option options[] = {
+        {"list",    no_argument,        NULL,   'l'},
+        {"begin",   required_argument,  NULL,   'b'},
+        {"end",     required_argument,  NULL,   'e'},
+        {"jobs",    required_argument,  NULL,   'j'},
+        {"format",  required_argument,  NULL,   'f'},
+        {"output",  required_argument,  NULL,   'o'},
+        {"help",    no_argument,        NULL,   'h'},
+        {NULL,      0,                  NULL,   0}
+    };
+
+    bool list = false;
+    unsigned long long from = 0;
+    unsigned long long to = ULLONG_MAX;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool csv = false;
+    const char* output = NULL;
+
+    int i = 0;
+    int c;
+    while((c = getopt_long(argc, argv, "lb:e:j:f:o:h", options, &i)) != -1)
+        switch(c){
+            case 'l':
+                list = true;
+                break;
+            case 'b':
+                from = (unsigned long long)(atof(optarg)*1000000.0);
+                break;
+            case 'e':
+                to = (unsigned long long)(atof(optarg)*1000000.0);
+                break;
+            case 'j':{
+                char* end;
+                long value = strtol(optarg, &end, 10);
+                if(*optarg == '\0' || *end != '\0' || value < 1 || value > INT_MAX){
+                    cerr << "EZP: Invalid number of jobs " << optarg << endl;
+                    return -1;
+                }
+                jobs = value;
+                break;
+            }
+            case 'f':
+                if(strcmp(optarg, "chrome") == 0)
+                    csv = false;
+                else if(strcmp(optarg, "csv") == 0)
+                    csv = true;
+                else{
+                    cerr << "EZP: Unknown format " << optarg << endl;
+                    return -1;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+                printHelp(true);
+                return 0;
+            default:
+                printHelp(false);
+                return -1;
+        }
+    if(optind != argc - 1){
+        printHelp(false);
+        return -1;
+    }
+
+    //Listing needs the index only, a time range that ends before it begins decodes no chunk
+    ezp::Recording recording;
+    if(!ezp::EasyPerformanceAnalyzer::readRecording(argv[optind], list ? ULLONG_MAX : from, list ? 0 : to, jobs, recording))
+        return -1;
+
+    FILE* file = stdout;
+    if(output != NULL && (file = fopen(output, "w")) == NULL){
+        cerr << "EZP: Could not open " << output << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    if(list){
+        fprintf(file, "Process %u, %.3f ms, %u chunks\n", recording.pid, recording.duration/1000000.0, (unsigned int)recording.chunks.size());
+        fprintf(file, "%-12s%-10s%-16s%-10s%-10s%-10s%-14s%-14s\n", "Offset", "Bytes", "Thread", "TID", "Blocks", "B/block", "First(ms)", "Last(ms)");
+        for(vector<ezp::RecordChunk>::const_iterator it = recording.chunks.begin(); it != recording.chunks.end(); it++){
+            char name[EZP_THREAD_NAME_LENGTH + 1];
+            snprintf(name, sizeof(name), "%s", it->threadName);
+            fprintf(file, "%-12llu%-10u%-16s%-10d%-10u%-10.2f%-14.3f%-14.3f\n", it->offset, it->size, name, it->tid, it->numEvents,
+                    it->numEvents > 0 ? (double)it->size/it->numEvents : 0.0, (long long)(it->firstBegin - recording.beginTime)/1000000.0,
+                    (it->lastEnd - recording.beginTime)/1000000.0);
+        }
+    }
+    else if(csv){
+        fprintf(file, "tid,thread,block,begin_ns,end_ns,cpu_ns\n");
+        map<int, string> threadNames;
+        for(vector<ezp::RecordChunk>::const_iterator it = recording.chunks.begin(); it != recording.chunks.end(); it++)
+            threadNames[it->tid] = string(it->threadName, strnlen(it->threadName, sizeof(it->threadName)));
+        for(vector<ezp::RecordedBlock>::const_iterator it = recording.blocks.begin(); it != recording.blocks.end(); it++)
+            fprintf(file, "%d,\"%s\",\"%s\",%llu,%llu,%llu\n", it->tid, threadNames[it->tid].c_str(), recording.labels[it->blockName].c_str(),
+                    it->begin, it->end, it->cpuTime);
+    }
+    else{
+        //Chrome trace event format, timestamps are in us since the beginning of the recording
+        fprintf(file, "{\"otherData\":{\"clock\":\"wall clock\",\"durationNs\":%llu},\n\"traceEvents\":[", recording.duration);
+        bool first = true;
+        map<int, bool> namedThreads;
+        for(vector<ezp::RecordChunk>::const_iterator it = recording.chunks.begin(); it != recording.chunks.end(); it++){
+            if(namedThreads[it->tid])
+                continue;
+            namedThreads[it->tid] = true;
+            fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",",
+                    recording.pid, it->tid);
+            writeJSONString(file, string(it->threadName, strnlen(it->threadName, sizeof(it->threadName))));
+            fprintf(file, "}}");
+            first = false;
+        }
+        for(vector<ezp::RecordedBlock>::const_iterator it = recording.blocks.begin(); it != recording.blocks.end(); it++){
+            fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+            writeJSONString(file, recording.labels[it->blockName]);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":%u,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpuNs\":%llu}}",
+                    recording.pid, it->tid, it->begin/1000.0, (it->end - it->begin)/1000.0, it->cpuTime);
+            first = false;
+        }
+        fprintf(file, "\n]}\n");
+    }
+
+    if(file != stdout)
+        fclose(file);
+    return 0;
+}
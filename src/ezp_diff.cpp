@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_diff.cpp
+ * @brief Compares two saved offline analysis snapshots and detects regressions
+ * @version 1.0
+ * @date 2026-10-18
+ */
+
+#include<cctype>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<map>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<getopt.h>
+
+using namespace std;
+
+/**
+ * @brief Summed results of one block as loaded from a snapshot
+ */
+struct BlockStats{
+    double calls;               ///< Number of runs
+    double totalTime;           ///< Total time in nanoseconds
+    vector<double> histogram;   ///< Number of runs in each duration bucket
+
+    BlockStats(){
+        calls = 0;
+        totalTime = 0;
+    }
+
+    double average() const{
+        return calls == 0 ? 0 : totalTime/calls;
+    }
+};
+
+typedef map<string, BlockStats> Snapshot;
+
+/**
+ * @brief Minimal parser for the JSON reports written by EZP_WRITE_OFFLINE(..., JSON)
+ */
+class JSONReader{
+public:
+
+    JSONReader(const string& text_) : text(text_), pos(0), ok(true){}
+
+    /**
+     * @brief Reads the summed profiles of a report into a snapshot
+     *
+     * @param snapshot Snapshot to fill
+     *
+     * @return Whether the report was well formed
+     */
+    bool readReport(Snapshot& snapshot){
+        if(!expect('{'))
+            return false;
+        while(ok && peek() != '}'){
+            string key = readString();
+            expect(':');
+            if(key == "summed")
+                readSummed(snapshot);
+            else
+                skipValue();
+            if(peek() == ',')
+                pos++;
+        }
+        expect('}');
+        return ok;
+    }
+
+private:
+
+    const string& text; ///< Whole document
+    size_t pos;         ///< Current position in the document
+    bool ok;            ///< Whether no error was encountered yet
+
+    char peek(){
+        while(pos < text.size() && isspace(text[pos]))
+            pos++;
+        if(pos >= text.size()){
+            ok = false;
+            return '\0';
+        }
+        return text[pos];
+    }
+
+    bool expect(char c){
+        if(peek() != c)
+            ok = false;
+        else
+            pos++;
+        return ok;
+    }
+
+    string readString(){
+        string result;
+        if(!expect('"'))
+            return result;
+        while(pos < text.size() && text[pos] != '"'){
+            if(text[pos] == '\\' && pos + 1 < text.size()){
+                pos++;
+                if(text[pos] == 'u' && pos + 4 < text.size()){
+                    result += (char)strtol(text.substr(pos + 1, 4).c_str(), NULL, 16);
+                    pos += 4;
+                }
+                else if(text[pos] == 'n')
+                    result += '\n';
+                else
+                    result += text[pos];
+            }
+            else
+                result += text[pos];
+            pos++;
+        }
+        expect('"');
+        return result;
+    }
+
+    double readNumber(){
+        peek();
+        const char* begin = text.c_str() + pos;
+        char* end;
+        double result = strtod(begin, &end);
+        if(end == begin)
+            ok = false;
+        pos += end - begin;
+        return result;
+    }
+
+    void skipValue(){
+        char c = peek();
+        if(c == '"')
+            readString();
+        else if(c == '{' || c == '['){
+            char close = c == '{' ? '}' : ']';
+            pos++;
+            while(ok && peek() != close){
+                if(c == '{'){
+                    readString();
+                    expect(':');
+                }
+                skipValue();
+                if(peek() == ',')
+                    pos++;
+            }
+            expect(close);
+        }
+        else if(c == 't' || c == 'f' || c == 'n')
+            while(pos < text.size() && isalpha(text[pos]))
+                pos++;
+        else
+            readNumber();
+    }
+
+    void readSummed(Snapshot& snapshot){
+        expect('[');
+        while(ok && peek() != ']'){
+            string name;
+            BlockStats stats;
+            expect('{');
+            while(ok && peek() != '}'){
+                string key = readString();
+                expect(':');
+                if(key == "block")
+                    name = readString();
+                else if(key == "calls")
+                    stats.calls = readNumber();
+                else if(key == "total_ns")
+                    stats.totalTime = readNumber();
+                else if(key == "histogram"){
+                    expect('[');
+                    while(ok && peek() != ']'){
+                        stats.histogram.push_back(readNumber());
+                        if(peek() == ',')
+                            pos++;
+                    }
+                    expect(']');
+                }
+                else
+                    skipValue();
+                if(peek() == ',')
+                    pos++;
+            }
+            expect('}');
+            snapshot[name] = stats;
+            if(peek() == ',')
+                pos++;
+        }
+        expect(']');
+    }
+};
+
+/**
+ * @brief Reads a binary dump written by EZP_DUMP_OFFLINE, EZP_DUMP_ON_EXIT or EZP_DUMP_ON_SIGNAL, summing records across threads
+ *
+ * @param data Contents of the dump
+ * @param snapshot Snapshot to fill
+ *
+ * @return Whether the dump was well formed
+ */
+bool readDump(const string& data, Snapshot& snapshot){
+    unsigned int header[5]; //magic, version, pid, histogramBuckets, numRecords
+    if(data.size() < sizeof(header))
+        return false;
+    memcpy(header, data.data(), sizeof(header));
+    if(header[1] != 1)
+        return false;
+
+    //Records are laid out as in DumpRecord but with the bucket count of the dumped process
+    size_t buckets = header[3];
+    size_t recordSize = 2*sizeof(unsigned int) + (2 + buckets)*sizeof(unsigned long long);
+    if(data.size() < sizeof(header) + header[4]*recordSize)
+        return false;
+
+    for(size_t i=0;i<header[4];i++){
+        const char* record = data.data() + sizeof(header) + i*recordSize;
+        int tid;
+        unsigned int hash;
+        unsigned long long values[2];
+        memcpy(&tid, record, sizeof(tid));
+        if(tid == 0) //Recycled record of an exited thread
+            continue;
+        memcpy(&hash, record + sizeof(unsigned int), sizeof(hash));
+        memcpy(values, record + 2*sizeof(unsigned int), sizeof(values));
+
+        string name;
+        for(int shift=24;shift>=0;shift-=8)
+            if((char)(hash >> shift) != '\0')
+                name += (char)(hash >> shift);
+
+        BlockStats& stats = snapshot[name];
+        stats.calls += values[0];
+        stats.totalTime += values[1];
+        stats.histogram.resize(buckets, 0);
+        for(size_t j=0;j<buckets;j++){
+            unsigned long long count;
+            memcpy(&count, record + 2*sizeof(unsigned int) + (2 + j)*sizeof(unsigned long long), sizeof(count));
+            stats.histogram[j] += count;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Loads a snapshot from a JSON report or a binary dump file
+ *
+ * @param path Path to the file
+ * @param snapshot Snapshot to fill
+ *
+ * @return Whether the file could be read and parsed
+ */
+bool loadSnapshot(const char* path, Snapshot& snapshot){
+    ifstream file(path, ios::in | ios::binary);
+    if(!file){
+        cerr << "ezp_diff: Cannot open " << path << endl;
+        return false;
+    }
+    stringstream contents;
+    contents << file.rdbuf();
+    string text = contents.str();
+
+    if(text.compare(0, 4, "EZPD") == 0){
+        if(!readDump(text, snapshot)){
+            cerr << "ezp_diff: " << path << " is not a valid EZP binary dump" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    JSONReader reader(text);
+    if(!reader.readReport(snapshot)){
+        cerr << "ezp_diff: " << path << " is not a valid EZP JSON report" << endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Tests whether the candidate durations tend to be larger than the baseline durations with the Mann-Whitney U test
+ *
+ * Runs in the same histogram bucket are treated as ties, which the variance is corrected for.
+ *
+ * @param baseline Baseline histogram
+ * @param candidate Candidate histogram
+ * @param z Written with the normal approximation of the U statistic, positive if the candidate is slower
+ *
+ * @return Two-sided p-value, 1 if there is not enough data
+ */
+double mannWhitney(const vector<double>& baseline, const vector<double>& candidate, double& z){
+    z = 0;
+    size_t buckets = max(baseline.size(), candidate.size());
+    double n1 = 0, n2 = 0, candidateRanks = 0, ties = 0, rank = 0;
+    for(size_t i=0;i<buckets;i++){
+        double a = i < baseline.size() ? baseline[i] : 0;
+        double b = i < candidate.size() ? candidate[i] : 0;
+        double t = a + b;
+        candidateRanks += b*(rank + (t + 1)/2);
+        ties += t*t*t - t;
+        rank += t;
+        n1 += a;
+        n2 += b;
+    }
+
+    double N = n1 + n2;
+    if(n1 == 0 || n2 == 0 || N < 2)
+        return 1;
+    double u = candidateRanks - n2*(n2 + 1)/2;
+    double variance = n1*n2/12*((N + 1) - ties/(N*(N - 1)));
+    if(variance <= 0)
+        return 1;
+    z = (u - n1*n2/2)/sqrt(variance);
+    return erfc(fabs(z)/sqrt(2.0));
+}
+
+void printHelp(bool desc){
+    cout << "Usage: ezp_diff [OPTION]... BASELINE CANDIDATE" << endl;
+    if(desc){
+        cout << "Compares two offline analysis reports saved with EZP_WRITE_OFFLINE(..., JSON) or ezp_control -j," << endl;
+        cout << "or binary dumps saved with EZP_DUMP_OFFLINE, EZP_DUMP_ON_EXIT or EZP_DUMP_ON_SIGNAL." << endl;
+    }
+    cout << endl;
+    cout << "  -t, --threshold=RATIO    Slowdown ratio of average times that is a regression (default 1.05)" << endl;
+    cout << "  -a, --alpha=P            Significance level of the Mann-Whitney U test (default 0.01)" << endl;
+    cout << "  -h, --help               Displays this message" << endl;
+    cout << endl;
+    cout << "Exit status:" << endl;
+    cout << "  0  no regression" << endl;
+    cout << "  1  a block common to both reports got significantly slower by more than the threshold" << endl;
+    cout << "  2  invalid arguments, or a report that could not be read" << endl;
+}
+
+int main(int argc, char** argv){
+    struct option options[] = {
+        {"threshold",   required_argument,  NULL,   't'},
+        {"alpha",       required_argument,  NULL,   'a'},
+        {"help",        no_argument,        NULL,   'h'},
+        {NULL,          0,                  NULL,   0}
+    };
+
+    double threshold = 1.05;
+    double alpha = 0.01;
+
+    int i = 0;
+    int opt;
+    while((opt = getopt_long(argc, argv, "t:a:h", options, &i)) != -1)
+        switch(opt){
+            case 't':
+                threshold = atof(optarg);
+                break;
+            case 'a':
+                alpha = atof(optarg);
+                break;
+            case 'h':
+                printHelp(true);
+                return 0;
+            default:
+                printHelp(false);
+                return 2;
+        }
+
+    //A regression gate must not mistake an error for a regression, errors have their own exit status
+    if(argc - optind != 2){
+        printHelp(false);
+        return 2;
+    }
+
+    Snapshot baseline, candidate;
+    if(!loadSnapshot(argv[optind], baseline) || !loadSnapshot(argv[optind + 1], candidate))
+        return 2;
+
+    int regressions = 0;
+    printf("EZP: ===============================================================================\n");
+    printf("EZP: Name    Baseline(ms)    Candidate(ms)   Delta(ms)       Ratio     p-value\n");
+    printf("EZP: -------------------------------------------------------------------------------\n");
+    for(Snapshot::iterator it = baseline.begin(); it != baseline.end(); it++){
+        Snapshot::iterator other = candidate.find(it->first);
+        if(other == candidate.end()){
+            printf("EZP: %4s    only in baseline\n", it->first.c_str());
+            continue;
+        }
+
+        const BlockStats& base = it->second;
+        const BlockStats& cand = other->second;
+        double ratio = base.average() == 0 ? (cand.average() == 0 ? 1 : INFINITY) : cand.average()/base.average();
+        double z;
+        double p = mannWhitney(base.histogram, cand.histogram, z);
+        bool regression = ratio > threshold && z > 0 && p < alpha;
+        if(regression)
+            regressions++;
+
+        printf("EZP: %4s    %-12.4f    %-12.4f    %-+12.4f    %-8.3f  %-9.3g %s%s\n",
+                it->first.c_str(), base.average()/1e6, cand.average()/1e6, (cand.average() - base.average())/1e6, ratio, p,
+                p < 0.001 ? "***" : p < 0.01 ? "** " : p < 0.05 ? "*  " : "   ",
+                regression ? " REGRESSION" : "");
+    }
+    for(Snapshot::iterator it = candidate.begin(); it != candidate.end(); it++)
+        if(baseline.find(it->first) == baseline.end())
+            printf("EZP: %4s    only in candidate\n", it->first.c_str());
+    printf("EZP: ===============================================================================\n");
+    printf("EZP: %d regression(s) above ratio %g at significance level %g\n", regressions, threshold, alpha);
+
+    return regressions > 0 ? 1 : 0;
+}
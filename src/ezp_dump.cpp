@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_dump.cpp
+ * @brief Async-signal-safe binary dumps of offline analysis records
+ * @date 2026-10-18
+ */
+
+#include<csignal>
+#include<cstdlib>
+#include<fcntl.h>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Number of records that are formatted at once before being written
+ */
+#define EZP_DUMP_BATCH 64
+
+/**
+ * @brief Preallocated buffer that records are formatted into, so that dumping does not allocate
+ */
+static DumpRecord dumpBuffer[EZP_DUMP_BATCH];
+
+/**
+ * @brief Writes a buffer to a file descriptor completely, using only async-signal-safe calls
+ *
+ * @param fd File descriptor to write to
+ * @param data Buffer to write
+ * @param size Size of the buffer in bytes
+ *
+ * @return Whether the buffer was written completely
+ */
+static bool writeAllSafe(int fd, const void* data, size_t size)
+{
+    const char* ptr = (const char*)data;
+    while(size > 0){
+        ssize_t ret = write(fd, ptr, size);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return false;
+        ptr += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+//This function is not time critical and is async-signal-safe
+bool EasyPerformanceAnalyzer::dumpOfflineProfiles(const char* path)
+{
+    int savedErrno = errno;
+    bool success = false;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd >= 0){
+        success = writeDump(fd);
+        close(fd);
+    }
+
+    errno = savedErrno;
+    return success;
+}
+
+//This function is not time critical and is async-signal-safe
+bool EasyPerformanceAnalyzer::writeDump(int fd)
+{
+    //Only one dump at a time since the buffer is shared; a signal arriving during a dump is dropped
+    if(__atomic_exchange_n(&dumpLock, 1, __ATOMIC_ACQUIRE))
+        return false;
+
+    unsigned int numRecords = __atomic_load_n(&numOfflineRecords, __ATOMIC_ACQUIRE);
+    if(numRecords > EZP_MAX_DUMPED_BLOCKS)
+        numRecords = EZP_MAX_DUMPED_BLOCKS;
+
+    DumpHeader header;
+    memcpy(header.magic, "EZPD", 4);
+    header.version = 1;
+    header.pid = getpid();
+    header.histogramBuckets = EZP_HISTOGRAM_BUCKETS;
+    header.numRecords = numRecords;
+    bool success = writeAllSafe(fd, &header, sizeof(header));
+
+    for(unsigned int begin = 0; success && begin < numRecords; begin += EZP_DUMP_BATCH){
+        unsigned int end = begin + EZP_DUMP_BATCH < numRecords ? begin + EZP_DUMP_BATCH : numRecords;
+        for(unsigned int i = begin; i < end; i++){
+            AggregateMarker* marker = offlineRecords[i];
+            DumpRecord* record = dumpBuffer + (i - begin);
+            record->tid = marker->tid;
+            record->blockName = marker->blockName;
+            record->numSamples = __atomic_load_n(&(marker->numSamples), __ATOMIC_RELAXED);
+            record->totalTime = __atomic_load_n(&(marker->totalTime), __ATOMIC_RELAXED);
+            for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+                record->histogram[j] = __atomic_load_n(&(marker->histogram[j]), __ATOMIC_RELAXED);
+        }
+        success = writeAllSafe(fd, dumpBuffer, (end - begin)*sizeof(DumpRecord));
+    }
+
+    __atomic_store_n(&dumpLock, 0, __ATOMIC_RELEASE);
+    return success;
+}
+
+//This function is not time critical and is async-signal-safe
+void EasyPerformanceAnalyzer::getProcessPath(const char* base, char* path, size_t size)
+{
+    size_t length = strlen(base);
+    if(length > size - 1)
+        length = size - 1;
+    memcpy(path, base, length);
+    path[length] = '\0';
+
+    //A forked child must not overwrite the files of its parent, snprintf() is not async-signal-safe
+    if(cmdSocketPid <= 0)
+        return;
+    char digits[16];
+    int numDigits = 0;
+    for(pid_t pid = cmdSocketPid; pid > 0; pid /= 10)
+        digits[numDigits++] = '0' + pid % 10;
+    if(length + 1 + numDigits > size - 1)
+        return;
+    path[length++] = '.';
+    while(numDigits > 0)
+        path[length++] = digits[--numDigits];
+    path[length] = '\0';
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::dumpOnExit(const char* path)
+{
+    bool registered = exitDumpPath[0] != '\0';
+    strncpy(exitDumpPath, path, sizeof(exitDumpPath) - 1);
+    if(!registered && atexit(&EasyPerformanceAnalyzer::dumpAtExit) != 0)
+        EZP_PERR("EZP: atexit() error: Could not register the dump handler\n");
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::dumpOnSignal(int signum, const char* path)
+{
+    strncpy(signalDumpPath, path, sizeof(signalDumpPath) - 1);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &EasyPerformanceAnalyzer::dumpAtSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(signum, &action, NULL) == -1)
+        EZP_PERR("EZP: sigaction() error: %s\n", strerror(errno));
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::dumpAtExit()
+{
+    char path[PATH_MAX + 16];
+    getProcessPath(exitDumpPath, path, sizeof(path));
+    if(!dumpOfflineProfiles(path))
+        EZP_PERR("EZP: Could not dump offline analyses to %s at exit\n", path);
+}
+
+//This function is not time critical and is async-signal-safe
+void EasyPerformanceAnalyzer::dumpAtSignal(int signum)
+{
+    char path[PATH_MAX + 16];
+    getProcessPath(signalDumpPath, path, sizeof(path));
+    dumpOfflineProfiles(path);
+
+    //Snapshot signals let the process continue, others must still do what they were sent for
+    if(signum != SIGUSR1 && signum != SIGUSR2){
+        signal(signum, SIG_DFL);
+        raise(signum);
+    }
+}
+
+} /* namespace ezp */
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_filter.cpp
+ * @brief Per-block and per-thread enabling and disabling of instrumentation
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+//This function is not time critical, called once per block name and thread
+void EasyPerformanceAnalyzer::registerBlock(unsigned int blockName)
+{
+    //Functions are filtered by address; other threads have mostly registered the name already
+    if(isFunctionBlock(blockName) || getBlockId(blockName) >= 0)
+        return;
+
+    pthread_mutex_lock(&filterLock);
+
+    //Another thread may have registered it in the meantime
+    if(getBlockId(blockName) >= 0){
+        pthread_mutex_unlock(&filterLock);
+        return;
+    }
+
+    if(numBlockIds < EZP_MAX_BLOCK_IDS){
+        int id = numBlockIds++;
+        blockIdNames[id] = blockName;
+        if(!matchBlockFilters(blockName))
+            __atomic_or_fetch(&(disabledBlocks[id/32]), 1u << (id%32), __ATOMIC_RELAXED);
+
+        //Publish the ID only after its name and bit are written
+        unsigned int slot = (blockName*2654435761u) >> (32 - __builtin_ctz(EZP_BLOCK_ID_TABLE_SIZE));
+        while(blockIdSlots[slot] != 0)
+            slot = (slot + 1) & (EZP_BLOCK_ID_TABLE_SIZE - 1);
+        __atomic_store_n(&(blockIdSlots[slot]), id + 1, __ATOMIC_RELEASE);
+    }
+
+    else if(numBlockIds == EZP_MAX_BLOCK_IDS){
+        EZP_PERR("EZP: More than %d block names, the rest cannot be filtered or traced\n", EZP_MAX_BLOCK_IDS);
+        numBlockIds++; //Warn only once
+    }
+
+    pthread_mutex_unlock(&filterLock);
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::matchBlockFilters(unsigned int blockName)
+{
+    char cbuf[5];
+    unhashStr(blockName, cbuf);
+    for(FilterRules::reverse_iterator it = blockFilters.rbegin(); it != blockFilters.rend(); it++)
+        if(strncmp(cbuf, it->first.c_str(), it->first.size()) == 0)
+            return it->second;
+    return true;
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::matchThreadFilters(const ThreadInfo* info)
+{
+    char tbuf[16];
+    snprintf(tbuf, sizeof(tbuf), "%d", info->tid);
+    for(FilterRules::const_reverse_iterator it = threadFilters.rbegin(); it != threadFilters.rend(); it++)
+        if(it->first == tbuf || strncmp(info->name, it->first.c_str(), it->first.size()) == 0)
+            return it->second;
+    return true;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setBlockFilter(const char* prefix, bool enable)
+{
+    pthread_mutex_lock(&filterLock);
+    blockFilters.push_back(std::make_pair(std::string(prefix), enable));
+
+    //Only blocks matched by the new filter change, it is the last one that matches them
+    unsigned int numIds = numBlockIds < EZP_MAX_BLOCK_IDS ? numBlockIds : EZP_MAX_BLOCK_IDS;
+    size_t length = strlen(prefix);
+    char cbuf[5];
+    for(unsigned int id=0;id<numIds;id++){
+        unhashStr(blockIdNames[id], cbuf);
+        if(strncmp(cbuf, prefix, length) != 0)
+            continue;
+        if(enable)
+            __atomic_and_fetch(&(disabledBlocks[id/32]), ~(1u << (id%32)), __ATOMIC_RELAXED);
+        else
+            __atomic_or_fetch(&(disabledBlocks[id/32]), 1u << (id%32), __ATOMIC_RELAXED);
+    }
+    setState(STATE_FILTERING, true);
+    pthread_mutex_unlock(&filterLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setThreadFilter(const char* thread, bool enable)
+{
+    pthread_mutex_lock(&threadLock);
+    threadFilters.push_back(std::make_pair(std::string(thread), enable));
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++)
+        if(!it->second->retired)
+            __atomic_store_n(&(it->second->disabled), !matchThreadFilters(it->second), __ATOMIC_RELAXED);
+    setState(STATE_FILTERING, true);
+    pthread_mutex_unlock(&threadLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::resetFilters()
+{
+    //Filters are added under either lock, so the state is only cleared while holding both
+    pthread_mutex_lock(&threadLock);
+    pthread_mutex_lock(&filterLock);
+    blockFilters.clear();
+    for(int i=0;i<EZP_MAX_BLOCK_IDS/32;i++)
+        __atomic_store_n(&(disabledBlocks[i]), 0, __ATOMIC_RELAXED);
+    functionFilters.clear();
+    for(int i=0;i<EZP_MAX_FUNCTIONS/32;i++)
+        __atomic_store_n(&(disabledFunctions[i]), 0, __ATOMIC_RELAXED);
+    threadFilters.clear();
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++)
+        __atomic_store_n(&(it->second->disabled), false, __ATOMIC_RELAXED);
+    setState(STATE_FILTERING, false);
+    pthread_mutex_unlock(&filterLock);
+    pthread_mutex_unlock(&threadLock);
+}
+
+} /* namespace ezp */
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_fork.cpp
+ * @brief Analysis sessions of forked processes and merging of their records into their parent
+ * @date 2026-10-18
+ */
+
+#include<cstddef>
+#include<cstdlib>
+#include<sys/mman.h>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Reads a buffer from a file descriptor completely
+ *
+ * @param fd File descriptor to read from
+ * @param data Buffer to read into
+ * @param size Size of the buffer in bytes
+ *
+ * @return Whether the buffer was read completely
+ */
+static bool readAll(int fd, void* data, size_t size)
+{
+    char* ptr = (char*)data;
+    while(size > 0){
+        ssize_t ret = read(fd, ptr, size);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return false;
+        ptr += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether the peer of a connection is a child of this process run by the same user
+ *
+ * @param fd Connection to check
+ *
+ * @return Whether the peer is a child of this process
+ */
+static bool isChildPeer(int fd)
+{
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == -1){
+        EZP_PERR("EZP: getsockopt() error: %s\n", strerror(errno));
+        return false;
+    }
+    if(cred.uid != geteuid())
+        return false;
+
+    //The parent ID follows the state in /proc/PID/stat, after the command name that may contain anything
+    char path[32];
+    char stat[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", cred.pid);
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+        return false;
+    size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[length] = '\0';
+    const char* commEnd = strrchr(stat, ')');
+    char state;
+    int ppid;
+    return commEnd != NULL && sscanf(commEnd + 1, " %c %d", &state, &ppid) == 2 && ppid == getpid();
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::registerForkHandlers()
+{
+    int err = pthread_atfork(prepareFork, resumeParentAfterFork, resetChildAfterFork);
+    if(err != 0)
+        EZP_PERR("EZP: pthread_atfork() error: %s\n", strerror(err));
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::prepareFork()
+{
+    //Always in this order, which every nesting elsewhere follows: launchCmdListener() publishes shared stats, taking offlineLock
+    //under listenerLauncherLock; resetFilters() takes filterLock and stopRecording() takes recordLock under threadLock, and
+    //setSampling() changes the state under threadLock. pullLock of pullSharedStats(), which takes threadLock and offlineLock
+    //under it, is not taken here: a child forked during a pull must not pull
+    pthread_mutex_lock(&listenerLauncherLock);
+    pthread_mutex_lock(&exporterLauncherLock);
+    pthread_mutex_lock(&threadLock);
+    pthread_mutex_lock(&lock);
+    pthread_mutex_lock(&smoothLock);
+    pthread_mutex_lock(&offlineLock);
+    pthread_mutex_lock(&filterLock);
+    pthread_mutex_lock(&recordLock);
+    pthread_mutex_lock(&traceLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::resumeParentAfterFork()
+{
+    pthread_mutex_unlock(&traceLock);
+    pthread_mutex_unlock(&recordLock);
+    pthread_mutex_unlock(&filterLock);
+    pthread_mutex_unlock(&offlineLock);
+    pthread_mutex_unlock(&smoothLock);
+    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&threadLock);
+    pthread_mutex_unlock(&exporterLauncherLock);
+    pthread_mutex_unlock(&listenerLauncherLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::resetChildAfterFork()
+{
+    //Only the forking thread survives in the child and it has a new ID; other threads never run again in the child
+    cachedTid = 0;
+    TID tid = getTid();
+
+    //The listener and exporter threads were not forked and their sockets belong to the parent; the listener is launched
+    //again under a name of our own by the next EZP_START*
+    if(cmdAcceptor != -1)
+        close(cmdAcceptor);
+    cmdAcceptor = -1;
+    setState(STATE_LISTENER_RUNNING, false);
+    parentSocketPid = cmdSocketPid;
+    cmdSocketPid = getpid();
+    if(exporterAcceptor != -1)
+        close(exporterAcceptor);
+    exporterAcceptor = -1;
+    exporterRunning = false;
+
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++)
+        if(it->second != currentThread){
+            delete[] it->second->traceRing;
+            delete[] it->second->sampleRing;
+            delete it->second;
+        }
+    threads.clear();
+    retiredPools.clear();
+    if(currentThread != NULL){
+        currentThread->tid = tid;
+        threads[tid] = currentThread;
+
+        //Timers are not inherited, the thread creates its own at its next block if sampling; the records it had open are gone
+        currentThread->samplingTimerCreated = false;
+        currentThread->samplingGeneration = 0;
+        currentThread->numOpenBlocks = 0;
+        currentThread->recordBuffer = NULL;
+    }
+
+    //The encoder thread was not forked and the recording belongs to the parent; closing our copy of the descriptor does not flush
+    //the buffered data of the parent, and the buffers of the parent are leaked
+    if(recordFile != NULL)
+        close(fileno(recordFile));
+    recordFile = NULL;
+    recordStopping = false;
+    recordQueue = NULL;
+    recordQueueTail = NULL;
+    numRecordBuffers = 0;
+    setState(STATE_RECORDING, false);
+
+    //Neither was the trace writer thread, traces queued in the parent are written by the parent and leaked here
+    traceQueue = NULL;
+    traceQueueTail = NULL;
+    numQueuedTraces = 0;
+    traceWriterRunning = false;
+
+    //Records of the parent are not ours; offline markers are leaked as in clearOfflineProfiles()
+    for(Blk2Clk::iterator it = blocks.begin(); it != blocks.end(); it++)
+        delete it->second;
+    blocks.clear();
+    for(Blk2SMarker::iterator it = smoothBlocks.begin(); it != smoothBlocks.end(); it++)
+        delete it->second;
+    smoothBlocks.clear();
+    offlineBlocks.clear();
+    numOfflineRecords = 0;
+    offlineGeneration++;
+
+    //The shared memory segment of the parent stays mapped in the child, detach from it; our own is published with our listener
+    sharedStatsPending = sharedStats != NULL;
+#ifndef ANDROID
+    if(sharedStatsPending)
+        munmap(sharedStats, sizeof(SharedHeader) + EZP_MAX_DUMPED_BLOCKS*sizeof(SharedRecord));
+#endif
+    sharedStats = NULL;
+    sharedRecords = NULL;
+
+    //Spare markers of the parent, e.g those of EZP_INIT, are used by no thread of ours and are kept like in clearOfflineProfiles()
+    preallocateOfflineMarkers(true);
+
+    //Dumps and traces of the parent are not overwritten, getProcessPath() adds our cmdSocketPid to the paths
+    dumpLock = 0;
+
+    resumeParentAfterFork();
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::getCmdSocketAddress(pid_t pid, struct sockaddr_un& addr, socklen_t& addrLen)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    //Abstract socket: the name begins with a null character and is not null terminated
+    if(pid > 0)
+        snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "%s.%d", cmdSocketName, pid);
+    else
+        strncpy(addr.sun_path + 1, cmdSocketName, sizeof(addr.sun_path) - 2);
+    addrLen = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(addr.sun_path + 1);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::enableChildMerging()
+{
+    childMerging = true;
+    launchCmdListener();
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::mergeIntoParent()
+{
+    if(!sendToParent())
+        return false;
+    clearOfflineProfiles();
+    return true;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::mergeAtExit()
+{
+    if(parentSocketPid >= 0 && !sendToParent())
+        EZP_PERR("EZP: Could not merge offline analyses into the parent process at exit\n");
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::sendToParent()
+{
+    if(parentSocketPid < 0){
+        EZP_PERR("EZP: This process was not forked from an instrumented process, there is no parent to merge into\n");
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    socklen_t addrLen;
+    int fd;
+
+    if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1){
+        EZP_PERR("EZP: socket() error: %s\n",strerror(errno));
+        return false;
+    }
+
+    getCmdSocketAddress(parentSocketPid, addr, addrLen);
+    if(connect(fd, (struct sockaddr*)&addr, addrLen) == -1){
+        EZP_PERR("EZP: connect() error: %s\n",strerror(errno));
+        EZP_PERR("EZP: The parent process must call EZP_MERGE_CHILDREN or have its command listener running.\n");
+        close(fd);
+        return false;
+    }
+
+    bool success = writeAll(fd, std::string("m", 2)) && writeDump(fd);
+
+    //Wait for the parent to close the connection so that the records are there when we are reaped
+    if(success){
+        char c;
+        shutdown(fd, SHUT_WR);
+        while(read(fd, &c, 1) > 0);
+    }
+    else
+        EZP_PERR("EZP: write() error: Could not send offline analyses to the parent process\n");
+
+    close(fd);
+    return success;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::receiveMerge(int fd)
+{
+    if(!isChildPeer(fd)){
+        EZP_PERR("EZP: Refused offline analyses to merge from a process that is not a child of this process\n");
+        return;
+    }
+
+    DumpHeader header;
+    if(!readAll(fd, &header, sizeof(header)) || memcmp(header.magic, "EZPD", 4) != 0 || header.version != 1 ||
+            header.histogramBuckets != EZP_HISTOGRAM_BUCKETS){
+        EZP_PERR("EZP: Received malformed offline analyses to merge\n");
+        return;
+    }
+
+    TID childrenTid = getRetiredTid("children");
+    unsigned int merged = 0;
+    DumpRecord record;
+    for(unsigned int i=0;i<header.numRecords;i++){
+        if(!readAll(fd, &record, sizeof(record))){
+            EZP_PERR("EZP: Received truncated offline analyses from process %u\n", header.pid);
+            break;
+        }
+        if(record.tid == 0) //Recycled record of an exited thread
+            continue;
+
+        AggregateMarker source(record.tid, record.blockName);
+        source.numSamples = record.numSamples;
+        source.totalTime = record.totalTime;
+        for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+            source.histogram[j] = record.histogram[j];
+
+        pthread_mutex_lock(&offlineLock);
+        foldOfflineMarker(getOfflineMarker(BlockKey(childrenTid, record.blockName)), &source);
+        pthread_mutex_unlock(&offlineLock);
+        merged++;
+    }
+
+    EZP_PRINT("EZP: Merged %u offline analysis records of process %u.\n", merged, header.pid);
+}
+
+} /* namespace ezp */
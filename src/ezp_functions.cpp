@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_functions.cpp
+ * @brief Offline analysis of functions entering and exiting through the function hooks of libezp_hooks
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<cxxabi.h>
+#include<dlfcn.h>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setFunctionHooks(bool on)
+{
+    //Registered after the static objects that exist so far, so runs before they are destroyed
+    pthread_mutex_lock(&filterLock);
+    if(on && !stopFunctionHooksRegistered){
+        atexit(stopFunctionHooks);
+        stopFunctionHooksRegistered = true;
+    }
+    pthread_mutex_unlock(&filterLock);
+    setState(STATE_FUNCTION_HOOKS, on);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::stopFunctionHooks()
+{
+    setState(STATE_FUNCTION_HOOKS, false);
+}
+
+//This function is time critical!
+void EasyPerformanceAnalyzer::startProfilingFunction(void* function)
+{
+    //Entries and exits stay paired whatever the state, functions entered while the hooks were off are never analyzed
+    unsigned int depth = numOpenFunctions++;
+    unsigned int blockName = 0;
+    if(depth < EZP_MAX_FUNCTION_DEPTH && (__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_FUNCTION_HOOKS))
+        blockName = getFunctionBlockName(function);
+
+    //Offline records keep one beginning time per block, so only the outermost call of a recursive function is analyzed
+    for(unsigned int i=0;blockName != 0 && i<depth;i++)
+        if(openFunctions[i] == blockName)
+            blockName = 0;
+
+    if(depth < EZP_MAX_FUNCTION_DEPTH)
+        openFunctions[depth] = blockName;
+    if(blockName == 0)
+        return;
+
+    //Disabled threads do not start the block
+    Timespec* begin = openOfflineBlock(blockName);
+    if(begin != NULL)
+        clock_gettime(EZP_CLOCK, begin);
+}
+
+//This function is time critical!
+void EasyPerformanceAnalyzer::endProfilingFunction(void* function)
+{
+    //Exits of functions entered before the hooks were linked in, e.g during static initialization
+    if(numOpenFunctions == 0)
+        return;
+
+    unsigned int depth = --numOpenFunctions;
+    if(depth >= EZP_MAX_FUNCTION_DEPTH || openFunctions[depth] == 0)
+        return;
+
+    Timespec end;
+    clock_gettime(EZP_CLOCK,&end);
+    endOfflineBlock(openFunctions[depth], &end);
+}
+
+//This function is not time critical, called once per function
+unsigned int EasyPerformanceAnalyzer::registerFunction(void* function)
+{
+    //Keep the calls of functions that do not fit from locking every time
+    if(__atomic_load_n(&numFunctions, __ATOMIC_RELAXED) >= EZP_MAX_FUNCTIONS)
+        return 0;
+
+    pthread_mutex_lock(&filterLock);
+
+    //Another thread may have registered it in the meantime
+    unsigned int slot = ((unsigned int)((unsigned long)function >> 2)*2654435761u) >> (32 - __builtin_ctz(EZP_FUNCTION_TABLE_SIZE));
+    while(functionSlots[slot] != 0 && functionAddresses[functionSlots[slot] - 1] != function)
+        slot = (slot + 1) & (EZP_FUNCTION_TABLE_SIZE - 1);
+
+    unsigned int index;
+    if(functionSlots[slot] != 0)
+        index = functionSlots[slot] - 1;
+
+    else if(numFunctions < EZP_MAX_FUNCTIONS){
+        index = numFunctions;
+        functionAddresses[index] = function;
+        if(!matchFunctionFilters(function))
+            __atomic_or_fetch(&(disabledFunctions[index/32]), 1u << (index%32), __ATOMIC_RELAXED);
+
+        //Publish the index only after its address and bit are written
+        __atomic_store_n(&(functionSlots[slot]), index + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&numFunctions, numFunctions + 1, __ATOMIC_RELAXED);
+        if(numFunctions == EZP_MAX_FUNCTIONS)
+            EZP_PERR("EZP: Reached %d instrumented functions, further functions will not be analyzed\n", EZP_MAX_FUNCTIONS);
+    }
+
+    else{
+        pthread_mutex_unlock(&filterLock);
+        return 0;
+    }
+
+    bool disabled = (disabledFunctions[index/32] >> (index%32)) & 1;
+    pthread_mutex_unlock(&filterLock);
+    return disabled ? 0 : EZP_FUNCTION_BLOCK_NAME | index;
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::matchFunctionFilters(const void* function)
+{
+    for(AddressRules::reverse_iterator it = functionFilters.rbegin(); it != functionFilters.rend(); it++)
+        if(function >= it->first.first && function < it->first.second)
+            return it->second;
+    return true;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setFunctionFilter(const void* begin, const void* end, bool enable)
+{
+    pthread_mutex_lock(&filterLock);
+    functionFilters.push_back(std::make_pair(std::make_pair(begin, end), enable));
+
+    //Only functions matched by the new filter change, it is the last one that matches them
+    for(unsigned int index=0;index<numFunctions;index++){
+        if(functionAddresses[index] < begin || functionAddresses[index] >= end)
+            continue;
+        if(enable)
+            __atomic_and_fetch(&(disabledFunctions[index/32]), ~(1u << (index%32)), __ATOMIC_RELAXED);
+        else
+            __atomic_or_fetch(&(disabledFunctions[index/32]), 1u << (index%32), __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&filterLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::getBlockLabel(unsigned int blockName, char* output)
+{
+    if(!isFunctionBlock(blockName)){
+        unhashStr(blockName, output);
+        return;
+    }
+
+    void* function = functionAddresses[blockName & ~EZP_FUNCTION_BLOCK_NAME];
+    Dl_info info;
+    if(dladdr(function, &info) == 0 || info.dli_fname == NULL)
+        snprintf(output, EZP_BLOCK_LABEL_LENGTH, "%p", function);
+
+    //dladdr() gives the closest dynamic symbol below, which is another function if this one is not exported
+    else if(info.dli_sname != NULL && info.dli_saddr == function){
+        int status;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+        snprintf(output, EZP_BLOCK_LABEL_LENGTH, "%s", demangled != NULL ? demangled : info.dli_sname);
+        free(demangled);
+    }
+
+    //Static functions, or executables linked without -rdynamic; addr2line finds them from the offset in their module
+    else{
+        const char* module = strrchr(info.dli_fname, '/');
+        snprintf(output, EZP_BLOCK_LABEL_LENGTH, "%s+0x%lx", module != NULL ? module + 1 : info.dli_fname,
+                (unsigned long)((char*)function - (char*)info.dli_fbase));
+    }
+}
+
+} /* namespace ezp */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_hooks.cpp
+ * @brief Function hooks called by code compiled with -finstrument-functions, link libezp_hooks before libezp to use them
+ * @date 2026-10-18
+ *
+ * This file must not be compiled with -finstrument-functions itself
+ */
+
+#include"ezp.hpp"
+
+/**
+ * @brief Whether the calling thread is inside a hook
+ *
+ * Template code that libezp shares with instrumented code may be the instrumented copy and call the hooks again
+ */
+static __thread bool inHook = false;
+
+extern "C"{
+
+__attribute__((no_instrument_function)) void __cyg_profile_func_enter(void* function, void* callSite)
+{
+    if(inHook)
+        return;
+    inHook = true;
+    ezp::EasyPerformanceAnalyzer::startProfilingFunction(function);
+    inHook = false;
+}
+
+__attribute__((no_instrument_function)) void __cyg_profile_func_exit(void* function, void* callSite)
+{
+    if(inHook)
+        return;
+    inHook = true;
+    ezp::EasyPerformanceAnalyzer::endProfilingFunction(function);
+    inHook = false;
+}
+
+}
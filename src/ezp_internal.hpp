@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_internal.hpp
+ * @brief Platform-dependent definitions and time critical helpers shared by the EZP translation units
+ * @date 2026-10-18
+ */
+
+#ifndef EZP_INTERNAL_HPP
+#define EZP_INTERNAL_HPP
+
+#include<cstring>
+#include<sched.h>
+#include<sys/resource.h>
+
+#include"ezp.hpp"
+
+namespace ezp{
+
+///////////////////////////////////////////////////////////////////////////////
+//Platform-dependent defs
+///////////////////////////////////////////////////////////////////////////////
+
+#define EZP_CLOCK CLOCK_THREAD_CPUTIME_ID
+#define EZP_WALL_CLOCK CLOCK_MONOTONIC
+
+/**
+ * @brief Value of ThreadInfo::recordBuffer while its thread appends to the buffer
+ */
+#define EZP_RECORD_BUSY ((RecordBuffer*)1)
+
+/**
+ * @brief Version of the recording file layout that is written, readers also take version 1
+ */
+#define EZP_RECORD_VERSION 2
+#ifdef ANDROID
+#define EZP_GET_TID gettid()
+#else
+#define EZP_GET_TID syscall(SYS_gettid)
+#endif
+
+#ifdef ANDROID
+#define EZP_PRINT(...) __android_log_print(ANDROID_LOG_INFO, ezp::EasyPerformanceAnalyzer::androidTag, __VA_ARGS__)
+#define EZP_PERR(...) (ezp::EasyPerformanceAnalyzer::forceStderr ? fprintf(stderr,__VA_ARGS__) :__android_log_print(ANDROID_LOG_ERROR, ezp::EasyPerformanceAnalyzer::androidTag, __VA_ARGS__))
+#else
+#define EZP_PRINT(...) printf(__VA_ARGS__)
+#define EZP_PERR(...) fprintf(stderr,__VA_ARGS__)
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//Inline functions
+///////////////////////////////////////////////////////////////////////////////
+
+//This function is time critical!
+inline TID EasyPerformanceAnalyzer::getTid()
+{
+    if(cachedTid == 0)
+        cacheTid();
+    return cachedTid;
+}
+
+//This function is time critical!
+inline int EasyPerformanceAnalyzer::getBlockId(unsigned int blockName)
+{
+    //Fibonacci hashing, then linear probing; the table is never more than half full so an empty slot is always found
+    unsigned int slot = (blockName*2654435761u) >> (32 - __builtin_ctz(EZP_BLOCK_ID_TABLE_SIZE));
+    while(true){
+        unsigned short id = __atomic_load_n(&(blockIdSlots[slot]), __ATOMIC_ACQUIRE);
+        if(id == 0)
+            return -1;
+        if(blockIdNames[id - 1] == blockName)
+            return id - 1;
+        slot = (slot + 1) & (EZP_BLOCK_ID_TABLE_SIZE - 1);
+    }
+}
+
+//This function is time critical!
+inline bool EasyPerformanceAnalyzer::isFilteredOut(unsigned int blockName)
+{
+    if(currentThread != NULL && __atomic_load_n(&(currentThread->disabled), __ATOMIC_RELAXED))
+        return true;
+
+    //Functions are filtered by address before they start, block filters do not apply to them
+    if(isFunctionBlock(blockName))
+        return false;
+
+    //Blocks get their ID when they first start; the rest did not fit and are never filtered
+    int id = getBlockId(blockName);
+    return id >= 0 && ((__atomic_load_n(&(disabledBlocks[id/32]), __ATOMIC_RELAXED) >> (id%32)) & 1);
+}
+
+//This function is time critical!
+inline bool EasyPerformanceAnalyzer::isFunctionBlock(unsigned int blockName)
+{
+    return (blockName & 0xFF000000u) == EZP_FUNCTION_BLOCK_NAME;
+}
+
+//This function is time critical!
+inline unsigned int EasyPerformanceAnalyzer::getFunctionBlockName(void* function)
+{
+    //Same open addressing as block IDs, the lowest bits of function addresses are mostly alignment
+    unsigned int slot = ((unsigned int)((unsigned long)function >> 2)*2654435761u) >> (32 - __builtin_ctz(EZP_FUNCTION_TABLE_SIZE));
+    while(true){
+        unsigned short index = __atomic_load_n(&(functionSlots[slot]), __ATOMIC_ACQUIRE);
+        if(index == 0)
+            return registerFunction(function);
+        if(functionAddresses[index - 1] == function){
+            index--;
+            if((__atomic_load_n(&(disabledFunctions[index/32]), __ATOMIC_RELAXED) >> (index%32)) & 1)
+                return 0;
+            return EZP_FUNCTION_BLOCK_NAME | index;
+        }
+        slot = (slot + 1) & (EZP_FUNCTION_TABLE_SIZE - 1);
+    }
+}
+
+//This function is time critical!
+inline void EasyPerformanceAnalyzer::pushOpenBlock(ThreadInfo* info, AggregateMarker* marker, unsigned int blockName, const Timespec* wallBegin)
+{
+    unsigned int depth = info->numOpenBlocks;
+    if(depth >= EZP_MAX_OPEN_BLOCKS)
+        return;
+
+    //Other threads read the stack under the sequence, the SIGPROF handler of this thread only up to the published depth
+    unsigned int sequence = info->openSequence;
+    __atomic_store_n(&(info->openSequence), sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    info->openBlocks[depth].marker = marker;
+    info->openBlocks[depth].blockName = blockName;
+    info->openBlocks[depth].wallBegin = *wallBegin;
+    __atomic_store_n(&(info->numOpenBlocks), depth + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&(info->openSequence), sequence + 2, __ATOMIC_RELEASE);
+}
+
+//This function is time critical!
+inline bool EasyPerformanceAnalyzer::popOpenBlock(ThreadInfo* info, unsigned int blockName, Timespec* wallBegin)
+{
+    //Blocks end in reverse order unless they overlap, so the search almost always stops at the innermost one
+    unsigned int depth = info->numOpenBlocks;
+    for(unsigned int i = depth; i > 0; i--)
+        if(info->openBlocks[i - 1].blockName == blockName){
+            *wallBegin = info->openBlocks[i - 1].wallBegin;
+            unsigned int sequence = info->openSequence;
+            __atomic_store_n(&(info->openSequence), sequence + 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&(info->numOpenBlocks), i - 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_ACQ_REL);
+            for(unsigned int j = i; j < depth; j++)
+                info->openBlocks[j - 1] = info->openBlocks[j];
+            __atomic_store_n(&(info->numOpenBlocks), depth - 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&(info->openSequence), sequence + 2, __ATOMIC_RELEASE);
+            return true;
+        }
+    return false;
+}
+
+//This function is time critical!
+inline Timespec* EasyPerformanceAnalyzer::pushOtherBlock(ThreadInfo* info, unsigned int blockName, BlockAnalysis analysis, Timespec* recordBegin)
+{
+    unsigned int depth = info->numOtherBlocks;
+    if(depth >= EZP_MAX_OTHER_BLOCKS)
+        return recordBegin;
+    info->otherBlocks[depth].blockName = blockName;
+    info->otherBlocks[depth].analysis = analysis;
+    info->numOtherBlocks = depth + 1;
+    return &(info->otherBlocks[depth].beginTime);
+}
+
+//This function is time critical!
+inline bool EasyPerformanceAnalyzer::popOtherBlock(ThreadInfo* info, unsigned int blockName, BlockAnalysis analysis, Timespec* beginTime)
+{
+    unsigned int depth = info->numOtherBlocks;
+    for(unsigned int i = depth; i > 0; i--)
+        if(info->otherBlocks[i - 1].blockName == blockName && info->otherBlocks[i - 1].analysis == (unsigned int)analysis){
+            *beginTime = info->otherBlocks[i - 1].beginTime;
+            for(unsigned int j = i; j < depth; j++)
+                info->otherBlocks[j - 1] = info->otherBlocks[j];
+            info->numOtherBlocks = depth - 1;
+            return true;
+        }
+    return false;
+}
+
+//This function is time critical!
+inline void EasyPerformanceAnalyzer::traceBlock(unsigned int blockName, const Timespec* begin, const Timespec* end)
+{
+    ThreadInfo* info = currentThread;
+    if(info == NULL)
+        return;
+    if(info->traceRing == NULL){
+        info->traceRingSize = __atomic_load_n(&traceRingSize, __ATOMIC_RELAXED);
+        info->traceRing = new TraceEvent[info->traceRingSize];
+    }
+
+    //Only this thread touches its ring, older blocks are overwritten
+    TraceEvent* event = info->traceRing + info->numTraceEvents%info->traceRingSize;
+    info->numTraceEvents++;
+    event->blockName = blockName;
+    event->beginTime = begin->tv_sec*1000000000ULL + begin->tv_nsec;
+    event->duration = getTimeDiffNs(begin, end);
+
+    //Blocks with a threshold always have an ID since setting the threshold gives them one
+    int id = getBlockId(blockName);
+    if(id < 0)
+        return;
+    unsigned long long threshold = __atomic_load_n(&(traceThresholds[id]), __ATOMIC_RELAXED);
+    if(threshold != 0 && event->duration > threshold)
+        queueTrace(info, threshold);
+}
+
+//This function is time critical!
+inline void EasyPerformanceAnalyzer::recordBlock(ThreadInfo* info, unsigned int blockName, const Timespec* wallBegin, unsigned long long cpuTime)
+{
+    Timespec wallEnd;
+    clock_gettime(EZP_WALL_CLOCK, &wallEnd);
+
+    //stopRecording() may take the buffer from under us; it leaves NULL instead of EZP_RECORD_BUSY then and we queue the buffer ourselves
+    RecordBuffer* buffer = __atomic_exchange_n(&(info->recordBuffer), EZP_RECORD_BUSY, __ATOMIC_ACQUIRE);
+    if(buffer == NULL)
+        buffer = takeRecordBuffer();
+    if(buffer != NULL){
+        RecordEvent* event = buffer->events + buffer->numEvents++;
+        event->blockName = blockName;
+        event->begin = wallBegin->tv_sec*1000000000ULL + wallBegin->tv_nsec;
+        event->end = wallEnd.tv_sec*1000000000ULL + wallEnd.tv_nsec;
+        event->cpuTime = cpuTime;
+        event->request = info->requestId;
+        if(buffer->numEvents == EZP_RECORD_BUFFER_EVENTS){
+            //Blocks still open are only recorded once they end, readers learn here that they began; those started before the recording have no wall time
+            buffer->numOpenEvents = 0;
+            for(unsigned int i=0;i<info->numOpenBlocks;i++){
+                if(info->openBlocks[i].wallBegin.tv_sec == 0 && info->openBlocks[i].wallBegin.tv_nsec == 0)
+                    continue;
+                RecordEvent* open = buffer->openEvents + buffer->numOpenEvents++;
+                open->blockName = info->openBlocks[i].blockName;
+                open->begin = info->openBlocks[i].wallBegin.tv_sec*1000000000ULL + info->openBlocks[i].wallBegin.tv_nsec;
+                open->end = 0;
+                open->cpuTime = 0;
+                open->request = info->requestId;
+            }
+            queueRecordBuffer(info, buffer);
+            buffer = NULL;
+        }
+    }
+    RecordBuffer* busy = EZP_RECORD_BUSY;
+    if(!__atomic_compare_exchange_n(&(info->recordBuffer), &busy, buffer, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED) && buffer != NULL)
+        queueRecordBuffer(info, buffer);
+}
+
+//This function is time critical!
+inline void EasyPerformanceAnalyzer::takeSchedSample(SchedSample* sample, bool begin)
+{
+    //Keep the wall clock next to the CPU clock, the system call would otherwise count as off-CPU time
+    if(!begin)
+        clock_gettime(EZP_WALL_CLOCK, &(sample->wallTime));
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    sample->voluntarySwitches = usage.ru_nvcsw;
+    sample->involuntarySwitches = usage.ru_nivcsw;
+    if(begin)
+        clock_gettime(EZP_WALL_CLOCK, &(sample->wallTime));
+    sample->valid = true;
+}
+
+//This function is time critical!
+inline int EasyPerformanceAnalyzer::getNode()
+{
+    //Served by the vDSO without entering the kernel on most platforms
+    int cpu = sched_getcpu();
+    return cpu >= 0 && cpu < EZP_MAX_CPUS ? __atomic_load_n(&(cpuNodes[cpu]), __ATOMIC_RELAXED) : 0;
+}
+
+//This function is time critical!
+inline AllocCounters* EasyPerformanceAnalyzer::getAllocCounters()
+{
+    ThreadInfo* info = currentThread;
+    if(info == NULL)
+        return NULL;
+
+    //The counters of a thread never move, ask libezp_malloc.so once per thread
+    if(info->allocCounters == NULL)
+        info->allocCounters = __atomic_load_n(&allocCountersGetter, __ATOMIC_RELAXED)();
+    return info->allocCounters;
+}
+
+//This function is time critical!
+inline float EasyPerformanceAnalyzer::getTimeDiff(const Timespec* begin, const Timespec* end)
+{
+    return (float)(end->tv_sec - begin->tv_sec)*1000.0f + (float)(end->tv_nsec - begin->tv_nsec)/1000000.0f;
+}
+
+//This function is time critical!
+inline unsigned long long EasyPerformanceAnalyzer::getTimeDiffNs(const Timespec* begin, const Timespec* end)
+{
+    long long diff = (long long)(end->tv_sec - begin->tv_sec)*1000000000LL + (end->tv_nsec - begin->tv_nsec);
+    return diff < 0 ? 0 : diff;
+}
+
+//This function is time critical!
+inline int EasyPerformanceAnalyzer::getHistogramBucket(unsigned long long ns)
+{
+    if(ns == 0)
+        return 0;
+    int bucket = 64 - __builtin_clzll(ns);
+    return bucket < EZP_HISTOGRAM_BUCKETS ? bucket : EZP_HISTOGRAM_BUCKETS - 1;
+}
+
+//This function is time critical!
+inline void EasyPerformanceAnalyzer::updateSharedRecord(AggregateMarker* marker, int bucket)
+{
+    SharedRecord* record = marker->shared;
+    unsigned int seq = record->seq;
+
+    //All writers hold offlineLock, so the sequence lock only has to protect readers in other processes
+    __atomic_store_n(&(record->seq), seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&(record->numSamples), (unsigned long long)marker->numSamples, __ATOMIC_RELAXED);
+    __atomic_store_n(&(record->totalTime), marker->totalTime, __ATOMIC_RELAXED);
+    if(bucket >= 0)
+        __atomic_store_n(&(record->histogram[bucket]), (unsigned long long)marker->histogram[bucket], __ATOMIC_RELAXED);
+    else{
+        __atomic_store_n(&(record->tid), marker->tid, __ATOMIC_RELAXED);
+        __atomic_store_n(&(record->blockName), marker->blockName, __ATOMIC_RELAXED);
+        for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+            __atomic_store_n(&(record->histogram[i]), (unsigned long long)marker->histogram[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&(record->seq), seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Estimates a percentile of durations from a duration histogram
+ *
+ * @param histogram Number of runs in each of the EZP_HISTOGRAM_BUCKETS duration buckets
+ * @param percentile Requested percentile, between 0 and 1
+ *
+ * @return Estimated duration in nanoseconds, 0 if the histogram is empty
+ */
+inline double getHistogramPercentile(const unsigned long long* histogram, double percentile)
+{
+    unsigned long long count = 0;
+    for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+        count += histogram[i];
+    if(count == 0)
+        return 0.0;
+
+    //Find the bucket that holds the rank and interpolate linearly inside it
+    double rank = percentile*count;
+    unsigned long long cumulative = 0;
+    for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++){
+        if(histogram[i] > 0 && cumulative + histogram[i] >= rank){
+            if(i == 0)
+                return 0.0;
+            double low = ldexp(1.0, i - 1);
+            if(i == EZP_HISTOGRAM_BUCKETS - 1) //Last bucket has no upper bound
+                return low;
+            return low + low*(rank - cumulative)/histogram[i];
+        }
+        cumulative += histogram[i];
+    }
+    return ldexp(1.0, EZP_HISTOGRAM_BUCKETS - 2);
+}
+
+//This function is time critical!
+inline void EasyPerformanceAnalyzer::unhashStr(unsigned int hash, char* output)
+{
+    output[4] = '\0';
+
+    output[3] = hash;
+    hash = hash >> 8;
+
+    output[2] = hash;
+    hash = hash >> 8;
+
+    output[1] = hash;
+    hash = hash >> 8;
+
+    output[0] = hash;
+}
+
+} /* namespace ezp */
+
+#endif /* EZP_INTERNAL_HPP */
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_malloc.cpp
+ * @brief Allocator shim to load with LD_PRELOAD, counts the allocations of each thread for EZP_SET_ALLOC_STATS
+ * @date 2026-10-18
+ *
+ * operator new and the rest of the C++ runtime allocate through malloc() and are counted as well; valloc(), pvalloc() and
+ * reallocarray() are counted through memalign() and realloc()
+ */
+
+#include<cerrno>
+#include<cstring>
+#include<dlfcn.h>
+#include<stdint.h>
+#include<unistd.h>
+
+#include"ezp.hpp"
+
+/**
+ * @brief Size of the buffer that serves allocations made by dlsym() before the real allocator is found
+ */
+#define EZP_BOOTSTRAP_BUFFER_SIZE 8192
+
+/**
+ * @brief Allocations of the calling thread; initial-exec so that reaching it never allocates
+ */
+static __thread ezp::AllocCounters counters __attribute__((tls_model("initial-exec")));
+
+static void* (*realMalloc)(size_t) = NULL;
+static void* (*realCalloc)(size_t, size_t) = NULL;
+static void* (*realRealloc)(void*, size_t) = NULL;
+static void (*realFree)(void*) = NULL;
+static int (*realPosixMemalign)(void**, size_t, size_t) = NULL;
+static void* (*realAlignedAlloc)(size_t, size_t) = NULL;
+static void* (*realMemalign)(size_t, size_t) = NULL;
+
+static char bootstrapBuffer[EZP_BOOTSTRAP_BUFFER_SIZE] __attribute__((aligned(16)));
+static size_t bootstrapUsed = 0;
+static bool resolving = false;
+
+/**
+ * @brief Serves an allocation from the bootstrap buffer, which is never freed
+ *
+ * @param size Number of bytes
+ * @param alignment Alignment of the memory, a power of two
+ *
+ * @return Zeroed memory, NULL if the buffer is exhausted
+ */
+static void* bootstrapAlloc(size_t size, size_t alignment = 16)
+{
+    if(alignment < 16)
+        alignment = 16;
+    uintptr_t base = (uintptr_t)bootstrapBuffer;
+    size_t offset = ((base + bootstrapUsed + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    size = (size + 15) & ~(size_t)15;
+    if(offset > EZP_BOOTSTRAP_BUFFER_SIZE || size > EZP_BOOTSTRAP_BUFFER_SIZE - offset)
+        return NULL;
+    bootstrapUsed = offset + size;
+    return bootstrapBuffer + offset;
+}
+
+/**
+ * @brief Tells whether memory was served from the bootstrap buffer
+ *
+ * @param ptr Memory
+ *
+ * @return Whether ptr is in the bootstrap buffer
+ */
+static bool isBootstrap(void* ptr)
+{
+    return (char*)ptr >= bootstrapBuffer && (char*)ptr < bootstrapBuffer + EZP_BOOTSTRAP_BUFFER_SIZE;
+}
+
+/**
+ * @brief Finds the allocator functions that come after this library, i.e those of the C library
+ */
+static void findRealAllocator()
+{
+    resolving = true;
+    realCalloc = (void* (*)(size_t, size_t))dlsym(RTLD_NEXT, "calloc");
+    realMalloc = (void* (*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    realRealloc = (void* (*)(void*, size_t))dlsym(RTLD_NEXT, "realloc");
+    realFree = (void (*)(void*))dlsym(RTLD_NEXT, "free");
+    realPosixMemalign = (int (*)(void**, size_t, size_t))dlsym(RTLD_NEXT, "posix_memalign");
+    realAlignedAlloc = (void* (*)(size_t, size_t))dlsym(RTLD_NEXT, "aligned_alloc");
+    realMemalign = (void* (*)(size_t, size_t))dlsym(RTLD_NEXT, "memalign");
+    resolving = false;
+}
+
+/**
+ * @brief Finds the real allocator as soon as the library is loaded, before threads are likely to exist
+ */
+__attribute__((constructor)) static void initAllocator()
+{
+    if(realMalloc == NULL)
+        findRealAllocator();
+}
+
+extern "C"{
+
+/**
+ * @brief Gives the allocation counters of the calling thread to libezp
+ *
+ * @return Allocation counters of the calling thread, valid as long as the thread lives
+ */
+__attribute__((visibility("default"))) ezp::AllocCounters* ezp_get_alloc_counters()
+{
+    return &counters;
+}
+
+void* malloc(size_t size)
+{
+    if(realMalloc == NULL){
+        if(resolving)
+            return bootstrapAlloc(size);
+        findRealAllocator();
+    }
+    counters.count++;
+    counters.bytes += size;
+    return realMalloc(size);
+}
+
+void* calloc(size_t num, size_t size)
+{
+    //dlsym() itself uses calloc()
+    if(realCalloc == NULL){
+        if(resolving)
+            return bootstrapAlloc(num*size);
+        findRealAllocator();
+    }
+    counters.count++;
+    counters.bytes += num*size;
+    return realCalloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    if(realRealloc == NULL){
+        if(resolving)
+            return bootstrapAlloc(size);
+        findRealAllocator();
+    }
+    counters.count++;
+    counters.bytes += size;
+    if(isBootstrap(ptr)){
+        void* moved = realMalloc(size);
+        size_t available = bootstrapBuffer + EZP_BOOTSTRAP_BUFFER_SIZE - (char*)ptr;
+        if(moved != NULL)
+            memcpy(moved, ptr, size < available ? size : available);
+        return moved;
+    }
+    return realRealloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+    if(ptr == NULL || isBootstrap(ptr))
+        return;
+    if(realFree == NULL)
+        findRealAllocator();
+    realFree(ptr);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    if(realPosixMemalign == NULL){
+        if(resolving){
+            if(alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+                return EINVAL;
+            *ptr = bootstrapAlloc(size, alignment);
+            return *ptr != NULL ? 0 : ENOMEM;
+        }
+        findRealAllocator();
+    }
+    counters.count++;
+    counters.bytes += size;
+    return realPosixMemalign(ptr, alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    if(realAlignedAlloc == NULL){
+        if(resolving)
+            return (alignment & (alignment - 1)) == 0 ? bootstrapAlloc(size, alignment) : NULL;
+        findRealAllocator();
+    }
+    counters.count++;
+    counters.bytes += size;
+    return realAlignedAlloc(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    if(realMemalign == NULL){
+        if(resolving)
+            return (alignment & (alignment - 1)) == 0 ? bootstrapAlloc(size, alignment) : NULL;
+        findRealAllocator();
+    }
+    counters.count++;
+    counters.bytes += size;
+    return realMemalign(alignment, size);
+}
+
+void* valloc(size_t size)
+{
+    return memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+void* pvalloc(size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    if(size > SIZE_MAX - page){
+        errno = ENOMEM;
+        return NULL;
+    }
+    return memalign(page, (size + page - 1) & ~(page - 1));
+}
+
+void* reallocarray(void* ptr, size_t num, size_t size)
+{
+    if(size != 0 && num > SIZE_MAX/size){
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, num*size);
+}
+
+}
+
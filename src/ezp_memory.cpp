@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_memory.cpp
+ * @brief Memory limits and memory usage report of EZP itself
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Appends one row of the memory usage table
+ *
+ * @param output String to append to
+ * @param structure Name of the structure
+ * @param count Number of elements of the structure, negative if it is not counted in elements
+ * @param bytes Bytes that the structure takes
+ * @param total Total to add bytes to
+ */
+static void appendMemoryRow(std::string& output, const char* structure, long long count, unsigned long long bytes, unsigned long long& total)
+{
+    char buf[128];
+    char cbuf[32];
+    if(count >= 0)
+        snprintf(cbuf, sizeof(cbuf), "%lld", count);
+    else
+        snprintf(cbuf, sizeof(cbuf), "-");
+    snprintf(buf, sizeof(buf), "EZP: %-28s%-12s%llu\n", structure, cbuf, bytes);
+    output += buf;
+    total += bytes;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setMemoryLimits(unsigned int records, unsigned int pools, unsigned int ringSize)
+{
+    __atomic_store_n(&maxRecords, records, __ATOMIC_RELAXED);
+    __atomic_store_n(&maxPools, pools, __ATOMIC_RELAXED);
+    __atomic_store_n(&traceRingSize, ringSize > 0 ? ringSize : 1, __ATOMIC_RELAXED);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::formatMemoryUsage(std::string& output)
+{
+    char buf[256];
+    unsigned long long total = 0;
+
+    output += "EZP: ===============================================================================\n";
+    output += "EZP: Memory used by EZP in this process, map nodes estimated\n";
+    output += "EZP: -------------------------------------------------------------------------------\n";
+    output += "EZP: Structure                   Count       Bytes\n";
+    output += "EZP: -------------------------------------------------------------------------------\n";
+
+    //Each lock is taken on its own so that the report never holds two of them
+    pthread_mutex_lock(&offlineLock);
+    size_t numMarkers = numOfflineMarkers;
+    size_t numSpareMarkers = freeOfflineMarkers.size();
+    size_t numOfflineKeys = offlineBlocks.size();
+    unsigned long long spareNodeBytes = PoolAllocatorBase::freeBytes;
+    unsigned long long overflows = numOverflows;
+    pthread_mutex_unlock(&offlineLock);
+    size_t offlineNodeBytes = sizeof(Blk2AMarker::value_type) + EZP_MAP_NODE_OVERHEAD;
+    appendMemoryRow(output, "Offline records", numMarkers - numSpareMarkers, (numMarkers - numSpareMarkers)*sizeof(AggregateMarker), total);
+    appendMemoryRow(output, "Spare offline records", numSpareMarkers, numSpareMarkers*sizeof(AggregateMarker), total);
+    appendMemoryRow(output, "Offline record map", numOfflineKeys, numOfflineKeys*offlineNodeBytes, total);
+    appendMemoryRow(output, "Spare offline map nodes", spareNodeBytes/offlineNodeBytes, spareNodeBytes, total);
+
+    pthread_mutex_lock(&lock);
+    size_t numBlocks = blocks.size();
+    pthread_mutex_unlock(&lock);
+    appendMemoryRow(output, "Real-time records", numBlocks,
+            numBlocks*(sizeof(Timespec) + sizeof(Blk2Clk::value_type) + EZP_MAP_NODE_OVERHEAD), total);
+
+    pthread_mutex_lock(&smoothLock);
+    size_t numSmoothBlocks = smoothBlocks.size();
+    pthread_mutex_unlock(&smoothLock);
+    appendMemoryRow(output, "Smoothed records", numSmoothBlocks,
+            numSmoothBlocks*(sizeof(SmoothMarker) + sizeof(Blk2SMarker::value_type) + EZP_MAP_NODE_OVERHEAD), total);
+
+    //Rings are only allocated by their own thread, a ring being allocated meanwhile is counted or not
+    size_t numThreads = 0, numRetired = 0, numTraceRings = 0, numSampleRings = 0;
+    unsigned long long traceRingBytes = 0;
+    pthread_mutex_lock(&threadLock);
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++){
+        ThreadInfo* info = it->second;
+        if(info->retired)
+            numRetired++;
+        else
+            numThreads++;
+        if(__atomic_load_n(&(info->traceRing), __ATOMIC_RELAXED) != NULL){
+            numTraceRings++;
+            traceRingBytes += (unsigned long long)__atomic_load_n(&(info->traceRingSize), __ATOMIC_RELAXED)*sizeof(TraceEvent);
+        }
+        if(__atomic_load_n(&(info->sampleRing), __ATOMIC_RELAXED) != NULL)
+            numSampleRings++;
+    }
+    pthread_mutex_unlock(&threadLock);
+    size_t threadBytes = sizeof(ThreadInfo) + sizeof(Tid2Thread::value_type) + EZP_MAP_NODE_OVERHEAD;
+    appendMemoryRow(output, "Threads", numThreads, numThreads*threadBytes, total);
+    appendMemoryRow(output, "Retired buckets", numRetired,
+            numRetired*(threadBytes + sizeof(Name2Thread::value_type) + EZP_THREAD_NAME_LENGTH + EZP_MAP_NODE_OVERHEAD), total);
+    appendMemoryRow(output, "Trace rings", numTraceRings, traceRingBytes, total);
+    appendMemoryRow(output, "Sample rings", numSampleRings, numSampleRings*EZP_SAMPLE_RING_SIZE*sizeof(SampleEvent), total);
+
+    pthread_mutex_lock(&recordLock);
+    size_t numBuffers = numRecordBuffers;
+    for(RecordBuffer* buffer = freeRecordBuffers; buffer != NULL; buffer = buffer->next)
+        numBuffers++;
+    pthread_mutex_unlock(&recordLock);
+    appendMemoryRow(output, "Record buffers", numBuffers, numBuffers*sizeof(RecordBuffer), total);
+
+    if(sharedStats != NULL)
+        appendMemoryRow(output, "Shared memory segment", 1, sizeof(SharedHeader) + EZP_MAX_DUMPED_BLOCKS*sizeof(SharedRecord), total);
+    appendMemoryRow(output, "Static tables", -1, sizeof(offlineRecords) + sizeof(blockIdSlots) + sizeof(blockIdNames) + sizeof(disabledBlocks) +
+            sizeof(traceThresholds) + sizeof(cpuNodes) + sizeof(functionSlots) + sizeof(functionAddresses) + sizeof(disabledFunctions), total);
+
+    output += "EZP: -------------------------------------------------------------------------------\n";
+    snprintf(buf, sizeof(buf), "EZP: %-40s%llu\n", "Total", total);
+    output += buf;
+    output += "EZP: -------------------------------------------------------------------------------\n";
+    unsigned int recordLimit = __atomic_load_n(&maxRecords, __ATOMIC_RELAXED);
+    unsigned int poolLimit = __atomic_load_n(&maxPools, __ATOMIC_RELAXED);
+    char records[16], pools[16];
+    snprintf(records, sizeof(records), "%u", recordLimit);
+    snprintf(pools, sizeof(pools), "%u", poolLimit);
+    snprintf(buf, sizeof(buf), "EZP: Limits: %s records per analysis, %s retired buckets, trace rings of %u blocks\n",
+            recordLimit > 0 ? records : "no limit on", poolLimit > 0 ? pools : "no limit on", __atomic_load_n(&traceRingSize, __ATOMIC_RELAXED));
+    output += buf;
+
+    //The othr record of a thread is created even past the limit, and live threads cannot be turned away
+    if(recordLimit > 0){
+        snprintf(buf, sizeof(buf), "EZP: Bound: %u records per analysis plus one %s record per live thread, i.e %llu offline records now\n",
+                recordLimit, EZP_OTHER_NAME, (unsigned long long)recordLimit + numThreads);
+        output += buf;
+    }
+    snprintf(buf, sizeof(buf), "EZP: Live threads are not capped, each takes %llu bytes plus its rings until it exits\n", (unsigned long long)threadBytes);
+    output += buf;
+    snprintf(buf, sizeof(buf), "EZP: %llu offline blocks started in %s records for lack of a record of their own\n", overflows, EZP_OTHER_NAME);
+    output += buf;
+    output += "EZP: ===============================================================================\n";
+}
+
+} /* namespace ezp */
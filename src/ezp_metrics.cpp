@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_metrics.cpp
+ * @brief OpenMetrics exporter of offline analysis results
+ * @date 2026-10-18
+ */
+
+#include<cstddef>
+#include<cstdlib>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Offline analysis results of one block read from its marker(s)
+ */
+struct MetricsRecord_t{
+    unsigned long long count;                           ///< Number of runs
+    unsigned long long sum;                             ///< Total time of runs in nanoseconds
+    unsigned long long histogram[EZP_HISTOGRAM_BUCKETS];///< Number of runs in each duration bucket
+
+    /**
+     * @brief Creates an empty record
+     */
+    MetricsRecord_t()
+    {
+        count = 0;
+        sum = 0;
+        memset(histogram, 0, sizeof(histogram));
+    }
+
+    /**
+     * @brief Adds the current contents of a marker to this record without locking
+     *
+     * @param marker Marker that may be concurrently written by its own thread
+     */
+    void add(AggregateMarker* marker)
+    {
+        for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++){
+            unsigned int bucketCount = __atomic_load_n(&(marker->histogram[i]), __ATOMIC_RELAXED);
+            histogram[i] += bucketCount;
+            count += bucketCount; //Counting from the buckets keeps count and +Inf bucket consistent
+        }
+        sum += __atomic_load_n(&(marker->totalTime), __ATOMIC_RELAXED);
+    }
+};
+
+typedef struct MetricsRecord_t MetricsRecord;
+
+/**
+ * @brief Appends one histogram series in OpenMetrics text format
+ *
+ * @param output String to append to
+ * @param family Name of the metric family
+ * @param labels Labels of the series without braces, e.g block="XMPL"
+ * @param record Values of the series
+ */
+static void appendHistogram(std::string& output, const char* family, const char* labels, const MetricsRecord& record)
+{
+    char buf[256];
+    unsigned long long cumulative = 0;
+    for(int i=0;i<EZP_HISTOGRAM_BUCKETS - 1;i++){
+        cumulative += record.histogram[i];
+        snprintf(buf, sizeof(buf), "%s_bucket{%s,le=\"%.10g\"} %llu\n", family, labels, ldexp(1e-9, i), cumulative);
+        output += buf;
+    }
+    snprintf(buf, sizeof(buf), "%s_bucket{%s,le=\"+Inf\"} %llu\n", family, labels, record.count);
+    output += buf;
+    snprintf(buf, sizeof(buf), "%s_count{%s} %llu\n", family, labels, record.count);
+    output += buf;
+    snprintf(buf, sizeof(buf), "%s_sum{%s} %.9f\n", family, labels, record.sum/1e9);
+    output += buf;
+}
+
+/**
+ * @brief Writes a block name as a label value, escaping as required by OpenMetrics
+ *
+ * @param name Block name, of maximum length EZP_BLOCK_LABEL_LENGTH - 1
+ * @param output Preallocated buffer to write to, must be at least 2*EZP_BLOCK_LABEL_LENGTH characters long
+ */
+static void escapeLabelValue(const char* name, char* output)
+{
+    for(; *name != '\0'; name++){
+        if(*name == '\\' || *name == '"'){
+            *output++ = '\\';
+            *output++ = *name;
+        }
+        else if(*name == '\n'){
+            *output++ = '\\';
+            *output++ = 'n';
+        }
+        else
+            *output++ = *name;
+    }
+    *output = '\0';
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::launchMetricsExporter(const char* address)
+{
+    pthread_mutex_lock(&exporterLauncherLock);
+
+    if(exporterRunning){ //Extra guard agains other threads entering this function at the same time
+        pthread_mutex_unlock(&exporterLauncherLock);
+        return;
+    }
+
+    int acceptorFD;
+
+    //Loopback TCP socket
+    if(strncmp(address, "tcp:", 4) == 0){
+        struct sockaddr_in acceptorAddr;
+
+        if((acceptorFD = socket(AF_INET, SOCK_STREAM, 0)) == -1){
+            EZP_PERR("EZP: socket() error: %s\n",strerror(errno));
+            pthread_mutex_unlock(&exporterLauncherLock);
+            return;
+        }
+
+        int reuse = 1;
+        setsockopt(acceptorFD, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        memset(&acceptorAddr, 0, sizeof(acceptorAddr));
+        acceptorAddr.sin_family = AF_INET;
+        acceptorAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        acceptorAddr.sin_port = htons(atoi(address + 4));
+
+        if(bind(acceptorFD, (struct sockaddr*)&acceptorAddr, sizeof(acceptorAddr)) == -1){
+            EZP_PERR("EZP: bind() error on exporter address %s: %s\n", address, strerror(errno));
+            close(acceptorFD);
+            pthread_mutex_unlock(&exporterLauncherLock);
+            return;
+        }
+    }
+
+    //Abstract or filesystem UNIX socket
+    else if(strncmp(address, "unix:", 5) == 0 && address[5] != '\0'){
+        struct sockaddr_un acceptorAddr;
+        const char* name = address + 5;
+
+        if((acceptorFD = socket(AF_UNIX, SOCK_STREAM, 0)) == -1){
+            EZP_PERR("EZP: socket() error: %s\n",strerror(errno));
+            pthread_mutex_unlock(&exporterLauncherLock);
+            return;
+        }
+
+        memset(&acceptorAddr, 0, sizeof(acceptorAddr));
+        acceptorAddr.sun_family = AF_UNIX;
+        socklen_t addrLen;
+        if(name[0] == '/'){
+            strncpy(acceptorAddr.sun_path, name, sizeof(acceptorAddr.sun_path) - 1);
+            unlink(name);
+            addrLen = sizeof(acceptorAddr);
+        }
+        else{
+            strncpy(acceptorAddr.sun_path + 1, name, sizeof(acceptorAddr.sun_path) - 2);
+            addrLen = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(acceptorAddr.sun_path + 1);
+        }
+
+        if(bind(acceptorFD, (struct sockaddr*)&acceptorAddr, addrLen) == -1){
+            EZP_PERR("EZP: bind() error on exporter address %s: %s\n", address, strerror(errno));
+            close(acceptorFD);
+            pthread_mutex_unlock(&exporterLauncherLock);
+            return;
+        }
+    }
+
+    else{
+        EZP_PERR("EZP: Invalid exporter address %s, must be tcp:PORT or unix:NAME\n", address);
+        pthread_mutex_unlock(&exporterLauncherLock);
+        return;
+    }
+
+    if(listen(acceptorFD, 5) == -1){
+        EZP_PERR("EZP: listen() error: %s\n",strerror(errno));
+        close(acceptorFD);
+        pthread_mutex_unlock(&exporterLauncherLock);
+        return;
+    }
+
+    pthread_attr_t exporterAttr;
+    pthread_attr_init(&exporterAttr);
+    pthread_attr_setdetachstate(&exporterAttr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&metricsExporter, &exporterAttr, &EasyPerformanceAnalyzer::exportMetrics, (void*)(new int(acceptorFD)));
+    pthread_attr_destroy(&exporterAttr);
+    if(!ret){
+        exporterAcceptor = acceptorFD;
+        exporterRunning = true;
+    }
+    else{
+        EZP_PERR("EZP: pthread_create() error: %s\n", strerror(ret));
+        close(acceptorFD);
+    }
+
+    pthread_mutex_unlock(&exporterLauncherLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::snapshotOfflineMarkers(std::vector<Blk2AMarkerPair>& markers, unsigned int& generation)
+{
+    //Markers are never freed, so the previous copy stays valid as long as no record was added or removed
+    if(__atomic_load_n(&offlineGeneration, __ATOMIC_ACQUIRE) == generation)
+        return;
+
+    pthread_mutex_lock(&offlineLock);
+    markers.assign(offlineBlocks.begin(), offlineBlocks.end());
+    generation = offlineGeneration;
+    pthread_mutex_unlock(&offlineLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::formatMetrics(const std::vector<Blk2AMarkerPair>& markers, std::string& output)
+{
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    char escaped[2*EZP_BLOCK_LABEL_LENGTH];
+    char labels[2*EZP_BLOCK_LABEL_LENGTH + 32];
+
+    std::map<unsigned int, MetricsRecord> summed;
+    for(std::vector<Blk2AMarkerPair>::const_iterator it = markers.begin(); it != markers.end(); it++)
+        summed[it->first.blockName].add(it->second);
+
+    if(exportPerThread){
+        output += "# TYPE ezp_block_seconds histogram\n";
+        output += "# UNIT ezp_block_seconds seconds\n";
+        output += "# HELP ezp_block_seconds Time spent in offline analysis blocks per thread.\n";
+        for(std::vector<Blk2AMarkerPair>::const_iterator it = markers.begin(); it != markers.end(); it++){
+            MetricsRecord record;
+            record.add(it->second);
+            getBlockLabel(it->first.blockName, cbuf);
+            escapeLabelValue(cbuf, escaped);
+            snprintf(labels, sizeof(labels), "block=\"%s\",tid=\"%d\"", escaped, it->first.tid);
+            appendHistogram(output, "ezp_block_seconds", labels, record);
+        }
+    }
+
+    output += "# TYPE ezp_block_summed_seconds histogram\n";
+    output += "# UNIT ezp_block_summed_seconds seconds\n";
+    output += "# HELP ezp_block_summed_seconds Time spent in offline analysis blocks summed across threads.\n";
+    for(std::map<unsigned int, MetricsRecord>::iterator it = summed.begin(); it != summed.end(); it++){
+        getBlockLabel(it->first, cbuf);
+        escapeLabelValue(cbuf, escaped);
+        snprintf(labels, sizeof(labels), "block=\"%s\"", escaped);
+        appendHistogram(output, "ezp_block_summed_seconds", labels, it->second);
+    }
+
+    output += "# EOF\n";
+}
+
+//This function is not time critical
+void* EasyPerformanceAnalyzer::exportMetrics(void* arg)
+{
+    int clientFD;
+    int acceptorFD = *((int*)arg);
+    delete (int*)arg;
+
+    std::vector<Blk2AMarkerPair> markers;
+    unsigned int generation = 0;
+    std::string response;
+    char request[1024];
+
+    EZP_PRINT("EZP: [%d]\tMetrics exporter running...\n",(unsigned int)EZP_GET_TID);
+
+    while(true){
+        if((clientFD = accept(acceptorFD, NULL, NULL)) == -1) {
+            EZP_PERR("EZP: accept() error: %s\n",strerror(errno));
+            continue;
+        }
+
+        //Do not let a stuck scraper block the exporter forever
+        struct timeval timeout;
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+        setsockopt(clientFD, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(clientFD, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        //Consume the request header, its contents do not matter since there is a single resource
+        size_t received = 0;
+        int ret;
+        while(received < sizeof(request) - 1 && (ret = read(clientFD, request + received, sizeof(request) - 1 - received)) > 0){
+            received += ret;
+            request[received] = '\0';
+            if(strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL)
+                break;
+        }
+
+        snapshotOfflineMarkers(markers, generation);
+
+        std::string body;
+        formatMetrics(markers, body);
+
+        char header[256];
+        snprintf(header, sizeof(header),
+                "HTTP/1.0 200 OK\r\n"
+                "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                "Content-Length: %lu\r\n"
+                "Connection: close\r\n\r\n", (unsigned long)body.size());
+        response = header;
+        response += body;
+
+        size_t sent = 0;
+        while(sent < response.size()){
+            ret = send(clientFD, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if(ret <= 0){
+                EZP_PERR("EZP: send() error: %s\n", strerror(errno));
+                break;
+            }
+            sent += ret;
+        }
+
+        close(clientFD);
+    }
+
+    //This function should and does return only when the process leaves
+}
+
+} /* namespace ezp */
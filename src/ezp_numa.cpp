@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_numa.cpp
+ * @brief Breakdown of offline analysis records per NUMA node
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Highest NUMA node index looked for in sysfs, node indices may have gaps
+ */
+#define EZP_MAX_SYSFS_NODES 256
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setNodeStats(bool on)
+{
+    pthread_once(&cpuNodesOnce, loadCpuNodes);
+    setState(STATE_NODE_STATS, on);
+}
+
+//This function is not time critical, called once
+void EasyPerformanceAnalyzer::loadCpuNodes()
+{
+    int numNodes = 0;
+    for(int node=0;node<EZP_MAX_SYSFS_NODES;node++){
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if(file == NULL)
+            continue;
+
+        //CPU list such as "0-3,8-11"
+        unsigned char index = node < EZP_MAX_NUMA_NODES ? node : EZP_MAX_NUMA_NODES - 1;
+        int first, last;
+        while(fscanf(file, "%d", &first) == 1){
+            last = first;
+            int c = fgetc(file);
+            if(c == '-'){
+                if(fscanf(file, "%d", &last) != 1)
+                    break;
+                c = fgetc(file);
+            }
+            for(int cpu = first; cpu <= last && cpu < EZP_MAX_CPUS; cpu++)
+                __atomic_store_n(&(cpuNodes[cpu]), index, __ATOMIC_RELAXED);
+            if(c != ',')
+                break;
+        }
+        fclose(file);
+
+        if(node >= EZP_MAX_NUMA_NODES && numNodes < EZP_MAX_NUMA_NODES)
+            EZP_PERR("EZP: NUMA node %d and above are counted as node %d\n", node, EZP_MAX_NUMA_NODES - 1);
+        numNodes = node + 1;
+    }
+
+    //Without sysfs, e.g on Android, all CPUs stay on node 0
+    if(numNodes == 0)
+        EZP_PERR("EZP: Could not read NUMA nodes from /sys/devices/system/node, counting all CPUs as node 0\n");
+}
+
+} /* namespace ezp */
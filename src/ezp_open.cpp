@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_open.cpp
+ * @brief Listing of the offline analysis blocks that are started but not ended, to find where threads hang
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Number of times the open block stack of a thread is read again while the thread keeps changing it
+ */
+#define EZP_OPEN_BLOCKS_RETRIES 1000
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::formatOpenBlocks(std::string& output)
+{
+    char buf[EZP_BLOCK_LABEL_LENGTH + 128];
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    char elapsed[32];
+    OpenBlock blocks[EZP_MAX_OPEN_BLOCKS];
+    Timespec now;
+    clock_gettime(EZP_WALL_CLOCK, &now);
+
+    //Blocks only read the wall clock when something needs it, from now on listings do
+    if(!(__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_OPEN_TIMES))
+        setState(STATE_OPEN_TIMES, true);
+
+    output += "EZP: ===============================================================================\n";
+    output += "EZP: Open offline analysis blocks, outermost first\n";
+    output += "EZP: -------------------------------------------------------------------------------\n";
+    output += "EZP: Thread ID    Thread              Depth    Name    Elapsed(ms)\n";
+    output += "EZP: -------------------------------------------------------------------------------\n";
+
+    //Threads never wait for the reader, it copies each stack again until the thread did not change it meanwhile
+    int numListed = 0;
+    pthread_mutex_lock(&threadLock);
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++){
+        ThreadInfo* info = it->second;
+        if(info->retired)
+            continue;
+
+        unsigned int depth = 0;
+        bool consistent = false;
+        for(int retry=0;retry<EZP_OPEN_BLOCKS_RETRIES && !consistent;retry++){
+            unsigned int sequence = __atomic_load_n(&(info->openSequence), __ATOMIC_ACQUIRE);
+            if(sequence & 1)
+                continue;
+            depth = __atomic_load_n(&(info->numOpenBlocks), __ATOMIC_ACQUIRE);
+            if(depth > EZP_MAX_OPEN_BLOCKS)
+                depth = EZP_MAX_OPEN_BLOCKS;
+            memcpy(blocks, info->openBlocks, depth*sizeof(OpenBlock));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            consistent = __atomic_load_n(&(info->openSequence), __ATOMIC_RELAXED) == sequence;
+        }
+        if(!consistent){
+            snprintf(buf, sizeof(buf), "EZP: %9d    %-16s    busy, starting and ending blocks too fast to be read\n", info->tid, info->name);
+            output += buf;
+            continue;
+        }
+
+        for(unsigned int i=0;i<depth;i++){
+            getBlockLabel(blocks[i].blockName, cbuf);
+            if(blocks[i].wallBegin.tv_sec == 0 && blocks[i].wallBegin.tv_nsec == 0)
+                snprintf(elapsed, sizeof(elapsed), "-");
+            else
+                snprintf(elapsed, sizeof(elapsed), "%.2f", getTimeDiff(&(blocks[i].wallBegin), &now));
+            snprintf(buf, sizeof(buf), "EZP: %9d    %-16s    %-5u    %4s    %s\n",
+                    info->tid, info->name, i, cbuf, elapsed);
+            output += buf;
+            numListed++;
+        }
+    }
+    pthread_mutex_unlock(&threadLock);
+
+    if(numListed == 0)
+        output += "EZP: No open block\n";
+    output += "EZP: ===============================================================================\n";
+}
+
+} /* namespace ezp */
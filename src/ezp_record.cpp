@@ -0,0 +1,721 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_record.cpp
+ * @brief Recordings of every ended offline analysis block, compressed into chunks of varints by a background thread
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<fcntl.h>
+#include<queue>
+#include<set>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Appends a varint to a chunk
+ *
+ * @param value Value to append
+ * @param output Chunk to append to
+ */
+static void appendVarint(unsigned long long value, std::string& output)
+{
+    while(value >= 0x80){
+        output += (char)(value | 0x80);
+        value >>= 7;
+    }
+    output += (char)value;
+}
+
+/**
+ * @brief Reads a varint from a chunk
+ *
+ * @param data Position in the chunk, moved past the varint
+ * @param end End of the chunk
+ * @param value Where to write the value
+ *
+ * @return Whether a whole varint was read before the end of the chunk
+ */
+static bool readVarint(const unsigned char*& data, const unsigned char* end, unsigned long long& value)
+{
+    value = 0;
+    for(int shift = 0; data < end && shift < 64; shift += 7){
+        unsigned char byte = *data++;
+        value |= (unsigned long long)(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::startRecording(const char* path)
+{
+    pthread_mutex_lock(&recordLock);
+    if(recordFile != NULL){
+        pthread_mutex_unlock(&recordLock);
+        EZP_PERR("EZP: Already recording, stop the recording first\n");
+        return false;
+    }
+
+    recordFile = fopen(path, "wb");
+    if(recordFile == NULL){
+        pthread_mutex_unlock(&recordLock);
+        EZP_PERR("EZP: fopen() error: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    Timespec now;
+    clock_gettime(EZP_WALL_CLOCK, &now);
+    memcpy(recordHeader.magic, "EZPR", 4);
+    recordHeader.version = EZP_RECORD_VERSION;
+    recordHeader.pid = getpid();
+    recordHeader.reserved = 0;
+    recordHeader.beginTime = now.tv_sec*1000000000ULL + now.tv_nsec;
+    fwrite(&recordHeader, sizeof(recordHeader), 1, recordFile);
+    recordStopping = false;
+
+    int err = pthread_create(&recordEncoder, NULL, encodeRecording, NULL);
+    if(err != 0){
+        EZP_PERR("EZP: pthread_create() error: %s\n", strerror(err));
+        fclose(recordFile);
+        recordFile = NULL;
+        pthread_mutex_unlock(&recordLock);
+        return false;
+    }
+    bool registerStop = !stopRecordingRegistered;
+    stopRecordingRegistered = true;
+    pthread_mutex_unlock(&recordLock);
+
+    if(registerStop && atexit(&EasyPerformanceAnalyzer::stopRecording) != 0)
+        EZP_PERR("EZP: atexit() error: Could not register the recording stop handler\n");
+    setState(STATE_RECORDING, true);
+    EZP_PRINT("EZP: Recording offline analysis blocks to %s\n", path);
+    return true;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::stopRecording()
+{
+    pthread_mutex_lock(&recordLock);
+    if(recordFile == NULL || recordStopping){
+        pthread_mutex_unlock(&recordLock);
+        return;
+    }
+    recordStopping = true;
+    pthread_mutex_unlock(&recordLock);
+    setState(STATE_RECORDING, false);
+
+    //Take the partial buffers of the live threads; a thread appending right now finds its buffer gone and queues it itself
+    pthread_mutex_lock(&threadLock);
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++){
+        RecordBuffer* buffer = __atomic_exchange_n(&(it->second->recordBuffer), NULL, __ATOMIC_ACQUIRE);
+        if(buffer != NULL && buffer != EZP_RECORD_BUSY)
+            queueRecordBuffer(it->second, buffer);
+    }
+    pthread_mutex_unlock(&threadLock);
+
+    pthread_mutex_lock(&recordLock);
+    pthread_cond_signal(&recordCond);
+    pthread_mutex_unlock(&recordLock);
+    pthread_join(recordEncoder, NULL);
+}
+
+//This function is not time critical, called once per EZP_RECORD_BUFFER_EVENTS blocks
+RecordBuffer* EasyPerformanceAnalyzer::takeRecordBuffer()
+{
+    pthread_mutex_lock(&recordLock);
+    if(recordFile == NULL || recordStopping){
+        pthread_mutex_unlock(&recordLock);
+        return NULL;
+    }
+    RecordBuffer* buffer = freeRecordBuffers;
+    if(buffer != NULL)
+        freeRecordBuffers = buffer->next;
+    else
+        buffer = new RecordBuffer;
+    numRecordBuffers++;
+    pthread_mutex_unlock(&recordLock);
+
+    buffer->numEvents = 0;
+    buffer->numOpenEvents = 0;
+    buffer->next = NULL;
+    return buffer;
+}
+
+//This function is not time critical, called once per EZP_RECORD_BUFFER_EVENTS blocks
+void EasyPerformanceAnalyzer::queueRecordBuffer(ThreadInfo* info, RecordBuffer* buffer)
+{
+    buffer->tid = info->tid;
+    memcpy(buffer->threadName, info->name, sizeof(buffer->threadName));
+    buffer->next = NULL;
+
+    pthread_mutex_lock(&recordLock);
+    if(recordQueueTail != NULL)
+        recordQueueTail->next = buffer;
+    else
+        recordQueue = buffer;
+    recordQueueTail = buffer;
+    pthread_cond_signal(&recordCond);
+    pthread_mutex_unlock(&recordLock);
+}
+
+//This function is not time critical
+void* EasyPerformanceAnalyzer::encodeRecording(void*)
+{
+    //Block names get indices in the order they first appear so that common names take one byte
+    std::map<unsigned int, unsigned int> nameIndices;
+    std::vector<unsigned int> names;
+    std::vector<RecordChunk> chunks;
+    unsigned long long offset = sizeof(RecordHeader);
+    std::string data;
+
+    pthread_mutex_lock(&recordLock);
+    FILE* file = recordFile;
+    while(true){
+        while(recordQueue == NULL && !(recordStopping && numRecordBuffers == 0))
+            pthread_cond_wait(&recordCond, &recordLock);
+        RecordBuffer* buffer = recordQueue;
+        if(buffer == NULL)
+            break;
+        recordQueue = buffer->next;
+        if(recordQueue == NULL)
+            recordQueueTail = NULL;
+        pthread_mutex_unlock(&recordLock);
+
+        if(buffer->numEvents > 0){
+            RecordChunk chunk;
+            memset(&chunk, 0, sizeof(chunk));
+            chunk.offset = offset;
+            chunk.numEvents = buffer->numEvents;
+            chunk.tid = buffer->tid;
+            chunk.codec = 0;
+            memcpy(chunk.threadName, buffer->threadName, sizeof(chunk.threadName));
+            chunk.firstBegin = ULLONG_MAX;
+            for(unsigned int i=0;i<buffer->numEvents;i++){
+                if(buffer->events[i].begin < chunk.firstBegin)
+                    chunk.firstBegin = buffer->events[i].begin;
+                if(buffer->events[i].end > chunk.lastEnd)
+                    chunk.lastEnd = buffer->events[i].end;
+            }
+            for(unsigned int i=0;i<buffer->numOpenEvents;i++)
+                if(buffer->openEvents[i].begin < chunk.firstBegin)
+                    chunk.firstBegin = buffer->openEvents[i].begin;
+
+            //Blocks end in order but begin out of order when nested, so beginnings are zigzag encoded deltas
+            data.clear();
+            unsigned long long previousBegin = chunk.firstBegin;
+            for(unsigned int i=0;i<buffer->numEvents + buffer->numOpenEvents;i++){
+                bool open = i >= buffer->numEvents;
+                const RecordEvent* event = open ? buffer->openEvents + i - buffer->numEvents : buffer->events + i;
+                if(i == buffer->numEvents)
+                    appendVarint(buffer->numOpenEvents, data);
+                std::pair<std::map<unsigned int, unsigned int>::iterator, bool> result =
+                    nameIndices.insert(std::make_pair(event->blockName, (unsigned int)names.size()));
+                if(result.second)
+                    names.push_back(event->blockName);
+                long long delta = (long long)(event->begin - previousBegin);
+                previousBegin = event->begin;
+                appendVarint(result.first->second, data);
+                appendVarint(((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63), data);
+                if(!open){
+                    appendVarint(event->end - event->begin, data);
+                    appendVarint(event->cpuTime, data);
+                }
+                appendVarint(event->request, data);
+            }
+            if(buffer->numOpenEvents == 0)
+                appendVarint(0, data);
+            chunk.size = data.size();
+            if(fwrite(data.data(), 1, data.size(), file) != data.size())
+                EZP_PERR("EZP: fwrite() error on the recording: %s\n", strerror(errno));
+            offset += data.size();
+            chunks.push_back(chunk);
+        }
+
+        pthread_mutex_lock(&recordLock);
+        buffer->next = freeRecordBuffers;
+        freeRecordBuffers = buffer;
+        numRecordBuffers--;
+    }
+    pthread_mutex_unlock(&recordLock);
+
+    //Labels are resolved here so that symbols of function blocks can be read without this process
+    RecordTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.namesOffset = offset;
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    for(std::vector<unsigned int>::const_iterator it = names.begin(); it != names.end(); it++){
+        getBlockLabel(*it, cbuf);
+        unsigned int length = strlen(cbuf);
+        fwrite(&(*it), sizeof(*it), 1, file);
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(cbuf, 1, length, file);
+        offset += sizeof(*it) + sizeof(length) + length;
+    }
+    trailer.indexOffset = offset;
+    if(!chunks.empty())
+        fwrite(&chunks[0], sizeof(RecordChunk), chunks.size(), file);
+    Timespec now;
+    clock_gettime(EZP_WALL_CLOCK, &now);
+    trailer.endTime = now.tv_sec*1000000000ULL + now.tv_nsec;
+    trailer.numNames = names.size();
+    trailer.numChunks = chunks.size();
+    memcpy(trailer.magic, "EZPI", 4);
+    trailer.version = EZP_RECORD_VERSION;
+    fwrite(&trailer, sizeof(trailer), 1, file);
+    if(fclose(file) != 0)
+        EZP_PERR("EZP: fclose() error on the recording: %s\n", strerror(errno));
+
+    unsigned long long numEvents = 0;
+    for(std::vector<RecordChunk>::const_iterator it = chunks.begin(); it != chunks.end(); it++)
+        numEvents += it->numEvents;
+    EZP_PRINT("EZP: Recorded %llu blocks in %u chunks, %llu bytes\n", numEvents, (unsigned int)chunks.size(),
+            offset + chunks.size()*sizeof(RecordChunk) + sizeof(trailer));
+
+    pthread_mutex_lock(&recordLock);
+    recordFile = NULL;
+    recordStopping = false;
+    pthread_mutex_unlock(&recordLock);
+    return NULL;
+}
+
+/**
+ * @brief Reads the contents of a chunk
+ *
+ * @param fd Recording file
+ * @param chunk Index entry of the chunk
+ * @param data Where to write the contents
+ *
+ * @return Whether the whole chunk was read
+ */
+static bool readChunk(int fd, const RecordChunk& chunk, std::vector<unsigned char>& data)
+{
+    data.resize(chunk.size);
+    return chunk.codec == 0 && pread(fd, data.empty() ? NULL : &data[0], chunk.size, chunk.offset) == (ssize_t)chunk.size;
+}
+
+/**
+ * @brief Decodes the next block of a chunk
+ *
+ * @param position Position in the chunk, moved past the block
+ * @param end End of the chunk
+ * @param chunk Index entry of the chunk
+ * @param version Version of the file layout
+ * @param open Whether the block was still open when the chunk was cut, it has no duration and CPU time then
+ * @param names Block name of each name index
+ * @param beginTime When the recording began in ns
+ * @param begin Beginning of the previous block of the chunk in ns, moved to the beginning of this block
+ * @param block Where to write the block
+ *
+ * @return Whether a whole block was read
+ */
+static bool decodeBlock(const unsigned char*& position, const unsigned char* end, const RecordChunk& chunk, unsigned int version, bool open,
+        const std::vector<unsigned int>& names, unsigned long long beginTime, unsigned long long& begin, RecordedBlock& block)
+{
+    unsigned long long index, delta, duration = 0, cpuTime = 0, request = 0;
+    if(!readVarint(position, end, index) || !readVarint(position, end, delta) || index >= names.size() ||
+            (!open && (!readVarint(position, end, duration) || !readVarint(position, end, cpuTime))) ||
+            (version >= 2 && !readVarint(position, end, request)))
+        return false;
+    begin += (delta >> 1) ^ (~(delta & 1) + 1);
+    block.tid = chunk.tid;
+    block.blockName = names[index];
+    //Blocks that began before the recording are cut at its beginning
+    block.begin = begin > beginTime ? begin - beginTime : 0;
+    block.end = open ? 0 : begin + duration - beginTime;
+    block.cpuTime = cpuTime;
+    block.request = request;
+    return true;
+}
+
+/**
+ * @brief Decodes a chunk
+ *
+ * @param data Contents of the chunk
+ * @param chunk Index entry of the chunk
+ * @param version Version of the file layout
+ * @param names Block name of each name index
+ * @param beginTime When the recording began in ns
+ * @param blocks Where to append the blocks of the chunk, in the order they ended
+ * @param open Where to append the blocks still open when the chunk was cut, outermost first
+ *
+ * @return Whether the chunk was well formed
+ */
+static bool decodeChunk(const std::vector<unsigned char>& data, const RecordChunk& chunk, unsigned int version, const std::vector<unsigned int>& names,
+        unsigned long long beginTime, std::vector<RecordedBlock>& blocks, std::vector<RecordedBlock>& open)
+{
+    const unsigned char* position = data.empty() ? NULL : &data[0];
+    const unsigned char* end = position + data.size();
+    unsigned long long begin = chunk.firstBegin;
+    RecordedBlock block;
+    for(unsigned int i=0;i<chunk.numEvents;i++){
+        if(!decodeBlock(position, end, chunk, version, false, names, beginTime, begin, block))
+            return false;
+        blocks.push_back(block);
+    }
+    if(version < 2)
+        return true;
+    unsigned long long numOpen;
+    if(!readVarint(position, end, numOpen) || numOpen > EZP_MAX_OPEN_BLOCKS)
+        return false;
+    for(unsigned int i=0;i<numOpen;i++){
+        if(!decodeBlock(position, end, chunk, version, true, names, beginTime, begin, block))
+            return false;
+        open.push_back(block);
+    }
+    return true;
+}
+
+/**
+ * @brief Opens a recording and reads its block names and chunk index
+ *
+ * @param path Recording file
+ * @param recording Recording to fill, all but its blocks
+ * @param names Where to write the block name of each name index
+ * @param version Where to write the version of the file layout
+ *
+ * @return File descriptor of the recording, -1 if it could not be read
+ */
+static int openRecording(const char* path, Recording& recording, std::vector<unsigned int>& names, unsigned int& version)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd == -1){
+        EZP_PERR("EZP: open() error: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    RecordHeader header;
+    RecordTrailer trailer;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if(size < (off_t)(sizeof(header) + sizeof(trailer)) || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            memcmp(header.magic, "EZPR", 4) != 0 || header.version < 1 || header.version > EZP_RECORD_VERSION){
+        EZP_PERR("EZP: %s is not an EZP recording\n", path);
+        close(fd);
+        return -1;
+    }
+    if(pread(fd, &trailer, sizeof(trailer), size - sizeof(trailer)) != sizeof(trailer) || memcmp(trailer.magic, "EZPI", 4) != 0 ||
+            trailer.version != header.version || trailer.indexOffset + trailer.numChunks*sizeof(RecordChunk) + sizeof(trailer) != (unsigned long long)size){
+        EZP_PERR("EZP: %s has no index, was the recording stopped?\n", path);
+        close(fd);
+        return -1;
+    }
+    version = header.version;
+
+    //Block names
+    std::vector<char> table(trailer.indexOffset - trailer.namesOffset);
+    names.clear();
+    recording.labels.clear();
+    if(!table.empty() && pread(fd, &table[0], table.size(), trailer.namesOffset) != (ssize_t)table.size()){
+        EZP_PERR("EZP: read() error on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    size_t position = 0;
+    for(unsigned int i=0;i<trailer.numNames;i++){
+        unsigned int blockName, length;
+        if(position + sizeof(blockName) + sizeof(length) > table.size())
+            break;
+        memcpy(&blockName, &table[position], sizeof(blockName));
+        memcpy(&length, &table[position + sizeof(blockName)], sizeof(length));
+        position += sizeof(blockName) + sizeof(length);
+        if(position + length > table.size())
+            break;
+        recording.labels[blockName] = std::string(&table[position], length);
+        names.push_back(blockName);
+        position += length;
+    }
+    if(names.size() != trailer.numNames){
+        EZP_PERR("EZP: %s has malformed block names\n", path);
+        close(fd);
+        return -1;
+    }
+
+    //Chunk index
+    recording.pid = header.pid;
+    recording.beginTime = header.beginTime;
+    recording.duration = trailer.endTime - header.beginTime;
+    recording.chunks.resize(trailer.numChunks);
+    recording.blocks.clear();
+    if(trailer.numChunks > 0 && pread(fd, &recording.chunks[0], trailer.numChunks*sizeof(RecordChunk), trailer.indexOffset) !=
+            (ssize_t)(trailer.numChunks*sizeof(RecordChunk))){
+        EZP_PERR("EZP: read() error on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Chunks that one decoding thread decodes
+ */
+typedef struct ChunkDecoder_t{
+    int fd;                                 ///< Recording file
+    unsigned int version;                   ///< Version of the file layout
+    const Recording* recording;             ///< Chunk index and names
+    const std::vector<unsigned int>* names; ///< Block name of each name index
+    unsigned long long from;                ///< Beginning of the time range in ns since the beginning of the recording
+    unsigned long long to;                  ///< End of the time range in ns since the beginning of the recording
+    std::vector<size_t> chunks;             ///< Indices of the chunks to decode
+    std::vector<RecordedBlock> blocks;      ///< Decoded blocks in the time range
+    bool valid;                             ///< Whether all chunks were decoded
+} ChunkDecoder;
+
+/**
+ * @brief Decodes the chunks of a decoder, run by each decoding thread
+ *
+ * @param arg Points to the ChunkDecoder
+ *
+ * @return NULL
+ */
+static void* decodeChunks(void* arg)
+{
+    ChunkDecoder* decoder = (ChunkDecoder*)arg;
+    std::vector<unsigned char> data;
+    std::vector<RecordedBlock> blocks, open;
+    for(std::vector<size_t>::const_iterator it = decoder->chunks.begin(); it != decoder->chunks.end(); it++){
+        const RecordChunk& chunk = decoder->recording->chunks[*it];
+        blocks.clear();
+        if(!readChunk(decoder->fd, chunk, data) ||
+                !decodeChunk(data, chunk, decoder->version, *decoder->names, decoder->recording->beginTime, blocks, open)){
+            decoder->valid = false;
+            return NULL;
+        }
+        for(std::vector<RecordedBlock>::const_iterator block = blocks.begin(); block != blocks.end(); block++)
+            if(block->end >= decoder->from && block->begin <= decoder->to)
+                decoder->blocks.push_back(*block);
+    }
+    return NULL;
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::readRecording(const char* path, unsigned long long from, unsigned long long to, int numThreads, Recording& recording)
+{
+    std::vector<unsigned int> names;
+    unsigned int version;
+    int fd = openRecording(path, recording, names, version);
+    if(fd == -1)
+        return false;
+
+    //Only the chunks that overlap the time range are read, spread over the threads; more threads than chunks would have nothing to do
+    if((size_t)numThreads > recording.chunks.size())
+        numThreads = recording.chunks.size();
+    if(numThreads < 1)
+        numThreads = 1;
+    std::vector<ChunkDecoder> decoders(numThreads);
+    for(int i=0;i<numThreads;i++){
+        decoders[i].fd = fd;
+        decoders[i].version = version;
+        decoders[i].recording = &recording;
+        decoders[i].names = &names;
+        decoders[i].from = from;
+        decoders[i].to = to;
+        decoders[i].valid = true;
+    }
+    int next = 0;
+    for(size_t i=0;i<recording.chunks.size();i++){
+        const RecordChunk& chunk = recording.chunks[i];
+        if(chunk.lastEnd - recording.beginTime >= from && (chunk.firstBegin < recording.beginTime || chunk.firstBegin - recording.beginTime <= to)){
+            decoders[next].chunks.push_back(i);
+            next = (next + 1)%numThreads;
+        }
+    }
+    std::vector<pthread_t> threads(numThreads);
+    std::vector<bool> launched(numThreads, false);
+    for(int i=1;i<numThreads;i++)
+        launched[i] = !decoders[i].chunks.empty() && pthread_create(&threads[i], NULL, decodeChunks, &decoders[i]) == 0;
+    for(int i=0;i<numThreads;i++)
+        if(!launched[i])
+            decodeChunks(&decoders[i]);
+    for(int i=1;i<numThreads;i++)
+        if(launched[i])
+            pthread_join(threads[i], NULL);
+    close(fd);
+
+    for(int i=0;i<numThreads;i++){
+        if(!decoders[i].valid){
+            EZP_PERR("EZP: %s has malformed chunks\n", path);
+            return false;
+        }
+        recording.blocks.insert(recording.blocks.end(), decoders[i].blocks.begin(), decoders[i].blocks.end());
+    }
+    std::sort(recording.blocks.begin(), recording.blocks.end(), RecordedBlock::compareBegin);
+    return true;
+}
+
+/**
+ * @brief Beginning or end of a block waiting to be visited by streamRecording()
+ */
+typedef struct StreamEvent_t{
+    unsigned long long time;    ///< When the block begins or ends in ns since the beginning of the recording
+    bool begin;                 ///< Whether this is the beginning of the block
+    unsigned long long order;   ///< Order in which events were found, keeps the visiting order deterministic
+    RecordedBlock block;        ///< Block
+
+    /**
+     * @brief Tells whether this event is visited after another one, for std::priority_queue
+     *
+     * Ends come before beginnings, outer blocks begin before and end after inner blocks at equal times
+     *
+     * @param other Other event
+     *
+     * @return Whether this event comes after the other one
+     */
+    bool operator<(const struct StreamEvent_t& other) const
+    {
+        if(time != other.time)
+            return time > other.time;
+        if(begin != other.begin)
+            return begin;
+        if(begin){
+            unsigned long long end = block.end == 0 ? ULLONG_MAX : block.end;
+            unsigned long long otherEnd = other.block.end == 0 ? ULLONG_MAX : other.block.end;
+            if(end != otherEnd)
+                return end < otherEnd;
+        }
+        else if(block.begin != other.block.begin)
+            return block.begin < other.block.begin;
+        return order > other.order;
+    }
+} StreamEvent;
+
+/**
+ * @brief Chunks of one thread as read by streamRecording()
+ */
+typedef struct StreamThread_t{
+    std::vector<size_t> chunks;         ///< Indices of the chunks of the thread, in the order they were written
+    size_t next;                        ///< Index in chunks of the next chunk to read
+    std::vector<RecordedBlock> open;    ///< Blocks already visited as begun that have not ended yet
+} StreamThread;
+
+/**
+ * @brief Queues the beginning or the end of a block to be visited
+ *
+ * @param pending Events waiting to be visited
+ * @param order Number of events ever queued, incremented
+ * @param block Block
+ * @param begin Whether this is the beginning of the block
+ */
+static void queueStreamEvent(std::priority_queue<StreamEvent>& pending, unsigned long long& order, const RecordedBlock& block, bool begin)
+{
+    StreamEvent event;
+    event.time = begin ? block.begin : block.end;
+    event.begin = begin;
+    event.order = order++;
+    event.block = block;
+    pending.push(event);
+}
+
+/**
+ * @brief Tells whether two decoded blocks are the same block of the same thread, one of them possibly still open
+ */
+static bool isSameBlock(const RecordedBlock& one, const RecordedBlock& two)
+{
+    return one.blockName == two.blockName && one.begin == two.begin;
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::streamRecording(const char* path, RecordingVisitor visitor, void* arg, Recording& recording)
+{
+    std::vector<unsigned int> names;
+    unsigned int version;
+    int fd = openRecording(path, recording, names, version);
+    if(fd == -1)
+        return false;
+
+    //No block of a thread left unread begins before its horizon: its next chunk's earliest beginning, then its last chunk's latest end
+    std::map<int, StreamThread> threads;
+    for(size_t i=0;i<recording.chunks.size();i++)
+        threads[recording.chunks[i].tid].chunks.push_back(i);
+    std::set<std::pair<unsigned long long, int> > horizons;
+    for(std::map<int, StreamThread>::iterator it = threads.begin(); it != threads.end(); it++){
+        const RecordChunk& chunk = recording.chunks[it->second.chunks[0]];
+        it->second.next = 0;
+        horizons.insert(std::make_pair(chunk.firstBegin > recording.beginTime ? chunk.firstBegin - recording.beginTime : 0, it->first));
+    }
+
+    std::priority_queue<StreamEvent> pending;
+    unsigned long long order = 0;
+    std::vector<unsigned char> data;
+    std::vector<RecordedBlock> blocks, open;
+    while(!horizons.empty()){
+        //Everything before the earliest horizon is final
+        std::pair<unsigned long long, int> horizon = *horizons.begin();
+        horizons.erase(horizons.begin());
+        while(!pending.empty() && pending.top().time < horizon.first){
+            visitor(pending.top().block, pending.top().begin, arg);
+            pending.pop();
+        }
+
+        StreamThread& thread = threads[horizon.second];
+        const RecordChunk& chunk = recording.chunks[thread.chunks[thread.next++]];
+        blocks.clear();
+        open.clear();
+        if(!readChunk(fd, chunk, data) || !decodeChunk(data, chunk, version, names, recording.beginTime, blocks, open)){
+            EZP_PERR("EZP: %s has malformed chunks\n", path);
+            close(fd);
+            return false;
+        }
+
+        //Blocks that began in an earlier chunk were already visited as begun
+        for(std::vector<RecordedBlock>::const_iterator it = blocks.begin(); it != blocks.end(); it++){
+            std::vector<RecordedBlock>::iterator begun = thread.open.begin();
+            while(begun != thread.open.end() && !isSameBlock(*begun, *it))
+                begun++;
+            if(begun != thread.open.end())
+                thread.open.erase(begun);
+            else
+                queueStreamEvent(pending, order, *it, true);
+            queueStreamEvent(pending, order, *it, false);
+        }
+        for(std::vector<RecordedBlock>::const_iterator it = open.begin(); it != open.end(); it++){
+            std::vector<RecordedBlock>::iterator begun = thread.open.begin();
+            while(begun != thread.open.end() && !isSameBlock(*begun, *it))
+                begun++;
+            if(begun != thread.open.end())
+                thread.open.erase(begun);
+            else
+                queueStreamEvent(pending, order, *it, true);
+        }
+
+        //Blocks neither ended in nor open at the end of this chunk ended without being recorded, e.g when filtered out
+        for(std::vector<RecordedBlock>::iterator it = thread.open.begin(); it != thread.open.end(); it++){
+            it->end = horizon.first;
+            queueStreamEvent(pending, order, *it, false);
+        }
+        thread.open = open;
+
+        if(thread.next < thread.chunks.size())
+            horizons.insert(std::make_pair(std::max(horizon.first, chunk.lastEnd - recording.beginTime), horizon.second));
+        else
+            for(std::vector<RecordedBlock>::iterator it = thread.open.begin(); it != thread.open.end(); it++){
+                it->end = std::max(recording.duration, it->begin);
+                queueStreamEvent(pending, order, *it, false);
+            }
+    }
+    close(fd);
+
+    while(!pending.empty()){
+        visitor(pending.top().block, pending.top().begin, arg);
+        pending.pop();
+    }
+    return true;
+}
+
+} /* namespace ezp */
@@ -0,0 +1,633 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_report.cpp
+ * @brief Text, JSON and CSV reports of offline analysis results
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief Writes a block or thread name as a JSON or CSV string, escaping as necessary
+ *
+ * @param name Block name of maximum length 4 or thread name
+ * @param csv Whether to escape the quote by doubling it as in CSV instead of with a backslash as in JSON
+ * @param output String to append the quoted name to
+ */
+static void appendQuoted(const char* name, bool csv, std::string& output)
+{
+    output += '"';
+    for(; *name != '\0'; name++){
+        if(*name == '"')
+            output += csv ? "\"\"" : "\\\"";
+        else if(*name == '\\' && !csv)
+            output += "\\\\";
+        else if((unsigned char)*name < 0x20 && !csv){
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", *name);
+            output += buf;
+        }
+        else
+            output += *name;
+    }
+    output += '"';
+}
+
+/**
+ * @brief Appends the JSON members common to thread-wise and summed profiles
+ *
+ * @param totalTime Total time in nanoseconds
+ * @param numSamples Number of runs
+ * @param histogram Number of runs in each duration bucket
+ * @param sched Scheduler statistics
+ * @param nodes Runs per NUMA node
+ * @param allocs Allocation statistics
+ * @param samples Number of samples taken while the block was open
+ * @param selfSamples Number of samples taken while the block was the innermost open block
+ * @param output String to append to
+ */
+static void appendJSONStats(unsigned long long totalTime, int numSamples, const unsigned long long* histogram, const SchedStats& sched,
+        const NodeStats& nodes, const AllocStats& allocs, unsigned long long samples, unsigned long long selfSamples, std::string& output)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+            "\"calls\": %d, \"total_ns\": %llu, \"average_ns\": %.3f, \"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, \"histogram\": [",
+            numSamples, totalTime, numSamples == 0 ? 0.0 : (double)totalTime/numSamples,
+            getHistogramPercentile(histogram, 0.5), getHistogramPercentile(histogram, 0.9), getHistogramPercentile(histogram, 0.99));
+    output += buf;
+    for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++){
+        snprintf(buf, sizeof(buf), i == 0 ? "%llu" : ", %llu", histogram[i]);
+        output += buf;
+    }
+    snprintf(buf, sizeof(buf),
+            "], \"sched_calls\": %d, \"wall_ns\": %llu, \"off_cpu_ns\": %llu, \"voluntary_switches\": %llu, \"involuntary_switches\": %llu",
+            sched.numSamples, sched.wallTime, sched.getOffCpuTime(), sched.voluntarySwitches, sched.involuntarySwitches);
+    output += buf;
+    snprintf(buf, sizeof(buf), ", \"alloc_calls\": %d, \"allocs\": %llu, \"alloc_bytes\": %llu, \"samples\": %llu, \"self_samples\": %llu",
+            allocs.numSamples, allocs.count, allocs.bytes, samples, selfSamples);
+    output += buf;
+
+    //Only nodes that runs ended on
+    output += ", \"nodes\": [";
+    bool first = true;
+    for(int i=0;i<EZP_MAX_NUMA_NODES;i++)
+        if(nodes.numSamples[i] > 0){
+            snprintf(buf, sizeof(buf), "%s{\"node\": %d, \"calls\": %d, \"total_ns\": %llu}",
+                    first ? "" : ", ", i, nodes.numSamples[i], nodes.totalTime[i]);
+            output += buf;
+            first = false;
+        }
+    output += "]";
+}
+
+/**
+ * @brief Appends the CSV columns common to thread-wise and summed profiles
+ *
+ * @param totalTime Total time in nanoseconds
+ * @param numSamples Number of runs
+ * @param histogram Number of runs in each duration bucket
+ * @param sched Scheduler statistics
+ * @param allocs Allocation statistics
+ * @param samples Number of samples taken while the block was open
+ * @param selfSamples Number of samples taken while the block was the innermost open block
+ * @param output String to append to
+ */
+static void appendCSVStats(unsigned long long totalTime, int numSamples, const unsigned long long* histogram, const SchedStats& sched,
+        const AllocStats& allocs, unsigned long long samples, unsigned long long selfSamples, std::string& output)
+{
+    char buf[384];
+    snprintf(buf, sizeof(buf), ",%d,%llu,%.3f,%.0f,%.0f,%.0f,%d,%llu,%llu,%llu,%llu,%d,%llu,%llu,%llu,%llu,\n",
+            numSamples, totalTime, numSamples == 0 ? 0.0 : (double)totalTime/numSamples,
+            getHistogramPercentile(histogram, 0.5), getHistogramPercentile(histogram, 0.9), getHistogramPercentile(histogram, 0.99),
+            sched.numSamples, sched.wallTime, sched.getOffCpuTime(), sched.voluntarySwitches, sched.involuntarySwitches,
+            allocs.numSamples, allocs.count, allocs.bytes, samples, selfSamples);
+    output += buf;
+}
+
+/**
+ * @brief Appends the CSV rows of the runs of a profile per NUMA node
+ *
+ * @param prefix Beginning of the rows up to the block name, i.e table, tid and thread columns
+ * @param blockName Name of the block
+ * @param nodes Runs per NUMA node
+ * @param output String to append to
+ */
+static void appendCSVNodes(const std::string& prefix, const char* blockName, const NodeStats& nodes, std::string& output)
+{
+    char buf[128];
+    for(int i=0;i<EZP_MAX_NUMA_NODES;i++)
+        if(nodes.numSamples[i] > 0){
+            output += prefix;
+            appendQuoted(blockName, true, output);
+            snprintf(buf, sizeof(buf), ",%d,%llu,%.3f,,,,,,,,,,,,,,%d\n",
+                    nodes.numSamples[i], nodes.totalTime[i], (double)nodes.totalTime[i]/nodes.numSamples[i], i);
+            output += buf;
+        }
+}
+
+/**
+ * @brief Appends a row of the scheduler statistics table of text reports
+ *
+ * @param label Thread or thread group, NULL for the table summed across threads
+ * @param width Width of the label column, negative for left-aligned
+ * @param blockName Name of the block
+ * @param sched Scheduler statistics of the block
+ * @param output String to append to
+ */
+static void appendTextSched(const char* label, int width, const char* blockName, const SchedStats& sched, std::string& output)
+{
+    char buf[EZP_BLOCK_LABEL_LENGTH + 128];
+    int length = label == NULL ? snprintf(buf, sizeof(buf), "EZP: %4s    ", blockName) :
+        snprintf(buf, sizeof(buf), "EZP: %*s    %4s    ", width, label, blockName);
+    snprintf(buf + length, sizeof(buf) - length, "%-16.2f    %-16.2f    %-8.1f    %-12.1f    %-12.1f\n",
+            sched.wallTime/1000000.0, sched.getOffCpuTime()/1000000.0,
+            sched.wallTime == 0 ? 0.0 : 100.0*sched.getOffCpuTime()/sched.wallTime,
+            (double)sched.voluntarySwitches/sched.numSamples, (double)sched.involuntarySwitches/sched.numSamples);
+    output += buf;
+}
+
+/**
+ * @brief Appends a row of the allocation statistics table of text reports
+ *
+ * @param label Thread or thread group, NULL for the table summed across threads
+ * @param width Width of the label column, negative for left-aligned
+ * @param blockName Name of the block
+ * @param allocs Allocation statistics of the block
+ * @param output String to append to
+ */
+static void appendTextAllocs(const char* label, int width, const char* blockName, const AllocStats& allocs, std::string& output)
+{
+    char buf[EZP_BLOCK_LABEL_LENGTH + 128];
+    int length = label == NULL ? snprintf(buf, sizeof(buf), "EZP: %4s    ", blockName) :
+        snprintf(buf, sizeof(buf), "EZP: %*s    %4s    ", width, label, blockName);
+    snprintf(buf + length, sizeof(buf) - length, "%-12.1f    %-16.1f    %-12llu    %-16llu\n",
+            (double)allocs.count/allocs.numSamples, (double)allocs.bytes/allocs.numSamples, allocs.count, allocs.bytes);
+    output += buf;
+}
+
+/**
+ * @brief Tells whether a summed profile has runs sampled with scheduler statistics
+ *
+ * @param profile Summed profile
+ *
+ * @return Whether the profile has sampled runs
+ */
+static bool hasSchedStats(const SummedProfile& profile)
+{
+    return profile.sched.numSamples > 0;
+}
+
+/**
+ * @brief Tells whether a summed profile has runs counted with allocation statistics
+ *
+ * @param profile Summed profile
+ *
+ * @return Whether the profile has counted runs
+ */
+static bool hasAllocStats(const SummedProfile& profile)
+{
+    return profile.allocs.numSamples > 0;
+}
+
+/**
+ * @brief Tells whether a summed profile was sampled
+ *
+ * @param profile Summed profile
+ *
+ * @return Whether the profile has samples
+ */
+static bool hasSamples(const SummedProfile& profile)
+{
+    return profile.samples > 0;
+}
+
+/**
+ * @brief Tells whether a summed profile has runs recorded per NUMA node
+ *
+ * @param profile Summed profile
+ *
+ * @return Whether the profile has runs on any node
+ */
+static bool hasNodeStats(const SummedProfile& profile)
+{
+    return profile.nodes.any();
+}
+
+/**
+ * @brief Gets the name of the thread or thread group of a thread-wise profile
+ *
+ * @param profile Thread-wise profile
+ * @param label Preallocated buffer of at least EZP_THREAD_NAME_LENGTH + 1 characters to write the name to
+ */
+static void getThreadLabel(const AggregateProfile& profile, char* label)
+{
+    if(profile.tid > 0)
+        snprintf(label, EZP_THREAD_NAME_LENGTH + 1, "%d", profile.tid);
+    else if(profile.threadName[0] == '\0')
+        strcpy(label, profile.retired ? "retired" : "?");
+    else
+        snprintf(label, EZP_THREAD_NAME_LENGTH + 1, profile.tid < 0 ? "%s*" : "%s", profile.threadName);
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::buildOfflineReport(OfflineReport& report)
+{
+    report.threadProfiles.clear();
+    report.summedProfiles.clear();
+
+    //Copy the records in one pass under the lock, everything else is done outside
+    pthread_mutex_lock(&offlineLock);
+    report.threadProfiles.resize(offlineBlocks.size());
+    std::vector<AggregateProfile>::iterator itt = report.threadProfiles.begin();
+    for(Blk2AMarker::iterator its = offlineBlocks.begin(); its != offlineBlocks.end(); its++, itt++){
+        itt->tid = its->first.tid;
+        itt->blockName = its->first.blockName;
+        itt->numSamples = its->second->numSamples;
+        itt->totalTime = its->second->totalTime;
+        for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+            itt->histogram[i] = its->second->histogram[i];
+        itt->sched = its->second->sched;
+        itt->nodes = its->second->nodes;
+        itt->allocs = its->second->allocs;
+        itt->samples = __atomic_load_n(&(its->second->samples), __ATOMIC_RELAXED);
+        itt->selfSamples = __atomic_load_n(&(its->second->selfSamples), __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&offlineLock);
+
+    if(report.threadProfiles.empty())
+        return false;
+
+    //Samples stay meaningful after sampling stops, so is the last period
+    pthread_mutex_lock(&threadLock);
+    report.samplingPeriod = samplingPeriod;
+    pthread_mutex_unlock(&threadLock);
+    collectSampledStacks(report.sampledStacks);
+
+    //Names may change after the records are created, look them up now
+    refreshThreadNames();
+    pthread_mutex_lock(&threadLock);
+    for(itt = report.threadProfiles.begin(); itt != report.threadProfiles.end(); itt++){
+        Tid2Thread::iterator threadIt = threads.find(itt->tid);
+        if(threadIt != threads.end()){
+            memcpy(itt->threadName, threadIt->second->name, sizeof(itt->threadName));
+            itt->retired = threadIt->second->retired;
+        }
+    }
+    pthread_mutex_unlock(&threadLock);
+
+    completeOfflineReport(report);
+    return true;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::completeOfflineReport(OfflineReport& report)
+{
+    report.summedProfiles.clear();
+
+    //Drop records recycled after their thread exited, they are already folded into a retired bucket
+    std::vector<AggregateProfile> profiles;
+    std::map<std::pair<std::string, unsigned int>, size_t> groupIndices;
+    profiles.reserve(report.threadProfiles.size());
+    for(std::vector<AggregateProfile>::iterator itt = report.threadProfiles.begin(); itt != report.threadProfiles.end(); itt++){
+        if(itt->tid == 0)
+            continue;
+        if(itt->tid < 0)
+            itt->retired = true;
+        if(threadAggregation == AGGREGATE_TID){
+            profiles.push_back(*itt);
+            continue;
+        }
+
+        //Group profiles of the same block coming from threads with the same name or pool
+        char group[EZP_THREAD_NAME_LENGTH];
+        if(threadAggregation == AGGREGATE_POOL)
+            getPoolName(itt->threadName, group);
+        else
+            memcpy(group, itt->threadName, sizeof(group));
+        std::pair<std::map<std::pair<std::string, unsigned int>, size_t>::iterator, bool> result =
+            groupIndices.insert(std::make_pair(std::make_pair(std::string(group), itt->blockName), profiles.size()));
+        if(result.second){
+            profiles.push_back(*itt);
+            profiles.back().tid = 0;
+            memcpy(profiles.back().threadName, group, sizeof(group));
+        }
+        else
+            profiles[result.first->second].add(*itt);
+    }
+    report.threadProfiles.swap(profiles);
+
+    //Sum profiles coming from different threads
+    std::map<unsigned int, size_t> summedIndices;
+    for(std::vector<AggregateProfile>::iterator itt = report.threadProfiles.begin(); itt != report.threadProfiles.end(); itt++){
+        itt->averageTime = itt->numSamples == 0 ? -1.0f : itt->totalTime/1000000.0f/itt->numSamples;
+
+        std::pair<std::map<unsigned int, size_t>::iterator, bool> result =
+            summedIndices.insert(std::make_pair(itt->blockName, report.summedProfiles.size()));
+        if(result.second)
+            report.summedProfiles.push_back(SummedProfile(itt->blockName));
+        report.summedProfiles[result.first->second].add(*itt);
+    }
+
+    //Sort according to average time taken
+    std::sort(report.threadProfiles.begin(),report.threadProfiles.end(),AggregateProfile::compareAvgTime);
+    std::sort(report.summedProfiles.begin(),report.summedProfiles.end(),SummedProfile::compare);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::formatOfflineReport(const OfflineReport& report, ReportFormat format, std::string& output)
+{
+    char buf[2*EZP_BLOCK_LABEL_LENGTH + 128];
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    char lbuf[EZP_THREAD_NAME_LENGTH + 1];
+
+    switch(format){
+        case FORMAT_TEXT:
+            output += "EZP: ===============================================================================\n";
+            output += "EZP: Thread-wise analysis results\n";
+            output += "EZP: -------------------------------------------------------------------------------\n";
+            if(threadAggregation == AGGREGATE_TID)
+                output += "EZP: Thread ID    Name    Average(ms)         Total(ms)           Calls\n";
+            else
+                output += "EZP: Thread             Name    Average(ms)         Total(ms)           Calls\n";
+            output += "EZP: -------------------------------------------------------------------------------\n";
+            for(std::vector<AggregateProfile>::const_iterator it = report.threadProfiles.begin(); it != report.threadProfiles.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                getThreadLabel(*it,lbuf);
+                int width = threadAggregation == AGGREGATE_TID ? 9 : -15;
+                if(it->numSamples == 0 && isFunctionBlock(it->blockName))
+                    snprintf(buf, sizeof(buf), "EZP: %*s    %4s    has not returned yet\n", width, lbuf, cbuf);
+                else if(it->numSamples == 0)
+                    snprintf(buf, sizeof(buf), "EZP: %*s    %4s    EZP_END_OFFLINE(\"%s\") was not present or was not enabled\n",
+                            width, lbuf, cbuf, cbuf);
+                else
+                    snprintf(buf, sizeof(buf), "EZP: %*s    %4s    %-16.2f    %-16.2f    %-10d\n",
+                            width, lbuf, cbuf, it->averageTime, it->totalTime/1000000.0, it->numSamples);
+                output += buf;
+            }
+
+            output += "EZP: ===============================================================================\n";
+            output += "EZP: Anaylsis results summed across threads\n";
+            output += "EZP: -------------------------------------------------------------------------------\n";
+            output += "EZP: Name    Average(ms)         Total(ms)           Calls\n";
+            output += "EZP: -------------------------------------------------------------------------------\n";
+            for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                if(it->numSamples == 0 && isFunctionBlock(it->blockName))
+                    snprintf(buf, sizeof(buf), "EZP: %4s    has not returned yet\n", cbuf);
+                else if(it->numSamples == 0)
+                    snprintf(buf, sizeof(buf), "EZP: %4s    EZP_END_OFFLINE(\"%s\") was not present or was not enabled\n",
+                            cbuf, cbuf);
+                else
+                    snprintf(buf, sizeof(buf), "EZP: %4s    %-16.2f    %-16.2f    %-10d\n",
+                            cbuf, it->totalTime/1000000.0/it->numSamples, it->totalTime/1000000.0, it->numSamples);
+                output += buf;
+            }
+            output += "EZP: ===============================================================================\n";
+
+            //Only when NUMA node statistics were on
+            if(std::find_if(report.summedProfiles.begin(), report.summedProfiles.end(), hasNodeStats) != report.summedProfiles.end()){
+                output += "EZP: Analysis results summed across threads per NUMA node\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                output += "EZP: Name    Node    Average(ms)         Total(ms)           Calls\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++){
+                    getBlockLabel(it->blockName,cbuf);
+                    for(int i=0;i<EZP_MAX_NUMA_NODES;i++)
+                        if(it->nodes.numSamples[i] > 0){
+                            snprintf(buf, sizeof(buf), "EZP: %4s    %4d    %-16.2f    %-16.2f    %-10d\n",
+                                    cbuf, i, it->nodes.totalTime[i]/1000000.0/it->nodes.numSamples[i], it->nodes.totalTime[i]/1000000.0,
+                                    it->nodes.numSamples[i]);
+                            output += buf;
+                        }
+                }
+                output += "EZP: ===============================================================================\n";
+            }
+
+            //Only when scheduler statistics were on, context switches are averaged over sampled runs
+            if(std::find_if(report.summedProfiles.begin(), report.summedProfiles.end(), hasSchedStats) != report.summedProfiles.end()){
+                output += "EZP: Scheduler statistics\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                if(threadAggregation == AGGREGATE_TID)
+                    output += "EZP: Thread ID    Name    Wall(ms)            Off-CPU(ms)         Off-CPU%    Vol. sw/call    Invol. sw/call\n";
+                else
+                    output += "EZP: Thread             Name    Wall(ms)            Off-CPU(ms)         Off-CPU%    Vol. sw/call    Invol. sw/call\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                for(std::vector<AggregateProfile>::const_iterator it = report.threadProfiles.begin(); it != report.threadProfiles.end(); it++)
+                    if(it->sched.numSamples > 0){
+                        getBlockLabel(it->blockName,cbuf);
+                        getThreadLabel(*it,lbuf);
+                        appendTextSched(lbuf, threadAggregation == AGGREGATE_TID ? 9 : -15, cbuf, it->sched, output);
+                    }
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                output += "EZP: Name    Wall(ms)            Off-CPU(ms)         Off-CPU%    Vol. sw/call    Invol. sw/call\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++)
+                    if(it->sched.numSamples > 0){
+                        getBlockLabel(it->blockName,cbuf);
+                        appendTextSched(NULL, 0, cbuf, it->sched, output);
+                    }
+                output += "EZP: ===============================================================================\n";
+            }
+
+            //Only when allocation statistics were on, allocations are averaged over counted runs and include nested blocks
+            if(std::find_if(report.summedProfiles.begin(), report.summedProfiles.end(), hasAllocStats) != report.summedProfiles.end()){
+                output += "EZP: Allocation statistics\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                if(threadAggregation == AGGREGATE_TID)
+                    output += "EZP: Thread ID    Name    Allocs/call     Bytes/call          Allocs          Bytes\n";
+                else
+                    output += "EZP: Thread             Name    Allocs/call     Bytes/call          Allocs          Bytes\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                for(std::vector<AggregateProfile>::const_iterator it = report.threadProfiles.begin(); it != report.threadProfiles.end(); it++)
+                    if(it->allocs.numSamples > 0){
+                        getBlockLabel(it->blockName,cbuf);
+                        getThreadLabel(*it,lbuf);
+                        appendTextAllocs(lbuf, threadAggregation == AGGREGATE_TID ? 9 : -15, cbuf, it->allocs, output);
+                    }
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                output += "EZP: Name    Allocs/call     Bytes/call          Allocs          Bytes\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++)
+                    if(it->allocs.numSamples > 0){
+                        getBlockLabel(it->blockName,cbuf);
+                        appendTextAllocs(NULL, 0, cbuf, it->allocs, output);
+                    }
+                output += "EZP: ===============================================================================\n";
+            }
+
+            //Only when sampling was on; blocks still open have samples but no measured time yet
+            if(std::find_if(report.summedProfiles.begin(), report.summedProfiles.end(), hasSamples) != report.summedProfiles.end()){
+                snprintf(buf, sizeof(buf), "EZP: Sampling statistics, one sample per %.2f ms of thread CPU time\n", report.samplingPeriod/1000000.0);
+                output += buf;
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                output += "EZP: Name    Samples         Self samples    Sampled(ms)         Measured(ms)\n";
+                output += "EZP: -------------------------------------------------------------------------------\n";
+                for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++)
+                    if(it->samples > 0){
+                        getBlockLabel(it->blockName,cbuf);
+                        snprintf(buf, sizeof(buf), "EZP: %4s    %-12llu    %-12llu    %-16.2f    %-16.2f\n",
+                                cbuf, it->samples, it->selfSamples, it->samples*report.samplingPeriod/1000000.0, it->totalTime/1000000.0);
+                        output += buf;
+                    }
+
+                //Most sampled backtraces of each block, stacks are sorted on block then on count
+                if(!report.sampledStacks.empty()){
+                    output += "EZP: -------------------------------------------------------------------------------\n";
+                    output += "EZP: Name    Samples         Backtrace, innermost frame first\n";
+                    output += "EZP: -------------------------------------------------------------------------------\n";
+                    int numShown = 0;
+                    for(std::vector<SampledStack>::const_iterator it = report.sampledStacks.begin(); it != report.sampledStacks.end(); it++){
+                        numShown = it != report.sampledStacks.begin() && (it - 1)->blockName == it->blockName ? numShown + 1 : 0;
+                        if(numShown >= EZP_MAX_REPORTED_STACKS)
+                            continue;
+                        getBlockLabel(it->blockName,cbuf);
+                        snprintf(buf, sizeof(buf), "EZP: %4s    %-12llu    ", cbuf, it->count);
+                        output += buf;
+                        for(unsigned int f=0;f<it->numFrames;f++){
+                            getAddressLabel(it->frames[f], cbuf);
+                            if(f > 0)
+                                output += " < ";
+                            output += cbuf;
+                        }
+                        output += '\n';
+                    }
+                }
+                output += "EZP: ===============================================================================\n";
+            }
+            break;
+
+        case FORMAT_JSON:
+            snprintf(buf, sizeof(buf), "{\n  \"version\": 1,\n  \"pid\": %d,\n  \"histogram_buckets\": %d,\n  \"threads\": [", getpid(), EZP_HISTOGRAM_BUCKETS);
+            output += buf;
+            for(std::vector<AggregateProfile>::const_iterator it = report.threadProfiles.begin(); it != report.threadProfiles.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                snprintf(buf, sizeof(buf), "%s\n    {\"tid\": %d, \"thread\": ", it == report.threadProfiles.begin() ? "" : ",", it->tid);
+                output += buf;
+                appendQuoted(it->threadName, false, output);
+                output += it->retired ? ", \"retired\": true, \"block\": " : ", \"retired\": false, \"block\": ";
+                appendQuoted(cbuf, false, output);
+                output += ", ";
+                appendJSONStats(it->totalTime, it->numSamples, it->histogram, it->sched, it->nodes, it->allocs, it->samples, it->selfSamples, output);
+                output += "}";
+            }
+            output += "\n  ],\n  \"summed\": [";
+            for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                output += it == report.summedProfiles.begin() ? "\n    {\"block\": " : ",\n    {\"block\": ";
+                appendQuoted(cbuf, false, output);
+                output += ", ";
+                appendJSONStats(it->totalTime, it->numSamples, it->histogram, it->sched, it->nodes, it->allocs, it->samples, it->selfSamples, output);
+                output += "}";
+            }
+            snprintf(buf, sizeof(buf), "\n  ],\n  \"sampling_period_ns\": %llu,\n  \"sampled_stacks\": [", report.samplingPeriod);
+            output += buf;
+            for(std::vector<SampledStack>::const_iterator it = report.sampledStacks.begin(); it != report.sampledStacks.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                output += it == report.sampledStacks.begin() ? "\n    {\"block\": " : ",\n    {\"block\": ";
+                appendQuoted(cbuf, false, output);
+                snprintf(buf, sizeof(buf), ", \"samples\": %llu, \"frames\": [", it->count);
+                output += buf;
+                for(unsigned int f=0;f<it->numFrames;f++){
+                    getAddressLabel(it->frames[f], cbuf);
+                    if(f > 0)
+                        output += ", ";
+                    appendQuoted(cbuf, false, output);
+                }
+                output += "]}";
+            }
+            output += "\n  ]\n}\n";
+            break;
+
+        case FORMAT_CSV:
+            output += "table,tid,thread,block,calls,total_ns,average_ns,p50_ns,p90_ns,p99_ns,sched_calls,wall_ns,off_cpu_ns,voluntary_switches,involuntary_switches,alloc_calls,allocs,alloc_bytes,samples,self_samples,node\n";
+            for(std::vector<AggregateProfile>::const_iterator it = report.threadProfiles.begin(); it != report.threadProfiles.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                snprintf(buf, sizeof(buf), ",%d,", it->tid);
+                std::string columns(buf);
+                appendQuoted(it->threadName, true, columns);
+                columns += ',';
+                output += "thread" + columns;
+                appendQuoted(cbuf, true, output);
+                appendCSVStats(it->totalTime, it->numSamples, it->histogram, it->sched, it->allocs, it->samples, it->selfSamples, output);
+                appendCSVNodes("thread_node" + columns, cbuf, it->nodes, output);
+            }
+            for(std::vector<SummedProfile>::const_iterator it = report.summedProfiles.begin(); it != report.summedProfiles.end(); it++){
+                getBlockLabel(it->blockName,cbuf);
+                output += "summed,,,";
+                appendQuoted(cbuf, true, output);
+                appendCSVStats(it->totalTime, it->numSamples, it->histogram, it->sched, it->allocs, it->samples, it->selfSamples, output);
+                appendCSVNodes("summed_node,,,", cbuf, it->nodes, output);
+            }
+            break;
+    }
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::formatOfflineProfiles(ReportFormat format, std::string& output)
+{
+    OfflineReport report;
+    buildOfflineReport(report);
+    formatOfflineReport(report, format, output);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::writeOfflineProfiles(FILE* file, ReportFormat format)
+{
+    OfflineReport report;
+    buildOfflineReport(report);
+    writeOfflineReport(report, file, format);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::writeOfflineReport(const OfflineReport& report, FILE* file, ReportFormat format)
+{
+    std::string output;
+    formatOfflineReport(report, format, output);
+    if(fwrite(output.data(), 1, output.size(), file) < output.size())
+        EZP_PERR("EZP: fwrite() error: %s\n", strerror(errno));
+    fflush(file);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::writeOfflineProfiles(int fd, ReportFormat format)
+{
+    std::string output;
+    formatOfflineProfiles(format, output);
+    if(!writeAll(fd, output))
+        EZP_PERR("EZP: write() error: %s\n", strerror(errno));
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::writeAll(int fd, const std::string& data)
+{
+    size_t written = 0;
+    while(written < data.size()){
+        int ret = write(fd, data.data() + written, data.size() - written);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return false;
+        written += ret;
+    }
+    return true;
+}
+
+} /* namespace ezp */
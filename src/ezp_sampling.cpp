@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_sampling.cpp
+ * @brief Statistical sampling of the offline analysis blocks open in each thread, driven by timers on thread CPU time
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<cxxabi.h>
+#include<dlfcn.h>
+#include<ucontext.h>
+
+#include"ezp_internal.hpp"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace ezp{
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setSampling(float periodMs, bool backtraces)
+{
+    pthread_once(&samplingHandlerOnce, installSamplingHandler);
+
+    //Threads rearm their timers at their next EZP_START_OFFLINE, or stop them at their next sample; the last period stays
+    //for reports to convert samples to time
+    pthread_mutex_lock(&threadLock);
+    if(periodMs > 0.0f)
+        samplingPeriod = (unsigned long long)(periodMs*1000000.0);
+    samplingBacktraces = backtraces;
+    __atomic_add_fetch(&samplingGeneration, 1, __ATOMIC_RELAXED);
+    setState(STATE_SAMPLING, periodMs > 0.0f);
+    pthread_mutex_unlock(&threadLock);
+}
+
+//This function is not time critical, called once
+void EasyPerformanceAnalyzer::installSamplingHandler()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = sampleThread;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    struct sigaction previous;
+    if(sigaction(SIGPROF, &action, &previous) == -1)
+        EZP_PERR("EZP: sigaction() error: %s\n", strerror(errno));
+    else if(!(previous.sa_flags & SA_SIGINFO) && previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+        EZP_PERR("EZP: Replaced the SIGPROF handler that was installed, e.g by gprof\n");
+}
+
+//This function is not time critical, called when a thread starts a block after sampling changed
+void EasyPerformanceAnalyzer::armSampling(ThreadInfo* info)
+{
+    pthread_mutex_lock(&threadLock);
+    unsigned long long period = (__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_SAMPLING) ? samplingPeriod : 0;
+    bool backtraces = samplingBacktraces;
+    unsigned int generation = __atomic_load_n(&samplingGeneration, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&threadLock);
+
+    if(!info->samplingTimerCreated){
+        struct sigevent event;
+        memset(&event, 0, sizeof(event));
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_notify_thread_id = info->tid;
+        if(timer_create(EZP_CLOCK, &event, &(info->samplingTimer)) == -1){
+            EZP_PERR("EZP: timer_create() error: %s\n", strerror(errno));
+            info->samplingGeneration = generation; //Do not retry at every block
+            return;
+        }
+        info->samplingTimerCreated = true;
+
+        //Backtraces are followed only inside the stack, which cannot be found from the signal handler
+        pthread_attr_t attr;
+        void* stack;
+        size_t stackSize;
+        if(pthread_getattr_np(pthread_self(), &attr) == 0){
+            if(pthread_attr_getstack(&attr, &stack, &stackSize) == 0){
+                info->stackLow = (unsigned long)stack;
+                info->stackHigh = (unsigned long)stack + stackSize;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+
+    //Allocated here since the signal handler cannot allocate
+    if(backtraces && info->sampleRing == NULL)
+        info->sampleRing = new SampleEvent[EZP_SAMPLE_RING_SIZE];
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period/1000000000ULL;
+    spec.it_interval.tv_nsec = period%1000000000ULL;
+    spec.it_value = spec.it_interval;
+    if(timer_settime(info->samplingTimer, 0, &spec, NULL) == -1)
+        EZP_PERR("EZP: timer_settime() error: %s\n", strerror(errno));
+    info->samplingGeneration = generation;
+}
+
+//This function is time critical, called in signal context: only async-signal-safe calls and no locks
+void EasyPerformanceAnalyzer::sampleThread(int signal, siginfo_t* signalInfo, void* context)
+{
+    ThreadInfo* info = currentThread;
+    if(info == NULL || !info->samplingTimerCreated)
+        return;
+
+    //Sampling was stopped, stop the timer of this thread; timer_settime() is async-signal-safe
+    if(!(__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_SAMPLING)){
+        int savedErrno = errno;
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        timer_settime(info->samplingTimer, 0, &spec, NULL);
+        info->samplingGeneration = 0;
+        errno = savedErrno;
+        return;
+    }
+
+    unsigned int depth = __atomic_load_n(&(info->numOpenBlocks), __ATOMIC_ACQUIRE);
+    if(depth == 0)
+        return;
+
+    //CPU-time timers expire on scheduler ticks, periods shorter than a tick are reported as overruns of one signal
+    unsigned int weight = 1 + (signalInfo->si_overrun > 0 ? signalInfo->si_overrun : 0);
+
+    //Only this thread writes the sample counts, relaxed stores are enough for reports to read them
+    for(unsigned int i=0;i<depth;i++){
+        AggregateMarker* marker = info->openBlocks[i].marker;
+        __atomic_store_n(&(marker->samples), marker->samples + weight, __ATOMIC_RELAXED);
+    }
+    AggregateMarker* innermost = info->openBlocks[depth - 1].marker;
+    __atomic_store_n(&(innermost->selfSamples), innermost->selfSamples + weight, __ATOMIC_RELAXED);
+
+    if(info->sampleRing == NULL)
+        return;
+    SampleEvent* event = info->sampleRing + info->numSampleEvents%EZP_SAMPLE_RING_SIZE;
+    event->blockName = innermost->blockName;
+    event->weight = weight;
+    event->numFrames = 0;
+
+    //Follow the frame pointer chain, which code built with -fomit-frame-pointer breaks: only frames inside the stack and
+    //going up it are followed, so reads never fault but callers may be missing or wrong
+    unsigned long pc = 0, fp = 0, sp = 0;
+    ucontext_t* uc = (ucontext_t*)context;
+#if defined(__x86_64__)
+    pc = uc->uc_mcontext.gregs[REG_RIP];
+    fp = uc->uc_mcontext.gregs[REG_RBP];
+    sp = uc->uc_mcontext.gregs[REG_RSP];
+#elif defined(__i386__)
+    pc = uc->uc_mcontext.gregs[REG_EIP];
+    fp = uc->uc_mcontext.gregs[REG_EBP];
+    sp = uc->uc_mcontext.gregs[REG_ESP];
+#elif defined(__aarch64__)
+    pc = uc->uc_mcontext.pc;
+    fp = uc->uc_mcontext.regs[29];
+    sp = uc->uc_mcontext.sp;
+#else
+    (void)uc;
+#endif
+    if(pc != 0)
+        event->frames[event->numFrames++] = (void*)pc;
+    unsigned long low = sp > info->stackLow ? sp : info->stackLow;
+    while(event->numFrames < EZP_SAMPLE_FRAMES && fp >= low && fp + 2*sizeof(void*) <= info->stackHigh && fp%sizeof(void*) == 0){
+        void** frame = (void**)fp;
+        if(frame[1] == NULL)
+            break;
+        event->frames[event->numFrames++] = frame[1];
+        low = fp + 2*sizeof(void*);
+        fp = (unsigned long)frame[0];
+    }
+    __atomic_store_n(&(info->numSampleEvents), info->numSampleEvents + 1, __ATOMIC_RELEASE);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::collectSampledStacks(std::vector<SampledStack>& stacks)
+{
+    stacks.clear();
+
+    //Samples being written while they are copied may be torn, which only shifts one count of the report
+    std::map<std::vector<unsigned long>, unsigned long long> counts;
+    std::vector<unsigned long> key;
+    pthread_mutex_lock(&threadLock);
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++){
+        ThreadInfo* info = it->second;
+        if(info->retired || info->sampleRing == NULL)
+            continue;
+        unsigned int numEvents = __atomic_load_n(&(info->numSampleEvents), __ATOMIC_ACQUIRE);
+        unsigned int first = numEvents > EZP_SAMPLE_RING_SIZE ? numEvents - EZP_SAMPLE_RING_SIZE : 0;
+        for(unsigned int i = first; i != numEvents; i++){
+            const SampleEvent* event = info->sampleRing + i%EZP_SAMPLE_RING_SIZE;
+            unsigned int numFrames = event->numFrames < EZP_SAMPLE_FRAMES ? event->numFrames : EZP_SAMPLE_FRAMES;
+            key.assign(1, event->blockName);
+            for(unsigned int f=0;f<numFrames;f++)
+                key.push_back((unsigned long)event->frames[f]);
+            counts[key] += event->weight;
+        }
+    }
+    pthread_mutex_unlock(&threadLock);
+
+    for(std::map<std::vector<unsigned long>, unsigned long long>::iterator it = counts.begin(); it != counts.end(); it++){
+        SampledStack stack;
+        stack.blockName = it->first[0];
+        stack.count = it->second;
+        stack.numFrames = it->first.size() - 1;
+        for(unsigned int f=0;f<stack.numFrames;f++)
+            stack.frames[f] = (void*)it->first[f + 1];
+        stacks.push_back(stack);
+    }
+    std::sort(stacks.begin(), stacks.end(), SampledStack::compare);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::getAddressLabel(const void* address, char* output)
+{
+    Dl_info info;
+    if(dladdr(address, &info) == 0 || info.dli_fname == NULL)
+        snprintf(output, EZP_BLOCK_LABEL_LENGTH, "%p", address);
+
+    //The closest dynamic symbol below may be another function if this one is not exported; link with -rdynamic
+    else if(info.dli_sname != NULL){
+        int status;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+        snprintf(output, EZP_BLOCK_LABEL_LENGTH, "%s+0x%lx", demangled != NULL ? demangled : info.dli_sname,
+                (unsigned long)((char*)address - (char*)info.dli_saddr));
+        free(demangled);
+    }
+    else{
+        const char* module = strrchr(info.dli_fname, '/');
+        snprintf(output, EZP_BLOCK_LABEL_LENGTH, "%s+0x%lx", module != NULL ? module + 1 : info.dli_fname,
+                (unsigned long)((char*)address - (char*)info.dli_fbase));
+    }
+}
+
+} /* namespace ezp */
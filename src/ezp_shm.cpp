@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_shm.cpp
+ * @brief Publishing and reading offline analysis records through POSIX shared memory
+ * @date 2026-10-18
+ */
+
+#include<csignal>
+#include<cstdlib>
+#include<dirent.h>
+#include<fcntl.h>
+#include<set>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+/**
+ * @brief How many times a reader retries a record that is being written before accepting a possibly torn copy
+ */
+#define EZP_SHARED_READ_RETRIES 1000
+
+/**
+ * @brief Gets the name of the shared memory segment of a process
+ *
+ * @param pid Process ID
+ * @param output Preallocated buffer to write the name to, must be at least 32 characters long
+ */
+static void getSharedStatsName(pid_t pid, char* output)
+{
+    snprintf(output, 32, "/ezp.%d", pid);
+}
+
+#ifndef ANDROID
+
+/**
+ * @brief Checks whether a mapped shared memory segment was published with the layout of this EZP version
+ *
+ * @param header Beginning of the segment
+ * @param size Size of the segment in bytes
+ *
+ * @return Whether the records of the segment can be read
+ */
+static bool isCompatibleSegment(const SharedHeader* header, size_t size)
+{
+    return memcmp(header->magic, "EZPS", 4) == 0 && header->version == 2 && header->histogramBuckets == EZP_HISTOGRAM_BUCKETS &&
+        header->recordSize == sizeof(SharedRecord) && sizeof(SharedHeader) + header->capacity*sizeof(SharedRecord) <= size;
+}
+
+/**
+ * @brief Copies a record of a shared memory segment under its sequence lock
+ *
+ * @param record Record in the segment
+ * @param copy Record to copy to, seq is the sequence that the copy was taken at
+ *
+ * @return Whether the copy is consistent; a wedged writer leaves the sequence odd forever, so the reader gives up eventually
+ */
+static bool readSharedRecord(const SharedRecord* record, SharedRecord& copy)
+{
+    for(int retry=0;retry<EZP_SHARED_READ_RETRIES;retry++){
+        copy.seq = __atomic_load_n(&(record->seq), __ATOMIC_ACQUIRE);
+        copy.tid = __atomic_load_n(&(record->tid), __ATOMIC_RELAXED);
+        copy.blockName = __atomic_load_n(&(record->blockName), __ATOMIC_RELAXED);
+        copy.numSamples = __atomic_load_n(&(record->numSamples), __ATOMIC_RELAXED);
+        copy.totalTime = __atomic_load_n(&(record->totalTime), __ATOMIC_RELAXED);
+        for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+            copy.histogram[j] = __atomic_load_n(&(record->histogram[j]), __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(copy.seq % 2 == 0 && __atomic_load_n(&(record->seq), __ATOMIC_RELAXED) == copy.seq)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Shared memory segment of another process that stays mapped between pulls
+ */
+typedef struct PulledSegment_t{
+    const SharedHeader* header;                 ///< Beginning of the mapped segment
+    size_t size;                                ///< Size of the mapped segment in bytes
+    char bucketName[EZP_THREAD_NAME_LENGTH];    ///< Name of the retired bucket that the records of the process are summed in
+    TID bucket;                                 ///< Retired bucket that the records of the process are summed in, 0 until it is created
+    std::vector<SharedRecord> seen;             ///< Copies of the records as of the last pull
+    unsigned int clearGeneration;               ///< Clear generation of the segment as of the last pull
+} PulledSegment;
+
+/**
+ * @brief Identifies a segment by process ID and inode, a process that publishes anew gets a new inode
+ */
+typedef std::pair<pid_t, ino_t> SegmentKey;
+
+static pthread_mutex_t pullLock = PTHREAD_MUTEX_INITIALIZER;    ///< Locks pulled segment access
+static std::map<SegmentKey, PulledSegment> pulledSegments;      ///< Mapped segments of live processes
+static std::set<SegmentKey> finishedSegments;                   ///< Segments of exited processes that were pulled a last time
+
+#endif
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::publishSharedStats()
+{
+#ifdef ANDROID
+    EZP_PERR("EZP: Shared memory statistics are not supported on Android\n");
+    return false;
+#else
+    pthread_mutex_lock(&offlineLock);
+    if(sharedStats != NULL){
+        pthread_mutex_unlock(&offlineLock);
+        return true;
+    }
+
+    char name[32];
+    getSharedStatsName(getpid(), name);
+    size_t size = sizeof(SharedHeader) + EZP_MAX_DUMPED_BLOCKS*sizeof(SharedRecord);
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        EZP_PERR("EZP: shm_open() error: %s\n", strerror(errno));
+        pthread_mutex_unlock(&offlineLock);
+        return false;
+    }
+    if(ftruncate(fd, size) == -1){
+        EZP_PERR("EZP: ftruncate() error: %s\n", strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        pthread_mutex_unlock(&offlineLock);
+        return false;
+    }
+    void* segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(segment == MAP_FAILED){
+        EZP_PERR("EZP: mmap() error: %s\n", strerror(errno));
+        shm_unlink(name);
+        pthread_mutex_unlock(&offlineLock);
+        return false;
+    }
+
+    SharedHeader* header = (SharedHeader*)segment;
+    memcpy(header->magic, "EZPS", 4);
+    header->version = 2;
+    header->pid = getpid();
+    header->histogramBuckets = EZP_HISTOGRAM_BUCKETS;
+    header->recordSize = sizeof(SharedRecord);
+    header->capacity = EZP_MAX_DUMPED_BLOCKS;
+    header->retireSeq = 0;
+    header->clearGeneration = 0;
+    sharedRecords = (SharedRecord*)(header + 1);
+
+    //Publish the records that were created before
+    unsigned int numRecords = numOfflineRecords < EZP_MAX_DUMPED_BLOCKS ? numOfflineRecords : EZP_MAX_DUMPED_BLOCKS;
+    for(unsigned int i=0;i<numRecords;i++){
+        offlineRecords[i]->shared = sharedRecords + i;
+        updateSharedRecord(offlineRecords[i], -1);
+    }
+    __atomic_store_n(&(header->numRecords), numRecords, __ATOMIC_RELEASE);
+    sharedStats = header;
+    pthread_mutex_unlock(&offlineLock);
+
+    atexit(&EasyPerformanceAnalyzer::unlinkSharedStats);
+    EZP_PRINT("EZP: Publishing offline analyses in shared memory segment %s\n", name);
+    return true;
+#endif
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::unlinkSharedStats()
+{
+#ifndef ANDROID
+    char name[32];
+    getSharedStatsName(getpid(), name);
+    shm_unlink(name);
+#endif
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::readSharedStats(pid_t pid, OfflineReport& report)
+{
+#ifdef ANDROID
+    EZP_PERR("EZP: Shared memory statistics are not supported on Android\n");
+    return false;
+#else
+    char name[32];
+    getSharedStatsName(pid, name);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd == -1){
+        EZP_PERR("EZP: shm_open() error on %s: %s\n", name, strerror(errno));
+        EZP_PERR("EZP: Make sure that process %d called EZP_BEGIN_SHARED_STATS.\n", pid);
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(SharedHeader)){
+        EZP_PERR("EZP: %s is not a valid EZP shared memory segment\n", name);
+        close(fd);
+        return false;
+    }
+    void* segment = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(segment == MAP_FAILED){
+        EZP_PERR("EZP: mmap() error: %s\n", strerror(errno));
+        return false;
+    }
+
+    const SharedHeader* header = (const SharedHeader*)segment;
+    if(!isCompatibleSegment(header, info.st_size)){
+        EZP_PERR("EZP: %s has an incompatible layout, was it published by a different EZP version?\n", name);
+        munmap(segment, info.st_size);
+        return false;
+    }
+    if(kill(pid, 0) == -1 && errno == ESRCH)
+        EZP_PERR("EZP: Process %d is gone, these are its last published records\n", pid);
+
+    unsigned int numRecords = __atomic_load_n(&(header->numRecords), __ATOMIC_ACQUIRE);
+    if(numRecords > header->capacity)
+        numRecords = header->capacity;
+
+    const SharedRecord* records = (const SharedRecord*)(header + 1);
+    report.threadProfiles.resize(numRecords);
+    report.summedProfiles.clear();
+    for(unsigned int i=0;i<numRecords;i++){
+        SharedRecord record;
+        if(!readSharedRecord(records + i, record))
+            EZP_PERR("EZP: Record %u is still being written, its values may be inconsistent\n", i);
+
+        AggregateProfile& profile = report.threadProfiles[i];
+        profile.tid = record.tid;
+        profile.blockName = record.blockName;
+        profile.numSamples = record.numSamples;
+        profile.totalTime = record.totalTime;
+        for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+            profile.histogram[j] = record.histogram[j];
+    }
+    munmap(segment, info.st_size);
+
+    completeOfflineReport(report);
+    return true;
+#endif
+}
+
+#ifndef ANDROID
+
+/**
+ * @brief Subtracts the values of a record from another, as far as they go
+ *
+ * @param record Record to subtract from
+ * @param values Record to subtract
+ */
+static void subtractSharedRecord(SharedRecord& record, const SharedRecord& values)
+{
+    record.numSamples -= std::min(record.numSamples, values.numSamples);
+    record.totalTime -= std::min(record.totalTime, values.totalTime);
+    for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+        record.histogram[j] -= std::min(record.histogram[j], values.histogram[j]);
+}
+
+/**
+ * @brief Gets what changed in a pulled segment since the last pull
+ *
+ * @param segment Pulled segment
+ * @param deltas Records to append the changes to
+ * @param last Whether this is the last pull of an exited process, which takes the records even if the process died moving some
+ */
+static void pullSegment(PulledSegment& segment, std::vector<SharedRecord>& deltas, bool last)
+{
+    //A pull that overlaps an exiting thread is dropped and done again at the next pull
+    unsigned int retireSeq = __atomic_load_n(&(segment.header->retireSeq), __ATOMIC_ACQUIRE);
+    if(retireSeq % 2 != 0 && !last)
+        return;
+
+    //The process cleared its offline analyses since the last pull, what its records hold now is all new
+    unsigned int clearGeneration = __atomic_load_n(&(segment.header->clearGeneration), __ATOMIC_ACQUIRE);
+    unsigned int numRecords = __atomic_load_n(&(segment.header->numRecords), __ATOMIC_ACQUIRE);
+    if(numRecords > segment.header->capacity)
+        numRecords = segment.header->capacity;
+
+    std::vector<SharedRecord> seen;
+    if(clearGeneration == segment.clearGeneration)
+        seen.assign(segment.seen.begin(), segment.seen.begin() + std::min((size_t)numRecords, segment.seen.size()));
+    std::vector<SharedRecord> changes;
+    std::map<unsigned int, SharedRecord> retired;
+
+    const SharedRecord* records = (const SharedRecord*)(segment.header + 1);
+    for(unsigned int i=0;i<numRecords;i++){
+        if(i < seen.size() && __atomic_load_n(&(records[i].seq), __ATOMIC_RELAXED) == seen[i].seq)
+            continue;
+
+        //A record that is still being written is read again at the next pull
+        SharedRecord current;
+        if(!readSharedRecord(records + i, current))
+            continue;
+        if(i >= seen.size())
+            seen.resize(i + 1, SharedRecord());
+
+        //The record went to another block, or back in time after a clear; count it from scratch
+        SharedRecord& previous = seen[i];
+        if(current.tid != previous.tid || current.blockName != previous.blockName || current.numSamples < previous.numSamples){
+
+            //The thread exited and what we summed of it reappears in a retired bucket of the process along with what we did not
+            if(previous.tid > 0 && current.tid != previous.tid){
+                std::map<unsigned int, SharedRecord>::iterator it = retired.insert(std::make_pair(previous.blockName, SharedRecord())).first;
+                it->second.numSamples += previous.numSamples;
+                it->second.totalTime += previous.totalTime;
+                for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+                    it->second.histogram[j] += previous.histogram[j];
+            }
+            memset(&previous, 0, sizeof(previous));
+        }
+
+        //Recycled records of exited threads hold nothing
+        if(current.tid != 0 && current.numSamples > previous.numSamples){
+            changes.push_back(current);
+            SharedRecord& delta = changes.back();
+            delta.numSamples -= previous.numSamples;
+            delta.totalTime -= previous.totalTime;
+            for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+                delta.histogram[j] -= previous.histogram[j];
+        }
+        previous = current;
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&(segment.header->retireSeq), __ATOMIC_RELAXED) != retireSeq && !last)
+        return;
+    if(__atomic_load_n(&(segment.header->clearGeneration), __ATOMIC_RELAXED) != clearGeneration && !last)
+        return;
+
+    //Retired buckets have negative thread IDs
+    for(std::vector<SharedRecord>::iterator it = changes.begin(); it != changes.end(); it++){
+        std::map<unsigned int, SharedRecord>::iterator itr = retired.find(it->blockName);
+        if(it->tid < 0 && itr != retired.end()){
+            SharedRecord delta = *it;
+            subtractSharedRecord(*it, itr->second);
+            subtractSharedRecord(itr->second, delta);
+        }
+        if(it->numSamples > 0)
+            deltas.push_back(*it);
+    }
+    segment.seen.swap(seen);
+    segment.clearGeneration = clearGeneration;
+}
+
+/**
+ * @brief Maps the segment of a process unless it is already mapped or finished
+ *
+ * @param pid Process ID of the publishing process
+ * @param listed Keys of listed segments to add the key of the segment to
+ */
+static void attachSegment(pid_t pid, std::set<SegmentKey>& listed)
+{
+    char name[32];
+    getSharedStatsName(pid, name);
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd == -1)
+        return; //Unlinked since it was listed
+    struct stat info;
+    if(fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(SharedHeader)){
+        close(fd);
+        return;
+    }
+    SegmentKey key(pid, info.st_ino);
+    listed.insert(key);
+    if(pulledSegments.count(key) > 0 || finishedSegments.count(key) > 0){
+        close(fd);
+        return;
+    }
+
+    void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        EZP_PERR("EZP: mmap() error on %s: %s\n", name, strerror(errno));
+        return;
+    }
+    if(!isCompatibleSegment((const SharedHeader*)mapped, info.st_size)){
+        EZP_PERR("EZP: %s has an incompatible layout, was it published by a different EZP version?\n", name);
+        munmap(mapped, info.st_size);
+        finishedSegments.insert(key);
+        return;
+    }
+
+    //Name the bucket COMM.PID within the thread name length
+    char comm[EZP_THREAD_NAME_LENGTH] = "";
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    FILE* file = fopen(path, "r");
+    if(file != NULL){
+        if(fgets(comm, sizeof(comm), file) != NULL)
+            comm[strcspn(comm, "\n")] = '\0';
+        fclose(file);
+    }
+    char suffix[16];
+    size_t suffixLength = snprintf(suffix, sizeof(suffix), "%s%d", comm[0] == '\0' ? "" : ".", pid);
+    size_t commLength = std::min(strlen(comm), EZP_THREAD_NAME_LENGTH - 1 - suffixLength);
+
+    PulledSegment& segment = pulledSegments[key];
+    segment.header = (const SharedHeader*)mapped;
+    segment.size = info.st_size;
+    memcpy(segment.bucketName, comm, commLength);
+    memcpy(segment.bucketName + commLength, suffix, suffixLength + 1);
+    segment.bucket = 0;
+    segment.clearGeneration = __atomic_load_n(&(segment.header->clearGeneration), __ATOMIC_ACQUIRE);
+    EZP_PRINT("EZP: Pulling offline analyses of process %d from %s\n", pid, name);
+}
+
+#endif
+
+//This function is not time critical
+int EasyPerformanceAnalyzer::pullSharedStats()
+{
+#ifdef ANDROID
+    EZP_PERR("EZP: Shared memory statistics are not supported on Android\n");
+    return -1;
+#else
+    pthread_mutex_lock(&pullLock);
+
+    //Segments live in /dev/shm on Linux; ours is skipped so that we do not sum our own sums
+    std::set<SegmentKey> listed;
+    DIR* dir = opendir("/dev/shm");
+    if(dir != NULL){
+        struct dirent* entry;
+        while((entry = readdir(dir)) != NULL){
+            int pid, length = 0;
+            if(sscanf(entry->d_name, "ezp.%d%n", &pid, &length) == 1 && entry->d_name[length] == '\0' && pid > 0 && pid != getpid())
+                attachSegment(pid, listed);
+        }
+        closedir(dir);
+    }
+    else
+        EZP_PERR("EZP: opendir() error on /dev/shm: %s\n", strerror(errno));
+
+    int numPulled = 0;
+    std::vector<SharedRecord> deltas;
+    std::map<SegmentKey, PulledSegment>::iterator it = pulledSegments.begin();
+    while(it != pulledSegments.end()){
+        PulledSegment& segment = it->second;
+        if(segment.bucket == 0)
+            segment.bucket = getRetiredTid(segment.bucketName);
+
+        //An unlinked segment is exiting or replaced; the mapping outlives it, so this pull gets everything it published
+        bool gone = listed.count(it->first) == 0 || (kill(it->first.first, 0) == -1 && errno == ESRCH);
+        deltas.clear();
+        pullSegment(segment, deltas, gone);
+        numPulled++;
+
+        pthread_mutex_lock(&offlineLock);
+        for(std::vector<SharedRecord>::const_iterator itd = deltas.begin(); itd != deltas.end(); itd++){
+            AggregateMarker source(itd->tid, itd->blockName);
+            source.numSamples = itd->numSamples;
+            source.totalTime = itd->totalTime;
+            for(int j=0;j<EZP_HISTOGRAM_BUCKETS;j++)
+                source.histogram[j] = itd->histogram[j];
+            foldOfflineMarker(getOfflineMarker(BlockKey(segment.bucket, itd->blockName)), &source);
+        }
+        pthread_mutex_unlock(&offlineLock);
+
+        if(!gone){
+            it++;
+            continue;
+        }
+        EZP_PRINT("EZP: Process %d is gone, its offline analyses stay summed in %s\n", it->first.first, segment.bucketName);
+        finishedSegments.insert(it->first);
+        munmap((void*)segment.header, segment.size);
+        pulledSegments.erase(it++);
+    }
+
+    pthread_mutex_unlock(&pullLock);
+    return numPulled;
+#endif
+}
+
+} /* namespace ezp */
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_threads.cpp
+ * @brief Thread IDs, thread names and retirement of the records of exited threads
+ * @date 2026-10-18
+ */
+
+#include"ezp_internal.hpp"
+
+#include<sys/prctl.h>
+
+namespace ezp{
+
+//This function is not time critical, called once per thread
+void EasyPerformanceAnalyzer::cacheTid()
+{
+    pthread_once(&forkHandlersOnce, registerForkHandlers);
+    cachedTid = EZP_GET_TID;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::createThreadKey()
+{
+    int err = pthread_key_create(&threadKey, retireThread);
+    if(err != 0)
+        EZP_PERR("EZP: pthread_key_create() error: %s\n", strerror(err));
+}
+
+//This function is not time critical, called once per thread
+void EasyPerformanceAnalyzer::registerThread()
+{
+    pthread_once(&threadKeyOnce, createThreadKey);
+
+    ThreadInfo* info = new ThreadInfo();
+    info->tid = getTid();
+    info->named = false;
+    info->retired = false;
+
+    //PR_GET_NAME gives the name set with pthread_setname_np(), which is the process name unless the thread was named
+    memset(info->name, 0, sizeof(info->name));
+    if(prctl(PR_GET_NAME, info->name, 0, 0, 0) == -1)
+        snprintf(info->name, sizeof(info->name), "%d", info->tid);
+    info->name[EZP_THREAD_NAME_LENGTH - 1] = '\0';
+
+    pthread_mutex_lock(&threadLock);
+    info->disabled = !matchThreadFilters(info);
+    threads[info->tid] = info;
+    pthread_mutex_unlock(&threadLock);
+
+    pthread_setspecific(threadKey, info);
+    currentThread = info;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::initThread()
+{
+    if(currentThread == NULL)
+        registerThread();
+    if((__atomic_load_n(&state, __ATOMIC_RELAXED) & STATE_SAMPLING) &&
+            currentThread->samplingGeneration != __atomic_load_n(&samplingGeneration, __ATOMIC_RELAXED))
+        armSampling(currentThread);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setThreadName(const char* name)
+{
+    if(currentThread == NULL)
+        registerThread();
+
+    pthread_mutex_lock(&threadLock);
+    strncpy(currentThread->name, name, EZP_THREAD_NAME_LENGTH - 1);
+    currentThread->name[EZP_THREAD_NAME_LENGTH - 1] = '\0';
+    currentThread->named = true;
+    __atomic_store_n(&(currentThread->disabled), !matchThreadFilters(currentThread), __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&threadLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::refreshThreadNames()
+{
+    std::vector<TID> tids;
+    pthread_mutex_lock(&threadLock);
+    for(Tid2Thread::iterator it = threads.begin(); it != threads.end(); it++)
+        if(!it->second->retired && !it->second->named)
+            tids.push_back(it->first);
+    pthread_mutex_unlock(&threadLock);
+
+    //Files of /proc are not read under threadLock, which first starts of new threads take
+    std::vector<std::string> names(tids.size());
+    for(size_t i=0;i<tids.size();i++){
+        char path[64];
+        char name[EZP_THREAD_NAME_LENGTH] = "";
+        snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tids[i]);
+        FILE* file = fopen(path, "r");
+        if(file == NULL)
+            continue; //Exited since it was listed
+        if(fgets(name, sizeof(name), file) != NULL)
+            name[strcspn(name, "\n")] = '\0';
+        fclose(file);
+        names[i] = name;
+    }
+
+    pthread_mutex_lock(&threadLock);
+    for(size_t i=0;i<tids.size();i++){
+        Tid2Thread::iterator it = threads.find(tids[i]);
+        if(names[i].empty() || it == threads.end() || it->second->named || strcmp(it->second->name, names[i].c_str()) == 0)
+            continue;
+        memcpy(it->second->name, names[i].c_str(), names[i].size() + 1);
+        __atomic_store_n(&(it->second->disabled), !matchThreadFilters(it->second), __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&threadLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setRequestId(unsigned long long id)
+{
+    if(currentThread == NULL)
+        registerThread();
+
+    //Only read by this thread when its blocks end
+    currentThread->requestId = id;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::getPoolName(const char* name, char* pool)
+{
+    strncpy(pool, name, EZP_THREAD_NAME_LENGTH - 1);
+    pool[EZP_THREAD_NAME_LENGTH - 1] = '\0';
+
+    //Strip the trailing number along with the separators before it, but never the whole name
+    int length = strlen(pool);
+    while(length > 1 && strchr("0123456789-_.:# ", pool[length - 1]) != NULL)
+        length--;
+    pool[length] = '\0';
+}
+
+//This function is not time critical
+TID EasyPerformanceAnalyzer::getRetiredTid(const char* pool)
+{
+    pthread_mutex_lock(&threadLock);
+    ThreadInfo* retired;
+    Name2Thread::iterator poolIt = retiredPools.find(pool);
+
+    //The bucket of EZP_OTHER_NAME is the last one that the limit allows, threads of new pools go to it once the others are taken
+    unsigned int limit = __atomic_load_n(&maxPools, __ATOMIC_RELAXED);
+    if(poolIt == retiredPools.end() && limit > 0 && retiredPools.size() + 1 >= limit){
+        pool = EZP_OTHER_NAME;
+        poolIt = retiredPools.find(pool);
+    }
+    if(poolIt != retiredPools.end())
+        retired = poolIt->second;
+    else{
+        retired = new ThreadInfo();
+        retired->tid = -(TID)(retiredPools.size() + 1);
+        strncpy(retired->name, pool, sizeof(retired->name) - 1);
+        retired->name[EZP_THREAD_NAME_LENGTH - 1] = '\0';
+        retired->retired = true;
+        retiredPools.insert(std::make_pair(std::string(retired->name), retired));
+        threads[retired->tid] = retired;
+    }
+    TID tid = retired->tid;
+    pthread_mutex_unlock(&threadLock);
+    return tid;
+}
+
+//This function is not time critical
+AggregateMarker* EasyPerformanceAnalyzer::getOfflineMarker(const BlockKey& key)
+{
+    Blk2AMarker::iterator it = offlineBlocks.find(key);
+    return it != offlineBlocks.end() ? it->second : createOfflineMarker(key);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::foldOfflineMarker(AggregateMarker* target, const AggregateMarker* source)
+{
+    __atomic_store_n(&(target->numSamples), target->numSamples + source->numSamples, __ATOMIC_RELAXED);
+    __atomic_store_n(&(target->totalTime), target->totalTime + source->totalTime, __ATOMIC_RELAXED);
+    for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+        __atomic_store_n(&(target->histogram[i]), target->histogram[i] + source->histogram[i], __ATOMIC_RELAXED);
+    target->sched.add(source->sched);
+    target->nodes.add(source->nodes);
+    target->allocs.add(source->allocs);
+    __atomic_store_n(&(target->samples), target->samples + source->samples, __ATOMIC_RELAXED);
+    __atomic_store_n(&(target->selfSamples), target->selfSamples + source->selfSamples, __ATOMIC_RELAXED);
+    if(target->shared != NULL)
+        updateSharedRecord(target, -1);
+}
+
+//This function is not time critical, called once per exiting thread
+void EasyPerformanceAnalyzer::retireThread(void* arg)
+{
+    ThreadInfo* info = (ThreadInfo*)arg;
+    TID tid = info->tid;
+
+    //No sample may come in once the records of the thread are recycled
+    if(info->samplingTimerCreated){
+        timer_delete(info->samplingTimer);
+        info->samplingTimerCreated = false;
+    }
+    info->numOpenBlocks = 0;
+
+    //Forget the thread, its records go to the retired bucket of the pool of the name it has now
+    char pool[EZP_THREAD_NAME_LENGTH];
+    char name[EZP_THREAD_NAME_LENGTH] = "";
+    if(!info->named && prctl(PR_GET_NAME, name, 0, 0, 0) == 0)
+        name[EZP_THREAD_NAME_LENGTH - 1] = '\0';
+    pthread_mutex_lock(&threadLock);
+    if(name[0] != '\0')
+        memcpy(info->name, name, sizeof(info->name));
+    getPoolName(info->name, pool);
+    Tid2Thread::iterator threadIt = threads.find(tid);
+    if(threadIt != threads.end() && threadIt->second == info)
+        threads.erase(threadIt);
+    pthread_mutex_unlock(&threadLock);
+    TID retiredTid = getRetiredTid(pool);
+
+    //stopRecording() does not see the thread anymore, its last blocks are queued here
+    RecordBuffer* buffer = __atomic_exchange_n(&(info->recordBuffer), NULL, __ATOMIC_ACQUIRE);
+    if(buffer != NULL)
+        queueRecordBuffer(info, buffer);
+
+    //Fold offline records into the retired bucket and recycle them; records of a thread are contiguous as the thread ID has priority in sorting
+    pthread_mutex_lock(&offlineLock);
+
+    //Readers of the shared memory segment must see the records either all in the thread or all in the bucket
+    unsigned int retireSeq = 0;
+    if(sharedStats != NULL){
+        retireSeq = sharedStats->retireSeq;
+        __atomic_store_n(&(sharedStats->retireSeq), retireSeq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+    Blk2AMarker::iterator it = offlineBlocks.lower_bound(BlockKey(tid, UINT_MAX));
+    while(it != offlineBlocks.end() && it->first.tid == tid){
+        AggregateMarker* marker = it->second;
+        offlineBlocks.erase(it++);
+
+        foldOfflineMarker(getOfflineMarker(BlockKey(retiredTid, marker->blockName)), marker);
+
+        //Lock-free readers may still hold the marker, so it is reset and kept instead of freed
+        __atomic_store_n(&(marker->tid), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->blockName), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->numSamples), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->totalTime), 0, __ATOMIC_RELAXED);
+        for(int i=0;i<EZP_HISTOGRAM_BUCKETS;i++)
+            __atomic_store_n(&(marker->histogram[i]), 0, __ATOMIC_RELAXED);
+        marker->sched = SchedStats();
+        marker->nodes = NodeStats();
+        marker->allocs = AllocStats();
+        __atomic_store_n(&(marker->samples), 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&(marker->selfSamples), 0, __ATOMIC_RELAXED);
+        if(marker->shared != NULL)
+            updateSharedRecord(marker, -1);
+        freeOfflineMarkers.push_back(marker);
+    }
+    if(sharedStats != NULL)
+        __atomic_store_n(&(sharedStats->retireSeq), retireSeq + 2, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&offlineGeneration, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&offlineLock);
+
+    //Real-time and smoothed records of this thread cannot be used anymore
+    pthread_mutex_lock(&lock);
+    Blk2Clk::iterator clkIt = blocks.lower_bound(BlockKey(tid, UINT_MAX));
+    while(clkIt != blocks.end() && clkIt->first.tid == tid){
+        delete clkIt->second;
+        blocks.erase(clkIt++);
+    }
+    pthread_mutex_unlock(&lock);
+
+    pthread_mutex_lock(&smoothLock);
+    Blk2SMarker::iterator smoothIt = smoothBlocks.lower_bound(BlockKey(tid, UINT_MAX));
+    while(smoothIt != smoothBlocks.end() && smoothIt->first.tid == tid){
+        delete smoothIt->second;
+        smoothBlocks.erase(smoothIt++);
+    }
+    pthread_mutex_unlock(&smoothLock);
+
+    currentThread = NULL;
+    delete[] info->traceRing;
+    delete[] info->sampleRing;
+    delete info;
+}
+
+} /* namespace ezp */
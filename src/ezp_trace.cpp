@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file ezp_trace.cpp
+ * @brief Traces of the most recently ended blocks of a thread, written when a block is over its threshold
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+
+#include"ezp_internal.hpp"
+
+namespace ezp{
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setTraceThreshold(const char* blockName, float thresholdMs)
+{
+    unsigned int name = hashStr(blockName);
+    registerBlock(name);
+    int id = getBlockId(name);
+    if(id < 0){
+        EZP_PERR("EZP: Cannot trace %s, there are more than %d block names\n", blockName, EZP_MAX_BLOCK_IDS);
+        return;
+    }
+
+    pthread_mutex_lock(&filterLock);
+    unsigned long long threshold = thresholdMs > 0.0f ? (unsigned long long)(thresholdMs*1000000.0) : 0;
+    unsigned long long previous = __atomic_exchange_n(&(traceThresholds[id]), threshold, __ATOMIC_RELAXED);
+    if(previous == 0 && threshold != 0)
+        numTraceThresholds++;
+    else if(previous != 0 && threshold == 0)
+        numTraceThresholds--;
+
+    //A new threshold gets a new budget of traces
+    __atomic_store_n(&numTraces, 0, __ATOMIC_RELAXED);
+    setState(STATE_TRACING, numTraceThresholds > 0);
+    pthread_mutex_unlock(&filterLock);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::setTracePath(const char* path)
+{
+    strncpy(tracePath, path, sizeof(tracePath) - 1);
+}
+
+//This function is not time critical
+bool EasyPerformanceAnalyzer::parseTraceThreshold(const char* threshold)
+{
+    const char* colon = strrchr(threshold, ':');
+    if(colon == NULL){
+        EZP_PERR("EZP: Malformed trace threshold \"%s\", must be BLOCK_NAME:THRESHOLD_MS\n", threshold);
+        return false;
+    }
+    char* end;
+    errno = 0;
+    double thresholdMs = strtod(colon + 1, &end);
+    if(end == colon + 1 || *end != '\0' || errno == ERANGE || !(thresholdMs >= 0.0)){
+        EZP_PERR("EZP: Malformed trace threshold \"%s\", THRESHOLD_MS must be a number of ms, 0 to stop tracing\n", threshold);
+        return false;
+    }
+    setTraceThreshold(std::string(threshold, colon - threshold).c_str(), thresholdMs);
+    return true;
+}
+
+//This function is not time critical, called only for blocks over their threshold
+void EasyPerformanceAnalyzer::queueTrace(ThreadInfo* info, unsigned long long threshold)
+{
+    unsigned int trace = __atomic_add_fetch(&numTraces, 1, __ATOMIC_RELAXED);
+    if(trace > EZP_MAX_TRACES){
+        if(trace == EZP_MAX_TRACES + 1)
+            EZP_PERR("EZP: Wrote %d traces, set a trace threshold again to write more\n", EZP_MAX_TRACES);
+        return;
+    }
+
+    //Oldest blocks first, the ring is full once it wrapped around; the file is written by the trace writer thread
+    TraceSnapshot* snapshot = new TraceSnapshot;
+    snapshot->tid = info->tid;
+    memcpy(snapshot->threadName, info->name, sizeof(snapshot->threadName));
+    snapshot->index = __atomic_fetch_add(&nextTraceIndex, 1, __ATOMIC_RELAXED);
+    snapshot->threshold = threshold;
+    snapshot->numEvents = info->numTraceEvents < info->traceRingSize ? info->numTraceEvents : info->traceRingSize;
+    snapshot->events = new TraceEvent[snapshot->numEvents];
+    for(unsigned int i=0;i<snapshot->numEvents;i++)
+        snapshot->events[i] = info->traceRing[(info->numTraceEvents - snapshot->numEvents + i)%info->traceRingSize];
+    snapshot->next = NULL;
+
+    pthread_mutex_lock(&traceLock);
+    if(!traceWriterRunning){
+        pthread_t writer;
+        int err = pthread_create(&writer, NULL, writeTraces, NULL);
+        if(err != 0){
+            pthread_mutex_unlock(&traceLock);
+            EZP_PERR("EZP: pthread_create() error: %s\n", strerror(err));
+            delete[] snapshot->events;
+            delete snapshot;
+            return;
+        }
+        pthread_detach(writer);
+        traceWriterRunning = true;
+    }
+    if(traceQueueTail != NULL)
+        traceQueueTail->next = snapshot;
+    else
+        traceQueue = snapshot;
+    traceQueueTail = snapshot;
+    numQueuedTraces++;
+    bool registerFlush = !flushTracesRegistered;
+    flushTracesRegistered = true;
+    pthread_cond_broadcast(&traceCond);
+    pthread_mutex_unlock(&traceLock);
+
+    if(registerFlush && atexit(&EasyPerformanceAnalyzer::flushTraces) != 0)
+        EZP_PERR("EZP: atexit() error: Could not register the trace flush handler\n");
+}
+
+//This function is not time critical
+void* EasyPerformanceAnalyzer::writeTraces(void*)
+{
+    pthread_mutex_lock(&traceLock);
+    while(true){
+        while(traceQueue == NULL)
+            pthread_cond_wait(&traceCond, &traceLock);
+        TraceSnapshot* snapshot = traceQueue;
+        traceQueue = snapshot->next;
+        if(traceQueue == NULL)
+            traceQueueTail = NULL;
+        pthread_mutex_unlock(&traceLock);
+
+        writeTrace(snapshot);
+        delete[] snapshot->events;
+        delete snapshot;
+
+        pthread_mutex_lock(&traceLock);
+        if(--numQueuedTraces == 0)
+            pthread_cond_broadcast(&traceCond);
+    }
+
+    //This function should and does return only when the process leaves
+    return NULL;
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::writeTrace(const TraceSnapshot* snapshot)
+{
+    char base[PATH_MAX + 16];
+    char path[PATH_MAX + 32];
+    getProcessPath(tracePath, base, sizeof(base));
+    snprintf(path, sizeof(path), "%s.%u.json", base, snapshot->index);
+    FILE* file = fopen(path, "w");
+    if(file == NULL){
+        EZP_PERR("EZP: fopen() error: %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    //Chrome trace event format, timestamps are in us
+    pid_t pid = getpid();
+    char cbuf[EZP_BLOCK_LABEL_LENGTH];
+    const TraceEvent* trigger = snapshot->events + snapshot->numEvents - 1;
+    getBlockLabel(trigger->blockName, cbuf);
+    fprintf(file, "{\"otherData\":{\"trigger\":\"%s\",\"durationNs\":%llu,\"thresholdNs\":%llu,\"clock\":\"thread CPU time\"},\n",
+            cbuf, trigger->duration, snapshot->threshold);
+    fprintf(file, "\"traceEvents\":[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            pid, snapshot->tid, snapshot->threadName);
+
+    for(unsigned int i=0;i<snapshot->numEvents;i++){
+        const TraceEvent* event = snapshot->events + i;
+        getBlockLabel(event->blockName, cbuf);
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f%s}",
+                cbuf, pid, snapshot->tid, event->beginTime/1000.0, event->duration/1000.0,
+                event == trigger ? ",\"args\":{\"trigger\":true}" : "");
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    getBlockLabel(trigger->blockName, cbuf);
+    EZP_PRINT("EZP: [%d]\t%s\t%6.2f ms over its trace threshold of %.2f ms, wrote the last %u blocks of the thread to %s\n",
+            snapshot->tid, cbuf, trigger->duration/1000000.0, snapshot->threshold/1000000.0, snapshot->numEvents, path);
+}
+
+//This function is not time critical
+void EasyPerformanceAnalyzer::flushTraces()
+{
+    pthread_mutex_lock(&traceLock);
+    while(numQueuedTraces > 0)
+        pthread_cond_wait(&traceCond, &traceLock);
+    pthread_mutex_unlock(&traceLock);
+}
+
+} /* namespace ezp */
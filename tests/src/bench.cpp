@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file bench.cpp
+ * @brief Benchmarks loops of known relative cost with EZP_BENCH and checks the means against a plain timing and the offline records
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+
+#include<ezp.hpp>
+
+#define NUM_ITERATIONS 2000
+#define NUM_REFERENCE_CALLS 2000
+
+static int numFailures = 0;
+static unsigned int seed = 1; //Not a constant, so that the loops cannot be computed at compile time
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+/**
+ * @brief Has no side effect, only its result keeps the compiler from dropping its calls
+ */
+template<int Iterations>
+static unsigned int iterate(){
+    unsigned int x = seed;
+    for(int i=0;i<Iterations;i++)
+        x = x*1103515245u + 12345u;
+    return x;
+}
+
+/**
+ * @brief Gets the time per call of iterate() on the thread CPU clock in ns, without EZP
+ */
+static double getReferenceTime(){
+    volatile unsigned int result;
+    double best = 1e30;
+    for(int round=0;round<5;round++){
+        struct timespec begin, end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+        for(int i=0;i<NUM_REFERENCE_CALLS;i++)
+            result = iterate<NUM_ITERATIONS>();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        best = std::min(best, ((end.tv_sec - begin.tv_sec)*1e9 + end.tv_nsec - begin.tv_nsec)/NUM_REFERENCE_CALLS);
+    }
+    (void)result;
+    return best;
+}
+
+/**
+ * @brief Gets the runs or the total time in ns of a block summed across threads, 0 if it has none
+ */
+static void getSummed(const char* block, long long& runs, long long& totalTime){
+    std::string csv;
+    EZP_FORMAT_OFFLINE(csv, CSV)
+    std::string row = std::string("\nsummed,,,\"") + block + "\",";
+    size_t pos = csv.find(row);
+    runs = 0;
+    totalTime = 0;
+    if(pos != std::string::npos && sscanf(csv.c_str() + pos + row.size(), "%lld,%lld", &runs, &totalTime) != 2)
+        runs = 0;
+}
+
+int main(int argc, char** argv){
+    EZP_SET_CONTROL_NAME("ezp_test_bench")
+    EZP_ENABLE
+    EZP_SET_BENCH_LIMITS(1, 2000)
+
+    double reference = getReferenceTime();
+    ezp::BenchResult single = ezp::Benchmark<ezp::ThreadCpuClock>::run("BN1", iterate<NUM_ITERATIONS>);
+    ezp::BenchResult twice = ezp::Benchmark<ezp::ThreadCpuClock>::run("BN2", iterate<2*NUM_ITERATIONS>);
+
+    //Generous bounds, the test runs on loaded machines; a dropped call would make the mean about 0
+    check(single.mean > 0.7*reference && single.mean < 1.3*reference, "mean agrees with a plain timing of the loop");
+    check(twice.mean > 1.6*single.mean && twice.mean < 2.4*single.mean, "twice the iterations take twice as long");
+    check(single.median > 0.0 && single.numSamples >= EZP_BENCH_MIN_SAMPLES, "batches are measured");
+
+    //Each call of a measured batch is one run of the block, lasting the batch's time per call
+    long long runs, totalTime;
+    getSummed("BN1", runs, totalTime);
+    check(runs == (long long)(single.batch*single.numSamples), "offline record counts every measured call");
+    check(runs > 0 && totalTime/(double)runs > 0.9*single.mean && totalTime/(double)runs < 1.1*single.mean,
+            "offline record average agrees with the mean");
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed, reference %.1f ns, means %.1f and %.1f ns, %lld runs of %llu x %llu\n", argv[0], numFailures,
+                reference, single.mean, twice.mean, runs, single.batch, single.numSamples);
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file critical.cpp
+ * @brief Records two threads that overlap in a block and then hand a request over, and checks what ezp_critical makes of it
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<pthread.h>
+
+#include<ezp.hpp>
+
+#define RECORDING_PATH "test-critical.ezr"
+#define REQUEST_ID 7
+
+static int numFailures = 0;
+static pthread_barrier_t barrier;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+//Both threads are inside CONC at once, then the first runs REQA and the second runs REQB once REQA ended, for the same request
+static void* runWorker(void* first){
+    EZP_START_OFFLINE("CONC")
+    pthread_barrier_wait(&barrier);
+    usleep(20000);
+    EZP_END_OFFLINE("CONC")
+    pthread_barrier_wait(&barrier);
+
+    EZP_SET_REQUEST_ID(REQUEST_ID)
+    if(first != NULL){
+        EZP_START_OFFLINE("REQA")
+        usleep(10000);
+        EZP_END_OFFLINE("REQA")
+        pthread_barrier_wait(&barrier);
+    }
+    else{
+        pthread_barrier_wait(&barrier);
+        EZP_START_OFFLINE("REQB")
+        usleep(30000);
+        EZP_END_OFFLINE("REQB")
+    }
+    EZP_SET_REQUEST_ID(0)
+    return NULL;
+}
+
+/**
+ * @brief Runs ezp_critical on the recording, returns its exit status and its output
+ */
+static int analyze(const char* analyzer, std::string& output){
+    std::string command = std::string(analyzer) + " " RECORDING_PATH " 2>/dev/null";
+    FILE* pipe = popen(command.c_str(), "r");
+    if(pipe == NULL)
+        return -1;
+    char buf[4096];
+    size_t length;
+    while((length = fread(buf, 1, sizeof(buf), pipe)) > 0)
+        output.append(buf, length);
+    return pclose(pipe);
+}
+
+/**
+ * @brief Gets the line that begins with prefix after position from, empty if there is none
+ */
+static std::string getLine(const std::string& output, const std::string& prefix, size_t from = 0){
+    size_t pos = output.find("\n" + prefix, from);
+    if(pos == std::string::npos)
+        return "";
+    return output.substr(pos + 1, output.find('\n', pos + 1) - pos - 1);
+}
+
+int main(int argc, char** argv){
+    if(argc != 2){
+        fprintf(stderr, "Usage: %s EZP_CRITICAL\n", argv[0]);
+        return 2;
+    }
+
+    EZP_SET_CONTROL_NAME("ezp_test_critical")
+    EZP_ENABLE
+    pthread_barrier_init(&barrier, NULL, 2);
+    EZP_BEGIN_RECORDING(RECORDING_PATH)
+    pthread_t workers[2];
+    pthread_create(&workers[0], NULL, runWorker, (void*)1);
+    pthread_create(&workers[1], NULL, runWorker, NULL);
+    pthread_join(workers[0], NULL);
+    pthread_join(workers[1], NULL);
+    EZP_END_RECORDING
+
+    std::string output;
+    check(analyze(argv[1], output) == 0, "ezp_critical succeeds");
+
+    //Name, calls, threads, active and busy time, mean and max threads inside
+    char name[16];
+    int calls, threads, maxInside;
+    double active, busy, meanInside;
+    check(sscanf(getLine(output, "CONC").c_str(), "%15s %d %d %lf %lf %lf %d", name, &calls, &threads, &active, &busy, &meanInside, &maxInside) == 7 &&
+            calls == 2 && threads == 2 && maxInside == 2, "both threads are inside the overlapping block at once");
+
+    size_t paths = output.find("\nCritical paths of 1 requests");
+    check(paths != std::string::npos, "blocks tagged with the same ID make one request");
+    double onPath = 0;
+    check(sscanf(getLine(output, "REQB", paths).c_str(), "%15s %lf", name, &onPath) == 2 && onPath >= 25 && onPath < 100,
+            "block that ended last is on the critical path for its length");
+    size_t request = output.find("\nRequest 7: ");
+    check(request != std::string::npos && output.find("2 blocks on the critical path", request) != std::string::npos,
+            "critical path walks back from the last block to the one it waited for");
+    size_t first = output.find("REQA", request);
+    check(request != std::string::npos && first != std::string::npos && first < output.find("REQB", request),
+            "critical path lists its blocks in time order");
+    remove(RECORDING_PATH);
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n%s", argv[0], numFailures, output.c_str());
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
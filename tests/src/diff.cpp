@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file diff.cpp
+ * @brief Writes JSON reports of a fast and a slow run of a block and checks the exit status of ezp_diff on them
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<sys/wait.h>
+
+#include<ezp.hpp>
+
+#define BASELINE_PATH "test-diff-baseline.json"
+#define CANDIDATE_PATH "test-diff-candidate.json"
+#define INVALID_PATH "test-diff-invalid.json"
+#define NUM_RUNS 100
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+/**
+ * @brief Runs the block, sleeping sleepUs us in each run, and writes the offline analyses of this run only as a JSON report
+ */
+static void writeReport(const char* path, int sleepUs){
+    EZP_CLEAR_OFFLINE
+    for(int i=0;i<NUM_RUNS;i++){
+        EZP_START_OFFLINE("DIF")
+        if(sleepUs > 0)
+            usleep(sleepUs);
+        EZP_END_OFFLINE("DIF")
+    }
+    FILE* file = fopen(path, "w");
+    if(file == NULL)
+        exit(2);
+    EZP_WRITE_OFFLINE(file, JSON)
+    fclose(file);
+}
+
+/**
+ * @brief Runs ezp_diff with arguments and returns its exit status, -1 if it did not exit
+ */
+static int diff(const char* differ, const char* arguments){
+    std::string command = std::string(differ) + " " + arguments + " >/dev/null 2>&1";
+    int status = system(command.c_str());
+    return status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char** argv){
+    if(argc != 2){
+        fprintf(stderr, "Usage: %s EZP_DIFF\n", argv[0]);
+        return 2;
+    }
+
+    EZP_SET_CONTROL_NAME("ezp_test_diff")
+    EZP_ENABLE
+    writeReport(BASELINE_PATH, 0);
+    writeReport(CANDIDATE_PATH, 500);
+    FILE* file = fopen(INVALID_PATH, "w");
+    if(file == NULL)
+        return 2;
+    fputs("{\"version\": 1, \"threads\": [", file);
+    fclose(file);
+
+    check(diff(argv[1], BASELINE_PATH " " BASELINE_PATH) == 0, "a report compared with itself has no regression");
+    check(diff(argv[1], BASELINE_PATH " " CANDIDATE_PATH) == 1, "a slower candidate is a regression");
+    check(diff(argv[1], CANDIDATE_PATH " " BASELINE_PATH) == 0, "a faster candidate is no regression");
+    check(diff(argv[1], BASELINE_PATH " test-diff-missing.json") == 2, "a missing report is an error");
+    check(diff(argv[1], BASELINE_PATH " " INVALID_PATH) == 2, "a truncated report is an error");
+    check(diff(argv[1], BASELINE_PATH) == 2, "a missing argument is an error");
+    check(diff(argv[1], "-x " BASELINE_PATH " " CANDIDATE_PATH) == 2, "an unknown option is an error");
+    remove(BASELINE_PATH);
+    remove(CANDIDATE_PATH);
+    remove(INVALID_PATH);
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n", argv[0], numFailures);
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file dump.cpp
+ * @brief Dumps offline analyses on demand and at the exit of a forked child, reads the dumps back and compares them with ezp_diff
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<pthread.h>
+#include<sys/wait.h>
+
+#include<ezp.hpp>
+
+#define DUMP_PATH "test-dump.ezd"
+#define REPORT_PATH "test-dump.json"
+#define EXIT_DUMP_PATH "test-dump-exit.ezd"
+#define RUNS_PER_THREAD 200
+#define RUNS_IN_CHILD 50
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+static void* runBlocks(void* numRuns){
+    for(long i=0;i<(long)numRuns;i++){
+        EZP_START_OFFLINE("DMP")
+        EZP_END_OFFLINE("DMP")
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reads a dump and sums the runs of all its records, -1 if it cannot be read
+ */
+static long long getDumpedRuns(const char* path){
+    FILE* file = fopen(path, "rb");
+    if(file == NULL)
+        return -1;
+    ezp::DumpHeader header;
+    long long numRuns = -1;
+    if(fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "EZPD", 4) == 0 &&
+            header.histogramBuckets == EZP_HISTOGRAM_BUCKETS){
+        numRuns = 0;
+        ezp::DumpRecord record;
+        for(unsigned int i=0;i<header.numRecords && numRuns >= 0;i++)
+            if(fread(&record, sizeof(record), 1, file) != 1)
+                numRuns = -1;
+            else if(record.tid != 0)
+                numRuns += record.numSamples;
+    }
+    fclose(file);
+    return numRuns;
+}
+
+/**
+ * @brief Runs ezp_diff on two files, returns its exit status and whether its output shows the block
+ */
+static int diff(const char* differ, const char* baseline, const char* candidate, bool& shown){
+    std::string command = std::string(differ) + " " + baseline + " " + candidate + " 2>/dev/null";
+    FILE* output = popen(command.c_str(), "r");
+    if(output == NULL)
+        return -1;
+    shown = false;
+    char line[1024];
+    while(fgets(line, sizeof(line), output) != NULL)
+        if(strstr(line, " DMP ") != NULL && strstr(line, "only in") == NULL)
+            shown = true;
+    int status = pclose(output);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int main(int argc, char** argv){
+    if(argc != 2){
+        fprintf(stderr, "Usage: %s EZP_DIFF\n", argv[0]);
+        return 2;
+    }
+
+    EZP_SET_CONTROL_NAME("ezp_test_dump")
+    EZP_ENABLE
+
+    //The worker exits before the dump, its runs are dumped from its retired bucket
+    pthread_t worker;
+    pthread_create(&worker, NULL, runBlocks, (void*)RUNS_PER_THREAD);
+    pthread_join(worker, NULL);
+    runBlocks((void*)RUNS_PER_THREAD);
+
+    check(ezp::EasyPerformanceAnalyzer::dumpOfflineProfiles(DUMP_PATH), "dump is written");
+    check(getDumpedRuns(DUMP_PATH) == 2*RUNS_PER_THREAD, "dump holds the runs of the live and of the exited thread");
+    FILE* file = fopen(REPORT_PATH, "w");
+    if(file == NULL)
+        return 2;
+    EZP_WRITE_OFFLINE(file, JSON)
+    fclose(file);
+
+    bool shown;
+    check(diff(argv[1], DUMP_PATH, DUMP_PATH, shown) == 0 && shown, "ezp_diff reads the dump");
+    check(diff(argv[1], DUMP_PATH, REPORT_PATH, shown) == 0 && shown, "ezp_diff aligns the dump with a JSON report of the same runs");
+
+    //A forked child starts from no records and dumps at exit next to the files of its parent
+    pid_t pid = fork();
+    if(pid == 0){
+        EZP_DUMP_ON_EXIT(EXIT_DUMP_PATH)
+        runBlocks((void*)RUNS_IN_CHILD);
+        exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    char exitDumpPath[64];
+    snprintf(exitDumpPath, sizeof(exitDumpPath), "%s.%d", EXIT_DUMP_PATH, pid);
+    check(getDumpedRuns(exitDumpPath) == RUNS_IN_CHILD, "child dumps its own runs at exit to PATH.PID");
+    check(getDumpedRuns(EXIT_DUMP_PATH) == -1, "child does not dump to the path of its parent");
+    remove(DUMP_PATH);
+    remove(REPORT_PATH);
+    remove(exitDumpPath);
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n", argv[0], numFailures);
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
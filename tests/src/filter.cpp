@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file filter.cpp
+ * @brief Turns block and thread filters on and off between runs of offline blocks and checks which runs are counted
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<pthread.h>
+
+#include<ezp.hpp>
+
+#define NUM_RUNS 10
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+static void runBlocks(){
+    for(int i=0;i<NUM_RUNS;i++){
+        EZP_START_OFFLINE("NETA")
+        EZP_END_OFFLINE("NETA")
+        EZP_START_OFFLINE("NETB")
+        EZP_END_OFFLINE("NETB")
+        EZP_START_OFFLINE("DISK")
+        EZP_END_OFFLINE("DISK")
+    }
+}
+
+static void* runSkippedWorker(void*){
+    EZP_SET_THREAD_NAME("skip-1")
+    runBlocks();
+    return NULL;
+}
+
+/**
+ * @brief Gets the runs of a block summed across threads, 0 if it has none
+ */
+static long long getRuns(const char* block){
+    std::string csv;
+    EZP_FORMAT_OFFLINE(csv, CSV)
+    std::string row = std::string("\nsummed,,,\"") + block + "\",";
+    size_t pos = csv.find(row);
+    if(pos == std::string::npos)
+        return 0;
+    return atoll(csv.c_str() + pos + row.size());
+}
+
+int main(int argc, char** argv){
+    EZP_SET_CONTROL_NAME("ezp_test_filter")
+    EZP_ENABLE
+    runBlocks();
+    check(getRuns("NETA") == NUM_RUNS && getRuns("NETB") == NUM_RUNS && getRuns("DISK") == NUM_RUNS, "all blocks count without filters");
+
+    //The last matching filter decides
+    EZP_DISABLE_BLOCKS("")
+    EZP_ENABLE_BLOCKS("NET")
+    runBlocks();
+    check(getRuns("NETA") == 2*NUM_RUNS && getRuns("NETB") == 2*NUM_RUNS, "enabled prefix counts");
+    check(getRuns("DISK") == NUM_RUNS, "block disabled by an earlier filter does not count");
+
+    //A run counts only if neither of its ends was disabled
+    EZP_START_OFFLINE("NETA")
+    EZP_DISABLE_BLOCKS("NETA")
+    EZP_END_OFFLINE("NETA")
+    EZP_START_OFFLINE("NETA")
+    EZP_ENABLE_BLOCKS("NETA")
+    EZP_END_OFFLINE("NETA")
+    check(getRuns("NETA") == 2*NUM_RUNS, "runs with a disabled end do not count");
+    EZP_START_OFFLINE("NETA")
+    EZP_END_OFFLINE("NETA")
+    check(getRuns("NETA") == 2*NUM_RUNS + 1, "block enabled again counts from its next run");
+
+    EZP_RESET_FILTERS
+    EZP_DISABLE_THREADS("skip")
+    pthread_t worker;
+    pthread_create(&worker, NULL, runSkippedWorker, NULL);
+    pthread_join(worker, NULL);
+    runBlocks();
+    check(getRuns("DISK") == 2*NUM_RUNS, "disabled thread does not count, others do");
+
+    EZP_RESET_FILTERS
+    runBlocks();
+    check(getRuns("NETA") == 4*NUM_RUNS + 1 && getRuns("NETB") == 4*NUM_RUNS && getRuns("DISK") == 3*NUM_RUNS,
+            "all blocks count again after the filters are reset");
+
+    if(numFailures > 0){
+        std::string csv;
+        EZP_FORMAT_OFFLINE(csv, CSV)
+        fprintf(stderr, "%s: %d checks failed\n%s", argv[0], numFailures, csv.c_str());
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
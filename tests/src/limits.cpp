@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file limits.cpp
+ * @brief Runs more blocks and pools than the memory limits allow and checks that the overflow lands in the othr record and bucket
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<pthread.h>
+
+#include<ezp.hpp>
+
+#define MAX_RECORDS 3
+#define MAX_POOLS 3
+#define NUM_RUNS 10
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+static void runBlock(const char* name, int numRuns){
+    for(int i=0;i<numRuns;i++){
+        EZP_START_OFFLINE(name)
+        EZP_END_OFFLINE(name)
+    }
+}
+
+static void* runPoolWorker(void* name){
+    EZP_SET_THREAD_NAME((const char*)name)
+    runBlock("POOL", NUM_RUNS);
+    return NULL;
+}
+
+/**
+ * @brief Gets the runs in the CSV row that begins with prefix, 0 if there is none
+ */
+static long long getRuns(const std::string& prefix){
+    std::string csv;
+    EZP_FORMAT_OFFLINE(csv, CSV)
+    size_t pos = csv.find("\n" + prefix);
+    if(pos == std::string::npos)
+        return 0;
+    return atoll(csv.c_str() + pos + 1 + prefix.size());
+}
+
+int main(int argc, char** argv){
+    EZP_SET_CONTROL_NAME("ezp_test_limits")
+    EZP_ENABLE
+
+    //Blocks past the record limit share the othr record of their thread, which is not counted in the limit
+    EZP_SET_MEMORY_LIMITS(MAX_RECORDS, 0, 256)
+    const char* blocks[] = {"BLK1", "BLK2", "BLK3", "BLK4", "BLK5", "BLK6"};
+    for(int i=0;i<6;i++)
+        runBlock(blocks[i], NUM_RUNS);
+    check(getRuns("summed,,,\"BLK1\",") == NUM_RUNS && getRuns("summed,,,\"BLK3\",") == NUM_RUNS, "blocks within the limit have their own records");
+    check(getRuns("summed,,,\"BLK4\",") == 0 && getRuns("summed,,,\"BLK6\",") == 0, "blocks past the limit have no record");
+    check(getRuns("summed,,,\"othr\",") == 3*NUM_RUNS, "runs of blocks past the limit are in the othr record");
+
+    //The reserved name is not analyzed, it would mix with the overflow
+    runBlock("othr", NUM_RUNS);
+    check(getRuns("summed,,,\"othr\",") == 3*NUM_RUNS, "blocks named othr are ignored");
+
+    //Past MAX_POOLS - 1 retired buckets, exited threads of further pools go to the othr bucket
+    EZP_CLEAR_OFFLINE
+    EZP_SET_MEMORY_LIMITS(0, MAX_POOLS, 256)
+    const char* threads[] = {"pa-1", "pb-1", "pc-1", "pd-1", "pa-2"};
+    for(int i=0;i<5;i++){
+        pthread_t worker;
+        pthread_create(&worker, NULL, runPoolWorker, (void*)threads[i]);
+        pthread_join(worker, NULL);
+    }
+    check(getRuns("summed,,,\"POOL\",") == 5*NUM_RUNS, "no run of an exited thread is lost");
+    check(getRuns("thread,-1,\"pa\",\"POOL\",") == 2*NUM_RUNS, "threads of a pool within the limit share its bucket");
+    check(getRuns("thread,-2,\"pb\",\"POOL\",") == NUM_RUNS, "second pool has its own bucket");
+    check(getRuns("thread,-3,\"othr\",\"POOL\",") == 2*NUM_RUNS, "threads of pools past the limit are in the othr bucket");
+
+    if(numFailures > 0){
+        std::string csv;
+        EZP_FORMAT_OFFLINE(csv, CSV)
+        fprintf(stderr, "%s: %d checks failed\n%s", argv[0], numFailures, csv.c_str());
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
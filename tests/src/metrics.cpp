@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file metrics.cpp
+ * @brief Scrapes the OpenMetrics exporter and checks its exposition format
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<sys/socket.h>
+#include<sys/un.h>
+
+#include<ezp.hpp>
+
+#define NUM_RUNS 100
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+/**
+ * @brief Sends a GET request to the exporter listening on an abstract UNIX socket and reads the whole response
+ */
+static bool scrape(const char* name, std::string& response){
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path + 1, name, sizeof(addr.sun_path) - 2);
+    socklen_t addrLen = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(name);
+
+    //The exporter thread may not be accepting yet
+    bool connected = false;
+    for(int i=0;i<100 && !connected;i++){
+        connected = connect(fd, (struct sockaddr*)&addr, addrLen) == 0;
+        if(!connected)
+            usleep(10000);
+    }
+    if(!connected){
+        close(fd);
+        return false;
+    }
+
+    const char* request = "GET /metrics HTTP/1.0\r\n\r\n";
+    if(write(fd, request, strlen(request)) != (ssize_t)strlen(request)){
+        close(fd);
+        return false;
+    }
+    char buf[4096];
+    ssize_t ret;
+    while((ret = read(fd, buf, sizeof(buf))) > 0)
+        response.append(buf, ret);
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief Gets the value of the sample of a series, -1 if the series is missing
+ */
+static long long getSample(const std::string& body, const std::string& series){
+    size_t pos = body.find("\n" + series + " ");
+    if(pos == std::string::npos)
+        return -1;
+    return atoll(body.c_str() + pos + series.size() + 2);
+}
+
+int main(int argc, char** argv){
+    EZP_SET_CONTROL_NAME("ezp_test_metrics")
+    EZP_ENABLE
+    EZP_BEGIN_EXPORTER("unix:ezp_test_metrics_exporter")
+
+    volatile int x = 0;
+    for(int i=0;i<NUM_RUNS;i++){
+        EZP_START_OFFLINE("TEST")
+        for(int j=0;j<1000;j++)
+            x += j;
+        EZP_END_OFFLINE("TEST")
+    }
+
+    std::string response;
+    check(scrape("ezp_test_metrics_exporter", response), "connect to the exporter");
+
+    size_t headerEnd = response.find("\r\n\r\n");
+    check(headerEnd != std::string::npos, "complete HTTP header");
+    if(numFailures > 0)
+        return 1;
+    std::string header = response.substr(0, headerEnd);
+    std::string body = response.substr(headerEnd + 4);
+
+    check(header.compare(0, 15, "HTTP/1.0 200 OK") == 0, "status 200");
+    check(header.find("Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8") != std::string::npos, "OpenMetrics content type");
+    size_t lengthPos = header.find("Content-Length: ");
+    check(lengthPos != std::string::npos && (size_t)atol(header.c_str() + lengthPos + 16) == body.size(), "Content-Length of the body");
+
+    //Metadata comes before the samples of the family, and the exposition ends with # EOF
+    check(body.find("# TYPE ezp_block_summed_seconds histogram\n") == 0, "TYPE line first");
+    check(body.find("# UNIT ezp_block_summed_seconds seconds\n") != std::string::npos, "UNIT line");
+    check(body.find("# HELP ezp_block_summed_seconds ") != std::string::npos, "HELP line");
+    check(body.size() >= 6 && body.compare(body.size() - 6, 6, "# EOF\n") == 0, "# EOF at the end");
+    check(body.find("# EOF") == body.size() - 6, "a single # EOF");
+
+    //Buckets are cumulative and end with +Inf equal to the count
+    long long count = getSample(body, "ezp_block_summed_seconds_count{block=\"TEST\"}");
+    check(count == NUM_RUNS, "count of the runs");
+    long long previous = 0;
+    for(int i=0;i<EZP_HISTOGRAM_BUCKETS - 1;i++){
+        char series[128];
+        snprintf(series, sizeof(series), "ezp_block_summed_seconds_bucket{block=\"TEST\",le=\"%.10g\"}", ldexp(1e-9, i));
+        long long bucket = getSample(body, series);
+        check(bucket >= previous, "cumulative buckets");
+        previous = bucket;
+    }
+    check(getSample(body, "ezp_block_summed_seconds_bucket{block=\"TEST\",le=\"+Inf\"}") == count, "+Inf bucket equal to the count");
+    check(body.find("\nezp_block_summed_seconds_sum{block=\"TEST\"} ") != std::string::npos, "sum of the runs");
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed, exposition was:\n%s", argv[0], numFailures, body.c_str());
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
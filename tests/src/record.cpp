@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file record.cpp
+ * @brief Records blocks of two threads, decodes the recording with ezp_decode and checks that every block comes back once
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<pthread.h>
+
+#include<ezp.hpp>
+
+#define RECORDING_PATH "test-record.ezr"
+#define RUNS_PER_THREAD 1000
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+static void* runBlocks(void*){
+    for(int i=0;i<RUNS_PER_THREAD;i++){
+        EZP_START_OFFLINE("REC")
+        EZP_END_OFFLINE("REC")
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs ezp_decode with options on the recording, returns its exit status and the number of output lines that hold block
+ */
+static int decode(const char* decoder, const char* options, const char* block, int& numLines){
+    std::string command = std::string(decoder) + " " + options + " " RECORDING_PATH " 2>/dev/null";
+    FILE* output = popen(command.c_str(), "r");
+    if(output == NULL)
+        return -1;
+    numLines = 0;
+    char line[1024];
+    while(fgets(line, sizeof(line), output) != NULL)
+        if(strstr(line, block) != NULL)
+            numLines++;
+    return pclose(output);
+}
+
+int main(int argc, char** argv){
+    if(argc != 2){
+        fprintf(stderr, "Usage: %s EZP_DECODE\n", argv[0]);
+        return 2;
+    }
+
+    EZP_SET_CONTROL_NAME("ezp_test_record")
+    EZP_ENABLE
+    EZP_BEGIN_RECORDING(RECORDING_PATH)
+    pthread_t worker;
+    pthread_create(&worker, NULL, runBlocks, NULL);
+    runBlocks(NULL);
+    pthread_join(worker, NULL);
+    EZP_END_RECORDING
+
+    int numLines;
+    check(decode(argv[1], "-f csv", "\"REC\"", numLines) == 0, "ezp_decode succeeds");
+    check(numLines == 2*RUNS_PER_THREAD, "CSV holds every recorded block once");
+    check(decode(argv[1], "-f csv -j 1000000000", "\"REC\"", numLines) == 0 && numLines == 2*RUNS_PER_THREAD,
+            "more jobs than chunks decode the same blocks");
+    check(decode(argv[1], "-f chrome -j 1", "\"name\":\"REC\"", numLines) == 0 && numLines == 2*RUNS_PER_THREAD,
+            "Chrome trace holds every recorded block once");
+    check(decode(argv[1], "-j 0", "REC", numLines) != 0, "zero jobs are rejected");
+    check(decode(argv[1], "-j x", "REC", numLines) != 0, "jobs that are not a number are rejected");
+    check(decode(argv[1], "-l", "Process", numLines) == 0 && numLines == 1, "chunks are listed");
+    remove(RECORDING_PATH);
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n", argv[0], numFailures);
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
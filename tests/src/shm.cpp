@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file shm.cpp
+ * @brief Pulls the shared memory segment of a child whose thread exits between two pulls and that clears its records before a third,
+ * and checks that every run is counted exactly once
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<pthread.h>
+#include<sys/wait.h>
+
+#include<ezp.hpp>
+
+#define RUNS_BEFORE_PULL 100
+#define RUNS_BEFORE_EXIT 50
+#define RUNS_AFTER_EXIT 20
+#define RUNS_AFTER_CLEAR 400
+
+static int numFailures = 0;
+static int toParent[2];
+static int toChild[2];
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+static void send(int fd){
+    char c = 0;
+    if(write(fd, &c, 1) != 1)
+        exit(2);
+}
+
+static void receive(int fd){
+    char c;
+    if(read(fd, &c, 1) != 1)
+        exit(2);
+}
+
+static void runBlocks(int numRuns){
+    for(int i=0;i<numRuns;i++){
+        EZP_START_OFFLINE("WRK")
+        EZP_END_OFFLINE("WRK")
+    }
+}
+
+//Runs blocks before the first pull and between the pulls, then exits so that its records move to a retired bucket
+static void* runWorker(void*){
+    runBlocks(RUNS_BEFORE_PULL);
+    send(toParent[1]);
+    receive(toChild[0]);
+    runBlocks(RUNS_BEFORE_EXIT);
+    return NULL;
+}
+
+static void runChild(){
+    EZP_SET_CONTROL_NAME("ezp_test_shm")
+    EZP_ENABLE
+    EZP_BEGIN_SHARED_STATS
+
+    pthread_t worker;
+    pthread_create(&worker, NULL, runWorker, NULL);
+    pthread_join(worker, NULL);
+    runBlocks(RUNS_AFTER_EXIT);
+    send(toParent[1]);
+
+    //More runs than any record held before the clear, so that they cannot pass for what is left to pull of them
+    receive(toChild[0]);
+    EZP_CLEAR_OFFLINE
+    runBlocks(RUNS_AFTER_CLEAR);
+    send(toParent[1]);
+
+    //The segment is unlinked at exit, stay until the parent is done with it
+    receive(toChild[0]);
+}
+
+/**
+ * @brief Gets the runs of WRK summed across the retired buckets of pulled processes, -1 if there are none
+ */
+static long long getPulledRuns(){
+    std::string csv;
+    EZP_FORMAT_OFFLINE(csv, CSV)
+    const char* row = "\nsummed,,,\"WRK\",";
+    size_t pos = csv.find(row);
+    if(pos == std::string::npos)
+        return -1;
+    return atoll(csv.c_str() + pos + strlen(row));
+}
+
+int main(int argc, char** argv){
+    if(pipe(toParent) == -1 || pipe(toChild) == -1)
+        return 2;
+    pid_t pid = fork();
+    if(pid == 0){
+        runChild();
+        return 0;
+    }
+
+    receive(toParent[0]);
+    check(ezp::EasyPerformanceAnalyzer::pullSharedStats() >= 1, "first pull finds the child");
+    check(getPulledRuns() == RUNS_BEFORE_PULL, "first pull counts the runs of the worker");
+    send(toChild[1]);
+
+    receive(toParent[0]);
+    EZP_PULL_SHARED_STATS
+    check(getPulledRuns() == RUNS_BEFORE_PULL + RUNS_BEFORE_EXIT + RUNS_AFTER_EXIT, "second pull counts every run once");
+    send(toChild[1]);
+
+    receive(toParent[0]);
+    EZP_PULL_SHARED_STATS
+    check(getPulledRuns() == RUNS_BEFORE_PULL + RUNS_BEFORE_EXIT + RUNS_AFTER_EXIT + RUNS_AFTER_CLEAR, "pull after a clear counts the new runs from zero");
+    send(toChild[1]);
+    waitpid(pid, NULL, 0);
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed, pulled %lld runs\n", argv[0], numFailures, getPulledRuns());
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}
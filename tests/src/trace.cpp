@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2014 EPFL
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/.
+ */
+
+/**
+ * @file trace.cpp
+ * @brief Runs a block over and under its trace threshold in a child and checks the traces that the child wrote until it exited
+ * @date 2026-10-18
+ */
+
+#include<cstdlib>
+#include<string>
+#include<sys/wait.h>
+
+#include<ezp.hpp>
+
+#define TRACE_PATH "test-trace"
+#define NUM_FAST_RUNS 300
+#define NUM_SLOW_RUNS (EZP_MAX_TRACES + 2)
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what){
+    if(!condition){
+        fprintf(stderr, "FAILED: %s\n", what);
+        numFailures++;
+    }
+}
+
+/**
+ * @brief Keeps the CPU busy for a time, traces are timed in thread CPU time
+ */
+static void spin(double ms){
+    struct timespec begin, now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    do
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    while((now.tv_sec - begin.tv_sec)*1e3 + (now.tv_nsec - begin.tv_nsec)/1e6 < ms);
+}
+
+static void runSlow(double ms){
+    EZP_START_OFFLINE("SLOW")
+    spin(ms);
+    EZP_END_OFFLINE("SLOW")
+}
+
+//Traces are written by a background thread that is flushed at exit
+static void runChild(){
+    EZP_SET_CONTROL_NAME("ezp_test_trace")
+    EZP_ENABLE
+    EZP_SET_TRACE_PATH(TRACE_PATH)
+    EZP_SET_TRACE_THRESHOLD("SLOW", 2)
+    for(int i=0;i<NUM_FAST_RUNS;i++){
+        EZP_START_OFFLINE("FAST")
+        EZP_END_OFFLINE("FAST")
+    }
+    runSlow(0.5);
+    runSlow(5);
+
+    //Without a threshold no trace is written
+    EZP_SET_TRACE_THRESHOLD("SLOW", 0)
+    runSlow(5);
+
+    //A threshold set again allows EZP_MAX_TRACES more
+    EZP_SET_TRACE_THRESHOLD("SLOW", 1)
+    for(int i=0;i<NUM_SLOW_RUNS;i++)
+        runSlow(1.5);
+}
+
+/**
+ * @brief Reads a whole trace written by the child, empty if there is none
+ */
+static std::string readTrace(int index){
+    char path[64];
+    snprintf(path, sizeof(path), "%s.%d.json", TRACE_PATH, index);
+    std::string contents;
+    FILE* file = fopen(path, "r");
+    if(file == NULL)
+        return contents;
+    char buf[4096];
+    size_t length;
+    while((length = fread(buf, 1, sizeof(buf), file)) > 0)
+        contents.append(buf, length);
+    fclose(file);
+    remove(path);
+    return contents;
+}
+
+static int count(const std::string& text, const char* pattern){
+    int num = 0;
+    for(size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        num++;
+    return num;
+}
+
+int main(int argc, char** argv){
+    //The parent never ran EZP, so the child is the first instrumented process and its paths have no .PID suffix
+    pid_t pid = fork();
+    if(pid == 0){
+        runChild();
+        return 0;
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "child exits");
+
+    std::string trace = readTrace(0);
+    check(count(trace, "\"trigger\":\"SLOW\"") == 1, "block over its threshold writes a trace");
+    check(count(trace, "\"ph\":\"X\"") == EZP_TRACE_RING_SIZE, "trace holds a full ring of the last blocks");
+    check(count(trace, "\"name\":\"SLOW\"") == 2, "trace holds the run under the threshold and the one over it");
+    check(count(trace, "\"trigger\":true") == 1, "last block of the trace is marked as the trigger");
+
+    int numTraces = 0;
+    for(int i=1;i<=NUM_SLOW_RUNS;i++)
+        if(!readTrace(i).empty())
+            numTraces++;
+    check(numTraces == EZP_MAX_TRACES, "at most EZP_MAX_TRACES traces are written after a threshold is set");
+
+    if(numFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n", argv[0], numFailures);
+        return 1;
+    }
+    printf("%s: OK\n", argv[0]);
+    return 0;
+}